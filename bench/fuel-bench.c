@@ -0,0 +1,156 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "warp.h"
+
+#define NUM_ROUNDS  8u
+
+//(func $sum (param $n i32) (param $acc i32) (result i32)), a loop of $n
+//back-edges, and (func $fib (param i32) (result i32)), recursive calls
+static uint8_t mdle_bytes[] = {
+    0x00, 0x61, 0x73, 0x6d, 0x01, 0x00, 0x00, 0x00, 0x01, 0x0c, 0x02, 0x60,
+    0x02, 0x7f, 0x7f, 0x01, 0x7f, 0x60, 0x01, 0x7f, 0x01, 0x7f, 0x03, 0x03,
+    0x02, 0x00, 0x01, 0x07, 0x0d, 0x02, 0x03, 0x73, 0x75, 0x6d, 0x00, 0x00,
+    0x03, 0x66, 0x69, 0x62, 0x00, 0x01, 0x0a, 0x3e, 0x02, 0x1f, 0x00, 0x02,
+    0x40, 0x03, 0x40, 0x20, 0x00, 0x45, 0x0d, 0x01, 0x20, 0x01, 0x20, 0x00,
+    0x6a, 0x21, 0x01, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x21, 0x00, 0x0c, 0x00,
+    0x0b, 0x0b, 0x20, 0x01, 0x0b, 0x1c, 0x00, 0x20, 0x00, 0x41, 0x02, 0x48,
+    0x04, 0x7f, 0x20, 0x00, 0x05, 0x20, 0x00, 0x41, 0x01, 0x6b, 0x10, 0x01,
+    0x20, 0x00, 0x41, 0x02, 0x6b, 0x10, 0x01, 0x6a, 0x0b, 0x0b,
+};
+
+typedef struct bench_case {
+    const char *name;
+    const char *func;
+    int32_t args[2];
+    uint32_t num_args;
+    int32_t result;
+} bench_case_t;
+
+static const bench_case_t cases[] = {
+    {"loop 1M", "sum", {1000000, 0}, 2, 1784293664},
+    {"fib 24", "fib", {24}, 1, 46368},
+};
+
+static void *bench_alloc(size_t size, size_t align)
+{
+    //over allocate and store the adjustment in the byte before the aligned pointer
+    size_t actual_align = align > 1 ? align : 1;
+    uint8_t *ptr = malloc(size + actual_align);
+
+    if (!ptr) {
+        return NULL;
+    }
+
+    size_t adjustment = actual_align - ((uintptr_t)ptr & (actual_align - 1));
+    ptr[adjustment - 1] = (uint8_t)adjustment;
+    return ptr + adjustment;
+}
+
+static void bench_free(void *ptr)
+{
+    uint8_t *aligned_ptr = ptr;
+    free(aligned_ptr - aligned_ptr[-1]);
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+//out_fuel is what one metered call was charged, its bodies and loop
+//iterations
+static double run(wrp_vm_t *vm, const bench_case_t *bench, bool metered, uint64_t *out_fuel)
+{
+    uint32_t func_idx = 0;
+
+    if (wrp_export_func(vm->mdle, bench->func, &func_idx) != WRP_SUCCESS) {
+        fprintf(stderr, "missing export %s\n", bench->func);
+        exit(EXIT_FAILURE);
+    }
+
+    double start = now_sec();
+
+    for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+        wrp_reset_vm(vm);
+
+        if (metered) {
+            wrp_set_fuel(vm, UINT64_MAX);
+        } else {
+            wrp_disable_fuel(vm);
+        }
+
+        for (uint32_t i = 0; i < bench->num_args; i++) {
+            wrp_stk_exec_push_i32(vm, bench->args[i]);
+        }
+
+        int32_t result = 0;
+
+        if (wrp_call(vm, func_idx) != WRP_SUCCESS || wrp_stk_exec_pop_i32(vm, &result) != WRP_SUCCESS ||
+            result != bench->result) {
+            fprintf(stderr, "%s failed: %s, result %d\n", bench->name, wrp_debug_err(vm->err), result);
+            exit(EXIT_FAILURE);
+        }
+
+        *out_fuel = metered ? UINT64_MAX - wrp_get_fuel(vm) : 0;
+    }
+
+    return (now_sec() - start) * 1e3 / NUM_ROUNDS;
+}
+
+int main(void)
+{
+    wrp_vm_t *vm = wrp_open_vm(bench_alloc, bench_free);
+
+    if (vm == NULL) {
+        fprintf(stderr, "failed to open vm\n");
+        return EXIT_FAILURE;
+    }
+
+    wrp_buf_t buf = {.bytes = mdle_bytes, .sz = sizeof(mdle_bytes), .pos = 0};
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
+    wrp_instance_t *instance = mdle != NULL ? wrp_create_instance(vm, mdle) : NULL;
+
+    if (instance == NULL || wrp_link_instance(vm, instance) != WRP_SUCCESS) {
+        fprintf(stderr, "failed to load module: %s\n", wrp_debug_err(vm->err));
+        return EXIT_FAILURE;
+    }
+
+    printf("%-10s %14s %14s %10s %14s\n", "fuel", "unmetered ms", "metered ms", "overhead", "fuel charged");
+
+    for (uint32_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint64_t fuel = 0;
+        double unmetered_ms = run(vm, &cases[i], false, &fuel);
+        double metered_ms = run(vm, &cases[i], true, &fuel);
+        double overhead = (metered_ms / unmetered_ms - 1.0) * 100.0;
+        printf("%-10s %14.2f %14.2f %9.1f%% %14llu\n", cases[i].name, unmetered_ms, metered_ms, overhead,
+            (unsigned long long)fuel);
+    }
+
+    wrp_unlink_instance(vm);
+    wrp_destroy_instance(vm, instance);
+    wrp_destroy_mdle(vm, mdle);
+    wrp_close_vm(vm);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "warp-buf.h"
+#include "warp-error.h"
+
+#define NUM_VALUES  (1u << 20)
+#define NUM_ROUNDS  32u
+
+//byte at a time decoder the fast paths replaced, kept as the baseline
+static bool read_LEB_baseline(wrp_buf_t *buf, uint32_t max_bits, bool sign_extend, uint64_t *out_value)
+{
+    size_t max_bytes = ((max_bits + 7 - 1) / 7);
+    uint32_t num_bytes = 0;
+    uint64_t result = 0;
+    uint32_t shift = 0;
+    uint64_t byte = 0;
+
+    while (true) {
+        if (wrp_end_of_buf(buf)) {
+            return false;
+        }
+
+        byte = buf->bytes[buf->pos++];
+
+        if (shift < 64) {
+            result |= ((byte & 0x7f) << shift);
+        }
+
+        shift += 7;
+
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+
+        num_bytes += 1;
+
+        if (num_bytes > max_bytes) {
+            return false;
+        }
+    }
+
+    if (sign_extend && (shift < max_bits) && (byte & 0x40)) {
+        result |= ~0ull << shift;
+    }
+
+    *out_value = result;
+    return true;
+}
+
+//the baseline used to sit behind a call into warp-buf.c, keep it out of line
+static bool (*volatile baseline_fn)(wrp_buf_t *, uint32_t, bool, uint64_t *) = read_LEB_baseline;
+
+static size_t write_uleb(uint8_t *bytes, uint64_t value)
+{
+    size_t sz = 0;
+
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        bytes[sz++] = byte | (value != 0 ? 0x80 : 0);
+    } while (value != 0);
+
+    return sz;
+}
+
+static size_t write_sleb(uint8_t *bytes, int64_t value)
+{
+    size_t sz = 0;
+    bool more = true;
+
+    while (more) {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        more = !((value == 0 && (byte & 0x40) == 0) || (value == -1 && (byte & 0x40) != 0));
+        bytes[sz++] = byte | (more ? 0x80 : 0);
+    }
+
+    return sz;
+}
+
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+typedef enum {
+    BENCH_U32_SMALL,
+    BENCH_U32_MIXED,
+    BENCH_S64_MIXED
+} bench_kind_t;
+
+static size_t make_values(bench_kind_t kind, uint8_t *bytes, uint64_t *values)
+{
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    size_t sz = 0;
+
+    for (uint32_t i = 0; i < NUM_VALUES; i++) {
+        uint64_t random = next_random(&state);
+
+        if (kind == BENCH_U32_SMALL) {
+            values[i] = random & 0x7f;
+            sz += write_uleb(&bytes[sz], values[i]);
+        } else if (kind == BENCH_U32_MIXED) {
+            //mostly small indices with a tail of larger immediates
+            uint32_t bits = (uint32_t[]){7, 7, 7, 14, 14, 21, 28, 32}[random & 7];
+            values[i] = (random >> 8) & (bits == 32 ? 0xffffffffull : ((1ull << bits) - 1));
+            sz += write_uleb(&bytes[sz], values[i]);
+        } else {
+            uint32_t bits = (uint32_t[]){7, 7, 14, 21, 32, 45, 56, 64}[random & 7];
+            int64_t value = (int64_t)(next_random(&state) >> (64 - bits));
+            values[i] = (uint64_t)(bits < 64 && (random & 8) ? -value : value);
+            sz += write_sleb(&bytes[sz], (int64_t)values[i]);
+        }
+    }
+
+    return sz;
+}
+
+static bool decode(bench_kind_t kind, wrp_buf_t *buf, bool baseline, uint64_t *out_value)
+{
+    if (baseline) {
+        return baseline_fn(buf, kind == BENCH_S64_MIXED ? 64 : 32, kind == BENCH_S64_MIXED, out_value);
+    }
+
+    if (kind == BENCH_S64_MIXED) {
+        int64_t value = 0;
+        bool ok = wrp_read_vari64(buf, &value) == WRP_SUCCESS;
+        *out_value = (uint64_t)value;
+        return ok;
+    }
+
+    uint32_t value = 0;
+    bool ok = wrp_read_varui32(buf, &value) == WRP_SUCCESS;
+    *out_value = value;
+    return ok;
+}
+
+static double run(bench_kind_t kind, uint8_t *bytes, size_t sz, uint64_t *values, bool baseline)
+{
+    wrp_buf_t buf = {.bytes = bytes, .sz = sz, .pos = 0};
+    uint64_t checksum = 0;
+    double start = now_sec();
+
+    for (uint32_t round = 0; round < NUM_ROUNDS; round++) {
+        buf.pos = 0;
+
+        for (uint32_t i = 0; i < NUM_VALUES; i++) {
+            uint64_t value = 0;
+
+            if (!decode(kind, &buf, baseline, &value)) {
+                fprintf(stderr, "decode failed at value %u\n", i);
+                exit(EXIT_FAILURE);
+            }
+
+            checksum += value;
+        }
+    }
+
+    double elapsed = now_sec() - start;
+
+    //verify once, outside of the timed loop
+    buf.pos = 0;
+
+    for (uint32_t i = 0; i < NUM_VALUES; i++) {
+        uint64_t value = 0;
+        decode(kind, &buf, baseline, &value);
+
+        if (value != values[i]) {
+            fprintf(stderr, "value %u decoded as %llx, expected %llx\n",
+                i, (unsigned long long)value, (unsigned long long)values[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (checksum == 1) {
+        printf("\n");
+    }
+
+    return elapsed * 1e9 / ((double)NUM_VALUES * NUM_ROUNDS);
+}
+
+int main(void)
+{
+    static const char *names[] = {"u32 one byte", "u32 mixed", "s64 mixed"};
+
+    uint8_t *bytes = malloc(NUM_VALUES * 10 + 16);
+    uint64_t *values = malloc(NUM_VALUES * sizeof(uint64_t));
+
+    if (bytes == NULL || values == NULL) {
+        fprintf(stderr, "failed to allocate benchmark buffers\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%-14s %12s %12s %10s\n", "leb128", "baseline ns", "warp ns", "speedup");
+
+    for (bench_kind_t kind = BENCH_U32_SMALL; kind <= BENCH_S64_MIXED; kind++) {
+        size_t sz = make_values(kind, bytes, values);
+        double baseline_ns = run(kind, bytes, sz, values, true);
+        double warp_ns = run(kind, bytes, sz, values, false);
+        printf("%-14s %12.2f %12.2f %9.2fx\n", names[kind], baseline_ns, warp_ns, baseline_ns / warp_ns);
+    }
+
+    free(values);
+    free(bytes);
+    return EXIT_SUCCESS;
+}
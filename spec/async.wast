@@ -0,0 +1,7 @@
+(module
+  (import "env" "load" (func $load (param i32) (result i32)))
+  (func (export "load_sum") (param i32 i32) (result i32)
+    (i32.add (call $load (get_local 0)) (call $load (get_local 1)))
+  )
+  (export "load" (func $load))
+)
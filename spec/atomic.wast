@@ -0,0 +1,98 @@
+(module
+  (memory (export "memory") 1 2 shared)
+
+  (func (export "store") (param i32 i32) (i32.atomic.store (get_local 0) (get_local 1)))
+  (func (export "load") (param i32) (result i32) (i32.atomic.load (get_local 0)))
+  (func (export "add") (param i32 i32) (result i32) (i32.atomic.rmw.add (get_local 0) (get_local 1)))
+  (func (export "sub") (param i32 i32) (result i32) (i32.atomic.rmw.sub (get_local 0) (get_local 1)))
+  (func (export "and") (param i32 i32) (result i32) (i32.atomic.rmw.and (get_local 0) (get_local 1)))
+  (func (export "or") (param i32 i32) (result i32) (i32.atomic.rmw.or (get_local 0) (get_local 1)))
+  (func (export "xor") (param i32 i32) (result i32) (i32.atomic.rmw.xor (get_local 0) (get_local 1)))
+  (func (export "xchg") (param i32 i32) (result i32) (i32.atomic.rmw.xchg (get_local 0) (get_local 1)))
+  (func (export "cmpxchg") (param i32 i32 i32) (result i32)
+    (i32.atomic.rmw.cmpxchg (get_local 0) (get_local 1) (get_local 2))
+  )
+  (func (export "load8_u") (param i32) (result i32) (i32.atomic.load8_u (get_local 0)))
+  (func (export "add8_u") (param i32 i32) (result i32) (i32.atomic.rmw8.add_u (get_local 0) (get_local 1)))
+  (func (export "i64.add") (param i32 i64) (result i64) (i64.atomic.rmw.add (get_local 0) (get_local 1)))
+  (func (export "i64.load") (param i32) (result i64) (i64.atomic.load (get_local 0)))
+  (func (export "notify") (param i32 i32) (result i32) (memory.atomic.notify (get_local 0) (get_local 1)))
+  (func (export "wait32") (param i32 i32 i64) (result i32)
+    (memory.atomic.wait32 (get_local 0) (get_local 1) (get_local 2))
+  )
+  (func (export "wait64") (param i32 i64 i64) (result i32)
+    (memory.atomic.wait64 (get_local 0) (get_local 1) (get_local 2))
+  )
+  (func (export "fence") (atomic.fence))
+  (func (export "grow_memory") (param i32) (result i32) (grow_memory (get_local 0)))
+)
+
+(assert_return (invoke "store" (i32.const 0) (i32.const 5)))
+(assert_return (invoke "load" (i32.const 0)) (i32.const 5))
+(assert_return (invoke "add" (i32.const 0) (i32.const 3)) (i32.const 5))
+(assert_return (invoke "sub" (i32.const 0) (i32.const 1)) (i32.const 8))
+(assert_return (invoke "and" (i32.const 0) (i32.const 0xe)) (i32.const 7))
+(assert_return (invoke "or" (i32.const 0) (i32.const 0x10)) (i32.const 6))
+(assert_return (invoke "xor" (i32.const 0) (i32.const 0x13)) (i32.const 0x16))
+(assert_return (invoke "xchg" (i32.const 0) (i32.const 7)) (i32.const 5))
+(assert_return (invoke "cmpxchg" (i32.const 0) (i32.const 7) (i32.const 9)) (i32.const 7))
+(assert_return (invoke "cmpxchg" (i32.const 0) (i32.const 7) (i32.const 1)) (i32.const 9))
+(assert_return (invoke "load" (i32.const 0)) (i32.const 9))
+(assert_trap (invoke "load" (i32.const 1)) "unaligned atomic")
+(assert_trap (invoke "load" (i32.const 0x20000)) "out of bounds memory access")
+(assert_return (invoke "store" (i32.const 8) (i32.const 0x1ff)))
+(assert_return (invoke "add8_u" (i32.const 8) (i32.const 1)) (i32.const 0xff))
+(assert_return (invoke "load" (i32.const 8)) (i32.const 0x100))
+(assert_return (invoke "load8_u" (i32.const 9)) (i32.const 1))
+(assert_return (invoke "i64.add" (i32.const 16) (i64.const 0x100000000)) (i64.const 0))
+(assert_return (invoke "i64.load" (i32.const 16)) (i64.const 0x100000000))
+(assert_return (invoke "notify" (i32.const 0) (i32.const 1)) (i32.const 0))
+(assert_return (invoke "wait32" (i32.const 0) (i32.const 1) (i64.const 0)) (i32.const 1))
+(assert_return (invoke "wait32" (i32.const 0) (i32.const 9) (i64.const 0)) (i32.const 2))
+(assert_return (invoke "wait64" (i32.const 16) (i64.const 0) (i64.const 0)) (i32.const 1))
+(assert_return (invoke "wait64" (i32.const 16) (i64.const 0x100000000) (i64.const 1000)) (i32.const 2))
+(assert_trap (invoke "wait32" (i32.const 2) (i32.const 0) (i64.const 0)) "unaligned atomic")
+(assert_return (invoke "fence"))
+(assert_return (invoke "grow_memory" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "load" (i32.const 0x1fffc)) (i32.const 0))
+(assert_return (invoke "grow_memory" (i32.const 1)) (i32.const -1))
+
+(register "env")
+
+(module
+  (import "env" "memory" (memory 1 2 shared))
+
+  (data (i32.const 64) "\2a")
+
+  (func (export "add") (param i32 i32) (result i32) (i32.atomic.rmw.add (get_local 0) (get_local 1)))
+  (func (export "load") (param i32) (result i32) (i32.atomic.load (get_local 0)))
+)
+
+(assert_return (invoke "load" (i32.const 64)) (i32.const 42))
+(assert_return (invoke "add" (i32.const 0) (i32.const 1)) (i32.const 9))
+(assert_return (invoke "load" (i32.const 0x1fffc)) (i32.const 0))
+
+(module
+  (memory 1)
+
+  (func (export "wait32") (param i32 i32 i64) (result i32)
+    (memory.atomic.wait32 (get_local 0) (get_local 1) (get_local 2))
+  )
+  (func (export "notify") (param i32 i32) (result i32) (memory.atomic.notify (get_local 0) (get_local 1)))
+)
+
+(assert_trap (invoke "wait32" (i32.const 0) (i32.const 0) (i64.const 0)) "expected shared memory")
+(assert_return (invoke "notify" (i32.const 0) (i32.const 1)) (i32.const 0))
+
+(assert_invalid
+  (module (memory 1 shared))
+  "shared memory must have maximum"
+)
+(assert_invalid
+  (module (memory 1 1 shared) (func (param i32) (result i32) (i32.atomic.load align=2 (get_local 0))))
+  "alignment must be equal to natural alignment"
+)
+(assert_invalid
+  (module (func (param i32) (result i32) (i32.atomic.load (get_local 0))))
+  "unknown memory"
+)
@@ -0,0 +1,34 @@
+(module
+  (func $sum (export "sum") (param $n i32) (param $acc i32) (result i32)
+    (block
+      (loop
+        (br_if 1 (i32.eqz (get_local $n)))
+        (set_local $acc (i32.add (get_local $acc) (get_local $n)))
+        (set_local $n (i32.sub (get_local $n) (i32.const 1)))
+        (br 0)
+      )
+    )
+    (get_local $acc)
+  )
+  (func (export "spin") (loop (br 0)))
+  (func (export "twice") (param i32) (result i32)
+    (i32.add (call $sum (get_local 0) (i32.const 0)) (call $sum (get_local 0) (i32.const 0)))
+  )
+  (func (export "clamp") (param i32) (result i32)
+    (if (result i32) (i32.lt_s (get_local 0) (i32.const 0))
+      (then (i32.const 0))
+      (else
+        (if (result i32) (i32.gt_s (get_local 0) (i32.const 100))
+          (then (i32.const 100))
+          (else (get_local 0))
+        )
+      )
+    )
+  )
+)
+
+(assert_return (invoke "sum" (i32.const 10) (i32.const 0)) (i32.const 55))
+(assert_return (invoke "twice" (i32.const 10)) (i32.const 110))
+(assert_return (invoke "clamp" (i32.const -5)) (i32.const 0))
+(assert_return (invoke "clamp" (i32.const 50)) (i32.const 50))
+(assert_return (invoke "clamp" (i32.const 500)) (i32.const 100))
@@ -0,0 +1,38 @@
+(module
+  (import "env" "global" (global $counter (mut i32)))
+  (global $sp (export "sp") (mut i32) (i32.const 3))
+
+  (func (export "get_sp") (result i32) (get_global $sp))
+  (func (export "set_sp") (param i32) (set_global $sp (get_local 0)))
+  (func (export "bump") (result i32)
+    (set_global $counter (i32.add (get_global $counter) (i32.const 1)))
+    (get_global $counter)
+  )
+)
+
+(assert_return (invoke "get_sp") (i32.const 3))
+(invoke "set_sp" (i32.const 8))
+(assert_return (invoke "get_sp") (i32.const 8))
+
+(module
+  (import "env" "global" (global $base i32))
+  (global $based i32 (get_global $base))
+
+  (func (export "get_based") (result i32) (get_global $based))
+)
+
+(assert_invalid
+  (module
+    (global i32 (i32.const 1))
+    (func (export "set") (param i32) (set_global 0 (get_local 0)))
+  )
+  "global is immutable"
+)
+
+(assert_invalid
+  (module
+    (import "env" "global" (global (mut i32)))
+    (global i32 (get_global 0))
+  )
+  "constant expression required"
+)
@@ -0,0 +1,11 @@
+(module
+  (memory 1)
+  (data (i32.const 0) "\07")
+
+  (func (export "store") (param i32) (i32.store (i32.const 0) (get_local 0)))
+  (func (export "load") (result i32) (i32.load (i32.const 0)))
+)
+
+(assert_return (invoke "load") (i32.const 7))
+(invoke "store" (i32.const 5))
+(assert_return (invoke "load") (i32.const 5))
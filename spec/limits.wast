@@ -0,0 +1,329 @@
+(module
+  (func (export "f0") (result i32) (i32.const 0))
+  (func (export "f1") (result i32) (i32.const 1))
+  (func (export "f2") (result i32) (i32.const 2))
+  (func (export "f3") (result i32) (i32.const 3))
+  (func (export "f4") (result i32) (i32.const 4))
+  (func (export "f5") (result i32) (i32.const 5))
+  (func (export "f6") (result i32) (i32.const 6))
+  (func (export "f7") (result i32) (i32.const 7))
+  (func (export "f8") (result i32) (i32.const 8))
+  (func (export "f9") (result i32) (i32.const 9))
+  (func (export "f10") (result i32) (i32.const 10))
+  (func (export "f11") (result i32) (i32.const 11))
+  (func (export "f12") (result i32) (i32.const 12))
+  (func (export "f13") (result i32) (i32.const 13))
+  (func (export "f14") (result i32) (i32.const 14))
+  (func (export "f15") (result i32) (i32.const 15))
+  (func (export "f16") (result i32) (i32.const 16))
+  (func (export "f17") (result i32) (i32.const 17))
+  (func (export "f18") (result i32) (i32.const 18))
+  (func (export "f19") (result i32) (i32.const 19))
+  (func (export "f20") (result i32) (i32.const 20))
+  (func (export "f21") (result i32) (i32.const 21))
+  (func (export "f22") (result i32) (i32.const 22))
+  (func (export "f23") (result i32) (i32.const 23))
+  (func (export "f24") (result i32) (i32.const 24))
+  (func (export "f25") (result i32) (i32.const 25))
+  (func (export "f26") (result i32) (i32.const 26))
+  (func (export "f27") (result i32) (i32.const 27))
+  (func (export "f28") (result i32) (i32.const 28))
+  (func (export "f29") (result i32) (i32.const 29))
+  (func (export "f30") (result i32) (i32.const 30))
+  (func (export "f31") (result i32) (i32.const 31))
+  (func (export "f32") (result i32) (i32.const 32))
+  (func (export "f33") (result i32) (i32.const 33))
+  (func (export "f34") (result i32) (i32.const 34))
+  (func (export "f35") (result i32) (i32.const 35))
+  (func (export "f36") (result i32) (i32.const 36))
+  (func (export "f37") (result i32) (i32.const 37))
+  (func (export "f38") (result i32) (i32.const 38))
+  (func (export "f39") (result i32) (i32.const 39))
+  (func (export "f40") (result i32) (i32.const 40))
+  (func (export "f41") (result i32) (i32.const 41))
+  (func (export "f42") (result i32) (i32.const 42))
+  (func (export "f43") (result i32) (i32.const 43))
+  (func (export "f44") (result i32) (i32.const 44))
+  (func (export "f45") (result i32) (i32.const 45))
+  (func (export "f46") (result i32) (i32.const 46))
+  (func (export "f47") (result i32) (i32.const 47))
+  (func (export "f48") (result i32) (i32.const 48))
+  (func (export "f49") (result i32) (i32.const 49))
+  (func (export "f50") (result i32) (i32.const 50))
+  (func (export "f51") (result i32) (i32.const 51))
+  (func (export "f52") (result i32) (i32.const 52))
+  (func (export "f53") (result i32) (i32.const 53))
+  (func (export "f54") (result i32) (i32.const 54))
+  (func (export "f55") (result i32) (i32.const 55))
+  (func (export "f56") (result i32) (i32.const 56))
+  (func (export "f57") (result i32) (i32.const 57))
+  (func (export "f58") (result i32) (i32.const 58))
+  (func (export "f59") (result i32) (i32.const 59))
+  (func (export "f60") (result i32) (i32.const 60))
+  (func (export "f61") (result i32) (i32.const 61))
+  (func (export "f62") (result i32) (i32.const 62))
+  (func (export "f63") (result i32) (i32.const 63))
+  (func (export "f64") (result i32) (i32.const 64))
+  (func (export "f65") (result i32) (i32.const 65))
+  (func (export "f66") (result i32) (i32.const 66))
+  (func (export "f67") (result i32) (i32.const 67))
+  (func (export "f68") (result i32) (i32.const 68))
+  (func (export "f69") (result i32) (i32.const 69))
+  (func (export "f70") (result i32) (i32.const 70))
+  (func (export "f71") (result i32) (i32.const 71))
+  (func (export "f72") (result i32) (i32.const 72))
+  (func (export "f73") (result i32) (i32.const 73))
+  (func (export "f74") (result i32) (i32.const 74))
+  (func (export "f75") (result i32) (i32.const 75))
+  (func (export "f76") (result i32) (i32.const 76))
+  (func (export "f77") (result i32) (i32.const 77))
+  (func (export "f78") (result i32) (i32.const 78))
+  (func (export "f79") (result i32) (i32.const 79))
+  (func (export "f80") (result i32) (i32.const 80))
+  (func (export "f81") (result i32) (i32.const 81))
+  (func (export "f82") (result i32) (i32.const 82))
+  (func (export "f83") (result i32) (i32.const 83))
+  (func (export "f84") (result i32) (i32.const 84))
+  (func (export "f85") (result i32) (i32.const 85))
+  (func (export "f86") (result i32) (i32.const 86))
+  (func (export "f87") (result i32) (i32.const 87))
+  (func (export "f88") (result i32) (i32.const 88))
+  (func (export "f89") (result i32) (i32.const 89))
+  (func (export "f90") (result i32) (i32.const 90))
+  (func (export "f91") (result i32) (i32.const 91))
+  (func (export "f92") (result i32) (i32.const 92))
+  (func (export "f93") (result i32) (i32.const 93))
+  (func (export "f94") (result i32) (i32.const 94))
+  (func (export "f95") (result i32) (i32.const 95))
+  (func (export "f96") (result i32) (i32.const 96))
+  (func (export "f97") (result i32) (i32.const 97))
+  (func (export "f98") (result i32) (i32.const 98))
+  (func (export "f99") (result i32) (i32.const 99))
+  (func (export "f100") (result i32) (i32.const 100))
+  (func (export "f101") (result i32) (i32.const 101))
+  (func (export "f102") (result i32) (i32.const 102))
+  (func (export "f103") (result i32) (i32.const 103))
+  (func (export "f104") (result i32) (i32.const 104))
+  (func (export "f105") (result i32) (i32.const 105))
+  (func (export "f106") (result i32) (i32.const 106))
+  (func (export "f107") (result i32) (i32.const 107))
+  (func (export "f108") (result i32) (i32.const 108))
+  (func (export "f109") (result i32) (i32.const 109))
+  (func (export "f110") (result i32) (i32.const 110))
+  (func (export "f111") (result i32) (i32.const 111))
+  (func (export "f112") (result i32) (i32.const 112))
+  (func (export "f113") (result i32) (i32.const 113))
+  (func (export "f114") (result i32) (i32.const 114))
+  (func (export "f115") (result i32) (i32.const 115))
+  (func (export "f116") (result i32) (i32.const 116))
+  (func (export "f117") (result i32) (i32.const 117))
+  (func (export "f118") (result i32) (i32.const 118))
+  (func (export "f119") (result i32) (i32.const 119))
+  (func (export "f120") (result i32) (i32.const 120))
+  (func (export "f121") (result i32) (i32.const 121))
+  (func (export "f122") (result i32) (i32.const 122))
+  (func (export "f123") (result i32) (i32.const 123))
+  (func (export "f124") (result i32) (i32.const 124))
+  (func (export "f125") (result i32) (i32.const 125))
+  (func (export "f126") (result i32) (i32.const 126))
+  (func (export "f127") (result i32) (i32.const 127))
+  (func (export "f128") (result i32) (i32.const 128))
+  (func (export "f129") (result i32) (i32.const 129))
+  (func (export "f130") (result i32) (i32.const 130))
+  (func (export "f131") (result i32) (i32.const 131))
+  (func (export "f132") (result i32) (i32.const 132))
+  (func (export "f133") (result i32) (i32.const 133))
+  (func (export "f134") (result i32) (i32.const 134))
+  (func (export "f135") (result i32) (i32.const 135))
+  (func (export "f136") (result i32) (i32.const 136))
+  (func (export "f137") (result i32) (i32.const 137))
+  (func (export "f138") (result i32) (i32.const 138))
+  (func (export "f139") (result i32) (i32.const 139))
+  (func (export "f140") (result i32) (i32.const 140))
+  (func (export "f141") (result i32) (i32.const 141))
+  (func (export "f142") (result i32) (i32.const 142))
+  (func (export "f143") (result i32) (i32.const 143))
+  (func (export "f144") (result i32) (i32.const 144))
+  (func (export "f145") (result i32) (i32.const 145))
+  (func (export "f146") (result i32) (i32.const 146))
+  (func (export "f147") (result i32) (i32.const 147))
+  (func (export "f148") (result i32) (i32.const 148))
+  (func (export "f149") (result i32) (i32.const 149))
+  (func (export "f150") (result i32) (i32.const 150))
+  (func (export "f151") (result i32) (i32.const 151))
+  (func (export "f152") (result i32) (i32.const 152))
+  (func (export "f153") (result i32) (i32.const 153))
+  (func (export "f154") (result i32) (i32.const 154))
+  (func (export "f155") (result i32) (i32.const 155))
+  (func (export "f156") (result i32) (i32.const 156))
+  (func (export "f157") (result i32) (i32.const 157))
+  (func (export "f158") (result i32) (i32.const 158))
+  (func (export "f159") (result i32) (i32.const 159))
+  (func (export "f160") (result i32) (i32.const 160))
+  (func (export "f161") (result i32) (i32.const 161))
+  (func (export "f162") (result i32) (i32.const 162))
+  (func (export "f163") (result i32) (i32.const 163))
+  (func (export "f164") (result i32) (i32.const 164))
+  (func (export "f165") (result i32) (i32.const 165))
+  (func (export "f166") (result i32) (i32.const 166))
+  (func (export "f167") (result i32) (i32.const 167))
+  (func (export "f168") (result i32) (i32.const 168))
+  (func (export "f169") (result i32) (i32.const 169))
+  (func (export "f170") (result i32) (i32.const 170))
+  (func (export "f171") (result i32) (i32.const 171))
+  (func (export "f172") (result i32) (i32.const 172))
+  (func (export "f173") (result i32) (i32.const 173))
+  (func (export "f174") (result i32) (i32.const 174))
+  (func (export "f175") (result i32) (i32.const 175))
+  (func (export "f176") (result i32) (i32.const 176))
+  (func (export "f177") (result i32) (i32.const 177))
+  (func (export "f178") (result i32) (i32.const 178))
+  (func (export "f179") (result i32) (i32.const 179))
+  (func (export "f180") (result i32) (i32.const 180))
+  (func (export "f181") (result i32) (i32.const 181))
+  (func (export "f182") (result i32) (i32.const 182))
+  (func (export "f183") (result i32) (i32.const 183))
+  (func (export "f184") (result i32) (i32.const 184))
+  (func (export "f185") (result i32) (i32.const 185))
+  (func (export "f186") (result i32) (i32.const 186))
+  (func (export "f187") (result i32) (i32.const 187))
+  (func (export "f188") (result i32) (i32.const 188))
+  (func (export "f189") (result i32) (i32.const 189))
+  (func (export "f190") (result i32) (i32.const 190))
+  (func (export "f191") (result i32) (i32.const 191))
+  (func (export "f192") (result i32) (i32.const 192))
+  (func (export "f193") (result i32) (i32.const 193))
+  (func (export "f194") (result i32) (i32.const 194))
+  (func (export "f195") (result i32) (i32.const 195))
+  (func (export "f196") (result i32) (i32.const 196))
+  (func (export "f197") (result i32) (i32.const 197))
+  (func (export "f198") (result i32) (i32.const 198))
+  (func (export "f199") (result i32) (i32.const 199))
+  (func (export "f200") (result i32) (i32.const 200))
+  (func (export "f201") (result i32) (i32.const 201))
+  (func (export "f202") (result i32) (i32.const 202))
+  (func (export "f203") (result i32) (i32.const 203))
+  (func (export "f204") (result i32) (i32.const 204))
+  (func (export "f205") (result i32) (i32.const 205))
+  (func (export "f206") (result i32) (i32.const 206))
+  (func (export "f207") (result i32) (i32.const 207))
+  (func (export "f208") (result i32) (i32.const 208))
+  (func (export "f209") (result i32) (i32.const 209))
+  (func (export "f210") (result i32) (i32.const 210))
+  (func (export "f211") (result i32) (i32.const 211))
+  (func (export "f212") (result i32) (i32.const 212))
+  (func (export "f213") (result i32) (i32.const 213))
+  (func (export "f214") (result i32) (i32.const 214))
+  (func (export "f215") (result i32) (i32.const 215))
+  (func (export "f216") (result i32) (i32.const 216))
+  (func (export "f217") (result i32) (i32.const 217))
+  (func (export "f218") (result i32) (i32.const 218))
+  (func (export "f219") (result i32) (i32.const 219))
+  (func (export "f220") (result i32) (i32.const 220))
+  (func (export "f221") (result i32) (i32.const 221))
+  (func (export "f222") (result i32) (i32.const 222))
+  (func (export "f223") (result i32) (i32.const 223))
+  (func (export "f224") (result i32) (i32.const 224))
+  (func (export "f225") (result i32) (i32.const 225))
+  (func (export "f226") (result i32) (i32.const 226))
+  (func (export "f227") (result i32) (i32.const 227))
+  (func (export "f228") (result i32) (i32.const 228))
+  (func (export "f229") (result i32) (i32.const 229))
+  (func (export "f230") (result i32) (i32.const 230))
+  (func (export "f231") (result i32) (i32.const 231))
+  (func (export "f232") (result i32) (i32.const 232))
+  (func (export "f233") (result i32) (i32.const 233))
+  (func (export "f234") (result i32) (i32.const 234))
+  (func (export "f235") (result i32) (i32.const 235))
+  (func (export "f236") (result i32) (i32.const 236))
+  (func (export "f237") (result i32) (i32.const 237))
+  (func (export "f238") (result i32) (i32.const 238))
+  (func (export "f239") (result i32) (i32.const 239))
+  (func (export "f240") (result i32) (i32.const 240))
+  (func (export "f241") (result i32) (i32.const 241))
+  (func (export "f242") (result i32) (i32.const 242))
+  (func (export "f243") (result i32) (i32.const 243))
+  (func (export "f244") (result i32) (i32.const 244))
+  (func (export "f245") (result i32) (i32.const 245))
+  (func (export "f246") (result i32) (i32.const 246))
+  (func (export "f247") (result i32) (i32.const 247))
+  (func (export "f248") (result i32) (i32.const 248))
+  (func (export "f249") (result i32) (i32.const 249))
+  (func (export "f250") (result i32) (i32.const 250))
+  (func (export "f251") (result i32) (i32.const 251))
+  (func (export "f252") (result i32) (i32.const 252))
+  (func (export "f253") (result i32) (i32.const 253))
+  (func (export "f254") (result i32) (i32.const 254))
+  (func (export "f255") (result i32) (i32.const 255))
+  (func (export "f256") (result i32) (i32.const 256))
+  (func (export "f257") (result i32) (i32.const 257))
+  (func (export "f258") (result i32) (i32.const 258))
+  (func (export "f259") (result i32) (i32.const 259))
+  (func (export "f260") (result i32) (i32.const 260))
+  (func (export "f261") (result i32) (i32.const 261))
+  (func (export "f262") (result i32) (i32.const 262))
+  (func (export "f263") (result i32) (i32.const 263))
+  (func (export "f264") (result i32) (i32.const 264))
+  (func (export "f265") (result i32) (i32.const 265))
+  (func (export "f266") (result i32) (i32.const 266))
+  (func (export "f267") (result i32) (i32.const 267))
+  (func (export "f268") (result i32) (i32.const 268))
+  (func (export "f269") (result i32) (i32.const 269))
+  (func (export "f270") (result i32) (i32.const 270))
+  (func (export "f271") (result i32) (i32.const 271))
+  (func (export "f272") (result i32) (i32.const 272))
+  (func (export "f273") (result i32) (i32.const 273))
+  (func (export "f274") (result i32) (i32.const 274))
+  (func (export "f275") (result i32) (i32.const 275))
+  (func (export "f276") (result i32) (i32.const 276))
+  (func (export "f277") (result i32) (i32.const 277))
+  (func (export "f278") (result i32) (i32.const 278))
+  (func (export "f279") (result i32) (i32.const 279))
+  (func (export "f280") (result i32) (i32.const 280))
+  (func (export "f281") (result i32) (i32.const 281))
+  (func (export "f282") (result i32) (i32.const 282))
+  (func (export "f283") (result i32) (i32.const 283))
+  (func (export "f284") (result i32) (i32.const 284))
+  (func (export "f285") (result i32) (i32.const 285))
+  (func (export "f286") (result i32) (i32.const 286))
+  (func (export "f287") (result i32) (i32.const 287))
+  (func (export "f288") (result i32) (i32.const 288))
+  (func (export "f289") (result i32) (i32.const 289))
+  (func (export "f290") (result i32) (i32.const 290))
+  (func (export "f291") (result i32) (i32.const 291))
+  (func (export "f292") (result i32) (i32.const 292))
+  (func (export "f293") (result i32) (i32.const 293))
+  (func (export "f294") (result i32) (i32.const 294))
+  (func (export "f295") (result i32) (i32.const 295))
+  (func (export "f296") (result i32) (i32.const 296))
+  (func (export "f297") (result i32) (i32.const 297))
+  (func (export "f298") (result i32) (i32.const 298))
+  (func (export "f299") (result i32) (i32.const 299))
+
+  ;; index 50 and the default leave the outer block, the rest the inner one
+  (func (export "switch") (param i32) (result i32)
+    (block
+      (block
+        (br_table 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 1 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 0 1 (get_local 0))
+      )
+      (return (i32.const 1))
+    )
+    (i32.const 2)
+  )
+
+  (func (export "locals") (result i32) (local i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32 i32) (get_local 1999))
+)
+
+(assert_return (invoke "f299") (i32.const 299))
+(assert_return (invoke "switch" (i32.const 0)) (i32.const 1))
+(assert_return (invoke "switch" (i32.const 50)) (i32.const 2))
+(assert_return (invoke "switch" (i32.const 100)) (i32.const 2))
+(assert_return (invoke "locals") (i32.const 0))
+
+(assert_invalid
+  (module
+    (func (export "f") (result i32) (i32.const 0))
+    (func (export "f") (result i32) (i32.const 1))
+  )
+  "duplicate export name"
+)
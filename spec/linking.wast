@@ -0,0 +1,62 @@
+(module $lib
+  (import "env" "add" (func $add (param i32 i32) (result i32)))
+  (memory 1)
+  (data (i32.const 0) "\07")
+  (global $calls (mut i32) (i32.const 0))
+
+  (func (export "square") (param i32) (result i32)
+    (set_global $calls (i32.add (get_global $calls) (i32.const 1)))
+    (i32.mul (get_local 0) (get_local 0))
+  )
+  (func (export "calls") (result i32) (get_global $calls))
+  (func (export "peek") (result i32) (i32.load (i32.const 0)))
+  (func (export "sum") (param i32 i32) (result i32) (call $add (get_local 0) (get_local 1)))
+  (func (export "div") (param i32 i32) (result i32) (i32.div_s (get_local 0) (get_local 1)))
+  (export "add" (func $add))
+)
+
+(register "lib" $lib)
+
+(module
+  (import "lib" "square" (func $square (param i32) (result i32)))
+  (import "lib" "peek" (func $peek (result i32)))
+  (import "lib" "add" (func $add (param i32 i32) (result i32)))
+  (import "lib" "calls" (func $calls (result i32)))
+  (import "lib" "div" (func $div (param i32 i32) (result i32)))
+  (type $binary (func (param i32 i32) (result i32)))
+  (type $unary (func (param i32) (result i32)))
+  (memory 1)
+  (data (i32.const 0) "\03")
+  (table anyfunc (elem $square $add $sum_squares))
+
+  (func $sum_squares (export "sum_squares") (param i32 i32) (result i32)
+    (call $add (call $square (get_local 0)) (call $square (get_local 1)))
+  )
+  (func (export "peeks") (result i32) (i32.add (call $peek) (i32.load (i32.const 0))))
+  (func (export "indirect_square") (param i32) (result i32)
+    (call_indirect (type $unary) (get_local 0) (i32.const 0))
+  )
+  (func (export "indirect") (param i32 i32 i32) (result i32)
+    (call_indirect (type $binary) (get_local 1) (get_local 2) (get_local 0))
+  )
+  (export "calls" (func $calls))
+  (export "div" (func $div))
+)
+
+(assert_return (invoke "sum_squares" (i32.const 2) (i32.const 3)) (i32.const 13))
+(assert_return (invoke "sum_squares" (i32.const -4) (i32.const 0)) (i32.const 16))
+(assert_return (invoke "peeks") (i32.const 10))
+(assert_return (invoke "calls") (i32.const 4))
+(assert_return (invoke "div" (i32.const 6) (i32.const 3)) (i32.const 2))
+(assert_trap (invoke "div" (i32.const 1) (i32.const 0)) "integer divide by zero")
+(assert_return (invoke "peeks") (i32.const 10))
+(assert_return (invoke "indirect_square" (i32.const 5)) (i32.const 25))
+(assert_return (invoke "calls") (i32.const 5))
+(assert_return (invoke "indirect" (i32.const 1) (i32.const 2) (i32.const 3)) (i32.const 5))
+(assert_return (invoke "indirect" (i32.const 2) (i32.const 1) (i32.const 2)) (i32.const 5))
+(assert_trap (invoke "indirect" (i32.const 0) (i32.const 1) (i32.const 2)) "indirect call type mismatch")
+
+(assert_unlinkable
+  (module (import "lib" "square" (func (param i64) (result i64))))
+  "incompatible import type"
+)
@@ -0,0 +1,62 @@
+(module
+  (memory i64 1 0x10001)
+  (data (i64.const 8) "\2a")
+
+  (func (export "load") (param i64) (result i32) (i32.load (local.get 0)))
+  (func (export "store") (param i64 i32) (i32.store (local.get 0) (local.get 1)))
+  (func (export "load_offset_4g") (param i64) (result i32)
+    (i32.load offset=0x100000000 (local.get 0))
+  )
+  (func (export "load8_offset_1") (param i64) (result i32)
+    (i32.load8_u offset=1 (local.get 0))
+  )
+  (func (export "size") (result i64) (memory.size))
+  (func (export "grow") (param i64) (result i64) (memory.grow (local.get 0)))
+)
+
+(assert_return (invoke "load" (i64.const 8)) (i32.const 42))
+(assert_return (invoke "store" (i64.const 16) (i32.const 5)))
+(assert_return (invoke "load" (i64.const 16)) (i32.const 5))
+(assert_return (invoke "load" (i64.const 0xfffc)) (i32.const 0))
+(assert_trap (invoke "load" (i64.const 0xfffd)) "out of bounds memory access")
+(assert_trap (invoke "load" (i64.const -1)) "out of bounds memory access")
+(assert_trap (invoke "load_offset_4g" (i64.const 0)) "out of bounds memory access")
+(assert_trap (invoke "load8_offset_1" (i64.const -1)) "out of bounds memory access")
+(assert_return (invoke "size") (i64.const 1))
+(assert_return (invoke "grow" (i64.const 0x100000000)) (i64.const -1))
+(assert_return (invoke "grow" (i64.const 0x10000)) (i64.const 1))
+(assert_return (invoke "size") (i64.const 0x10001))
+(assert_return (invoke "load_offset_4g" (i64.const 0)) (i32.const 0))
+(assert_return (invoke "store" (i64.const 0x100000010) (i32.const 7)))
+(assert_return (invoke "load_offset_4g" (i64.const 0x10)) (i32.const 7))
+(assert_return (invoke "load" (i64.const 16)) (i32.const 5))
+(assert_trap (invoke "load" (i64.const 0x10000fffd)) "out of bounds memory access")
+(assert_return (invoke "grow" (i64.const 1)) (i64.const -1))
+
+(module
+  (memory i64 1 1 shared)
+
+  (func (export "add") (param i64 i32) (result i32) (i32.atomic.rmw.add (local.get 0) (local.get 1)))
+)
+
+(assert_return (invoke "add" (i64.const 0) (i32.const 3)) (i32.const 0))
+(assert_return (invoke "add" (i64.const 0) (i32.const 1)) (i32.const 3))
+(assert_trap (invoke "add" (i64.const 2) (i32.const 1)) "unaligned atomic")
+(assert_trap (invoke "add" (i64.const 0x10000) (i32.const 1)) "out of bounds memory access")
+
+(assert_invalid
+  (module (memory i64 1) (func (param i32) (result i32) (i32.load (local.get 0))))
+  "type mismatch"
+)
+(assert_invalid
+  (module (memory i64 1) (data (i32.const 0) "\01"))
+  "type mismatch"
+)
+(assert_invalid
+  (module (memory i64 0x1000001))
+  "memory size must be at most 1Tb"
+)
+(assert_malformed
+  (module binary "\00asm" "\01\00\00\00" "\05\03\01" "\08\01")
+  "integer too large"
+)
@@ -0,0 +1,20 @@
+(module
+  (memory 2 4)
+  (data (i32.const 0) "\05")
+  (global $g (mut i32) (i32.const 7))
+
+  (func (export "bump") (result i32)
+    (set_global $g (i32.add (get_global $g) (i32.const 1)))
+    (get_global $g)
+  )
+  (func (export "poke") (param i32 i32) (i32.store (get_local 0) (get_local 1)))
+  (func (export "peek") (param i32) (result i32) (i32.load (get_local 0)))
+  (func (export "grow") (result i32) (memory.grow (i32.const 1)))
+  (func (export "spin") (result i32) (loop (br 0)) (i32.const 0))
+)
+
+(assert_return (invoke "bump") (i32.const 8))
+(assert_return (invoke "peek" (i32.const 0)) (i32.const 5))
+(invoke "poke" (i32.const 65540) (i32.const 99))
+(assert_return (invoke "peek" (i32.const 65540)) (i32.const 99))
+(assert_return (invoke "grow") (i32.const 2))
@@ -0,0 +1,37 @@
+(module
+  (import "env" "add" (func $add (param i32 i32) (result i32)))
+  (import "env" "log" (func $log (param i32)))
+  (import "env" "counter" (global $counter (mut i32)))
+  (import "env" "memory" (memory 1))
+
+  (func (export "sum3") (param i32 i32 i32) (result i32)
+    (call $add (call $add (get_local 0) (get_local 1)) (get_local 2))
+  )
+  (func (export "tick") (result i32)
+    (set_global $counter (i32.add (get_global $counter) (i32.const 1)))
+    (call $log (get_global $counter))
+    (get_global $counter)
+  )
+  (func (export "peek") (result i32) (i32.load (i32.const 0)))
+  (export "add" (func $add))
+)
+
+(module
+  (memory (export "memory") 1)
+  (data (i32.const 0) "\2a")
+)
+
+(assert_unlinkable
+  (module (import "env" "missing" (func)))
+  "unknown import"
+)
+
+(assert_unlinkable
+  (module (import "env" "add" (func (param i64) (result i64))))
+  "incompatible import type"
+)
+
+(assert_unlinkable
+  (module (import "env" "add" (global i32)))
+  "incompatible import type"
+)
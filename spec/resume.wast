@@ -0,0 +1,20 @@
+(module
+  (import "env" "yield" (func $yield (param i32) (result i32)))
+  (func (export "count") (param $n i32) (param $i i32) (result i32)
+    (block
+      (loop
+        (br_if 1 (i32.ge_u (get_local $i) (get_local $n)))
+        (set_local $i (call $yield (get_local $i)))
+        (br 0)
+      )
+    )
+    (get_local $i)
+  )
+)
+
+(module
+  (import "lib" "sum" (func $sum (param i32 i32) (result i32)))
+  (func (export "twice") (param i32) (result i32)
+    (i32.add (call $sum (get_local 0) (i32.const 0)) (call $sum (get_local 0) (i32.const 0)))
+  )
+)
@@ -0,0 +1,16 @@
+(module
+  (func (export "sum") (param $n i32) (param $acc i32) (result i32)
+    (block
+      (loop
+        (br_if 1 (i32.eqz (get_local $n)))
+        (set_local $acc (i32.add (get_local $acc) (get_local $n)))
+        (set_local $n (i32.sub (get_local $n) (i32.const 1)))
+        (br 0)
+      )
+    )
+    (get_local $acc)
+  )
+)
+
+(assert_return (invoke "sum" (i32.const 0) (i32.const 0)) (i32.const 0))
+(assert_return (invoke "sum" (i32.const 100) (i32.const 0)) (i32.const 5050))
@@ -0,0 +1,49 @@
+(module
+  (type $out (func (result i32)))
+  (type $in-out (func (param i32) (result i32)))
+  (type $in (func (param i32)))
+  (type $out-again (func (result i32)))
+
+  (table 5 anyfunc)
+  (elem (i32.const 0) $seven $nine $identity)
+  (elem (i32.const 4) $nine)
+
+  (func $seven (type $out) (i32.const 7))
+  (func $nine (type $out) (i32.const 9))
+  (func $identity (type $in-out) (get_local 0))
+
+  (func (export "dispatch") (param i32) (result i32)
+    (call_indirect $out (get_local 0))
+  )
+  (func (export "dispatch_same_sig") (param i32) (result i32)
+    (call_indirect $out-again (get_local 0))
+  )
+)
+
+(assert_return (invoke "dispatch" (i32.const 0)) (i32.const 7))
+(assert_return (invoke "dispatch" (i32.const 1)) (i32.const 9))
+(assert_return (invoke "dispatch" (i32.const 4)) (i32.const 9))
+(assert_trap (invoke "dispatch" (i32.const 2)) "indirect call type mismatch")
+(assert_trap (invoke "dispatch" (i32.const 3)) "uninitialized element")
+(assert_trap (invoke "dispatch" (i32.const 5)) "undefined element")
+(assert_trap (invoke "dispatch" (i32.const -1)) "undefined element")
+(assert_return (invoke "dispatch_same_sig" (i32.const 0)) (i32.const 7))
+
+(assert_unlinkable
+  (module
+    (type $out (func (result i32)))
+    (table 5 anyfunc)
+    (elem (i32.const 0) $seven)
+    (elem (i32.const 4) $seven $seven)
+    (func $seven (type $out) (i32.const 7))
+  )
+  "elements segment does not fit"
+)
+
+(assert_invalid
+  (module
+    (type $out (func (result i32)))
+    (func (param i32) (result i32) (call_indirect $out (get_local 0)))
+  )
+  "unknown table"
+)
@@ -0,0 +1,244 @@
+(module
+  (func (export "f0") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 0)) (else (i32.const 0))))
+  )
+  (func (export "f1") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 1)) (else (i32.const -1))))
+  )
+  (func (export "f2") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 2)) (else (i32.const -2))))
+  )
+  (func (export "f3") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 3)) (else (i32.const -3))))
+  )
+  (func (export "f4") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 4)) (else (i32.const -4))))
+  )
+  (func (export "f5") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 5)) (else (i32.const -5))))
+  )
+  (func (export "f6") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 6)) (else (i32.const -6))))
+  )
+  (func (export "f7") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 7)) (else (i32.const -7))))
+  )
+  (func (export "f8") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 8)) (else (i32.const -8))))
+  )
+  (func (export "f9") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 9)) (else (i32.const -9))))
+  )
+  (func (export "f10") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 10)) (else (i32.const -10))))
+  )
+  (func (export "f11") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 11)) (else (i32.const -11))))
+  )
+  (func (export "f12") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 12)) (else (i32.const -12))))
+  )
+  (func (export "f13") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 13)) (else (i32.const -13))))
+  )
+  (func (export "f14") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 14)) (else (i32.const -14))))
+  )
+  (func (export "f15") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 15)) (else (i32.const -15))))
+  )
+  (func (export "f16") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 16)) (else (i32.const -16))))
+  )
+  (func (export "f17") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 17)) (else (i32.const -17))))
+  )
+  (func (export "f18") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 18)) (else (i32.const -18))))
+  )
+  (func (export "f19") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 19)) (else (i32.const -19))))
+  )
+  (func (export "f20") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 20)) (else (i32.const -20))))
+  )
+  (func (export "f21") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 21)) (else (i32.const -21))))
+  )
+  (func (export "f22") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 22)) (else (i32.const -22))))
+  )
+  (func (export "f23") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 23)) (else (i32.const -23))))
+  )
+  (func (export "f24") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 24)) (else (i32.const -24))))
+  )
+  (func (export "f25") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 25)) (else (i32.const -25))))
+  )
+  (func (export "f26") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 26)) (else (i32.const -26))))
+  )
+  (func (export "f27") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 27)) (else (i32.const -27))))
+  )
+  (func (export "f28") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 28)) (else (i32.const -28))))
+  )
+  (func (export "f29") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 29)) (else (i32.const -29))))
+  )
+  (func (export "f30") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 30)) (else (i32.const -30))))
+  )
+  (func (export "f31") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 31)) (else (i32.const -31))))
+  )
+  (func (export "f32") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 32)) (else (i32.const -32))))
+  )
+  (func (export "f33") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 33)) (else (i32.const -33))))
+  )
+  (func (export "f34") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 34)) (else (i32.const -34))))
+  )
+  (func (export "f35") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 35)) (else (i32.const -35))))
+  )
+  (func (export "f36") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 36)) (else (i32.const -36))))
+  )
+  (func (export "f37") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 37)) (else (i32.const -37))))
+  )
+  (func (export "f38") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 38)) (else (i32.const -38))))
+  )
+  (func (export "f39") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 39)) (else (i32.const -39))))
+  )
+  (func (export "f40") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 40)) (else (i32.const -40))))
+  )
+  (func (export "f41") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 41)) (else (i32.const -41))))
+  )
+  (func (export "f42") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 42)) (else (i32.const -42))))
+  )
+  (func (export "f43") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 43)) (else (i32.const -43))))
+  )
+  (func (export "f44") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 44)) (else (i32.const -44))))
+  )
+  (func (export "f45") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 45)) (else (i32.const -45))))
+  )
+  (func (export "f46") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 46)) (else (i32.const -46))))
+  )
+  (func (export "f47") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 47)) (else (i32.const -47))))
+  )
+  (func (export "f48") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 48)) (else (i32.const -48))))
+  )
+  (func (export "f49") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 49)) (else (i32.const -49))))
+  )
+  (func (export "f50") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 50)) (else (i32.const -50))))
+  )
+  (func (export "f51") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 51)) (else (i32.const -51))))
+  )
+  (func (export "f52") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 52)) (else (i32.const -52))))
+  )
+  (func (export "f53") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 53)) (else (i32.const -53))))
+  )
+  (func (export "f54") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 54)) (else (i32.const -54))))
+  )
+  (func (export "f55") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 55)) (else (i32.const -55))))
+  )
+  (func (export "f56") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 56)) (else (i32.const -56))))
+  )
+  (func (export "f57") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 57)) (else (i32.const -57))))
+  )
+  (func (export "f58") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 58)) (else (i32.const -58))))
+  )
+  (func (export "f59") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 59)) (else (i32.const -59))))
+  )
+  (func (export "f60") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 60)) (else (i32.const -60))))
+  )
+  (func (export "f61") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 61)) (else (i32.const -61))))
+  )
+  (func (export "f62") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 62)) (else (i32.const -62))))
+  )
+  (func (export "f63") (param i32) (result i32)
+    (block (result i32) (if (result i32) (local.get 0) (then (i32.const 63)) (else (i32.const -63))))
+  )
+)
+
+(assert_return (invoke "f0" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "f0" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "f1" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "f1" (i32.const 0)) (i32.const -1))
+(assert_return (invoke "f31" (i32.const 1)) (i32.const 31))
+(assert_return (invoke "f31" (i32.const 0)) (i32.const -31))
+(assert_return (invoke "f63" (i32.const 1)) (i32.const 63))
+(assert_return (invoke "f63" (i32.const 0)) (i32.const -63))
+
+;; functions 10 and 25 are invalid, the lower one is reported however the
+;; functions are spread over validation workers. With lazy validation the
+;; module instantiates, f0 runs and calling f10 traps with the type mismatch.
+(assert_invalid
+  (module
+    (func (export "f0") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 0)) (else (i32.const 0)))))
+    (func (export "f1") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 1)) (else (i32.const -1)))))
+    (func (export "f2") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 2)) (else (i32.const -2)))))
+    (func (export "f3") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 3)) (else (i32.const -3)))))
+    (func (export "f4") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 4)) (else (i32.const -4)))))
+    (func (export "f5") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 5)) (else (i32.const -5)))))
+    (func (export "f6") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 6)) (else (i32.const -6)))))
+    (func (export "f7") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 7)) (else (i32.const -7)))))
+    (func (export "f8") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 8)) (else (i32.const -8)))))
+    (func (export "f9") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 9)) (else (i32.const -9)))))
+    (func (export "f10") (param i32) (result i32) (i64.const 0))
+    (func (export "f11") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 11)) (else (i32.const -11)))))
+    (func (export "f12") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 12)) (else (i32.const -12)))))
+    (func (export "f13") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 13)) (else (i32.const -13)))))
+    (func (export "f14") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 14)) (else (i32.const -14)))))
+    (func (export "f15") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 15)) (else (i32.const -15)))))
+    (func (export "f16") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 16)) (else (i32.const -16)))))
+    (func (export "f17") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 17)) (else (i32.const -17)))))
+    (func (export "f18") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 18)) (else (i32.const -18)))))
+    (func (export "f19") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 19)) (else (i32.const -19)))))
+    (func (export "f20") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 20)) (else (i32.const -20)))))
+    (func (export "f21") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 21)) (else (i32.const -21)))))
+    (func (export "f22") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 22)) (else (i32.const -22)))))
+    (func (export "f23") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 23)) (else (i32.const -23)))))
+    (func (export "f24") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 24)) (else (i32.const -24)))))
+    (func (export "f25") (param i32) (result i32) (i32.const 0) (call 99))
+    (func (export "f26") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 26)) (else (i32.const -26)))))
+    (func (export "f27") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 27)) (else (i32.const -27)))))
+    (func (export "f28") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 28)) (else (i32.const -28)))))
+    (func (export "f29") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 29)) (else (i32.const -29)))))
+    (func (export "f30") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 30)) (else (i32.const -30)))))
+    (func (export "f31") (param i32) (result i32) (block (result i32) (if (result i32) (local.get 0) (then (i32.const 31)) (else (i32.const -31)))))
+  )
+  "type mismatch"
+)
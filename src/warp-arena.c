@@ -0,0 +1,145 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+
+#include "warp-arena.h"
+#include "warp-error.h"
+#include "warp.h"
+
+#define CHUNK_ALIGN 64
+
+struct wrp_arena_chunk {
+    wrp_arena_chunk_t *prev;
+    size_t sz;
+    size_t pos;
+};
+
+//the header is padded so the first allocation in a chunk is CHUNK_ALIGN aligned
+#define CHUNK_HEADER_SZ (((sizeof(wrp_arena_chunk_t) + CHUNK_ALIGN - 1) / CHUNK_ALIGN) * CHUNK_ALIGN)
+
+void wrp_arena_init(wrp_arena_t *arena, wrp_vm_t *vm, size_t chunk_sz)
+{
+    arena->vm = vm;
+    arena->chunk = NULL;
+    arena->chunk_sz = chunk_sz;
+}
+
+static wrp_err_t push_chunk(wrp_arena_t *arena, size_t min_sz)
+{
+    //chunks double so a large module needs a logarithmic number of them
+    size_t sz = arena->chunk_sz;
+
+    while (sz < min_sz) {
+        if (sz > SIZE_MAX / 2) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+
+        sz *= 2;
+    }
+
+    if (sz > SIZE_MAX - CHUNK_HEADER_SZ) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    wrp_arena_chunk_t *chunk = arena->vm->alloc_fn(CHUNK_HEADER_SZ + sz, CHUNK_ALIGN);
+
+    if (chunk == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    chunk->prev = arena->chunk;
+    chunk->sz = sz;
+    chunk->pos = 0;
+    arena->chunk = chunk;
+    arena->chunk_sz = sz * 2;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_arena_alloc(wrp_arena_t *arena, size_t sz, size_t align, void **out_ptr)
+{
+    if (align == 0 || align > CHUNK_ALIGN || (align & (align - 1)) != 0) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (sz > SIZE_MAX - CHUNK_ALIGN) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    wrp_arena_chunk_t *chunk = arena->chunk;
+    size_t pos = 0;
+
+    if (chunk != NULL) {
+        pos = (chunk->pos + align - 1) & ~(align - 1);
+    }
+
+    if (chunk == NULL || pos > chunk->sz || sz > chunk->sz - pos) {
+        if (push_chunk(arena, sz) != WRP_SUCCESS) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+
+        chunk = arena->chunk;
+        pos = 0;
+    }
+
+    uint8_t *ptr = (uint8_t *)chunk + CHUNK_HEADER_SZ + pos;
+    memset(ptr, 0, sz);
+    chunk->pos = pos + sz;
+    *out_ptr = ptr;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_arena_extend(wrp_arena_t *arena, void *ptr, size_t sz, size_t new_sz, size_t align, void **out_ptr)
+{
+    wrp_arena_chunk_t *chunk = arena->chunk;
+
+    if (new_sz < sz) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (chunk != NULL && (uint8_t *)ptr + sz == (uint8_t *)chunk + CHUNK_HEADER_SZ + chunk->pos) {
+        size_t pos = chunk->pos - sz;
+
+        if (new_sz <= chunk->sz - pos) {
+            memset((uint8_t *)ptr + sz, 0, new_sz - sz);
+            chunk->pos = pos + new_sz;
+            *out_ptr = ptr;
+            return WRP_SUCCESS;
+        }
+    }
+
+    void *grown = NULL;
+
+    if (wrp_arena_alloc(arena, new_sz, align, &grown) != WRP_SUCCESS) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (sz > 0) {
+        memcpy(grown, ptr, sz);
+    }
+
+    *out_ptr = grown;
+    return WRP_SUCCESS;
+}
+
+void wrp_arena_free(wrp_arena_t *arena)
+{
+    while (arena->chunk != NULL) {
+        wrp_arena_chunk_t *prev = arena->chunk->prev;
+        arena->vm->free_fn(arena->chunk);
+        arena->chunk = prev;
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "warp-types.h"
+
+typedef struct wrp_arena_chunk wrp_arena_chunk_t;
+
+//bump allocator over the vm allocator, chunks are only released by
+//wrp_arena_free so nothing allocated from an arena is freed individually
+typedef struct wrp_arena {
+    wrp_vm_t *vm;
+    wrp_arena_chunk_t *chunk;
+    size_t chunk_sz;
+} wrp_arena_t;
+
+void wrp_arena_init(wrp_arena_t *arena, wrp_vm_t *vm, size_t chunk_sz);
+
+wrp_err_t wrp_arena_alloc(wrp_arena_t *arena, size_t sz, size_t align, void **out_ptr);
+
+//grows ptr, which must be the arena's latest allocation, from sz to new_sz.
+//It grows in place while its chunk has room, otherwise it is copied.
+wrp_err_t wrp_arena_extend(wrp_arena_t *arena, void *ptr, size_t sz, size_t new_sz, size_t align, void **out_ptr);
+
+void wrp_arena_free(wrp_arena_t *arena);
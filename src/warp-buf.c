@@ -17,28 +17,117 @@
 #include <stdbool.h>
 
 #include "warp-buf.h"
+#include "warp-config.h"
 #include "warp-error.h"
 #include "warp-macros.h"
 
-static wrp_err_t read_LEB(wrp_buf_t *buf,
+#define LEB_CONTINUATION_BITS 0x8080808080808080ull
+
+//value bits of a byte, bytes past the terminator must be cleared
+#define LEB_PAYLOAD_BITS 0x7f7f7f7f7f7f7f7full
+
+static uint64_t sign_extend_LEB(uint64_t result, uint32_t shift, uint32_t max_bits, uint64_t last_byte)
+{
+    if ((shift < max_bits) && (last_byte & 0x40)) {
+        result |= ~0ull << shift;
+    }
+
+    return result;
+}
+
+//decodes from the first 8 bytes without a branch per byte, returns false
+//when they hold no terminator so the caller can fall back
+static bool read_LEB_swar(const uint8_t *bytes,
+    uint32_t max_bits,
+    bool sign_extend,
+    uint64_t *out_value,
+    uint32_t *out_num_bytes)
+{
+    uint64_t word = (uint64_t)bytes[0] | (uint64_t)bytes[1] << 8 | (uint64_t)bytes[2] << 16 |
+                    (uint64_t)bytes[3] << 24 | (uint64_t)bytes[4] << 32 | (uint64_t)bytes[5] << 40 |
+                    (uint64_t)bytes[6] << 48 | (uint64_t)bytes[7] << 56;
+
+    uint64_t terminators = ~word & LEB_CONTINUATION_BITS;
+
+    if (terminators == 0) {
+        return false;
+    }
+
+    //the lowest clear continuation bit ends the value
+    uint32_t num_bits = (uint32_t)__builtin_ctzll(terminators) + 1;
+    uint64_t value = word & LEB_PAYLOAD_BITS;
+
+    if (num_bits < 64) {
+        value &= (1ull << num_bits) - 1;
+    }
+
+    //gather the 7 bit groups, 8 groups fit in 56 bits
+    value = ((value & 0x7f007f007f007f00ull) >> 1) | (value & 0x007f007f007f007full);
+    value = ((value & 0x3fff00003fff0000ull) >> 2) | (value & 0x00003fff00003fffull);
+    value = ((value & 0x0fffffff00000000ull) >> 4) | (value & 0x000000000fffffffull);
+
+    uint32_t num_bytes = num_bits / 8;
+
+    if (sign_extend) {
+        value = sign_extend_LEB(value, num_bytes * 7, max_bits, bytes[num_bytes - 1]);
+    }
+
+    *out_value = value;
+    *out_num_bytes = num_bytes;
+    return true;
+}
+
+wrp_err_t wrp_read_LEB(wrp_buf_t *buf,
     uint32_t max_bits,
     bool sign_extend,
     uint64_t *out_value)
 {
     size_t max_bytes = ((max_bits + 7 - 1) / 7);
+    size_t remaining = buf->sz - buf->pos;
+
+    //most immediates fit in a single byte
+    if (remaining > 0 && (buf->bytes[buf->pos] & 0x80) == 0) {
+        uint64_t byte = buf->bytes[buf->pos++];
+        *out_value = sign_extend ? sign_extend_LEB(byte, 7, max_bits, byte) : byte;
+        return WRP_SUCCESS;
+    }
+
+    //a value may use one more byte than max_bytes, as below
+    if (remaining >= sizeof(uint64_t)) {
+        uint32_t num_bytes = 0;
+
+        if (read_LEB_swar(&buf->bytes[buf->pos], max_bits, sign_extend, out_value, &num_bytes)) {
+            if (num_bytes > max_bytes + 1) {
+                return WRP_ERR_INVALID_LEB;
+            }
+
+            buf->pos += num_bytes;
+            return WRP_SUCCESS;
+        }
+
+        if (max_bytes + 1 <= sizeof(uint64_t)) {
+            return WRP_ERR_INVALID_LEB;
+        }
+    }
+
+    //only bounds check per byte when the longest value could overrun the buffer
+    bool checked = remaining <= max_bytes;
     uint32_t num_bytes = 0;
     uint64_t result = 0;
     uint32_t shift = 0;
     uint64_t byte = 0;
 
     while (true) {
-        if (wrp_end_of_buf(buf)) {
+        if (checked && wrp_end_of_buf(buf)) {
             return WRP_ERR_INVALID_BUFFER_ACCESS;
         }
 
         byte = buf->bytes[buf->pos++];
 
-        result |= ((byte & 0x7f) << shift);
+        if (shift < 64) {
+            result |= ((byte & 0x7f) << shift);
+        }
+
         shift += 7;
 
         if ((byte & 0x80) == 0) {
@@ -52,8 +141,8 @@ static wrp_err_t read_LEB(wrp_buf_t *buf,
         }
     }
 
-    if (sign_extend && (shift < max_bits) && (byte & 0x40)) {
-        result |= -(1 << shift);
+    if (sign_extend) {
+        result = sign_extend_LEB(result, shift, max_bits, byte);
     }
 
     *out_value = result;
@@ -112,57 +201,12 @@ wrp_err_t wrp_read_uint32(wrp_buf_t *buf, uint32_t *out_value)
 wrp_err_t wrp_read_varui1(wrp_buf_t *buf, uint8_t *out_value)
 {
     uint64_t leb = 0;
-    WRP_CHECK(read_LEB(buf, 1, false, &leb));
-
-    *out_value = (uint8_t)leb;
-    return WRP_SUCCESS;
-}
-
-wrp_err_t wrp_read_varui7(wrp_buf_t *buf, uint8_t *out_value)
-{
-    uint64_t leb = 0;
-    WRP_CHECK(read_LEB(buf, 7, false, &leb));
+    WRP_CHECK(wrp_read_LEB(buf, 1, false, &leb));
 
     *out_value = (uint8_t)leb;
     return WRP_SUCCESS;
 }
 
-wrp_err_t wrp_read_varui32(wrp_buf_t *buf, uint32_t *out_value)
-{
-    uint64_t leb = 0;
-    WRP_CHECK(read_LEB(buf, 32, false, &leb));
-
-    *out_value = (uint32_t)leb;
-    return WRP_SUCCESS;
-}
-
-wrp_err_t wrp_read_vari7(wrp_buf_t *buf, int8_t *out_value)
-{
-    uint64_t leb = 0;
-    WRP_CHECK(read_LEB(buf, 7, true, &leb));
-
-    *out_value = (int8_t)leb;
-    return WRP_SUCCESS;
-}
-
-wrp_err_t wrp_read_vari32(wrp_buf_t *buf, int32_t *out_value)
-{
-    uint64_t leb = 0;
-    WRP_CHECK(read_LEB(buf, 32, true, &leb));
-
-    *out_value = (int32_t)leb;
-    return WRP_SUCCESS;
-}
-
-wrp_err_t wrp_read_vari64(wrp_buf_t *buf, int64_t *out_value)
-{
-    uint64_t leb = 0;
-    WRP_CHECK(read_LEB(buf, 64, true, &leb));
-
-    *out_value = (int64_t)leb;
-    return WRP_SUCCESS;
-}
-
 wrp_err_t wrp_read_f32(wrp_buf_t *buf, float *out_value)
 {
     if (buf->pos + sizeof(float)  > buf->sz) {
@@ -224,3 +268,36 @@ wrp_err_t wrp_read_limits(wrp_buf_t *buf, uint32_t *out_min, uint32_t *out_max)
 
     return WRP_SUCCESS;
 }
+
+wrp_err_t wrp_read_memory_limits(wrp_buf_t *buf,
+    uint64_t *out_min,
+    uint64_t *out_max,
+    bool *out_shared,
+    bool *out_memory64)
+{
+    uint32_t flags = 0;
+    WRP_CHECK(wrp_read_varui32(buf, &flags));
+
+    bool has_max = (flags & 0x01) != 0;
+    bool shared = (flags & 0x02) != 0;
+    bool memory64 = (flags & 0x04) != 0;
+
+    //shared memories must declare a maximum
+    if (flags > 0x07 || (shared && !has_max)) {
+        return WRP_ERR_INVALID_MEM_LIMIT;
+    }
+
+    //memory64 limits are encoded as 64 bit page counts
+    uint32_t max_bits = memory64 ? 64 : 32;
+    WRP_CHECK(wrp_read_LEB(buf, max_bits, false, out_min));
+
+    if (has_max) {
+        WRP_CHECK(wrp_read_LEB(buf, max_bits, false, out_max));
+    } else {
+        *out_max = memory64 ? MAX_MEMORY64_PAGES : MAX_MEMORY_PAGES;
+    }
+
+    *out_shared = shared;
+    *out_memory64 = memory64;
+    return WRP_SUCCESS;
+}
@@ -20,6 +20,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "warp-error.h"
 #include "warp-types.h"
 
 typedef struct wrp_buf {
@@ -38,17 +39,106 @@ wrp_err_t wrp_read_uint8(wrp_buf_t *buf, uint8_t *out_value);
 
 wrp_err_t wrp_read_uint32(wrp_buf_t *buf, uint32_t *out_value);
 
-wrp_err_t wrp_read_varui1(wrp_buf_t *buf, uint8_t *out_value);
-
-wrp_err_t wrp_read_varui7(wrp_buf_t *buf, uint8_t *out_value);
-
-wrp_err_t wrp_read_varui32(wrp_buf_t *buf, uint32_t *out_value);
+wrp_err_t wrp_read_LEB(wrp_buf_t *buf, uint32_t max_bits, bool sign_extend, uint64_t *out_value);
 
-wrp_err_t wrp_read_vari7(wrp_buf_t *buf, int8_t *out_value);
-
-wrp_err_t wrp_read_vari32(wrp_buf_t *buf, int32_t *out_value);
+wrp_err_t wrp_read_varui1(wrp_buf_t *buf, uint8_t *out_value);
 
-wrp_err_t wrp_read_vari64(wrp_buf_t *buf, int64_t *out_value);
+//most immediates fit in a single byte, those are decoded inline and every
+//other encoding goes through wrp_read_LEB
+static inline bool wrp_read_LEB_byte(wrp_buf_t *buf, uint8_t *out_byte)
+{
+    if (buf->pos < buf->sz && buf->bytes[buf->pos] < 0x80) {
+        *out_byte = buf->bytes[buf->pos++];
+        return true;
+    }
+
+    return false;
+}
+
+static inline wrp_err_t wrp_read_varui7(wrp_buf_t *buf, uint8_t *out_value)
+{
+    if (wrp_read_LEB_byte(buf, out_value)) {
+        return WRP_SUCCESS;
+    }
+
+    uint64_t leb = 0;
+    wrp_err_t err = wrp_read_LEB(buf, 7, false, &leb);
+    *out_value = (uint8_t)leb;
+    return err;
+}
+
+static inline wrp_err_t wrp_read_varui32(wrp_buf_t *buf, uint32_t *out_value)
+{
+    uint8_t byte = 0;
+
+    if (wrp_read_LEB_byte(buf, &byte)) {
+        *out_value = byte;
+        return WRP_SUCCESS;
+    }
+
+    uint64_t leb = 0;
+    wrp_err_t err = wrp_read_LEB(buf, 32, false, &leb);
+    *out_value = (uint32_t)leb;
+    return err;
+}
+
+static inline wrp_err_t wrp_read_varui64(wrp_buf_t *buf, uint64_t *out_value)
+{
+    uint8_t byte = 0;
+
+    if (wrp_read_LEB_byte(buf, &byte)) {
+        *out_value = byte;
+        return WRP_SUCCESS;
+    }
+
+    return wrp_read_LEB(buf, 64, false, out_value);
+}
+
+//a 7 bit value keeps its top bit, wider values sign extend from bit 6
+static inline wrp_err_t wrp_read_vari7(wrp_buf_t *buf, int8_t *out_value)
+{
+    uint8_t byte = 0;
+
+    if (wrp_read_LEB_byte(buf, &byte)) {
+        *out_value = (int8_t)byte;
+        return WRP_SUCCESS;
+    }
+
+    uint64_t leb = 0;
+    wrp_err_t err = wrp_read_LEB(buf, 7, true, &leb);
+    *out_value = (int8_t)leb;
+    return err;
+}
+
+static inline wrp_err_t wrp_read_vari32(wrp_buf_t *buf, int32_t *out_value)
+{
+    uint8_t byte = 0;
+
+    if (wrp_read_LEB_byte(buf, &byte)) {
+        *out_value = (int32_t)byte - (int32_t)((byte & 0x40) << 1);
+        return WRP_SUCCESS;
+    }
+
+    uint64_t leb = 0;
+    wrp_err_t err = wrp_read_LEB(buf, 32, true, &leb);
+    *out_value = (int32_t)leb;
+    return err;
+}
+
+static inline wrp_err_t wrp_read_vari64(wrp_buf_t *buf, int64_t *out_value)
+{
+    uint8_t byte = 0;
+
+    if (wrp_read_LEB_byte(buf, &byte)) {
+        *out_value = (int64_t)byte - (int64_t)((byte & 0x40) << 1);
+        return WRP_SUCCESS;
+    }
+
+    uint64_t leb = 0;
+    wrp_err_t err = wrp_read_LEB(buf, 64, true, &leb);
+    *out_value = (int64_t)leb;
+    return err;
+}
 
 wrp_err_t wrp_read_f32(wrp_buf_t *buf, float *out_value);
 
@@ -60,3 +150,9 @@ wrp_err_t wrp_read_string(wrp_buf_t *buf,
     uint32_t *out_str_len);
 
 wrp_err_t wrp_read_limits(wrp_buf_t *buf, uint32_t *out_min, uint32_t *out_max);
+
+wrp_err_t wrp_read_memory_limits(wrp_buf_t *buf,
+    uint64_t *out_min,
+    uint64_t *out_max,
+    bool *out_shared,
+    bool *out_memory64);
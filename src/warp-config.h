@@ -26,25 +26,54 @@
 
 // implementation limitations
 #define MAX_MODULE_NAME         64u
-#define MAX_TYPES               32u
-#define MAX_FUNCS               128u
-#define MAX_GLOBALS             32u
-#define MAX_ELEMENT_SEGMENTS    32u
-#define MAX_DATA_SEGMENTS       32u
-#define MAX_IMPORTS             128u
-#define MAX_EXPORTS             128u
-#define MAX_FUNC_PARAMETERS     128u
-#define MAX_FUNC_LOCALS         128u
-#define MAX_CODE_SIZE           4096u
-#define MAX_TABLE_SIZE          4096u
 #define MAX_MEMORY_PAGES        65536u //4Gb
+#define MAX_MEMORY64_PAGES      0x1000000u //1Tb
 #define MAX_GLOBAL_NAME_SIZE    128u
-#define MAX_LOCALS              1024u
 #define MAX_BLOCK_DEPTH         512
-#define MAX_BRANCH_TABLE_SIZE   32u
+
+// default module limits, only there to reject absurd modules, see wrp_set_limits
+#define DEFAULT_MAX_TYPES           1000000u
+#define DEFAULT_MAX_FUNCS           1000000u
+#define DEFAULT_MAX_IMPORTS         100000u
+#define DEFAULT_MAX_EXPORTS         100000u
+#define DEFAULT_MAX_GLOBALS         1000000u
+#define DEFAULT_MAX_ELEM_SEGMENTS   10000000u
+#define DEFAULT_MAX_DATA_SEGMENTS   100000u
+#define DEFAULT_MAX_TABLE_SIZE      10000000u
+#define DEFAULT_MAX_FUNC_PARAMS     1000u
+#define DEFAULT_MAX_FUNC_LOCALS     50000u
+#define DEFAULT_MAX_FUNC_BODY_SZ    7654321u
+#define DEFAULT_MAX_MDLE_SZ         (1ull << 30)    // staged size of the loaded module
+#define DEFAULT_MAX_MEMORY64_RESERVE 0x10000u       // pages of address space a memory64 reserves up front, 4Gb
 
 //vm config
 #define WRP_OPERAND_STK_SZ      4096
 #define WRP_BLOCK_STK_SZ        4096
 #define WRP_CALL_STK_SZ         4096
 #define WRP_ERROR_BUF_SZ        1024u
+#define WRP_MAX_WORKERS         64u     // workers validating a module or running a scheduler frame
+#define WRP_LOAD_ARENA_SZ       4096u   // first loader arena chunk, later chunks double
+#define WRP_REGISTRY_SZ         64u     // first registry table size, doubles when half full
+#define WRP_SCHED_DEQUE_SZ      256u    // first task capacity of each scheduler worker, doubles when full
+#define WRP_MDLE_IMAGE_VERSION  9u      // bump when a module image's contents change meaning
+
+//platform config
+#if defined(__linux__) || defined(__APPLE__)
+#define WRP_MEMORY_RESERVE      1   // reserve max pages of address space, commit demand-zero pages
+#else
+#define WRP_MEMORY_RESERVE      0
+#endif
+
+#if defined(__linux__) || defined(__APPLE__)
+#define WRP_THREADS             1   // pthreads back the default worker pool
+#else
+#define WRP_THREADS             0
+#endif
+
+#if defined(__linux__)
+#define WRP_MEMORY_IMAGES       1   // build initial memory in a memfd, map copy-on-write
+#define WRP_FUTEX               1   // atomic wait/notify on shared memory
+#else
+#define WRP_MEMORY_IMAGES       0
+#define WRP_FUTEX               0
+#endif
@@ -49,6 +49,8 @@ typedef enum wrp_err{
     WRP_ERR_INVALID_MEMORY_ACCESS,
     WRP_ERR_UNKNOWN_BLOCK,
     WRP_ERR_UNKNOWN_FUNC,
+    WRP_ERR_UNKNOWN_EXPORT,
+    WRP_ERR_UNKNOWN_IMPORT,
     WRP_ERR_UNKNOWN_IF,
     WRP_ERR_MISSING_FUNC_IMPORT,
     WRP_ERR_MISSING_TABLE_IMPORT,
@@ -71,6 +73,7 @@ typedef enum wrp_err{
     WRP_ERR_MDLE_INVALID_SECTION_ID,
     WRP_ERR_MDLE_SECTION_ORDER,
     WRP_ERR_MDLE_TYPE_OVERFLOW,
+    WRP_ERR_MDLE_IMPORT_OVERFLOW,
     WRP_ERR_MDLE_LOCAL_OVERFLOW,
     WRP_ERR_MDLE_CODE_OVERFLOW,
     WRP_ERR_MDLE_INVALID_FORM,
@@ -82,6 +85,7 @@ typedef enum wrp_err{
     WRP_ERR_MDLE_MEMORY_OVERFLOW,
     WRP_ERR_MDLE_GLOBAL_OVERFLOW,
     WRP_ERR_MDLE_EXPORT_OVERFLOW,
+    WRP_ERR_MDLE_DUPLICATE_EXPORT,
     WRP_ERR_MDLE_ELEMENT_OVERFLOW,
     WRP_ERR_MDLE_DATA_OVERFLOW,
     WRP_ERR_MDLE_CODE_MISMATCH,
@@ -100,6 +104,20 @@ typedef enum wrp_err{
     WRP_ERR_I32_OVERFLOW,
     WRP_ERR_I64_DIVIDE_BY_ZERO,
     WRP_ERR_I64_OVERFLOW,
+    WRP_ERR_UNALIGNED_ATOMIC,
+    WRP_ERR_INVALID_ATOMIC_WAIT,
+    WRP_ERR_UNDEFINED_ELEMENT,
+    WRP_ERR_UNINITIALIZED_ELEMENT,
+    WRP_ERR_INDIRECT_CALL_TYPE_MISMATCH,
+    WRP_ERR_OUT_OF_FUEL,
+    WRP_ERR_HOST_YIELD,
+    WRP_ERR_HOST_PENDING,
+    WRP_ERR_SUSPEND_REQUESTED,
+    WRP_ERR_INVALID_MDLE_IMAGE,
+    WRP_ERR_MDLE_IMAGE_VERSION,
+    WRP_ERR_MDLE_IMAGE_CHECKSUM,
+    WRP_ERR_VM_SUSPENDED,
+    WRP_ERR_SHARED_INSTANCE,
     WRP_NUM_ERRORS // must be last
 } wrp_err_t;
 
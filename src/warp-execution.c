@@ -15,6 +15,7 @@
  */
 
 #include <math.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <string.h>
 
@@ -23,6 +24,7 @@
 #include "warp-execution.h"
 #include "warp-expr.h"
 #include "warp-macros.h"
+#include "warp-memory.h"
 #include "warp-stack-ops.h"
 #include "warp-wasm.h"
 #include "warp.h"
@@ -62,7 +64,11 @@ static wrp_err_t exec_loop_op(wrp_vm_t *vm)
 {
     int8_t signature = 0;
     WRP_CHECK(wrp_read_vari7(&vm->opcode_stream, &signature));
+
+    //the first iteration was paid with the block around the loop, what the
+    //rest cost is looked up by the first back-edge
     WRP_CHECK(wrp_stk_exec_push_block(vm, vm->opcode_stream.pos - 1, BLOCK_LOOP, signature))
+    vm->ctrl_stk[vm->ctrl_stk_head].fuel_cost = 0;
     return WRP_SUCCESS;
 }
 
@@ -136,30 +142,24 @@ static wrp_err_t exec_br_if_op(wrp_vm_t *vm)
 
 static wrp_err_t exec_br_table_op(wrp_vm_t *vm)
 {
+    int32_t target_idx = 0;
+    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &target_idx));
+
     uint32_t target_count = 0;
     WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &target_count));
 
-    //TODO handle any table size
-    if (target_count > MAX_BRANCH_TABLE_SIZE) {
-        return WRP_ERR_MDLE_BRANCH_TABLE_OVERFLOW;
-    }
-
-    uint32_t branch_table[MAX_BRANCH_TABLE_SIZE] = {0};
+    //targets are varuints, so the chosen one is found by reading up to it,
+    //out of range indices fall through to the default after the last one
+    uint32_t num_reads = target_count + 1;
 
-    for (uint32_t i = 0; i < target_count; i++) {
-        WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &branch_table[i]));
+    if (target_idx >= 0 && (uint32_t)target_idx < target_count) {
+        num_reads = (uint32_t)target_idx + 1;
     }
 
-    uint32_t default_target = 0;
-    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &default_target));
-
-    int32_t target_idx = 0;
-    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &target_idx));
-
-    int32_t depth = default_target;
+    uint32_t depth = 0;
 
-    if (target_idx >= 0 && (uint32_t)target_idx < target_count) {
-        depth = branch_table[target_idx];
+    for (uint32_t i = 0; i < num_reads; i++) {
+        WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &depth));
     }
 
     WRP_CHECK(wrp_stk_exec_pop_block(vm, depth, true));
@@ -182,7 +182,34 @@ static wrp_err_t exec_call_op(wrp_vm_t *vm)
 
 static wrp_err_t exec_call_indirect_op(wrp_vm_t *vm)
 {
-    return WRP_ERR_UNKNOWN;
+    uint32_t type_idx = 0;
+    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &type_idx));
+
+    int8_t indirect_reserved = 0;
+    WRP_CHECK(wrp_read_vari7(&vm->opcode_stream, &indirect_reserved));
+
+    int32_t elem_idx = 0;
+    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &elem_idx));
+
+    //MVP only allows one table
+    wrp_table_t *table = &vm->instance->tables[0];
+
+    if ((uint32_t)elem_idx >= table->num_elem) {
+        return WRP_ERR_UNDEFINED_ELEMENT;
+    }
+
+    wrp_table_entry_t *entry = &table->elem[elem_idx];
+
+    if (entry->func == NULL) {
+        return WRP_ERR_UNINITIALIZED_ELEMENT;
+    }
+
+    if (entry->sig_id != vm->mdle->types[type_idx].sig_id) {
+        return WRP_ERR_INDIRECT_CALL_TYPE_MISMATCH;
+    }
+
+    WRP_CHECK(wrp_stk_exec_push_func(vm, entry->instance, entry->func, entry->func_idx));
+    return WRP_SUCCESS;
 }
 
 static wrp_err_t exec_drop_op(wrp_vm_t *vm)
@@ -264,16 +291,23 @@ static wrp_err_t exec_tee_local_op(wrp_vm_t *vm)
     return WRP_ERR_UNKNOWN;
 }
 
+//validation bounds the index, imported globals come first and are the only
+//ones behind a pointer
+static uint64_t *global_address(wrp_vm_t *vm, uint32_t global_idx)
+{
+    if (global_idx < vm->num_global_imports) {
+        return vm->global_imports[global_idx];
+    }
+
+    return &vm->globals[global_idx];
+}
+
 static wrp_err_t exec_get_global_op(wrp_vm_t *vm)
 {
     uint32_t global_idx = 0;
     WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &global_idx));
 
-    if (global_idx >= vm->mdle->num_globals) {
-        return WRP_ERR_INVALID_GLOBAL_IDX;
-    }
-
-    uint64_t global_value = *vm->mdle->globals[global_idx].value;
+    uint64_t global_value = *global_address(vm, global_idx);
     uint8_t global_type = vm->mdle->globals[global_idx].type;
     WRP_CHECK(wrp_stk_exec_push_op(vm, global_value, global_type));
     return WRP_SUCCESS;
@@ -284,52 +318,71 @@ static wrp_err_t exec_set_global_op(wrp_vm_t *vm)
     uint32_t global_idx = 0;
     WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &global_idx));
 
-    if (global_idx >= vm->mdle->num_globals) {
-        return WRP_ERR_INVALID_GLOBAL_IDX;
-    }
-
     uint64_t global_value = 0;
     int8_t global_type = 0;
     WRP_CHECK(wrp_stk_exec_pop_op(vm, &global_value, &global_type));
 
     //safe to assume types match as code has been type checked
-    *vm->mdle->globals[global_idx].value = global_value;
+    *global_address(vm, global_idx) = global_value;
+    vm->instance->globals_dirty = true;
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load(wrp_vm_t *vm,
-    int8_t type,
-    size_t natural_alignment,
-    size_t num_bytes,
-    bool sign_extend)
+static wrp_err_t memory_address(wrp_vm_t *vm, size_t num_bytes, uint64_t *out_address)
 {
     uint32_t flags = 0;
     WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &flags));
 
     //uint32_t alignment = (1U << flags);
 
-    uint32_t offset = 0;
-    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &offset));
+    wrp_memory_t *memory = vm->memory;
+    uint64_t effective_address = 0;
 
-    int32_t address = 0;
-    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &address));
+    //a 32 bit address plus offset can't wrap in 64 bits, so only memory64
+    //needs the carry check before the single compare against the size
+    if (memory->memory64) {
+        uint64_t offset = 0;
+        WRP_CHECK(wrp_read_varui64(&vm->opcode_stream, &offset));
 
-    uint32_t effective_address = (uint32_t)address + offset;
+        int64_t address = 0;
+        WRP_CHECK(wrp_stk_exec_pop_i64(vm, &address));
 
-    if (effective_address < (uint32_t)address || effective_address < offset) {
-        return WRP_ERR_I32_OVERFLOW;
-    }
+        effective_address = (uint64_t)address + offset;
 
-    if (effective_address + num_bytes < effective_address) {
-        return WRP_ERR_I32_OVERFLOW;
+        if (effective_address < offset) {
+            return WRP_ERR_INVALID_MEMORY_ACCESS;
+        }
+    } else {
+        uint32_t offset = 0;
+        WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &offset));
+
+        int32_t address = 0;
+        WRP_CHECK(wrp_stk_exec_pop_i32(vm, &address));
+
+        effective_address = (uint64_t)(uint32_t)address + offset;
     }
 
-    if (effective_address + num_bytes > vm->mdle->memories[0].num_pages * PAGE_SIZE) {
+    uint64_t mem_sz = (uint64_t)memory->num_pages * PAGE_SIZE;
+
+    if (num_bytes > mem_sz || effective_address > mem_sz - num_bytes) {
         return WRP_ERR_INVALID_MEMORY_ACCESS;
     }
 
+    *out_address = effective_address;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t load(wrp_vm_t *vm,
+    int8_t type,
+    size_t natural_alignment,
+    size_t num_bytes,
+    bool sign_extend)
+{
+    uint64_t effective_address = 0;
+    WRP_CHECK(memory_address(vm, num_bytes, &effective_address));
+
     uint64_t value = 0;
-    memcpy(&value, vm->mdle->memories[0].bytes + effective_address, num_bytes);
+    memcpy(&value, vm->memory->bytes + effective_address, num_bytes);
 
     if (sign_extend && (value & (1U << ((CHAR_BIT * num_bytes) - 1)))) {
 
@@ -416,37 +469,19 @@ static wrp_err_t exec_i64_load_32_u_op(wrp_vm_t *vm)
 
 static wrp_err_t store(wrp_vm_t *vm, size_t natural_alignment, size_t num_bytes)
 {
-    uint32_t flags = 0;
-    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &flags));
-
-    //uint32_t alignment = (1U << flags);
-
-    uint32_t offset = 0;
-    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &offset));
-
     uint64_t value = 0;
     int8_t type = 0;
     WRP_CHECK(wrp_stk_exec_pop_op(vm, &value, &type));
 
-    int32_t address = 0;
-    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &address));
-
-    uint32_t effective_address = (uint32_t)address + offset;
-
-    if (effective_address < (uint32_t)address || effective_address < offset) {
-        return WRP_ERR_I32_OVERFLOW;
-    }
+    uint64_t effective_address = 0;
+    WRP_CHECK(memory_address(vm, num_bytes, &effective_address));
 
-    if (effective_address + num_bytes < effective_address) {
-        return WRP_ERR_I32_OVERFLOW;
-    }
+    memcpy(vm->memory->bytes + effective_address, &value, num_bytes);
 
-    if (effective_address + num_bytes > vm->mdle->memories[0].num_pages * PAGE_SIZE) {
-        return WRP_ERR_INVALID_MEMORY_ACCESS;
+    if (vm->memory->dirty.epochs != NULL) {
+        wrp_mem_mark_dirty(vm->memory, effective_address, num_bytes);
     }
 
-    memcpy(vm->mdle->memories[0].bytes + effective_address, &value, num_bytes);
-
     return WRP_SUCCESS;
 }
 
@@ -500,7 +535,12 @@ static wrp_err_t exec_current_memory_op(wrp_vm_t *vm)
     int32_t reserved = 0;
     WRP_CHECK(wrp_read_vari32(&vm->opcode_stream, &reserved));
 
-    WRP_CHECK(wrp_stk_exec_push_i32(vm, (int32_t)vm->mdle->memories[0].num_pages));
+    if (vm->memory->memory64) {
+        WRP_CHECK(wrp_stk_exec_push_i64(vm, (int64_t)vm->memory->num_pages));
+    } else {
+        WRP_CHECK(wrp_stk_exec_push_i32(vm, (int32_t)vm->memory->num_pages));
+    }
+
     return WRP_SUCCESS;
 }
 
@@ -509,36 +549,573 @@ static wrp_err_t exec_grow_memory_op(wrp_vm_t *vm)
     int32_t reserved = 0;
     WRP_CHECK(wrp_read_vari32(&vm->opcode_stream, &reserved));
 
-    int32_t delta = 0;
-    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &delta));
+    //memory64 takes and returns i64 page counts
+    bool memory64 = vm->memory->memory64;
+    uint64_t delta = 0;
+
+    if (memory64) {
+        int64_t delta_i64 = 0;
+        WRP_CHECK(wrp_stk_exec_pop_i64(vm, &delta_i64));
+        delta = (uint64_t)delta_i64;
+    } else {
+        int32_t delta_i32 = 0;
+        WRP_CHECK(wrp_stk_exec_pop_i32(vm, &delta_i32));
+        delta = (uint32_t)delta_i32;
+    }
+
+    uint32_t prev_pages = vm->memory->num_pages;
+    int64_t result = -1;
 
     if (delta == 0) {
-        WRP_CHECK(wrp_stk_exec_push_i32(vm, (int32_t)vm->mdle->memories[0].num_pages));
-        return WRP_SUCCESS;
+        result = prev_pages;
+    } else if (delta <= UINT32_MAX &&
+        wrp_mem_grow(vm, vm->memory, (uint32_t)delta, &prev_pages) == WRP_SUCCESS) {
+        result = prev_pages;
     }
 
-    uint32_t total_pages = vm->mdle->memories[0].num_pages + (uint32_t)delta;
+    if (memory64) {
+        WRP_CHECK(wrp_stk_exec_push_i64(vm, result));
+    } else {
+        WRP_CHECK(wrp_stk_exec_push_i32(vm, (int32_t)result));
+    }
 
-    if (total_pages > vm->mdle->memories[0].max_pages) {
-        WRP_CHECK(wrp_stk_exec_push_i32(vm, -1));
-        return WRP_SUCCESS;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t atomic_address(wrp_vm_t *vm, size_t num_bytes, uint8_t **out_ptr)
+{
+    uint64_t effective_address = 0;
+    WRP_CHECK(memory_address(vm, num_bytes, &effective_address));
+
+    //unlike plain loads and stores, atomics trap when misaligned
+    if (effective_address % num_bytes != 0) {
+        return WRP_ERR_UNALIGNED_ATOMIC;
     }
 
-    uint8_t *bytes = vm->alloc_fn(total_pages * PAGE_SIZE, 64);
-    int32_t result = -1;
+    //every atomic counts as a write, even the loads
+    if (vm->memory->dirty.epochs != NULL) {
+        wrp_mem_mark_dirty(vm->memory, effective_address, num_bytes);
+    }
+
+    *out_ptr = vm->memory->bytes + effective_address;
+    return WRP_SUCCESS;
+}
 
-    if (bytes != NULL) {
-        memcpy(bytes, vm->mdle->memories[0].bytes, vm->mdle->memories[0].num_pages * PAGE_SIZE);
-        vm->free_fn(vm->mdle->memories[0].bytes);
-        result = (int32_t)vm->mdle->memories[0].num_pages;
-        vm->mdle->memories[0].bytes = bytes;
-        vm->mdle->memories[0].num_pages = total_pages;
+static uint64_t atomic_load_bytes(uint8_t *ptr, size_t num_bytes)
+{
+    switch (num_bytes) {
+    case sizeof(uint8_t):
+        return atomic_load((_Atomic uint8_t *)ptr);
+    case sizeof(uint16_t):
+        return atomic_load((_Atomic uint16_t *)ptr);
+    case sizeof(uint32_t):
+        return atomic_load((_Atomic uint32_t *)ptr);
+    default:
+        return atomic_load((_Atomic uint64_t *)ptr);
     }
+}
 
-    WRP_CHECK(wrp_stk_exec_push_i32(vm, result));
+static void atomic_store_bytes(uint8_t *ptr, size_t num_bytes, uint64_t value)
+{
+    switch (num_bytes) {
+    case sizeof(uint8_t):
+        atomic_store((_Atomic uint8_t *)ptr, (uint8_t)value);
+        break;
+    case sizeof(uint16_t):
+        atomic_store((_Atomic uint16_t *)ptr, (uint16_t)value);
+        break;
+    case sizeof(uint32_t):
+        atomic_store((_Atomic uint32_t *)ptr, (uint32_t)value);
+        break;
+    default:
+        atomic_store((_Atomic uint64_t *)ptr, value);
+        break;
+    }
+}
+
+//read-modify-write operations
+#define RMW_ADD     0
+#define RMW_SUB     1
+#define RMW_AND     2
+#define RMW_OR      3
+#define RMW_XOR     4
+#define RMW_XCHG    5
+
+#define ATOMIC_RMW(type, ptr, rmw_op, value)                            \
+    switch (rmw_op) {                                                   \
+    case RMW_ADD:                                                       \
+        return atomic_fetch_add((_Atomic type *)(ptr), (type)(value));  \
+    case RMW_SUB:                                                       \
+        return atomic_fetch_sub((_Atomic type *)(ptr), (type)(value));  \
+    case RMW_AND:                                                       \
+        return atomic_fetch_and((_Atomic type *)(ptr), (type)(value));  \
+    case RMW_OR:                                                        \
+        return atomic_fetch_or((_Atomic type *)(ptr), (type)(value));   \
+    case RMW_XOR:                                                       \
+        return atomic_fetch_xor((_Atomic type *)(ptr), (type)(value));  \
+    default:                                                            \
+        return atomic_exchange((_Atomic type *)(ptr), (type)(value));   \
+    }
+
+static uint64_t atomic_rmw_bytes(uint8_t *ptr, size_t num_bytes, uint8_t rmw_op, uint64_t value)
+{
+    switch (num_bytes) {
+    case sizeof(uint8_t):
+        ATOMIC_RMW(uint8_t, ptr, rmw_op, value);
+    case sizeof(uint16_t):
+        ATOMIC_RMW(uint16_t, ptr, rmw_op, value);
+    case sizeof(uint32_t):
+        ATOMIC_RMW(uint32_t, ptr, rmw_op, value);
+    default:
+        ATOMIC_RMW(uint64_t, ptr, rmw_op, value);
+    }
+}
+
+#define ATOMIC_CMPXCHG(type, ptr, expected, replacement)                                    \
+    {                                                                                       \
+        type current = (type)(expected);                                                    \
+        atomic_compare_exchange_strong((_Atomic type *)(ptr), &current, (type)(replacement)); \
+        return current;                                                                     \
+    }
+
+static uint64_t atomic_cmpxchg_bytes(uint8_t *ptr,
+    size_t num_bytes,
+    uint64_t expected,
+    uint64_t replacement)
+{
+    switch (num_bytes) {
+    case sizeof(uint8_t):
+        ATOMIC_CMPXCHG(uint8_t, ptr, expected, replacement);
+    case sizeof(uint16_t):
+        ATOMIC_CMPXCHG(uint16_t, ptr, expected, replacement);
+    case sizeof(uint32_t):
+        ATOMIC_CMPXCHG(uint32_t, ptr, expected, replacement);
+    default:
+        ATOMIC_CMPXCHG(uint64_t, ptr, expected, replacement);
+    }
+}
+
+static wrp_err_t atomic_load_op(wrp_vm_t *vm, int8_t type, size_t num_bytes)
+{
+    uint8_t *ptr = NULL;
+    WRP_CHECK(atomic_address(vm, num_bytes, &ptr));
+    WRP_CHECK(wrp_stk_exec_push_op(vm, atomic_load_bytes(ptr, num_bytes), type));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t atomic_store_op(wrp_vm_t *vm, size_t num_bytes)
+{
+    uint64_t value = 0;
+    int8_t type = 0;
+    WRP_CHECK(wrp_stk_exec_pop_op(vm, &value, &type));
+
+    uint8_t *ptr = NULL;
+    WRP_CHECK(atomic_address(vm, num_bytes, &ptr));
+    atomic_store_bytes(ptr, num_bytes, value);
     return WRP_SUCCESS;
 }
 
+static wrp_err_t atomic_rmw_op(wrp_vm_t *vm, int8_t type, size_t num_bytes, uint8_t rmw_op)
+{
+    uint64_t value = 0;
+    int8_t value_type = 0;
+    WRP_CHECK(wrp_stk_exec_pop_op(vm, &value, &value_type));
+
+    uint8_t *ptr = NULL;
+    WRP_CHECK(atomic_address(vm, num_bytes, &ptr));
+    WRP_CHECK(wrp_stk_exec_push_op(vm, atomic_rmw_bytes(ptr, num_bytes, rmw_op, value), type));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t atomic_cmpxchg_op(wrp_vm_t *vm, int8_t type, size_t num_bytes)
+{
+    uint64_t replacement = 0;
+    int8_t replacement_type = 0;
+    WRP_CHECK(wrp_stk_exec_pop_op(vm, &replacement, &replacement_type));
+
+    uint64_t expected = 0;
+    int8_t expected_type = 0;
+    WRP_CHECK(wrp_stk_exec_pop_op(vm, &expected, &expected_type));
+
+    uint8_t *ptr = NULL;
+    WRP_CHECK(atomic_address(vm, num_bytes, &ptr));
+
+    uint64_t result = atomic_cmpxchg_bytes(ptr, num_bytes, expected, replacement);
+    WRP_CHECK(wrp_stk_exec_push_op(vm, result, type));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t exec_atomic_notify_op(wrp_vm_t *vm)
+{
+    int32_t count = 0;
+    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &count));
+
+    uint8_t *ptr = NULL;
+    WRP_CHECK(atomic_address(vm, sizeof(uint32_t), &ptr));
+
+    uint32_t woken = wrp_mem_notify(vm->memory, ptr, (uint32_t)count);
+    WRP_CHECK(wrp_stk_exec_push_i32(vm, (int32_t)woken));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t exec_i32_atomic_wait_op(wrp_vm_t *vm)
+{
+    int64_t timeout = 0;
+    WRP_CHECK(wrp_stk_exec_pop_i64(vm, &timeout));
+
+    int32_t expected = 0;
+    WRP_CHECK(wrp_stk_exec_pop_i32(vm, &expected));
+
+    uint8_t *ptr = NULL;
+    WRP_CHECK(atomic_address(vm, sizeof(uint32_t), &ptr));
+
+    uint32_t result = 0;
+    WRP_CHECK(wrp_mem_wait32(vm->memory, ptr, (uint32_t)expected, timeout, &result));
+    WRP_CHECK(wrp_stk_exec_push_i32(vm, (int32_t)result));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t exec_i64_atomic_wait_op(wrp_vm_t *vm)
+{
+    int64_t timeout = 0;
+    WRP_CHECK(wrp_stk_exec_pop_i64(vm, &timeout));
+
+    int64_t expected = 0;
+    WRP_CHECK(wrp_stk_exec_pop_i64(vm, &expected));
+
+    uint8_t *ptr = NULL;
+    WRP_CHECK(atomic_address(vm, sizeof(uint64_t), &ptr));
+
+    uint32_t result = 0;
+    WRP_CHECK(wrp_mem_wait64(vm->memory, ptr, (uint64_t)expected, timeout, &result));
+    WRP_CHECK(wrp_stk_exec_push_i32(vm, (int32_t)result));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t exec_atomic_fence_op(wrp_vm_t *vm)
+{
+    uint8_t reserved = 0;
+    WRP_CHECK(wrp_read_uint8(&vm->opcode_stream, &reserved));
+
+    atomic_thread_fence(memory_order_seq_cst);
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t exec_i32_atomic_load_op(wrp_vm_t *vm)
+{
+    return atomic_load_op(vm, I32, sizeof(uint32_t));
+}
+
+static wrp_err_t exec_i64_atomic_load_op(wrp_vm_t *vm)
+{
+    return atomic_load_op(vm, I64, sizeof(uint64_t));
+}
+
+static wrp_err_t exec_i32_atomic_load_8_u_op(wrp_vm_t *vm)
+{
+    return atomic_load_op(vm, I32, sizeof(uint8_t));
+}
+
+static wrp_err_t exec_i32_atomic_load_16_u_op(wrp_vm_t *vm)
+{
+    return atomic_load_op(vm, I32, sizeof(uint16_t));
+}
+
+static wrp_err_t exec_i64_atomic_load_8_u_op(wrp_vm_t *vm)
+{
+    return atomic_load_op(vm, I64, sizeof(uint8_t));
+}
+
+static wrp_err_t exec_i64_atomic_load_16_u_op(wrp_vm_t *vm)
+{
+    return atomic_load_op(vm, I64, sizeof(uint16_t));
+}
+
+static wrp_err_t exec_i64_atomic_load_32_u_op(wrp_vm_t *vm)
+{
+    return atomic_load_op(vm, I64, sizeof(uint32_t));
+}
+
+static wrp_err_t exec_i32_atomic_store_op(wrp_vm_t *vm)
+{
+    return atomic_store_op(vm, sizeof(uint32_t));
+}
+
+static wrp_err_t exec_i64_atomic_store_op(wrp_vm_t *vm)
+{
+    return atomic_store_op(vm, sizeof(uint64_t));
+}
+
+static wrp_err_t exec_i32_atomic_store_8_op(wrp_vm_t *vm)
+{
+    return atomic_store_op(vm, sizeof(uint8_t));
+}
+
+static wrp_err_t exec_i32_atomic_store_16_op(wrp_vm_t *vm)
+{
+    return atomic_store_op(vm, sizeof(uint16_t));
+}
+
+static wrp_err_t exec_i64_atomic_store_8_op(wrp_vm_t *vm)
+{
+    return atomic_store_op(vm, sizeof(uint8_t));
+}
+
+static wrp_err_t exec_i64_atomic_store_16_op(wrp_vm_t *vm)
+{
+    return atomic_store_op(vm, sizeof(uint16_t));
+}
+
+static wrp_err_t exec_i64_atomic_store_32_op(wrp_vm_t *vm)
+{
+    return atomic_store_op(vm, sizeof(uint32_t));
+}
+
+static wrp_err_t exec_i32_atomic_rmw_add_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint32_t), RMW_ADD);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_add_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint64_t), RMW_ADD);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_8_add_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint8_t), RMW_ADD);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_16_add_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint16_t), RMW_ADD);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_8_add_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint8_t), RMW_ADD);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_16_add_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint16_t), RMW_ADD);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_32_add_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint32_t), RMW_ADD);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_sub_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint32_t), RMW_SUB);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_sub_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint64_t), RMW_SUB);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_8_sub_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint8_t), RMW_SUB);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_16_sub_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint16_t), RMW_SUB);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_8_sub_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint8_t), RMW_SUB);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_16_sub_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint16_t), RMW_SUB);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_32_sub_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint32_t), RMW_SUB);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_and_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint32_t), RMW_AND);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_and_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint64_t), RMW_AND);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_8_and_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint8_t), RMW_AND);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_16_and_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint16_t), RMW_AND);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_8_and_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint8_t), RMW_AND);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_16_and_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint16_t), RMW_AND);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_32_and_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint32_t), RMW_AND);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_or_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint32_t), RMW_OR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_or_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint64_t), RMW_OR);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_8_or_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint8_t), RMW_OR);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_16_or_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint16_t), RMW_OR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_8_or_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint8_t), RMW_OR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_16_or_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint16_t), RMW_OR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_32_or_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint32_t), RMW_OR);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_xor_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint32_t), RMW_XOR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_xor_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint64_t), RMW_XOR);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_8_xor_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint8_t), RMW_XOR);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_16_xor_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint16_t), RMW_XOR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_8_xor_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint8_t), RMW_XOR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_16_xor_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint16_t), RMW_XOR);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_32_xor_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint32_t), RMW_XOR);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_xchg_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint32_t), RMW_XCHG);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_xchg_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint64_t), RMW_XCHG);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_8_xchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint8_t), RMW_XCHG);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_16_xchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I32, sizeof(uint16_t), RMW_XCHG);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_8_xchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint8_t), RMW_XCHG);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_16_xchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint16_t), RMW_XCHG);
+}
+
+static wrp_err_t exec_i64_atomic_rmw_32_xchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_rmw_op(vm, I64, sizeof(uint32_t), RMW_XCHG);
+}
+
+static wrp_err_t exec_i32_atomic_rmw_cmpxchg_op(wrp_vm_t *vm)
+{
+    return atomic_cmpxchg_op(vm, I32, sizeof(uint32_t));
+}
+
+static wrp_err_t exec_i64_atomic_rmw_cmpxchg_op(wrp_vm_t *vm)
+{
+    return atomic_cmpxchg_op(vm, I64, sizeof(uint64_t));
+}
+
+static wrp_err_t exec_i32_atomic_rmw_8_cmpxchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_cmpxchg_op(vm, I32, sizeof(uint8_t));
+}
+
+static wrp_err_t exec_i32_atomic_rmw_16_cmpxchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_cmpxchg_op(vm, I32, sizeof(uint16_t));
+}
+
+static wrp_err_t exec_i64_atomic_rmw_8_cmpxchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_cmpxchg_op(vm, I64, sizeof(uint8_t));
+}
+
+static wrp_err_t exec_i64_atomic_rmw_16_cmpxchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_cmpxchg_op(vm, I64, sizeof(uint16_t));
+}
+
+static wrp_err_t exec_i64_atomic_rmw_32_cmpxchg_u_op(wrp_vm_t *vm)
+{
+    return atomic_cmpxchg_op(vm, I64, sizeof(uint32_t));
+}
+
 static wrp_err_t exec_i32_const_op(wrp_vm_t *vm)
 {
     int32_t i32_const = 0;
@@ -2658,10 +3235,120 @@ static wrp_err_t (*const exec_jump_table[])(wrp_vm_t *vm) = {
     //clang-format brace hack
 };
 
-wrp_err_t wrp_exec_func(wrp_vm_t *vm, uint32_t func_idx)
+static wrp_err_t (*const exec_atomic_jump_table[])(wrp_vm_t *vm) = {
+    [OP_ATOMIC_NOTIFY] = exec_atomic_notify_op,
+    [OP_I32_ATOMIC_WAIT] = exec_i32_atomic_wait_op,
+    [OP_I64_ATOMIC_WAIT] = exec_i64_atomic_wait_op,
+    [OP_ATOMIC_FENCE] = exec_atomic_fence_op,
+    [0x04] = exec_invalid_op,
+    [0x05] = exec_invalid_op,
+    [0x06] = exec_invalid_op,
+    [0x07] = exec_invalid_op,
+    [0x08] = exec_invalid_op,
+    [0x09] = exec_invalid_op,
+    [0x0A] = exec_invalid_op,
+    [0x0B] = exec_invalid_op,
+    [0x0C] = exec_invalid_op,
+    [0x0D] = exec_invalid_op,
+    [0x0E] = exec_invalid_op,
+    [0x0F] = exec_invalid_op,
+    [OP_I32_ATOMIC_LOAD] = exec_i32_atomic_load_op,
+    [OP_I64_ATOMIC_LOAD] = exec_i64_atomic_load_op,
+    [OP_I32_ATOMIC_LOAD_8_U] = exec_i32_atomic_load_8_u_op,
+    [OP_I32_ATOMIC_LOAD_16_U] = exec_i32_atomic_load_16_u_op,
+    [OP_I64_ATOMIC_LOAD_8_U] = exec_i64_atomic_load_8_u_op,
+    [OP_I64_ATOMIC_LOAD_16_U] = exec_i64_atomic_load_16_u_op,
+    [OP_I64_ATOMIC_LOAD_32_U] = exec_i64_atomic_load_32_u_op,
+    [OP_I32_ATOMIC_STORE] = exec_i32_atomic_store_op,
+    [OP_I64_ATOMIC_STORE] = exec_i64_atomic_store_op,
+    [OP_I32_ATOMIC_STORE_8] = exec_i32_atomic_store_8_op,
+    [OP_I32_ATOMIC_STORE_16] = exec_i32_atomic_store_16_op,
+    [OP_I64_ATOMIC_STORE_8] = exec_i64_atomic_store_8_op,
+    [OP_I64_ATOMIC_STORE_16] = exec_i64_atomic_store_16_op,
+    [OP_I64_ATOMIC_STORE_32] = exec_i64_atomic_store_32_op,
+    [OP_I32_ATOMIC_RMW_ADD] = exec_i32_atomic_rmw_add_op,
+    [OP_I64_ATOMIC_RMW_ADD] = exec_i64_atomic_rmw_add_op,
+    [OP_I32_ATOMIC_RMW_8_ADD_U] = exec_i32_atomic_rmw_8_add_u_op,
+    [OP_I32_ATOMIC_RMW_16_ADD_U] = exec_i32_atomic_rmw_16_add_u_op,
+    [OP_I64_ATOMIC_RMW_8_ADD_U] = exec_i64_atomic_rmw_8_add_u_op,
+    [OP_I64_ATOMIC_RMW_16_ADD_U] = exec_i64_atomic_rmw_16_add_u_op,
+    [OP_I64_ATOMIC_RMW_32_ADD_U] = exec_i64_atomic_rmw_32_add_u_op,
+    [OP_I32_ATOMIC_RMW_SUB] = exec_i32_atomic_rmw_sub_op,
+    [OP_I64_ATOMIC_RMW_SUB] = exec_i64_atomic_rmw_sub_op,
+    [OP_I32_ATOMIC_RMW_8_SUB_U] = exec_i32_atomic_rmw_8_sub_u_op,
+    [OP_I32_ATOMIC_RMW_16_SUB_U] = exec_i32_atomic_rmw_16_sub_u_op,
+    [OP_I64_ATOMIC_RMW_8_SUB_U] = exec_i64_atomic_rmw_8_sub_u_op,
+    [OP_I64_ATOMIC_RMW_16_SUB_U] = exec_i64_atomic_rmw_16_sub_u_op,
+    [OP_I64_ATOMIC_RMW_32_SUB_U] = exec_i64_atomic_rmw_32_sub_u_op,
+    [OP_I32_ATOMIC_RMW_AND] = exec_i32_atomic_rmw_and_op,
+    [OP_I64_ATOMIC_RMW_AND] = exec_i64_atomic_rmw_and_op,
+    [OP_I32_ATOMIC_RMW_8_AND_U] = exec_i32_atomic_rmw_8_and_u_op,
+    [OP_I32_ATOMIC_RMW_16_AND_U] = exec_i32_atomic_rmw_16_and_u_op,
+    [OP_I64_ATOMIC_RMW_8_AND_U] = exec_i64_atomic_rmw_8_and_u_op,
+    [OP_I64_ATOMIC_RMW_16_AND_U] = exec_i64_atomic_rmw_16_and_u_op,
+    [OP_I64_ATOMIC_RMW_32_AND_U] = exec_i64_atomic_rmw_32_and_u_op,
+    [OP_I32_ATOMIC_RMW_OR] = exec_i32_atomic_rmw_or_op,
+    [OP_I64_ATOMIC_RMW_OR] = exec_i64_atomic_rmw_or_op,
+    [OP_I32_ATOMIC_RMW_8_OR_U] = exec_i32_atomic_rmw_8_or_u_op,
+    [OP_I32_ATOMIC_RMW_16_OR_U] = exec_i32_atomic_rmw_16_or_u_op,
+    [OP_I64_ATOMIC_RMW_8_OR_U] = exec_i64_atomic_rmw_8_or_u_op,
+    [OP_I64_ATOMIC_RMW_16_OR_U] = exec_i64_atomic_rmw_16_or_u_op,
+    [OP_I64_ATOMIC_RMW_32_OR_U] = exec_i64_atomic_rmw_32_or_u_op,
+    [OP_I32_ATOMIC_RMW_XOR] = exec_i32_atomic_rmw_xor_op,
+    [OP_I64_ATOMIC_RMW_XOR] = exec_i64_atomic_rmw_xor_op,
+    [OP_I32_ATOMIC_RMW_8_XOR_U] = exec_i32_atomic_rmw_8_xor_u_op,
+    [OP_I32_ATOMIC_RMW_16_XOR_U] = exec_i32_atomic_rmw_16_xor_u_op,
+    [OP_I64_ATOMIC_RMW_8_XOR_U] = exec_i64_atomic_rmw_8_xor_u_op,
+    [OP_I64_ATOMIC_RMW_16_XOR_U] = exec_i64_atomic_rmw_16_xor_u_op,
+    [OP_I64_ATOMIC_RMW_32_XOR_U] = exec_i64_atomic_rmw_32_xor_u_op,
+    [OP_I32_ATOMIC_RMW_XCHG] = exec_i32_atomic_rmw_xchg_op,
+    [OP_I64_ATOMIC_RMW_XCHG] = exec_i64_atomic_rmw_xchg_op,
+    [OP_I32_ATOMIC_RMW_8_XCHG_U] = exec_i32_atomic_rmw_8_xchg_u_op,
+    [OP_I32_ATOMIC_RMW_16_XCHG_U] = exec_i32_atomic_rmw_16_xchg_u_op,
+    [OP_I64_ATOMIC_RMW_8_XCHG_U] = exec_i64_atomic_rmw_8_xchg_u_op,
+    [OP_I64_ATOMIC_RMW_16_XCHG_U] = exec_i64_atomic_rmw_16_xchg_u_op,
+    [OP_I64_ATOMIC_RMW_32_XCHG_U] = exec_i64_atomic_rmw_32_xchg_u_op,
+    [OP_I32_ATOMIC_RMW_CMPXCHG] = exec_i32_atomic_rmw_cmpxchg_op,
+    [OP_I64_ATOMIC_RMW_CMPXCHG] = exec_i64_atomic_rmw_cmpxchg_op,
+    [OP_I32_ATOMIC_RMW_8_CMPXCHG_U] = exec_i32_atomic_rmw_8_cmpxchg_u_op,
+    [OP_I32_ATOMIC_RMW_16_CMPXCHG_U] = exec_i32_atomic_rmw_16_cmpxchg_u_op,
+    [OP_I64_ATOMIC_RMW_8_CMPXCHG_U] = exec_i64_atomic_rmw_8_cmpxchg_u_op,
+    [OP_I64_ATOMIC_RMW_16_CMPXCHG_U] = exec_i64_atomic_rmw_16_cmpxchg_u_op,
+    [OP_I64_ATOMIC_RMW_32_CMPXCHG_U] = exec_i64_atomic_rmw_32_cmpxchg_u_op
+    //clang-format brace hack
+};
+
+static wrp_err_t exec_atomic_op(wrp_vm_t *vm)
+{
+    uint32_t atomic_opcode = 0;
+    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &atomic_opcode));
+
+    if (atomic_opcode >= NUM_ATOMIC_OPCODES) {
+        return WRP_ERR_INVALID_OPCODE;
+    }
+
+    return exec_atomic_jump_table[atomic_opcode](vm);
+}
+
+//fuel running out and suspend requests stop a call at a call or loop
+//back-edge before anything but the instruction's operands has changed, so
+//it's rewound to run again on resume. A yielding or pending host function
+//has already returned, so resuming carries on after the call to it.
+static wrp_err_t stop_exec(wrp_vm_t *vm, size_t pc, int32_t oprd_stk_head)
 {
-    WRP_CHECK(wrp_stk_exec_push_call(vm, func_idx));
+    if (vm->err == WRP_ERR_OUT_OF_FUEL || vm->err == WRP_ERR_SUSPEND_REQUESTED) {
+        vm->opcode_stream.pos = pc;
+        vm->oprd_stk_head = oprd_stk_head;
+        vm->suspended = true;
+    } else if (vm->err == WRP_ERR_HOST_YIELD || vm->err == WRP_ERR_HOST_PENDING) {
+        vm->suspended = true;
+    }
+
+    return vm->err;
+}
 
+static wrp_err_t exec_loop(wrp_vm_t *vm)
+{
     while (vm->call_stk_head >= 0) {
         if (vm->opcode_stream.bytes == NULL) {
             return WRP_ERR_INVALID_INSTRUCTION_STREAM;
@@ -2671,22 +3358,75 @@ wrp_err_t wrp_exec_func(wrp_vm_t *vm, uint32_t func_idx)
             return WRP_ERR_INSTRUCTION_OVERFLOW;
         }
 
+        size_t pc = vm->opcode_stream.pos;
+        int32_t oprd_stk_head = vm->oprd_stk_head;
         uint8_t opcode = 0;
         WRP_CHECK(wrp_read_uint8(&vm->opcode_stream, &opcode));
 
+        if (opcode == OP_ATOMIC_PREFIX) {
+            if ((vm->err = exec_atomic_op(vm)) != WRP_SUCCESS) {
+                return vm->err;
+            }
+
+            continue;
+        }
+
         if (opcode >= NUM_OPCODES) {
             return WRP_ERR_INVALID_OPCODE;
         }
 
         if ((vm->err = exec_jump_table[opcode](vm)) != WRP_SUCCESS) {
-            //restore program counter
-            return vm->err;
+            return stop_exec(vm, pc, oprd_stk_head);
         }
     }
 
     return WRP_SUCCESS;
 }
 
+wrp_err_t wrp_exec_func(wrp_vm_t *vm, uint32_t func_idx)
+{
+    vm->entry_func_idx = func_idx;
+    vm->entry_stopped = false;
+    wrp_err_t err = wrp_stk_exec_push_call(vm, func_idx);
+
+    //an entry that couldn't be paid for is called again on resume, a host
+    //function that yielded has nothing left to run
+    if (err == WRP_ERR_OUT_OF_FUEL || err == WRP_ERR_SUSPEND_REQUESTED) {
+        vm->suspended = true;
+        vm->entry_stopped = true;
+        return err;
+    }
+
+    //a pending host function only has its results left to be pushed
+    if (err == WRP_ERR_HOST_PENDING) {
+        vm->suspended = true;
+        return err;
+    }
+
+    if (err != WRP_SUCCESS && err != WRP_ERR_HOST_YIELD) {
+        return err;
+    }
+
+    return exec_loop(vm);
+}
+
+wrp_err_t wrp_exec_resume(wrp_vm_t *vm)
+{
+    vm->suspended = false;
+
+    if (vm->entry_stopped) {
+        return wrp_exec_func(vm, vm->entry_func_idx);
+    }
+
+    //the entry was a host function that has been completed
+    if (vm->call_stk_head < 0) {
+        return WRP_SUCCESS;
+    }
+
+    wrp_stk_exec_enter_instance(vm, vm->call_stk[vm->call_stk_head].instance);
+    return exec_loop(vm);
+}
+
 wrp_err_t wrp_exec_init_expr(wrp_vm_t *vm,
     wrp_init_expr_t *expr,
     uint64_t *out_value)
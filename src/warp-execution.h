@@ -22,6 +22,9 @@
 
 wrp_err_t wrp_exec_func(wrp_vm_t *vm, uint32_t func_idx);
 
+//continues the call a suspended vm stopped, from the instance it stopped in
+wrp_err_t wrp_exec_resume(wrp_vm_t *vm);
+
 wrp_err_t wrp_exec_init_expr(wrp_vm_t *vm,
     wrp_init_expr_t *expr,
     uint64_t *out_value);
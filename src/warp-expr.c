@@ -86,8 +86,8 @@ wrp_err_t wrp_skip_expr(wrp_buf_t *buf, uint8_t *out_opcode, size_t *out_expr_sz
     } else if (opcode >= OP_I32_LOAD && opcode <= OP_I64_STORE_32) {
         uint32_t memory_immediate_flags = 0;
         WRP_CHECK(wrp_read_varui32(buf, &memory_immediate_flags));
-        uint32_t memory_immediate_offset = 0;
-        WRP_CHECK(wrp_read_varui32(buf, &memory_immediate_offset));
+        uint64_t memory_immediate_offset = 0;
+        WRP_CHECK(wrp_read_varui64(buf, &memory_immediate_offset));
     } else if (opcode >= OP_CURRENT_MEMORY && opcode <= OP_GROW_MEMORY) {
         int8_t memory_reserved = 0;
         WRP_CHECK(wrp_read_vari7(buf, &memory_reserved));
@@ -103,6 +103,19 @@ wrp_err_t wrp_skip_expr(wrp_buf_t *buf, uint8_t *out_opcode, size_t *out_expr_sz
     } else if (opcode == OP_F64_CONST) {
         double f64_const = 0;
         WRP_CHECK(wrp_read_f64(buf, &f64_const));
+    } else if (opcode == OP_ATOMIC_PREFIX) {
+        uint32_t atomic_opcode = 0;
+        WRP_CHECK(wrp_read_varui32(buf, &atomic_opcode));
+
+        if (atomic_opcode == OP_ATOMIC_FENCE) {
+            uint8_t fence_reserved = 0;
+            WRP_CHECK(wrp_read_uint8(buf, &fence_reserved));
+        } else {
+            uint32_t memory_immediate_flags = 0;
+            WRP_CHECK(wrp_read_varui32(buf, &memory_immediate_flags));
+            uint64_t memory_immediate_offset = 0;
+            WRP_CHECK(wrp_read_varui64(buf, &memory_immediate_offset));
+        }
     }
 
     *out_opcode = opcode;
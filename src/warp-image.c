@@ -0,0 +1,447 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "warp-buf.h"
+#include "warp-config.h"
+#include "warp-error.h"
+#include "warp-image.h"
+#include "warp-macros.h"
+#include "warp-type-check.h"
+#include "warp-wasm.h"
+#include "warp.h"
+
+#define IMAGE_MAGIC_NUMBER 0x49505257 // "WRPI"
+#define IMAGE_HEADER_SZ 64
+
+typedef struct wrp_image_header {
+    uint32_t magic_number;
+    uint32_t version;
+    uint64_t layout;
+    uint64_t mdle_sz;
+    uint64_t checksum;
+    uint64_t read_in_place;
+} wrp_image_header_t;
+
+_Static_assert(sizeof(wrp_image_header_t) <= IMAGE_HEADER_SZ, "image header overflows its padding");
+
+//images are only read by the build that wrote them, the checksum catches
+//corruption, not tampering
+static uint64_t hash_words(const uint64_t *words, size_t num_words)
+{
+    uint64_t hash = 0xcbf29ce484222325u;
+
+    for (size_t i = 0; i < num_words; i++) {
+        hash = (hash ^ words[i]) * 0x100000001b3u;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+//the module struct sizes stand in for its layout
+static uint64_t layout_hash(void)
+{
+    const uint64_t sizes[] = {
+        sizeof(void *),
+        sizeof(size_t),
+        sizeof(wrp_wasm_mdle_t),
+        sizeof(wrp_wasm_meta_t),
+        sizeof(wrp_type_t),
+        sizeof(wrp_func_t),
+        sizeof(wrp_global_t),
+        sizeof(wrp_table_t),
+        sizeof(wrp_elem_segment_t),
+        sizeof(wrp_memory_t),
+        sizeof(wrp_data_segment_t),
+        sizeof(wrp_import_t),
+        sizeof(wrp_export_t),
+        sizeof(wrp_name_slot_t),
+    };
+
+    return hash_words(sizes, sizeof(sizes) / sizeof(sizes[0]));
+}
+
+//modules are sized in multiples of 64 bytes, see wrp_mdle_sz
+static uint64_t checksum(const wrp_wasm_mdle_t *mdle, size_t mdle_sz)
+{
+    return hash_words((const uint64_t *)mdle, mdle_sz / sizeof(uint64_t));
+}
+
+//pointers move from being relative to one base to another, the module's
+//bytes are at local while they are moved. A relocator that doesn't write
+//only checks that every pointer can be moved.
+typedef struct wrp_relocator {
+    uintptr_t from;
+    uintptr_t to;
+    uint8_t *local;
+    size_t sz;
+    bool write;
+} wrp_relocator_t;
+
+static wrp_err_t relocate(const wrp_relocator_t *reloc,
+    void *field,
+    size_t count,
+    size_t entry_sz,
+    size_t entry_align,
+    void **out_local)
+{
+    void *ptr = NULL;
+    memcpy(&ptr, field, sizeof(ptr));
+
+    uintptr_t address = (uintptr_t)ptr;
+
+    if (address < reloc->from || address - reloc->from > reloc->sz) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    size_t offset = address - reloc->from;
+
+    if (offset % entry_align != 0 || (entry_sz != 0 && count > (reloc->sz - offset) / entry_sz)) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    if (reloc->write) {
+        void *relocated = (void *)(reloc->to + offset);
+        memcpy(field, &relocated, sizeof(relocated));
+    }
+
+    if (out_local != NULL) {
+        *out_local = reloc->local + offset;
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t relocate_bytes(const wrp_relocator_t *reloc, void *field, size_t sz)
+{
+    return relocate(reloc, field, sz, 1, 1, NULL);
+}
+
+static wrp_err_t relocate_offsets(const wrp_relocator_t *reloc, void *field, size_t count)
+{
+    return relocate(reloc, field, count, sizeof(size_t), alignof(size_t), NULL);
+}
+
+static wrp_err_t relocate_str(const wrp_relocator_t *reloc, void *field)
+{
+    void *local = NULL;
+    WRP_CHECK(relocate(reloc, field, 0, 1, 1, &local));
+
+    //names must end inside the module
+    size_t offset = (uint8_t *)local - reloc->local;
+
+    if (memchr(local, '\0', reloc->sz - offset) == NULL) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    return WRP_SUCCESS;
+}
+
+//walks every pointer of a module at reloc->local, entries are reached through
+//their local addresses since the pointers to them are already moved
+//lookups stop at an empty slot, an index sized like the loader's always has one
+static wrp_err_t relocate_index(const wrp_relocator_t *reloc, void *field, uint32_t index_sz, uint32_t count)
+{
+    if (index_sz < (uint64_t)count * 2 || (index_sz & (index_sz - 1)) != 0) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    void *local = NULL;
+    WRP_CHECK(relocate(reloc, field, index_sz, sizeof(wrp_name_slot_t), alignof(wrp_name_slot_t), &local));
+    wrp_name_slot_t *index = local;
+
+    for (uint32_t i = 0; i < index_sz; i++) {
+        if (index[i].idx > count) {
+            return WRP_ERR_INVALID_MDLE_IMAGE;
+        }
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t relocate_mdle(const wrp_relocator_t *reloc)
+{
+    wrp_wasm_mdle_t *mdle = (wrp_wasm_mdle_t *)reloc->local;
+    wrp_wasm_meta_t *meta = &mdle->meta;
+
+    WRP_CHECK(relocate_bytes(reloc, &mdle->param_type_buf, meta->num_type_params));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->result_type_buf, meta->num_type_returns));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->local_type_buf, meta->num_code_locals));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->code_buf, meta->code_buf_sz));
+    WRP_CHECK(relocate_offsets(reloc, &mdle->block_addrs_buf, meta->num_block_ops));
+    WRP_CHECK(relocate_offsets(reloc, &mdle->block_label_buf, meta->num_block_ops));
+    WRP_CHECK(relocate_offsets(reloc, &mdle->block_cost_buf, meta->num_block_ops));
+    WRP_CHECK(relocate_offsets(reloc, &mdle->if_addrs_buf, meta->num_if_ops));
+    WRP_CHECK(relocate_offsets(reloc, &mdle->else_addrs_buf, meta->num_if_ops));
+    WRP_CHECK(relocate_offsets(reloc, &mdle->if_label_buf, meta->num_if_ops));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->global_expr_buf, meta->global_expr_buf_sz));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->import_name_buf, meta->import_name_buf_sz));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->import_field_buf, meta->import_field_buf_sz));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->export_name_buf, meta->export_name_buf_sz));
+    WRP_CHECK(relocate(reloc, &mdle->elem_buf, meta->num_elem, sizeof(uint32_t), alignof(uint32_t), NULL));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->elem_expr_buf, meta->elem_expr_buf_sz));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->data_buf, meta->data_buf_sz));
+    WRP_CHECK(relocate_bytes(reloc, &mdle->data_expr_buf, meta->data_expr_buf_sz));
+
+    void *local = NULL;
+    WRP_CHECK(relocate(reloc, &mdle->types, mdle->num_types, sizeof(wrp_type_t), alignof(wrp_type_t), &local));
+    wrp_type_t *types = local;
+
+    for (uint32_t i = 0; i < mdle->num_types; i++) {
+        if (types[i].sig_id > i) {
+            return WRP_ERR_INVALID_MDLE_IMAGE;
+        }
+
+        WRP_CHECK(relocate_bytes(reloc, &types[i].param_types, types[i].num_params));
+        WRP_CHECK(relocate_bytes(reloc, &types[i].result_types, types[i].num_results));
+    }
+
+    WRP_CHECK(relocate(reloc, &mdle->funcs, mdle->num_funcs, sizeof(wrp_func_t), alignof(wrp_func_t), &local));
+    wrp_func_t *funcs = local;
+
+    for (uint32_t i = 0; i < mdle->num_funcs; i++) {
+        wrp_func_t *func = &funcs[i];
+
+        if (func->type_idx >= mdle->num_types || !func->validated) {
+            return WRP_ERR_INVALID_MDLE_IMAGE;
+        }
+
+        WRP_CHECK(relocate_bytes(reloc, &func->local_types, func->num_locals));
+        WRP_CHECK(relocate_bytes(reloc, &func->code, func->code_sz));
+        WRP_CHECK(relocate_offsets(reloc, &func->block_addrs, func->num_blocks));
+        WRP_CHECK(relocate_offsets(reloc, &func->block_labels, func->num_blocks));
+        WRP_CHECK(relocate_offsets(reloc, &func->block_costs, func->num_blocks));
+        WRP_CHECK(relocate_offsets(reloc, &func->if_addrs, func->num_ifs));
+        WRP_CHECK(relocate_offsets(reloc, &func->if_labels, func->num_ifs));
+        WRP_CHECK(relocate_offsets(reloc, &func->else_addrs, func->num_ifs));
+    }
+
+    WRP_CHECK(relocate(reloc, &mdle->globals, mdle->num_globals, sizeof(wrp_global_t), alignof(wrp_global_t), &local));
+    wrp_global_t *globals = local;
+
+    if (mdle->num_global_imports > mdle->num_globals) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    for (uint32_t i = mdle->num_global_imports; i < mdle->num_globals; i++) {
+        WRP_CHECK(relocate_bytes(reloc, &globals[i].init_expr.code, globals[i].init_expr.sz));
+    }
+
+    WRP_CHECK(relocate(reloc, &mdle->tables, mdle->num_tables, sizeof(wrp_table_t), alignof(wrp_table_t), &local));
+    wrp_table_t *tables = local;
+
+    for (uint32_t i = 0; i < mdle->num_tables; i++) {
+        if (tables[i].elem != NULL || tables[i].num_elem > tables[i].max_elem) {
+            return WRP_ERR_INVALID_MDLE_IMAGE;
+        }
+    }
+
+    WRP_CHECK(relocate(reloc,
+        &mdle->elem_segments,
+        mdle->num_elem_segments,
+        sizeof(wrp_elem_segment_t),
+        alignof(wrp_elem_segment_t),
+        &local));
+    wrp_elem_segment_t *elem_segments = local;
+
+    for (uint32_t i = 0; i < mdle->num_elem_segments; i++) {
+        wrp_elem_segment_t *segment = &elem_segments[i];
+        WRP_CHECK(relocate(reloc, &segment->elem, segment->num_elem, sizeof(uint32_t), alignof(uint32_t), NULL));
+        WRP_CHECK(relocate_bytes(reloc, &segment->offset_expr.code, segment->offset_expr.sz));
+    }
+
+    WRP_CHECK(relocate(reloc, &mdle->memories, mdle->num_memories, sizeof(wrp_memory_t), alignof(wrp_memory_t), &local));
+    wrp_memory_t *memories = local;
+
+    //memory images are built by the module's first instance, never carried over
+    for (uint32_t i = 0; reloc->write && i < mdle->num_memories; i++) {
+        memories[i].has_image = false;
+        memories[i].image_fd = -1;
+    }
+
+    WRP_CHECK(relocate(reloc,
+        &mdle->data_segments,
+        mdle->num_data_segments,
+        sizeof(wrp_data_segment_t),
+        alignof(wrp_data_segment_t),
+        &local));
+    wrp_data_segment_t *data_segments = local;
+
+    for (uint32_t i = 0; i < mdle->num_data_segments; i++) {
+        wrp_data_segment_t *segment = &data_segments[i];
+
+        if (segment->mem_idx >= mdle->num_memories) {
+            return WRP_ERR_INVALID_MDLE_IMAGE;
+        }
+
+        WRP_CHECK(relocate_bytes(reloc, &segment->data, segment->sz));
+        WRP_CHECK(relocate_bytes(reloc, &segment->offset_expr.code, segment->offset_expr.sz));
+    }
+
+    WRP_CHECK(relocate(reloc, &mdle->imports, mdle->num_imports, sizeof(wrp_import_t), alignof(wrp_import_t), &local));
+    wrp_import_t *imports = local;
+
+    for (uint32_t i = 0; i < mdle->num_imports; i++) {
+        WRP_CHECK(relocate_str(reloc, &imports[i].name));
+        WRP_CHECK(relocate_str(reloc, &imports[i].field));
+    }
+
+    WRP_CHECK(relocate(reloc, &mdle->exports, mdle->num_exports, sizeof(wrp_export_t), alignof(wrp_export_t), &local));
+    wrp_export_t *exports = local;
+
+    for (uint32_t i = 0; i < mdle->num_exports; i++) {
+        WRP_CHECK(relocate_str(reloc, &exports[i].name));
+    }
+
+    WRP_CHECK(relocate_index(reloc, &mdle->import_index, mdle->import_index_sz, mdle->num_imports));
+    WRP_CHECK(relocate_index(reloc, &mdle->export_index, mdle->export_index_sz, mdle->num_exports));
+    return WRP_SUCCESS;
+}
+
+//state the module keeps for itself is not part of the image
+static void reset_mdle_state(wrp_wasm_mdle_t *copy)
+{
+    copy->check_vm = NULL;
+    atomic_flag_clear(&copy->check_lock);
+    copy->image = false;
+}
+
+wrp_err_t wrp_write_mdle_image(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, wrp_buf_t *out_image)
+{
+    //the image skips validation, so every function is checked now
+    WRP_CHECK(wrp_type_check_remaining_funcs(vm, mdle));
+
+    size_t mdle_sz = wrp_mdle_sz(&mdle->meta);
+    uint8_t *bytes = vm->alloc_fn(IMAGE_HEADER_SZ + mdle_sz, 64);
+
+    if (bytes == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    wrp_wasm_mdle_t *image_mdle = (wrp_wasm_mdle_t *)&bytes[IMAGE_HEADER_SZ];
+    memcpy(image_mdle, mdle, mdle_sz);
+    reset_mdle_state(image_mdle);
+
+    wrp_relocator_t reloc = {.from = (uintptr_t)mdle, .to = 0, .local = (uint8_t *)image_mdle, .sz = mdle_sz, .write = true};
+    wrp_err_t err = relocate_mdle(&reloc);
+
+    //modules instantiated in place reference code outside of themselves
+    if (err != WRP_SUCCESS) {
+        vm->free_fn(bytes);
+        return err;
+    }
+
+    wrp_image_header_t header = {0};
+    header.magic_number = IMAGE_MAGIC_NUMBER;
+    header.version = WRP_MDLE_IMAGE_VERSION;
+    header.layout = layout_hash();
+    header.mdle_sz = mdle_sz;
+    header.checksum = checksum(image_mdle, mdle_sz);
+
+    memset(bytes, 0, IMAGE_HEADER_SZ);
+    memcpy(bytes, &header, sizeof(header));
+
+    out_image->bytes = bytes;
+    out_image->sz = IMAGE_HEADER_SZ + mdle_sz;
+    out_image->pos = 0;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_header(wrp_buf_t *image, wrp_image_header_t *out_header)
+{
+    if (image->sz < IMAGE_HEADER_SZ || ((uintptr_t)image->bytes & 63) != 0) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    memcpy(out_header, image->bytes, sizeof(*out_header));
+
+    if (out_header->magic_number != IMAGE_MAGIC_NUMBER) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    //images from another version or build are stale rather than invalid
+    if (out_header->version != WRP_MDLE_IMAGE_VERSION || out_header->layout != layout_hash()) {
+        return WRP_ERR_MDLE_IMAGE_VERSION;
+    }
+
+    if (out_header->mdle_sz < sizeof(wrp_wasm_mdle_t) || out_header->mdle_sz % 64 != 0
+        || out_header->mdle_sz > image->sz - IMAGE_HEADER_SZ) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_read_mdle_image(wrp_vm_t *vm, wrp_buf_t *image, bool in_place, wrp_wasm_mdle_t **out_mdle)
+{
+    wrp_image_header_t header = {0};
+    WRP_CHECK(check_header(image, &header));
+
+    //its pointers no longer hold offsets
+    if (header.read_in_place != 0) {
+        return WRP_ERR_INVALID_MDLE_IMAGE;
+    }
+
+    wrp_wasm_mdle_t *src = (wrp_wasm_mdle_t *)&image->bytes[IMAGE_HEADER_SZ];
+
+    if (checksum(src, header.mdle_sz) != header.checksum) {
+        return WRP_ERR_MDLE_IMAGE_CHECKSUM;
+    }
+
+    //the reading vm may be stricter than the one that wrote the image
+    WRP_CHECK(wrp_check_meta(&src->meta, &vm->limits));
+
+    //everything is checked before the first pointer is moved, a rejected
+    //image is left as it was
+    wrp_relocator_t reloc = {.from = 0, .to = (uintptr_t)src, .local = (uint8_t *)src, .sz = header.mdle_sz, .write = false};
+    WRP_CHECK(relocate_mdle(&reloc));
+
+    wrp_table_t *tables = (wrp_table_t *)((uint8_t *)src + (uintptr_t)src->tables);
+
+    for (uint32_t i = 0; i < src->num_tables; i++) {
+        if (tables[i].max_elem > vm->limits.max_table_elem) {
+            return WRP_ERR_INVALID_TABLE_LIMIT;
+        }
+    }
+
+    wrp_wasm_mdle_t *mdle = src;
+
+    if (in_place) {
+        header.read_in_place = 1;
+        memcpy(image->bytes, &header, sizeof(header));
+    } else {
+        mdle = vm->alloc_fn(header.mdle_sz, 64);
+
+        if (mdle == NULL) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+
+        memcpy(mdle, src, header.mdle_sz);
+    }
+
+    //can't fail, the same pointers were just checked
+    reloc = (wrp_relocator_t){.from = 0, .to = (uintptr_t)mdle, .local = (uint8_t *)mdle, .sz = header.mdle_sz, .write = true};
+    relocate_mdle(&reloc);
+
+    mdle->image = in_place;
+    *out_mdle = mdle;
+    return WRP_SUCCESS;
+}
@@ -0,0 +1,31 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "warp-types.h"
+
+//an image is a copy of a validated module whose pointers are stored as
+//offsets, it can be read back without loading or validating
+wrp_err_t wrp_write_mdle_image(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, wrp_buf_t *out_image);
+
+//the whole image is checked before anything is written. In place its
+//pointers are moved inside image, which can then not be read again,
+//otherwise image is only read and the module is a copy allocated by vm.
+wrp_err_t wrp_read_mdle_image(wrp_vm_t *vm, wrp_buf_t *image, bool in_place, wrp_wasm_mdle_t **out_mdle);
@@ -17,7 +17,9 @@
 #include <stdalign.h>
 #include <string.h>
 
+#include "warp-arena.h"
 #include "warp-buf.h"
+#include "warp-config.h"
 #include "warp-error.h"
 #include "warp-expr.h"
 #include "warp-load.h"
@@ -26,6 +28,18 @@
 #include "warp-wasm.h"
 #include "warp.h"
 
+//the module is parsed once into a staging module whose arrays live in an
+//arena, code and data stay in the input buffer until the final module is
+//sized and everything is copied into it by compact_mdle
+typedef struct wrp_loader {
+    wrp_vm_t *vm;
+    wrp_buf_t *buf;
+    bool in_place;
+    wrp_arena_t arena;
+    wrp_wasm_meta_t meta;
+    wrp_wasm_mdle_t mdle;
+} wrp_loader_t;
+
 static wrp_err_t check_preamble(wrp_buf_t *buf)
 {
     if (buf->sz < 8) {
@@ -49,17 +63,129 @@ static wrp_err_t check_preamble(wrp_buf_t *buf)
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_type_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+//every entry occupies at least one byte, so a count larger than the rest of
+//the buffer is malformed and must not size an allocation
+static wrp_err_t alloc_entries(wrp_loader_t *loader,
+    uint32_t count,
+    size_t entry_sz,
+    size_t align,
+    void **out_entries)
+{
+    wrp_buf_t *buf = loader->buf;
+
+    if (count > buf->sz - buf->pos) {
+        return WRP_ERR_INVALID_BUFFER_ACCESS;
+    }
+
+    return wrp_arena_alloc(&loader->arena, (size_t)count * entry_sz, align, out_entries);
+}
+
+//funcs, tables, memories and globals start with their imports, the section
+//that defines the rest grows the staged array once by its count
+static wrp_err_t append_entries(wrp_loader_t *loader,
+    uint32_t num_entries,
+    uint32_t count,
+    size_t entry_sz,
+    size_t align,
+    void **entries)
+{
+    wrp_buf_t *buf = loader->buf;
+
+    if (count > buf->sz - buf->pos) {
+        return WRP_ERR_INVALID_BUFFER_ACCESS;
+    }
+
+    void *grown = NULL;
+    WRP_CHECK(wrp_arena_alloc(&loader->arena, ((size_t)num_entries + count) * entry_sz, align, &grown));
+
+    if (num_entries > 0) {
+        memcpy(grown, *entries, num_entries * entry_sz);
+    }
+
+    *entries = grown;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t load_name(wrp_loader_t *loader, char **out_name, uint32_t *out_name_len)
+{
+    wrp_buf_t *buf = loader->buf;
+    WRP_CHECK(wrp_read_varui32(buf, out_name_len));
+
+    size_t name_pos = buf->pos;
+    WRP_CHECK(wrp_skip(buf, *out_name_len));
+
+    //arena memory is zeroed so the copy is already terminated
+    void *name = NULL;
+    WRP_CHECK(wrp_arena_alloc(&loader->arena, (size_t)*out_name_len + 1, 1, &name));
+    memcpy(name, &buf->bytes[name_pos], *out_name_len);
+
+    *out_name = name;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t load_value_types(wrp_loader_t *loader, uint32_t count, int8_t **out_types)
+{
+    void *types = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(int8_t), alignof(int8_t), &types));
+    *out_types = types;
+
+    for (uint32_t i = 0; i < count; i++) {
+        WRP_CHECK(wrp_read_vari7(loader->buf, &(*out_types)[i]));
+
+        if (!wrp_is_valid_value_type((*out_types)[i])) {
+            return WRP_ERR_INVALID_TYPE;
+        }
+    }
+
+    return WRP_SUCCESS;
+}
+
+static bool same_signature(wrp_type_t *a, wrp_type_t *b)
+{
+    if (a->num_params != b->num_params || a->num_results != b->num_results) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < a->num_params; i++) {
+        if (a->param_types[i] != b->param_types[i]) {
+            return false;
+        }
+    }
+
+    for (uint32_t i = 0; i < a->num_results; i++) {
+        if (a->result_types[i] != b->result_types[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static wrp_err_t load_type_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    out_mdle->num_types = count;
-    uint32_t current_param = 0;
-    uint32_t current_result = 0;
+    loader->meta.num_types = count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *types = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_type_t), alignof(wrp_type_t), &types));
+    mdle->types = types;
+    mdle->num_types = count;
+
+    //open addressed by signature hash, slots hold a type index plus one and
+    //live in the load arena only
+    uint32_t index_sz = wrp_index_sz(count);
+    void *index = NULL;
+    WRP_CHECK(wrp_arena_alloc(&loader->arena, (size_t)index_sz * sizeof(uint32_t), alignof(uint32_t), &index));
+    uint32_t *sig_index = index;
 
     for (uint32_t i = 0; i < count; i++) {
-        wrp_type_t *type = &out_mdle->types[i];
+        wrp_type_t *type = &mdle->types[i];
 
         WRP_CHECK(wrp_read_varui7(buf, &type->form));
 
@@ -69,21 +195,12 @@ static wrp_err_t load_type_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
 
         WRP_CHECK(wrp_read_varui32(buf, &type->num_params));
 
-        if (type->num_params > MAX_FUNC_PARAMETERS) {
+        if (type->num_params > loader->vm->limits.max_func_params) {
             return WRP_ERR_MDLE_FUNC_PARAMETER_OVERFLOW;
         }
 
-        type->param_types = &out_mdle->param_type_buf[current_param];
-
-        for (uint32_t j = 0; j < type->num_params; j++) {
-            WRP_CHECK(wrp_read_vari7(buf, &out_mdle->param_type_buf[current_param]));
-
-            if (!wrp_is_valid_value_type(out_mdle->param_type_buf[current_param])) {
-                return WRP_ERR_INVALID_TYPE;
-            }
-
-            current_param++;
-        }
+        WRP_CHECK(load_value_types(loader, type->num_params, &type->param_types));
+        loader->meta.num_type_params += type->num_params;
 
         WRP_CHECK(wrp_read_varui32(buf, &type->num_results));
 
@@ -91,61 +208,139 @@ static wrp_err_t load_type_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
             return WRP_ERR_MDLE_FUNC_RETURN_OVERFLOW;
         }
 
-        type->result_types = &out_mdle->result_type_buf[current_result];
+        WRP_CHECK(load_value_types(loader, type->num_results, &type->result_types));
+        loader->meta.num_type_returns += type->num_results;
 
-        for (uint32_t j = 0; j < type->num_results; j++) {
-            WRP_CHECK(wrp_read_vari7(buf, &out_mdle->result_type_buf[current_result]));
+        type->sig_id = i;
 
-            if (!wrp_is_valid_value_type(out_mdle->result_type_buf[current_result])) {
-                return WRP_ERR_INVALID_TYPE;
-            }
+        uint32_t mask = index_sz - 1;
+        uint32_t slot = wrp_hash_signature(type) & mask;
+
+        while (sig_index[slot] != 0 && !same_signature(&mdle->types[sig_index[slot] - 1], type)) {
+            slot = (slot + 1) & mask;
+        }
 
-            current_result++;
+        if (sig_index[slot] != 0) {
+            type->sig_id = sig_index[slot] - 1;
+        } else {
+            sig_index[slot] = i + 1;
         }
     }
 
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_import_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_memory_limits(wrp_buf_t *buf, wrp_memory_t *memory)
+{
+    uint64_t min_pages = 0;
+    uint64_t max_pages = 0;
+    bool shared = false;
+    bool memory64 = false;
+    WRP_CHECK(wrp_read_memory_limits(buf, &min_pages, &max_pages, &shared, &memory64));
+
+    uint64_t page_limit = memory64 ? MAX_MEMORY64_PAGES : MAX_MEMORY_PAGES;
+
+    if (min_pages > max_pages || max_pages > page_limit) {
+        return WRP_ERR_INVALID_MEM_LIMIT;
+    }
+
+    //bytes are created at link time, see wrp_mem_init
+    memory->bytes = NULL;
+    memory->num_pages = (uint32_t)min_pages;
+    memory->min_pages = (uint32_t)min_pages;
+    memory->max_pages = (uint32_t)max_pages;
+    memory->reserved_pages = 0;
+    memory->generation = 0;
+    memory->shared = shared;
+    memory->memory64 = memory64;
+    memory->imported = false;
+    memory->mapped = false;
+    memory->has_image = false;
+    memory->image_fd = -1;
+    memory->import = NULL;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t load_import_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    out_mdle->num_imports = count;
-    uint32_t current_name_char = 0;
-    uint32_t current_field_char = 0;
+    loader->meta.num_imports = count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *imports = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_import_t), alignof(wrp_import_t), &imports));
+    mdle->imports = imports;
+    mdle->num_imports = count;
+
+    //no import section is smaller than its count, so these hold every import
+    void *memories = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_memory_t), alignof(wrp_memory_t), &memories));
+    mdle->memories = memories;
+
+    void *globals = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_global_t), alignof(wrp_global_t), &globals));
+    mdle->globals = globals;
+
+    void *funcs = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_func_t), alignof(wrp_func_t), &funcs));
+    mdle->funcs = funcs;
 
     for (uint32_t i = 0; i < count; i++) {
-        wrp_import_t *import = &out_mdle->imports[i];
-        import->name = &out_mdle->import_name_buf[current_name_char];
-        import->field = &out_mdle->import_field_buf[current_field_char];
+        wrp_import_t *import = &mdle->imports[i];
 
-        //TODO remove magic number
         uint32_t name_len = 0;
         uint32_t field_len = 0;
-        WRP_CHECK(wrp_read_string(buf, import->name, 1024, &name_len));
-        WRP_CHECK(wrp_read_string(buf, import->name, 1024, &field_len));
+        WRP_CHECK(load_name(loader, &import->name, &name_len));
+        WRP_CHECK(load_name(loader, &import->field, &field_len));
         WRP_CHECK(wrp_read_uint8(buf, &import->kind));
 
-        current_name_char += current_name_char + 1;
-        current_field_char += field_len + 1;
+        loader->meta.import_name_buf_sz += name_len + 1;
+        loader->meta.import_field_buf_sz += field_len + 1;
 
         if (import->kind == EXTERNAL_FUNC) {
-            return WRP_ERR_INVALID_IMPORT;
+            loader->meta.num_funcs++;
+            WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+            uint32_t type_idx = 0;
+            WRP_CHECK(wrp_read_varui32(buf, &type_idx));
+
+            if (type_idx >= mdle->num_types) {
+                return WRP_ERR_INVALID_TYPE_IDX;
+            }
+
+            //imported functions have no body to validate
+            import->idx = mdle->num_funcs;
+            mdle->funcs[mdle->num_funcs] = (wrp_func_t){.type_idx = type_idx, .validated = true};
+            mdle->num_funcs++;
+            mdle->num_func_imports++;
         } else if (import->kind == EXTERNAL_TABLE) {
             return WRP_ERR_INVALID_IMPORT;
         } else if (import->kind == EXTERNAL_MEMORY) {
-            return WRP_ERR_INVALID_IMPORT;
+            loader->meta.num_memories++;
+            WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+            import->idx = mdle->num_memories;
+            WRP_CHECK(load_memory_limits(buf, &mdle->memories[mdle->num_memories]));
+            mdle->memories[mdle->num_memories].imported = true;
+            mdle->num_memories++;
         } else if (import->kind == EXTERNAL_GLOBAL) {
-            import->idx = out_mdle->num_globals;
-            WRP_CHECK(wrp_read_vari7(buf, &out_mdle->globals[out_mdle->num_globals].type));
-            WRP_CHECK(wrp_read_varui1(buf, &out_mdle->globals[out_mdle->num_globals].mutability));
-            out_mdle->num_globals++;
-
-            //WASM v1 forbids mutable globals
-            if (out_mdle->globals[out_mdle->num_globals].mutability != GLOBAL_IMMUTABLE) {
-                return WRP_ERR_INVALID_MUTIBILITY;
+            loader->meta.num_globals++;
+            WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+            wrp_global_t *global = &mdle->globals[mdle->num_globals];
+            import->idx = mdle->num_globals;
+            WRP_CHECK(wrp_read_vari7(buf, &global->type));
+            WRP_CHECK(wrp_read_varui1(buf, &global->mutability));
+            mdle->num_globals++;
+            mdle->num_global_imports++;
+
+            if (!wrp_is_valid_value_type(global->type)) {
+                return WRP_ERR_INVALID_TYPE;
             }
         }
     }
@@ -153,35 +348,53 @@ static wrp_err_t load_import_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_func_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_func_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    for (uint32_t i = out_mdle->num_funcs; i < out_mdle->num_funcs + count; i++) {
-        wrp_func_t *func = &out_mdle->funcs[i];
+    loader->meta.num_funcs += count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *funcs = mdle->funcs;
+    WRP_CHECK(append_entries(loader, mdle->num_funcs, count, sizeof(wrp_func_t), alignof(wrp_func_t), &funcs));
+    mdle->funcs = funcs;
+
+    for (uint32_t i = mdle->num_funcs; i < mdle->num_funcs + count; i++) {
+        wrp_func_t *func = &mdle->funcs[i];
 
         WRP_CHECK(wrp_read_varui32(buf, &func->type_idx));
 
-        if (func->type_idx >= out_mdle->num_types) {
+        if (func->type_idx >= mdle->num_types) {
             return WRP_ERR_INVALID_TYPE_IDX;
         }
     }
 
-    out_mdle->num_funcs += count;
+    mdle->num_funcs += count;
 
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_table_section(wrp_vm_t *vm,
-    wrp_buf_t *buf,
-    wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_table_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    for (uint32_t i = out_mdle->num_tables; i < out_mdle->num_tables + count; i++) {
-        wrp_table_t *table = &out_mdle->tables[i];
+    loader->meta.num_tables += count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *tables = mdle->tables;
+    WRP_CHECK(append_entries(loader, mdle->num_tables, count, sizeof(wrp_table_t), alignof(wrp_table_t), &tables));
+    mdle->tables = tables;
+
+    for (uint32_t i = mdle->num_tables; i < mdle->num_tables + count; i++) {
+        wrp_table_t *table = &mdle->tables[i];
 
         int8_t elem_type = 0;
         WRP_CHECK(wrp_read_vari7(buf, &elem_type));
@@ -191,149 +404,162 @@ static wrp_err_t load_table_section(wrp_vm_t *vm,
         }
 
         uint32_t min_table_elem = 0;
-        uint32_t max_table_elem = MAX_TABLE_SIZE;
+        uint32_t max_table_elem = loader->vm->limits.max_table_elem;
         WRP_CHECK(wrp_read_limits(buf, &min_table_elem, &max_table_elem));
 
-        if (min_table_elem > max_table_elem || max_table_elem > MAX_TABLE_SIZE) {
+        if (min_table_elem > max_table_elem || max_table_elem > loader->vm->limits.max_table_elem) {
             return WRP_ERR_INVALID_TABLE_LIMIT;
         }
 
-        if (min_table_elem > 0) {
-            table->elem = vm->alloc_fn(min_table_elem * sizeof(uint32_t), alignof(uint32_t));
-
-            if (table->elem == NULL) {
-                return WRP_ERR_MEMORY_ALLOCATION_FAILED;
-            }
-        }
-
+        //elements belong to instances, see wrp_instance_init
+        table->elem = NULL;
         table->type = elem_type;
         table->num_elem = min_table_elem;
         table->max_elem = max_table_elem;
     }
 
-    out_mdle->num_tables += count;
+    mdle->num_tables += count;
 
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_memory_section(wrp_vm_t *vm,
-    wrp_buf_t *buf,
-    wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_memory_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    for (uint32_t i = out_mdle->num_memories; i < out_mdle->num_memories + count; i++) {
-        wrp_memory_t *memory = &out_mdle->memories[i];
+    loader->meta.num_memories += count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
 
-        uint32_t min_pages = 0;
-        uint32_t max_pages = MAX_MEMORY_PAGES;
-        WRP_CHECK(wrp_read_limits(buf, &min_pages, &max_pages));
+    void *memories = mdle->memories;
+    WRP_CHECK(append_entries(loader, mdle->num_memories, count, sizeof(wrp_memory_t), alignof(wrp_memory_t), &memories));
+    mdle->memories = memories;
 
-        if (min_pages > max_pages || max_pages > MAX_MEMORY_PAGES) {
-            return WRP_ERR_INVALID_MEM_LIMIT;
-        }
+    for (uint32_t i = mdle->num_memories; i < mdle->num_memories + count; i++) {
+        WRP_CHECK(load_memory_limits(buf, &mdle->memories[i]));
+    }
 
-        if (min_pages > 0) {
-            memory->bytes = vm->alloc_fn(min_pages * PAGE_SIZE, 64);
+    mdle->num_memories += count;
 
-            if (memory->bytes == NULL) {
-                return WRP_ERR_MEMORY_ALLOCATION_FAILED;
-            }
-        }
+    return WRP_SUCCESS;
+}
 
-        memory->num_pages = min_pages;
-        memory->max_pages = max_pages;
-    }
+//init expressions stay in the input buffer until compact_mdle copies them
+static wrp_err_t load_init_expr(wrp_loader_t *loader, wrp_init_expr_t *out_expr, size_t *out_expr_sz)
+{
+    wrp_buf_t *buf = loader->buf;
 
-    out_mdle->num_memories += count;
+    size_t expr_pos = buf->pos;
+    WRP_CHECK(wrp_skip_init_expr(buf, out_expr_sz));
 
+    out_expr->code = &buf->bytes[expr_pos];
+    out_expr->sz = *out_expr_sz;
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_global_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_global_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    for (uint32_t i = out_mdle->num_globals; i < out_mdle->num_globals + count; i++) {
-        wrp_global_t *global = &out_mdle->globals[i];
-        global->value = &out_mdle->global_buf[i];
-        *global->value = 0;
+    loader->meta.num_globals += count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *globals = mdle->globals;
+    WRP_CHECK(append_entries(loader, mdle->num_globals, count, sizeof(wrp_global_t), alignof(wrp_global_t), &globals));
+    mdle->globals = globals;
+
+    for (uint32_t i = mdle->num_globals; i < mdle->num_globals + count; i++) {
+        wrp_global_t *global = &mdle->globals[i];
         WRP_CHECK(wrp_read_vari7(buf, &global->type));
         WRP_CHECK(wrp_read_varui1(buf, &global->mutability));
 
-        //TODO skip init expr
-
         if (!wrp_is_valid_value_type(global->type)) {
             return WRP_ERR_INVALID_TYPE;
         }
 
-        //WASM v1 forbids mutable globals
-        if (global->mutability != GLOBAL_IMMUTABLE) {
-            return WRP_ERR_INVALID_MUTIBILITY;
-        }
+        size_t expr_sz = 0;
+        WRP_CHECK(load_init_expr(loader, &global->init_expr, &expr_sz));
+        global->init_expr.value_type = global->type;
+        loader->meta.global_expr_buf_sz += expr_sz;
     }
 
-    out_mdle->num_globals += count;
+    mdle->num_globals += count;
 
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_export_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_export_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    out_mdle->num_exports += count;
-    uint32_t current_char = 0;
+    loader->meta.num_exports = count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *exports = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_export_t), alignof(wrp_export_t), &exports));
+    mdle->exports = exports;
+    mdle->num_exports = count;
 
     for (uint32_t i = 0; i < count; i++) {
-        wrp_export_t *export = &out_mdle->exports[i];
-        export->name = &out_mdle->export_name_buf[current_char];
+        wrp_export_t *export = &mdle->exports[i];
 
-        //TODO remove magic number
         uint32_t name_len = 0;
-        WRP_CHECK(wrp_read_string(buf, export->name, 1024, &name_len));
+        WRP_CHECK(load_name(loader, &export->name, &name_len));
         WRP_CHECK(wrp_read_varui7(buf, &export->kind));
         WRP_CHECK(wrp_read_varui32(buf, &export->idx));
 
-        current_char += name_len + 1;
+        loader->meta.export_name_buf_sz += name_len + 1;
 
-        if (export->kind == EXTERNAL_FUNC && export->idx >= out_mdle->num_funcs) {
+        if (export->kind == EXTERNAL_FUNC && export->idx >= mdle->num_funcs) {
             return WRP_ERR_INVALID_FUNC_IDX;
         } else if (export->kind == EXTERNAL_TABLE) {
             return WRP_ERR_INVALID_EXPORT;
-        } else if (export->kind == EXTERNAL_MEMORY) {
-            return WRP_ERR_INVALID_EXPORT;
-        } else if (export->kind == EXTERNAL_GLOBAL) {
-            return WRP_ERR_INVALID_EXPORT;
+        } else if (export->kind == EXTERNAL_MEMORY && export->idx >= mdle->num_memories) {
+            return WRP_ERR_INVALID_MEM_IDX;
+        } else if (export->kind == EXTERNAL_GLOBAL && export->idx >= mdle->num_globals) {
+            return WRP_ERR_INVALID_GLOBAL_IDX;
         }
     }
 
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_start_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_start_section(wrp_loader_t *loader)
 {
-    WRP_CHECK(wrp_read_varui32(buf, &out_mdle->start_func_idx));
-    out_mdle->start_func_present = true;
+    WRP_CHECK(wrp_read_varui32(loader->buf, &loader->mdle.start_func_idx));
+    loader->mdle.start_func_present = true;
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_element_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_element_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    out_mdle->num_elem_segments = count;
-    size_t expr_offset = 0;
-    uint32_t elem_offset = 0;
+    loader->meta.num_elem_segments = count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *segments = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_elem_segment_t), alignof(wrp_elem_segment_t), &segments));
+    mdle->elem_segments = segments;
+    mdle->num_elem_segments = count;
 
     for (uint32_t i = 0; i < count; i++) {
-        wrp_elem_segment_t *segment = &out_mdle->elem_segments[i];
-        segment->offset_expr.code = &out_mdle->elem_expr_buf[expr_offset];
-        segment->elem = &out_mdle->elem_buf[elem_offset];
+        wrp_elem_segment_t *segment = &mdle->elem_segments[i];
 
         WRP_CHECK(wrp_read_varui32(buf, &segment->table_idx));
 
@@ -342,107 +568,177 @@ static wrp_err_t load_element_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
             return WRP_ERR_INVALID_MEM_IDX;
         }
 
-        if (segment->table_idx >= out_mdle->num_tables) {
+        if (segment->table_idx >= mdle->num_tables) {
             return WRP_ERR_INVALID_TABLE_IDX;
         }
 
-        size_t expr_pos = buf->pos;
         size_t expr_sz = 0;
-        WRP_CHECK(wrp_skip_init_expr(buf, &expr_sz));
-
-        memcpy(segment->offset_expr.code, &buf->bytes[expr_pos], expr_sz);
-        segment->offset_expr.sz = expr_sz;
+        WRP_CHECK(load_init_expr(loader, &segment->offset_expr, &expr_sz));
         segment->offset_expr.value_type = I32;
 
         WRP_CHECK(wrp_read_varui32(buf, &segment->num_elem));
 
+        void *elem = NULL;
+        WRP_CHECK(alloc_entries(loader, segment->num_elem, sizeof(uint32_t), alignof(uint32_t), &elem));
+        segment->elem = elem;
+
         for(uint32_t j = 0; j < segment->num_elem; j++){
             WRP_CHECK(wrp_read_varui32(buf, &segment->elem[j]));
+
+            if (segment->elem[j] >= mdle->num_funcs) {
+                return WRP_ERR_INVALID_FUNC_IDX;
+            }
         }
 
-        expr_offset += expr_sz;
-        elem_offset += segment->num_elem;
+        loader->meta.elem_expr_buf_sz += expr_sz;
+        loader->meta.num_elem += segment->num_elem;
     }
 
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_code_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t check_code_count(wrp_loader_t *loader, uint32_t count, uint32_t *out_num_func_imports)
 {
-    uint32_t count = 0;
-    WRP_CHECK(wrp_read_varui32(buf, &count));
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
 
-    uint32_t num_func_imports = 0;
-    for (uint32_t i = 0; i < out_mdle->num_imports; i++) {
-        if (out_mdle->imports[i].kind == EXTERNAL_FUNC) {
-            num_func_imports++;
-        }
+    if (count != mdle->num_funcs - mdle->num_func_imports) {
+        return WRP_ERR_MDLE_CODE_MISMATCH;
     }
 
-    if (count != out_mdle->num_funcs - num_func_imports) {
-        return WRP_ERR_MDLE_CODE_MISMATCH;
+    *out_num_func_imports = mdle->num_func_imports;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_body_sz(wrp_loader_t *loader, uint32_t body_sz)
+{
+    if (body_sz > loader->vm->limits.max_func_body_sz) {
+        return WRP_ERR_MDLE_CODE_OVERFLOW;
     }
 
-    uint32_t current_local = 0;
-    size_t code_offset = 0;
-    for (uint32_t i = 0; i < count; i++) {
-        size_t code_segment_pos = buf->pos;
+    return WRP_SUCCESS;
+}
 
-        wrp_func_t *func = &out_mdle->funcs[num_func_imports + i];
-        func->local_types = &out_mdle->local_type_buf[current_local];
-        func->num_locals = 0;
+static wrp_err_t load_code_body(wrp_loader_t *loader, wrp_func_t *func, uint32_t body_sz)
+{
+    wrp_buf_t *buf = loader->buf;
+    WRP_CHECK(check_body_sz(loader, body_sz));
 
-        uint32_t body_sz = 0;
-        WRP_CHECK(wrp_read_varui32(buf, &body_sz));
+    size_t body_pos = buf->pos;
 
-        uint32_t num_local_entries = 0;
-        WRP_CHECK(wrp_read_varui32(buf, &num_local_entries));
+    //local entries are run length encoded, each is expanded onto the end of
+    //the function's local types as it is read
+    uint32_t num_local_entries = 0;
+    WRP_CHECK(wrp_read_varui32(buf, &num_local_entries));
 
-        for (uint32_t j = 0; j < num_local_entries; j++) {
-            uint32_t num_locals = 0;
-            WRP_CHECK(wrp_read_varui32(buf, &num_locals));
+    void *local_types = NULL;
+    uint32_t total_locals = 0;
+    WRP_CHECK(wrp_arena_alloc(&loader->arena, 0, alignof(int8_t), &local_types));
 
-            int8_t value_type;
-            WRP_CHECK(wrp_read_vari7(buf, &value_type));
+    for (uint32_t j = 0; j < num_local_entries; j++) {
+        uint32_t num_locals = 0;
+        WRP_CHECK(wrp_read_varui32(buf, &num_locals));
 
-            if (!wrp_is_valid_value_type(value_type)) {
-                return WRP_ERR_INVALID_TYPE;
-            }
+        int8_t value_type;
+        WRP_CHECK(wrp_read_vari7(buf, &value_type));
 
-            for (uint32_t k = 0; k < num_locals; k++) {
-                func->local_types[func->num_locals] = value_type;
-                func->num_locals++;
-            }
+        if (!wrp_is_valid_value_type(value_type)) {
+            return WRP_ERR_INVALID_TYPE;
+        }
+
+        if (num_locals > loader->vm->limits.max_func_locals - total_locals) {
+            return WRP_ERR_MDLE_LOCAL_OVERFLOW;
         }
 
-        size_t code_sz = body_sz - (buf->pos - code_segment_pos) + 1;
+        WRP_CHECK(wrp_arena_extend(&loader->arena,
+            local_types,
+            total_locals,
+            (size_t)total_locals + num_locals,
+            alignof(int8_t),
+            &local_types));
 
-        memcpy(&out_mdle->code_buf[code_offset], &buf->bytes[buf->pos], code_sz);
-        func->code = &out_mdle->code_buf[code_offset];
-        func->code_sz = code_sz;
+        memset((int8_t *)local_types + total_locals, value_type, num_locals);
+        total_locals += num_locals;
+    }
 
-        WRP_CHECK(wrp_skip(buf, code_sz));
-        code_offset += code_sz;
+    func->local_types = local_types;
+    func->num_locals = total_locals;
+    loader->meta.num_code_locals += total_locals;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
 
-        current_local += func->num_locals;
+    if (buf->pos - body_pos > body_sz) {
+        return WRP_ERR_INVALID_BUFFER_ACCESS;
     }
 
+    size_t code_end = body_pos + body_sz;
+    func->code = &buf->bytes[buf->pos];
+    func->code_sz = code_end - buf->pos;
+
+    //the type checker records an entry per block, loop and if, they are
+    //counted as the body is read so the final module can size and split
+    //those buffers up front
+    while (buf->pos < code_end) {
+        uint8_t opcode = 0;
+        size_t expr_sz = 0;
+        WRP_CHECK(wrp_skip_expr(buf, &opcode, &expr_sz));
+
+        if (opcode == OP_IF) {
+            func->num_ifs++;
+        } else if (opcode == OP_BLOCK || opcode == OP_LOOP) {
+            func->num_blocks++;
+        }
+    }
+
+    //an expression can't run on into the next body
+    if (buf->pos != code_end) {
+        return WRP_ERR_INVALID_BUFFER_ACCESS;
+    }
+
+    loader->meta.code_buf_sz += func->code_sz;
+    loader->meta.num_block_ops += func->num_blocks;
+    loader->meta.num_if_ops += func->num_ifs;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
     return WRP_SUCCESS;
 }
 
-static wrp_err_t load_data_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t load_code_section(wrp_loader_t *loader)
 {
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
     uint32_t count = 0;
     WRP_CHECK(wrp_read_varui32(buf, &count));
 
-    out_mdle->num_data_segments = count;
-    size_t expr_offset = 0;
-    size_t data_offset = 0;
+    uint32_t num_func_imports = 0;
+    WRP_CHECK(check_code_count(loader, count, &num_func_imports));
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t body_sz = 0;
+        WRP_CHECK(wrp_read_varui32(buf, &body_sz));
+        WRP_CHECK(load_code_body(loader, &mdle->funcs[num_func_imports + i], body_sz));
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t load_data_section(wrp_loader_t *loader)
+{
+    wrp_buf_t *buf = loader->buf;
+    wrp_wasm_mdle_t *mdle = &loader->mdle;
+
+    uint32_t count = 0;
+    WRP_CHECK(wrp_read_varui32(buf, &count));
+
+    loader->meta.num_data_segments = count;
+    WRP_CHECK(wrp_check_meta(&loader->meta, &loader->vm->limits));
+
+    void *segments = NULL;
+    WRP_CHECK(alloc_entries(loader, count, sizeof(wrp_data_segment_t), alignof(wrp_data_segment_t), &segments));
+    mdle->data_segments = segments;
+    mdle->num_data_segments = count;
 
     for (uint32_t i = 0; i < count; i++) {
-        wrp_data_segment_t *segment = &out_mdle->data_segments[i];
-        segment->offset_expr.code = &out_mdle->data_expr_buf[expr_offset];
-        segment->data = &out_mdle->data_buf[data_offset];
+        wrp_data_segment_t *segment = &mdle->data_segments[i];
 
         WRP_CHECK(wrp_read_varui32(buf, &segment->mem_idx));
 
@@ -451,38 +747,309 @@ static wrp_err_t load_data_section(wrp_buf_t *buf, wrp_wasm_mdle_t *out_mdle)
             return WRP_ERR_INVALID_MEM_IDX;
         }
 
-        if (segment->mem_idx >= out_mdle->num_memories) {
+        if (segment->mem_idx >= mdle->num_memories) {
             return WRP_ERR_INVALID_MEM_IDX;
         }
 
-        size_t expr_pos = buf->pos;
         size_t expr_sz = 0;
-        WRP_CHECK(wrp_skip_init_expr(buf, &expr_sz));
-
-        memcpy(segment->offset_expr.code, &buf->bytes[expr_pos], expr_sz);
-        segment->offset_expr.sz = expr_sz;
-        segment->offset_expr.value_type = I32;
+        WRP_CHECK(load_init_expr(loader, &segment->offset_expr, &expr_sz));
+        segment->offset_expr.value_type = mdle->memories[segment->mem_idx].memory64 ? I64 : I32;
 
         uint32_t data_sz = 0;
         WRP_CHECK(wrp_read_varui32(buf, &data_sz));
 
-        memcpy(segment->data, &buf->bytes[buf->pos], data_sz);
+        segment->data = &buf->bytes[buf->pos];
         segment->sz = (size_t)data_sz;
-
         WRP_CHECK(wrp_skip(buf, data_sz));
 
-        expr_offset += expr_sz;
-        data_offset += data_sz;
+        loader->meta.data_expr_buf_sz += expr_sz;
+        loader->meta.data_buf_sz += data_sz;
     }
 
     return WRP_SUCCESS;
 }
 
-wrp_err_t wrp_load_mdle(wrp_vm_t *vm,
-    wrp_buf_t *buf,
-    wrp_wasm_mdle_t *out_mdle)
+//copies bytes still referenced in the input buffer, unless the module is
+//loaded in place and keeps referencing them
+static uint8_t *compact_bytes(wrp_loader_t *loader, uint8_t *dst, uint8_t *src, size_t sz)
 {
-    buf->pos = 0;
+    if (loader->in_place) {
+        return src;
+    }
+
+    if (sz != 0) {
+        memcpy(dst, src, sz);
+    }
+
+    return dst;
+}
+
+//sizes the module from the totals gathered while loading and copies the
+//staged module into that single allocation
+static wrp_err_t compact_mdle(wrp_loader_t *loader, wrp_wasm_mdle_t **out_mdle)
+{
+    wrp_vm_t *vm = loader->vm;
+    wrp_wasm_mdle_t *staged = &loader->mdle;
+
+    //limits still apply to the totals, the buffers are just not needed
+    wrp_wasm_meta_t meta = loader->meta;
+
+    if (loader->in_place) {
+        meta.code_buf_sz = 0;
+        meta.data_buf_sz = 0;
+        meta.elem_expr_buf_sz = 0;
+        meta.data_expr_buf_sz = 0;
+        meta.global_expr_buf_sz = 0;
+    }
+
+    size_t mdle_sz = wrp_mdle_sz(&meta);
+    wrp_wasm_mdle_t *mdle = vm->alloc_fn(mdle_sz, 64);
+
+    if (mdle == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    memset(mdle, 0, mdle_sz);
+    wrp_mdle_init(&meta, mdle);
+    mdle->meta = meta;
+
+    mdle->num_types = staged->num_types;
+    size_t param_offset = 0;
+    size_t result_offset = 0;
+
+    for (uint32_t i = 0; i < staged->num_types; i++) {
+        wrp_type_t *type = &mdle->types[i];
+        *type = staged->types[i];
+
+        type->param_types = &mdle->param_type_buf[param_offset];
+        memcpy(type->param_types, staged->types[i].param_types, type->num_params);
+        param_offset += type->num_params;
+
+        type->result_types = &mdle->result_type_buf[result_offset];
+        memcpy(type->result_types, staged->types[i].result_types, type->num_results);
+        result_offset += type->num_results;
+    }
+
+    mdle->num_funcs = staged->num_funcs;
+    mdle->num_func_imports = staged->num_func_imports;
+    size_t local_offset = 0;
+    size_t code_offset = 0;
+    size_t block_offset = 0;
+    size_t if_offset = 0;
+
+    for (uint32_t i = 0; i < staged->num_funcs; i++) {
+        wrp_func_t *func = &mdle->funcs[i];
+        *func = staged->funcs[i];
+
+        func->local_types = &mdle->local_type_buf[local_offset];
+        local_offset += func->num_locals;
+
+        if (func->num_locals != 0) {
+            memcpy(func->local_types, staged->funcs[i].local_types, func->num_locals);
+        }
+
+        func->code = compact_bytes(loader, &mdle->code_buf[code_offset], staged->funcs[i].code, func->code_sz);
+        code_offset += func->code_sz;
+
+        //each function gets its own slice so functions validate independently
+        func->block_addrs = &mdle->block_addrs_buf[block_offset];
+        func->block_labels = &mdle->block_label_buf[block_offset];
+        func->block_costs = &mdle->block_cost_buf[block_offset];
+        block_offset += staged->funcs[i].num_blocks;
+
+        func->if_addrs = &mdle->if_addrs_buf[if_offset];
+        func->else_addrs = &mdle->else_addrs_buf[if_offset];
+        func->if_labels = &mdle->if_label_buf[if_offset];
+        if_offset += staged->funcs[i].num_ifs;
+
+        //functions validated while streaming keep the entries they recorded,
+        //imports have none
+        if (func->validated && i >= staged->num_func_imports) {
+            memcpy(func->block_addrs, staged->funcs[i].block_addrs, func->num_blocks * sizeof(size_t));
+            memcpy(func->block_labels, staged->funcs[i].block_labels, func->num_blocks * sizeof(size_t));
+            memcpy(func->block_costs, staged->funcs[i].block_costs, func->num_blocks * sizeof(size_t));
+            memcpy(func->if_addrs, staged->funcs[i].if_addrs, func->num_ifs * sizeof(size_t));
+            memcpy(func->else_addrs, staged->funcs[i].else_addrs, func->num_ifs * sizeof(size_t));
+            memcpy(func->if_labels, staged->funcs[i].if_labels, func->num_ifs * sizeof(size_t));
+        } else {
+            func->num_blocks = 0;
+            func->num_ifs = 0;
+        }
+    }
+
+    mdle->num_globals = staged->num_globals;
+    mdle->num_global_imports = staged->num_global_imports;
+    size_t global_expr_offset = 0;
+
+    for (uint32_t i = 0; i < staged->num_globals; i++) {
+        wrp_global_t *global = &mdle->globals[i];
+        *global = staged->globals[i];
+
+        //imported globals have no initializer
+        if (i < staged->num_global_imports) {
+            global->init_expr = (wrp_init_expr_t){0};
+            continue;
+        }
+
+        global->init_expr.code = compact_bytes(loader,
+            &mdle->global_expr_buf[global_expr_offset],
+            staged->globals[i].init_expr.code,
+            global->init_expr.sz);
+        global_expr_offset += global->init_expr.sz;
+    }
+
+    mdle->num_tables = staged->num_tables;
+
+    for (uint32_t i = 0; i < staged->num_tables; i++) {
+        mdle->tables[i] = staged->tables[i];
+    }
+
+    mdle->num_elem_segments = staged->num_elem_segments;
+    size_t elem_offset = 0;
+    size_t elem_expr_offset = 0;
+
+    for (uint32_t i = 0; i < staged->num_elem_segments; i++) {
+        wrp_elem_segment_t *segment = &mdle->elem_segments[i];
+        *segment = staged->elem_segments[i];
+
+        segment->elem = &mdle->elem_buf[elem_offset];
+        memcpy(segment->elem, staged->elem_segments[i].elem, segment->num_elem * sizeof(uint32_t));
+        elem_offset += segment->num_elem;
+
+        segment->offset_expr.code = compact_bytes(loader,
+            &mdle->elem_expr_buf[elem_expr_offset],
+            staged->elem_segments[i].offset_expr.code,
+            segment->offset_expr.sz);
+        elem_expr_offset += segment->offset_expr.sz;
+    }
+
+    mdle->num_memories = staged->num_memories;
+    memcpy(mdle->memories, staged->memories, staged->num_memories * sizeof(wrp_memory_t));
+
+    mdle->num_data_segments = staged->num_data_segments;
+    size_t data_offset = 0;
+    size_t data_expr_offset = 0;
+
+    for (uint32_t i = 0; i < staged->num_data_segments; i++) {
+        wrp_data_segment_t *segment = &mdle->data_segments[i];
+        *segment = staged->data_segments[i];
+
+        segment->data = compact_bytes(loader, &mdle->data_buf[data_offset], staged->data_segments[i].data, segment->sz);
+        data_offset += segment->sz;
+
+        segment->offset_expr.code = compact_bytes(loader,
+            &mdle->data_expr_buf[data_expr_offset],
+            staged->data_segments[i].offset_expr.code,
+            segment->offset_expr.sz);
+        data_expr_offset += segment->offset_expr.sz;
+    }
+
+    mdle->num_imports = staged->num_imports;
+    size_t name_offset = 0;
+    size_t field_offset = 0;
+
+    for (uint32_t i = 0; i < staged->num_imports; i++) {
+        wrp_import_t *import = &mdle->imports[i];
+        *import = staged->imports[i];
+
+        size_t name_sz = strlen(staged->imports[i].name) + 1;
+        import->name = &mdle->import_name_buf[name_offset];
+        memcpy(import->name, staged->imports[i].name, name_sz);
+        name_offset += name_sz;
+
+        size_t field_sz = strlen(staged->imports[i].field) + 1;
+        import->field = &mdle->import_field_buf[field_offset];
+        memcpy(import->field, staged->imports[i].field, field_sz);
+        field_offset += field_sz;
+    }
+
+    mdle->num_exports = staged->num_exports;
+    size_t export_offset = 0;
+
+    for (uint32_t i = 0; i < staged->num_exports; i++) {
+        wrp_export_t *export = &mdle->exports[i];
+        *export = staged->exports[i];
+
+        size_t name_sz = strlen(staged->exports[i].name) + 1;
+        export->name = &mdle->export_name_buf[export_offset];
+        memcpy(export->name, staged->exports[i].name, name_sz);
+        export_offset += name_sz;
+    }
+
+    mdle->start_func_idx = staged->start_func_idx;
+    mdle->start_func_present = staged->start_func_present;
+
+    wrp_err_t err = wrp_index_names(mdle);
+
+    if (err != WRP_SUCCESS) {
+        vm->free_fn(mdle);
+        return err;
+    }
+
+    *out_mdle = mdle;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_section_header(uint8_t section_id, uint32_t prev_section_id)
+{
+    if (section_id > SECTION_DATA) {
+        return WRP_ERR_MDLE_INVALID_SECTION_ID;
+    }
+
+    if (section_id > 0 && section_id <= prev_section_id) {
+        return WRP_ERR_MDLE_SECTION_ORDER;
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t load_section(wrp_loader_t *loader, uint8_t section_id, uint32_t section_sz)
+{
+    switch (section_id) {
+    case SECTION_CUSTOM:
+        return wrp_skip(loader->buf, section_sz);
+
+    case SECTION_TYPE:
+        return load_type_section(loader);
+
+    case SECTION_IMPORT:
+        return load_import_section(loader);
+
+    case SECTION_FUNC:
+        return load_func_section(loader);
+
+    case SECTION_TABLE:
+        return load_table_section(loader);
+
+    case SECTION_MEMORY:
+        return load_memory_section(loader);
+
+    case SECTION_GLOBAL:
+        return load_global_section(loader);
+
+    case SECTION_EXPORT:
+        return load_export_section(loader);
+
+    case SECTION_START:
+        return load_start_section(loader);
+
+    case SECTION_ELEMENT:
+        return load_element_section(loader);
+
+    case SECTION_CODE:
+        return load_code_section(loader);
+
+    case SECTION_DATA:
+        return load_data_section(loader);
+
+    default:
+        return WRP_ERR_MDLE_INVALID_SECTION_ID;
+    }
+}
+
+static wrp_err_t load_sections(wrp_loader_t *loader)
+{
+    wrp_buf_t *buf = loader->buf;
 
     WRP_CHECK(check_preamble(buf));
 
@@ -495,73 +1062,406 @@ wrp_err_t wrp_load_mdle(wrp_vm_t *vm,
         uint32_t section_sz = 0;
         WRP_CHECK(wrp_read_varui32(buf, &section_sz));
 
-        if (section_id > SECTION_DATA) {
-            return WRP_ERR_MDLE_INVALID_SECTION_ID;
+        WRP_CHECK(check_section_header(section_id, prev_section_id));
+        WRP_CHECK(load_section(loader, section_id, section_sz));
+
+        prev_section_id = section_id;
+    }
+
+    if (!wrp_end_of_buf(buf)) {
+        return WRP_ERR_MDLE_INVALID_BYTES;
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_load_mdle(wrp_vm_t *vm,
+    wrp_buf_t *buf,
+    bool in_place,
+    wrp_wasm_mdle_t **out_mdle)
+{
+    buf->pos = 0;
+
+    wrp_loader_t loader = {0};
+    loader.vm = vm;
+    loader.buf = buf;
+    loader.in_place = in_place;
+    wrp_arena_init(&loader.arena, vm, WRP_LOAD_ARENA_SZ);
+
+    wrp_err_t err = load_sections(&loader);
+
+    if (err == WRP_SUCCESS) {
+        err = compact_mdle(&loader, out_mdle);
+    }
+
+    wrp_arena_free(&loader.arena);
+    return err;
+}
+
+typedef enum wrp_stream_state {
+    STREAM_PREAMBLE,
+    STREAM_SECTION_HEADER,
+    STREAM_SECTION,
+    STREAM_CUSTOM_SECTION,
+    STREAM_CODE_COUNT,
+    STREAM_CODE_BODY_SZ,
+    STREAM_CODE_BODY,
+} wrp_stream_state_t;
+
+//only the section or function body being received is buffered, sections
+//are loaded from it as soon as they are complete and so is each function
+//body of the code section, which is validated before the next one arrives
+struct wrp_stream {
+    wrp_loader_t loader;
+    wrp_buf_t buf;
+    wrp_stream_state_t state;
+    wrp_err_t err;
+    uint8_t head[8];
+    size_t head_sz;
+    uint8_t section_id;
+    uint32_t prev_section_id;
+    uint8_t *section_buf;
+    size_t section_buf_sz;
+    uint8_t *pending;
+    size_t pending_sz;
+    size_t pending_pos;
+    size_t code_sz;
+    uint32_t num_bodies;
+    uint32_t body_idx;
+    uint32_t num_func_imports;
+};
+
+//the preamble, section headers and the code section's LEB sizes are
+//gathered a byte at a time in head until they can be decoded
+static bool head_LEB_complete(wrp_stream_t *stream, size_t LEB_pos)
+{
+    if (stream->head_sz <= LEB_pos) {
+        return false;
+    }
+
+    return stream->head[stream->head_sz - 1] < 0x80 || stream->head_sz - LEB_pos == 5;
+}
+
+static wrp_err_t expect_section_header(wrp_stream_t *stream)
+{
+    stream->state = STREAM_SECTION_HEADER;
+    stream->head_sz = 0;
+    return WRP_SUCCESS;
+}
+
+//sections whose entries reference their bytes are received into the arena,
+//other sections reuse one buffer that grows to the largest of them
+static wrp_err_t begin_section(wrp_stream_t *stream, uint32_t section_sz)
+{
+    wrp_loader_t *loader = &stream->loader;
+    wrp_vm_t *vm = loader->vm;
+
+    stream->pending_sz = section_sz;
+    stream->pending_pos = 0;
+    stream->head_sz = 0;
+
+    if (stream->section_id == SECTION_CUSTOM) {
+        stream->pending = NULL;
+        stream->state = STREAM_CUSTOM_SECTION;
+        return WRP_SUCCESS;
+    }
+
+    if (stream->section_id == SECTION_CODE) {
+        stream->code_sz = section_sz;
+        stream->state = STREAM_CODE_COUNT;
+        return WRP_SUCCESS;
+    }
+
+    if (stream->section_id == SECTION_GLOBAL || stream->section_id == SECTION_ELEMENT || stream->section_id == SECTION_DATA) {
+        void *pending = NULL;
+        WRP_CHECK(wrp_arena_alloc(&loader->arena, section_sz, 1, &pending));
+        stream->pending = pending;
+    } else {
+        if (section_sz > stream->section_buf_sz) {
+            if (stream->section_buf != NULL) {
+                vm->free_fn(stream->section_buf);
+            }
+
+            stream->section_buf = vm->alloc_fn(section_sz, 1);
+            stream->section_buf_sz = stream->section_buf != NULL ? section_sz : 0;
+
+            if (stream->section_buf == NULL) {
+                return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+            }
         }
 
-        if (section_id > 0 && section_id <= prev_section_id) {
-            return WRP_ERR_MDLE_SECTION_ORDER;
+        stream->pending = stream->section_buf;
+    }
+
+    stream->state = STREAM_SECTION;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t begin_code_body(wrp_stream_t *stream, uint32_t body_sz)
+{
+    if (body_sz > stream->code_sz) {
+        return WRP_ERR_INVALID_BUFFER_ACCESS;
+    }
+
+    WRP_CHECK(check_body_sz(&stream->loader, body_sz));
+
+    //code is referenced by the staged function until compact_mdle copies it
+    void *pending = NULL;
+    WRP_CHECK(wrp_arena_alloc(&stream->loader.arena, body_sz, 1, &pending));
+
+    stream->pending = pending;
+    stream->pending_sz = body_sz;
+    stream->pending_pos = 0;
+    stream->state = STREAM_CODE_BODY;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t end_code_section(wrp_stream_t *stream)
+{
+    if (stream->code_sz != 0) {
+        return WRP_ERR_MDLE_INVALID_BYTES;
+    }
+
+    return expect_section_header(stream);
+}
+
+static wrp_err_t validate_code_body(wrp_stream_t *stream, uint32_t func_idx)
+{
+    wrp_loader_t *loader = &stream->loader;
+    wrp_func_t *func = &loader->mdle.funcs[func_idx];
+
+    //the type checker records into the function's own slices
+    void *entries = NULL;
+    WRP_CHECK(wrp_arena_alloc(&loader->arena, func->num_blocks * sizeof(size_t) * 3, alignof(size_t), &entries));
+    func->block_addrs = entries;
+    func->block_labels = func->block_addrs + func->num_blocks;
+    func->block_costs = func->block_labels + func->num_blocks;
+
+    WRP_CHECK(wrp_arena_alloc(&loader->arena, func->num_ifs * sizeof(size_t) * 3, alignof(size_t), &entries));
+    func->if_addrs = entries;
+    func->else_addrs = func->if_addrs + func->num_ifs;
+    func->if_labels = func->else_addrs + func->num_ifs;
+
+    return wrp_type_check_staged_func(loader->vm, &loader->mdle, func_idx);
+}
+
+static wrp_err_t end_pending(wrp_stream_t *stream)
+{
+    wrp_loader_t *loader = &stream->loader;
+
+    stream->buf.bytes = stream->pending;
+    stream->buf.sz = stream->pending_sz;
+    stream->buf.pos = 0;
+
+    switch (stream->state) {
+    case STREAM_CUSTOM_SECTION:
+        return expect_section_header(stream);
+
+    case STREAM_SECTION:
+        WRP_CHECK(load_section(loader, stream->section_id, (uint32_t)stream->pending_sz));
+
+        if (!wrp_end_of_buf(&stream->buf)) {
+            return WRP_ERR_MDLE_INVALID_BYTES;
         }
 
-        switch (section_id) {
-        case SECTION_CUSTOM:
-            WRP_CHECK(wrp_skip(buf, section_sz));
-            break;
+        return expect_section_header(stream);
 
-        case SECTION_TYPE:
-            WRP_CHECK(load_type_section(buf, out_mdle));
-            break;
+    case STREAM_CODE_BODY: {
+        uint32_t func_idx = stream->num_func_imports + stream->body_idx;
+        WRP_CHECK(load_code_body(loader, &loader->mdle.funcs[func_idx], (uint32_t)stream->pending_sz));
 
-        case SECTION_IMPORT:
-            WRP_CHECK(load_import_section(buf, out_mdle));
-            break;
+        if (!loader->vm->lazy_validation) {
+            WRP_CHECK(validate_code_body(stream, func_idx));
+        }
 
-        case SECTION_FUNC:
-            WRP_CHECK(load_func_section(buf, out_mdle));
-            break;
+        stream->code_sz -= stream->pending_sz;
+        stream->head_sz = 0;
 
-        case SECTION_TABLE:
-            WRP_CHECK(load_table_section(vm, buf, out_mdle));
-            break;
+        if (++stream->body_idx == stream->num_bodies) {
+            return end_code_section(stream);
+        }
 
-        case SECTION_MEMORY:
-            WRP_CHECK(load_memory_section(vm, buf, out_mdle));
-            break;
+        stream->state = STREAM_CODE_BODY_SZ;
+        return WRP_SUCCESS;
+    }
 
-        case SECTION_GLOBAL:
-            WRP_CHECK(load_global_section(buf, out_mdle));
-            break;
+    default:
+        return WRP_ERR_UNKNOWN;
+    }
+}
+
+static wrp_err_t decode_head(wrp_stream_t *stream)
+{
+    wrp_buf_t head = {.bytes = stream->head, .sz = stream->head_sz, .pos = 0};
 
-        case SECTION_EXPORT:
-            WRP_CHECK(load_export_section(buf, out_mdle));
-            break;
+    switch (stream->state) {
+    case STREAM_PREAMBLE:
+        if (stream->head_sz < 8) {
+            return WRP_SUCCESS;
+        }
 
-        case SECTION_START:
-            WRP_CHECK(load_start_section(buf, out_mdle));
-            break;
+        WRP_CHECK(check_preamble(&head));
+        return expect_section_header(stream);
 
-        case SECTION_ELEMENT:
-            WRP_CHECK(load_element_section(buf, out_mdle));
-            break;
+    case STREAM_SECTION_HEADER: {
+        if (!head_LEB_complete(stream, 1)) {
+            return WRP_SUCCESS;
+        }
 
-        case SECTION_CODE:
-            WRP_CHECK(load_code_section(buf, out_mdle));
-            break;
+        uint32_t section_sz = 0;
+        WRP_CHECK(wrp_read_varui7(&head, &stream->section_id));
+        WRP_CHECK(wrp_read_varui32(&head, &section_sz));
+        WRP_CHECK(check_section_header(stream->section_id, stream->prev_section_id));
+        stream->prev_section_id = stream->section_id;
 
-        case SECTION_DATA:
-            WRP_CHECK(load_data_section(buf, out_mdle));
-            break;
+        WRP_CHECK(begin_section(stream, section_sz));
 
-        default:
-            break;
+        if (stream->state != STREAM_CODE_COUNT && section_sz == 0) {
+            return end_pending(stream);
         }
 
-        prev_section_id = section_id;
+        return WRP_SUCCESS;
     }
 
-    if (!wrp_end_of_buf(buf)) {
-        return WRP_ERR_MDLE_INVALID_BYTES;
+    case STREAM_CODE_COUNT:
+        if (!head_LEB_complete(stream, 0)) {
+            return WRP_SUCCESS;
+        }
+
+        WRP_CHECK(wrp_read_varui32(&head, &stream->num_bodies));
+
+        if (head.pos > stream->code_sz) {
+            return WRP_ERR_INVALID_BUFFER_ACCESS;
+        }
+
+        stream->code_sz -= head.pos;
+        stream->head_sz = 0;
+        stream->body_idx = 0;
+        WRP_CHECK(check_code_count(&stream->loader, stream->num_bodies, &stream->num_func_imports));
+
+        if (stream->num_bodies == 0) {
+            return end_code_section(stream);
+        }
+
+        stream->state = STREAM_CODE_BODY_SZ;
+        return WRP_SUCCESS;
+
+    case STREAM_CODE_BODY_SZ: {
+        if (!head_LEB_complete(stream, 0)) {
+            return WRP_SUCCESS;
+        }
+
+        uint32_t body_sz = 0;
+        WRP_CHECK(wrp_read_varui32(&head, &body_sz));
+
+        if (head.pos > stream->code_sz) {
+            return WRP_ERR_INVALID_BUFFER_ACCESS;
+        }
+
+        stream->code_sz -= head.pos;
+        WRP_CHECK(begin_code_body(stream, body_sz));
+
+        if (body_sz == 0) {
+            return end_pending(stream);
+        }
+
+        return WRP_SUCCESS;
+    }
+
+    default:
+        return WRP_ERR_UNKNOWN;
+    }
+}
+
+static wrp_err_t feed_stream(wrp_stream_t *stream, const uint8_t *bytes, size_t sz)
+{
+    size_t pos = 0;
+
+    while (pos < sz) {
+        if (stream->state == STREAM_SECTION || stream->state == STREAM_CUSTOM_SECTION
+            || stream->state == STREAM_CODE_BODY) {
+            size_t num_bytes = stream->pending_sz - stream->pending_pos;
+
+            if (num_bytes > sz - pos) {
+                num_bytes = sz - pos;
+            }
+
+            if (stream->pending != NULL) {
+                memcpy(&stream->pending[stream->pending_pos], &bytes[pos], num_bytes);
+            }
+
+            stream->pending_pos += num_bytes;
+            pos += num_bytes;
+
+            if (stream->pending_pos == stream->pending_sz) {
+                WRP_CHECK(end_pending(stream));
+            }
+
+            continue;
+        }
+
+        stream->head[stream->head_sz++] = bytes[pos++];
+        WRP_CHECK(decode_head(stream));
     }
 
     return WRP_SUCCESS;
 }
+
+wrp_err_t wrp_load_stream_begin(wrp_vm_t *vm, wrp_stream_t **out_stream)
+{
+    wrp_stream_t *stream = vm->alloc_fn(sizeof(wrp_stream_t), alignof(wrp_stream_t));
+
+    if (stream == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    memset(stream, 0, sizeof(wrp_stream_t));
+    stream->loader.vm = vm;
+    stream->loader.buf = &stream->buf;
+    stream->loader.in_place = false;
+    wrp_arena_init(&stream->loader.arena, vm, WRP_LOAD_ARENA_SZ);
+    stream->state = STREAM_PREAMBLE;
+    stream->err = WRP_SUCCESS;
+
+    *out_stream = stream;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_load_stream_feed(wrp_stream_t *stream, const uint8_t *bytes, size_t sz)
+{
+    //a failed stream keeps failing until it is finished
+    if (stream->err == WRP_SUCCESS) {
+        stream->err = feed_stream(stream, bytes, sz);
+    }
+
+    return stream->err;
+}
+
+wrp_err_t wrp_load_stream_finish(wrp_stream_t *stream, wrp_wasm_mdle_t **out_mdle)
+{
+    wrp_loader_t *loader = &stream->loader;
+    wrp_vm_t *vm = loader->vm;
+    wrp_err_t err = stream->err;
+
+    //the stream must end between sections
+    if (err == WRP_SUCCESS && stream->state == STREAM_PREAMBLE) {
+        err = WRP_ERR_MDLE_MISSING_PREAMBLE;
+    }
+
+    if (err == WRP_SUCCESS && (stream->state != STREAM_SECTION_HEADER || stream->head_sz != 0)) {
+        err = WRP_ERR_INVALID_BUFFER_ACCESS;
+    }
+
+    if (err == WRP_SUCCESS) {
+        err = compact_mdle(loader, out_mdle);
+    }
+
+    wrp_arena_free(&loader->arena);
+
+    if (stream->section_buf != NULL) {
+        vm->free_fn(stream->section_buf);
+    }
+
+    vm->free_fn(stream);
+    return err;
+}
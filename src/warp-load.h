@@ -16,6 +16,7 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -23,4 +24,12 @@
 
 wrp_err_t wrp_load_mdle(wrp_vm_t *vm,
     wrp_buf_t *buf,
-    wrp_wasm_mdle_t *out_mdle);
+    bool in_place,
+    wrp_wasm_mdle_t **out_mdle);
+
+wrp_err_t wrp_load_stream_begin(wrp_vm_t *vm, wrp_stream_t **out_stream);
+
+wrp_err_t wrp_load_stream_feed(wrp_stream_t *stream, const uint8_t *bytes, size_t sz);
+
+//frees the stream whether or not a module is loaded
+wrp_err_t wrp_load_stream_finish(wrp_stream_t *stream, wrp_wasm_mdle_t **out_mdle);
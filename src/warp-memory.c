@@ -0,0 +1,1290 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#if defined(__linux__)
+#define _GNU_SOURCE
+#endif
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "warp-config.h"
+
+#if WRP_MEMORY_RESERVE
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if WRP_MEMORY_IMAGES || WRP_FUTEX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if WRP_FUTEX
+#include <linux/futex.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+#include "warp-encode.h"
+#include "warp-error.h"
+#include "warp-execution.h"
+#include "warp-macros.h"
+#include "warp-memory.h"
+#include "warp-wasm.h"
+#include "warp.h"
+
+#if WRP_MEMORY_RESERVE
+
+#if !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#if !defined(MAP_NORESERVE)
+#define MAP_NORESERVE 0
+#endif
+
+#endif
+
+//generations are unique across all memories, so a view of a destroyed
+//memory can't match a new one that happens to reuse its address
+static _Atomic uint64_t next_generation = 1;
+
+static void bump_generation(wrp_memory_t *memory)
+{
+    atomic_store(&memory->generation, atomic_fetch_add(&next_generation, 1));
+}
+
+static void release_bytes(wrp_vm_t *vm, wrp_memory_t *memory)
+{
+    if (memory->bytes == NULL) {
+        return;
+    }
+
+#if WRP_MEMORY_RESERVE
+    if (memory->mapped) {
+        munmap(memory->bytes, (size_t)memory->reserved_pages * PAGE_SIZE);
+    } else {
+        vm->free_fn(memory->bytes);
+    }
+#else
+    vm->free_fn(memory->bytes);
+#endif
+
+    memory->bytes = NULL;
+    memory->reserved_pages = 0;
+    memory->mapped = false;
+    bump_generation(memory);
+}
+
+#if WRP_MEMORY_RESERVE
+
+static uint8_t *map_reservation(uint64_t num_pages)
+{
+    uint64_t reserve_sz = num_pages * PAGE_SIZE;
+
+    if (reserve_sz == 0 || reserve_sz > SIZE_MAX) {
+        return NULL;
+    }
+
+    //address space only, pages are committed as the memory grows
+    void *bytes = mmap(NULL,
+        (size_t)reserve_sz,
+        PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+        -1,
+        0);
+
+    return bytes == MAP_FAILED ? NULL : bytes;
+}
+
+static void reserve_bytes(wrp_vm_t *vm, wrp_memory_t *memory)
+{
+    uint64_t reserve_pages = memory->max_pages;
+
+    //a memory64 without a small maximum would take up to a terabyte each and
+    //starts smaller, shared memories can't move when grown so keep their max
+    if (memory->memory64 && !memory->shared && reserve_pages > vm->limits.max_memory64_reserve_pages) {
+        reserve_pages = vm->limits.max_memory64_reserve_pages;
+
+        if (reserve_pages < memory->min_pages) {
+            reserve_pages = memory->min_pages;
+        }
+    }
+
+    uint8_t *bytes = map_reservation(reserve_pages);
+
+    if (bytes == NULL) {
+        return;
+    }
+
+    memory->bytes = bytes;
+    memory->num_pages = 0;
+    memory->reserved_pages = (uint32_t)reserve_pages;
+    memory->mapped = true;
+}
+
+//the kernel moves the page tables, so committed pages that were never
+//touched stay unbacked. A range spanning mappings it can't move is copied.
+static wrp_err_t move_pages(uint8_t *from, uint8_t *to, size_t sz)
+{
+    if (sz == 0) {
+        return WRP_SUCCESS;
+    }
+
+#if defined(__linux__)
+    if (mremap(from, sz, sz, MREMAP_MAYMOVE | MREMAP_FIXED, to) != MAP_FAILED) {
+        return WRP_SUCCESS;
+    }
+#endif
+
+    if (mprotect(to, sz, PROT_READ | PROT_WRITE) != 0) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    memcpy(to, from, sz);
+    return WRP_SUCCESS;
+}
+
+//a reservation smaller than the max moves to one at least twice its size
+//when grown past, only memory64 memories that aren't shared have those
+static wrp_err_t extend_reservation(wrp_memory_t *memory, uint64_t total_pages)
+{
+    uint64_t reserve_pages = (uint64_t)memory->reserved_pages * 2;
+
+    if (reserve_pages < total_pages) {
+        reserve_pages = total_pages;
+    }
+
+    if (reserve_pages > memory->max_pages) {
+        reserve_pages = memory->max_pages;
+    }
+
+    uint8_t *bytes = map_reservation(reserve_pages);
+
+    if (bytes == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    //an image is mapped over the initial pages, apart from the pages after it
+    uint32_t num_pages = memory->num_pages;
+    uint32_t image_pages = memory->has_image ? memory->min_pages : 0;
+    size_t image_sz = (size_t)image_pages * PAGE_SIZE;
+    size_t sz = (size_t)num_pages * PAGE_SIZE;
+    wrp_err_t err = move_pages(memory->bytes, bytes, image_sz);
+
+    if (err == WRP_SUCCESS) {
+        err = move_pages(memory->bytes + image_sz, bytes + image_sz, sz - image_sz);
+    }
+
+    if (err != WRP_SUCCESS) {
+        munmap(bytes, (size_t)reserve_pages * PAGE_SIZE);
+        return err;
+    }
+
+    munmap(memory->bytes, (size_t)memory->reserved_pages * PAGE_SIZE);
+    memory->bytes = bytes;
+    memory->reserved_pages = (uint32_t)reserve_pages;
+    bump_generation(memory);
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t decommit_pages(wrp_memory_t *memory)
+{
+    if (memory->num_pages == 0) {
+        return WRP_SUCCESS;
+    }
+
+    //replacing the range drops dirty and image pages in one call
+    void *bytes = mmap(memory->bytes,
+        (size_t)memory->num_pages * PAGE_SIZE,
+        PROT_NONE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+        -1,
+        0);
+
+    if (bytes == MAP_FAILED) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    memory->num_pages = 0;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t commit_pages(wrp_memory_t *memory, uint32_t first_page, uint32_t end_page)
+{
+    if (end_page > memory->reserved_pages) {
+        return WRP_ERR_INVALID_MEM_LIMIT;
+    }
+
+    if (end_page > first_page) {
+        uint8_t *start = memory->bytes + (size_t)first_page * PAGE_SIZE;
+        size_t sz = (size_t)(end_page - first_page) * PAGE_SIZE;
+
+        if (mprotect(start, sz, PROT_READ | PROT_WRITE) != 0) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+    }
+
+    return WRP_SUCCESS;
+}
+
+#endif
+
+static wrp_err_t reset_bytes(wrp_vm_t *vm, wrp_memory_t *memory)
+{
+#if WRP_MEMORY_RESERVE
+    if (memory->bytes == NULL) {
+        reserve_bytes(vm, memory);
+    }
+
+    if (memory->mapped) {
+        return decommit_pages(memory);
+    }
+#endif
+
+    //shared memories can't move when grown, so they need a reservation
+    if (memory->shared && memory->max_pages > 0) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (memory->bytes != NULL && memory->num_pages == memory->min_pages) {
+        return WRP_SUCCESS;
+    }
+
+    uint8_t *bytes = NULL;
+
+    //memory64 sizes may not be addressable on 32 bit hosts
+    if ((uint64_t)memory->min_pages * PAGE_SIZE > SIZE_MAX) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (memory->min_pages > 0) {
+        bytes = vm->alloc_fn((size_t)memory->min_pages * PAGE_SIZE, 64);
+
+        if (bytes == NULL) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+    }
+
+    release_bytes(vm, memory);
+    memory->bytes = bytes;
+    memory->num_pages = memory->min_pages;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t zero_bytes(wrp_memory_t *memory)
+{
+#if WRP_MEMORY_RESERVE
+    if (memory->mapped) {
+        WRP_CHECK(commit_pages(memory, 0, memory->min_pages));
+        memory->num_pages = memory->min_pages;
+        return WRP_SUCCESS;
+    }
+#endif
+
+    if (memory->num_pages != 0) {
+        memset(memory->bytes, 0, (size_t)memory->num_pages * PAGE_SIZE);
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t eval_segment_offset(wrp_vm_t *vm,
+    wrp_data_segment_t *segment,
+    uint64_t mem_sz,
+    uint64_t *out_offset)
+{
+    uint64_t offset_value = 0;
+    WRP_CHECK(wrp_exec_init_expr(vm, &segment->offset_expr, &offset_value));
+
+    //memory64 offsets are i64, both are unsigned addresses
+    uint64_t offset = 0;
+
+    if (segment->offset_expr.value_type == I64) {
+        offset = (uint64_t)wrp_decode_i64(offset_value);
+    } else {
+        offset = (uint32_t)wrp_decode_i32(offset_value);
+    }
+
+    if (offset > mem_sz || segment->sz > mem_sz - offset) {
+        return WRP_ERR_INVALID_MEMORY_ACCESS;
+    }
+
+    *out_offset = offset;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_segments(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *mdle,
+    uint32_t mem_idx,
+    uint64_t mem_sz)
+{
+    for (uint32_t i = 0; i < mdle->num_data_segments; i++) {
+        wrp_data_segment_t *segment = &mdle->data_segments[i];
+
+        if (segment->mem_idx == mem_idx) {
+            uint64_t offset = 0;
+            WRP_CHECK(eval_segment_offset(vm, segment, mem_sz, &offset));
+        }
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t copy_segments(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *mdle,
+    uint32_t mem_idx,
+    wrp_memory_t *memory)
+{
+    uint64_t mem_sz = (uint64_t)memory->num_pages * PAGE_SIZE;
+
+    for (uint32_t i = 0; i < mdle->num_data_segments; i++) {
+        wrp_data_segment_t *segment = &mdle->data_segments[i];
+
+        if (segment->mem_idx == mem_idx) {
+            uint64_t offset = 0;
+            WRP_CHECK(eval_segment_offset(vm, segment, mem_sz, &offset));
+            memcpy(memory->bytes + offset, segment->data, segment->sz);
+        }
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t init_imported_memory(wrp_vm_t *vm, wrp_instance_t *instance, uint32_t mem_idx)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+    wrp_memory_t *memory = &instance->memories[mem_idx];
+    wrp_memory_t *target = memory->import;
+
+    if (target == NULL) {
+        return WRP_ERR_MISSING_MEMORY_IMPORT;
+    }
+
+    uint32_t num_pages = target->num_pages;
+
+    //the exporting module hasn't been linked yet
+    if (num_pages > 0 && target->bytes == NULL) {
+        return WRP_ERR_MISSING_MEMORY_IMPORT;
+    }
+
+    if (target->shared != memory->shared ||
+        target->memory64 != memory->memory64 ||
+        num_pages < memory->min_pages ||
+        target->max_pages > memory->max_pages) {
+        return WRP_ERR_INVALID_IMPORT;
+    }
+
+    //existing contents are kept, only this module's segments are written
+    WRP_CHECK(check_segments(vm, mdle, mem_idx, (uint64_t)num_pages * PAGE_SIZE));
+    return copy_segments(vm, mdle, mem_idx, target);
+}
+
+#if WRP_MEMORY_IMAGES
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 0x0001u
+#endif
+
+static bool is_image_candidate(wrp_wasm_mdle_t *mdle, uint32_t mem_idx)
+{
+    if (mdle->memories[mem_idx].min_pages == 0) {
+        return false;
+    }
+
+    //offsets read from imported globals may change between links
+    for (uint32_t i = 0; i < mdle->num_data_segments; i++) {
+        wrp_data_segment_t *segment = &mdle->data_segments[i];
+
+        uint8_t opcode = segment->offset_expr.code[0];
+
+        if (segment->mem_idx == mem_idx && opcode != OP_I32_CONST && opcode != OP_I64_CONST) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool write_image(int fd, uint8_t *data, size_t sz, off_t offset)
+{
+    while (sz > 0) {
+        ssize_t written = pwrite(fd, data, sz, offset);
+
+        if (written <= 0) {
+            return false;
+        }
+
+        data += written;
+        sz -= (size_t)written;
+        offset += written;
+    }
+
+    return true;
+}
+
+static int build_image(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, uint32_t mem_idx)
+{
+    uint64_t mem_sz = (uint64_t)mdle->memories[mem_idx].min_pages * PAGE_SIZE;
+
+    int fd = (int)syscall(SYS_memfd_create, "warp-memory", MFD_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    //a freshly truncated memfd reads back as zero pages without touching them
+    if (ftruncate(fd, (off_t)mem_sz) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < mdle->num_data_segments; i++) {
+        wrp_data_segment_t *segment = &mdle->data_segments[i];
+        uint64_t offset = 0;
+
+        if (segment->mem_idx != mem_idx) {
+            continue;
+        }
+
+        if (eval_segment_offset(vm, segment, mem_sz, &offset) != WRP_SUCCESS ||
+            !write_image(fd, segment->data, segment->sz, (off_t)offset)) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+//instances linking together may both build the image, only the first one
+//published is kept
+static int publish_image(wrp_memory_t *shared, int fd)
+{
+    int published = -1;
+
+    if (!atomic_compare_exchange_strong_explicit(&shared->image_fd, &published, fd, memory_order_acq_rel, memory_order_acquire)) {
+        close(fd);
+        return published;
+    }
+
+    return fd;
+}
+
+static wrp_err_t map_image(wrp_memory_t *memory, int fd)
+{
+    //the image replaces the front of the reservation, the rest stays uncommitted
+    void *bytes = mmap(memory->bytes,
+        (size_t)memory->min_pages * PAGE_SIZE,
+        PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_FIXED,
+        fd,
+        0);
+
+    if (bytes == MAP_FAILED) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    memory->num_pages = memory->min_pages;
+    memory->has_image = true;
+    return WRP_SUCCESS;
+}
+
+#endif
+
+static wrp_err_t reserve_epochs(wrp_vm_t *vm, wrp_memory_t *memory, uint32_t num_pages)
+{
+    wrp_dirty_pages_t *dirty = &memory->dirty;
+
+    if (num_pages <= dirty->num_pages) {
+        return WRP_SUCCESS;
+    }
+
+    //the log holds one entry per page after dropping superseded ones, twice
+    //that leaves room to append as many again between compactions
+    if (num_pages > UINT32_MAX / 2) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    uint64_t *epochs = vm->alloc_fn((size_t)num_pages * sizeof(uint64_t), alignof(uint64_t));
+
+    if (epochs == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    uint32_t log_cap = num_pages * 2;
+    wrp_dirty_entry_t *log = vm->alloc_fn((size_t)log_cap * sizeof(wrp_dirty_entry_t), alignof(wrp_dirty_entry_t));
+
+    if (log == NULL) {
+        vm->free_fn(epochs);
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (dirty->log_count > 0) {
+        memcpy(log, dirty->log, (size_t)dirty->log_count * sizeof(wrp_dirty_entry_t));
+    }
+
+    if (dirty->log != NULL) {
+        vm->free_fn(dirty->log);
+    }
+
+    dirty->log = log;
+    dirty->log_cap = log_cap;
+
+    if (dirty->num_pages > 0) {
+        memcpy(epochs, dirty->epochs, (size_t)dirty->num_pages * sizeof(uint64_t));
+    }
+
+    memset(epochs + dirty->num_pages, 0, (size_t)(num_pages - dirty->num_pages) * sizeof(uint64_t));
+
+    if (dirty->epochs != NULL) {
+        vm->free_fn(dirty->epochs);
+    }
+
+    dirty->epochs = epochs;
+    dirty->num_pages = num_pages;
+    return WRP_SUCCESS;
+}
+
+//an entry is current when no newer stamp of its page follows it
+static bool is_current(const wrp_dirty_pages_t *dirty, wrp_dirty_entry_t entry)
+{
+    return dirty->epochs[entry.page] == entry.epoch;
+}
+
+//keeps only each page's newest entry, at most one per page
+static void compact_log(wrp_dirty_pages_t *dirty)
+{
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < dirty->log_count; i++) {
+        wrp_dirty_entry_t entry = dirty->log[i];
+
+        if (is_current(dirty, entry)) {
+            dirty->log[count++] = entry;
+        }
+    }
+
+    dirty->log_count = count;
+}
+
+static void stamp_page(wrp_dirty_pages_t *dirty, uint32_t page)
+{
+    if (dirty->epochs[page] == dirty->epoch) {
+        return;
+    }
+
+    if (dirty->log_count == dirty->log_cap) {
+        compact_log(dirty);
+    }
+
+    dirty->epochs[page] = dirty->epoch;
+    dirty->log[dirty->log_count++] = (wrp_dirty_entry_t){ .page = page, .epoch = dirty->epoch };
+}
+
+static void stamp_pages(wrp_memory_t *memory, uint32_t first_page, uint32_t end_page)
+{
+    for (uint32_t page = first_page; page < end_page; page++) {
+        stamp_page(&memory->dirty, page);
+    }
+}
+
+//the log is in epoch order, finds its first entry stamped after epoch. A
+//walker that restamps pages appends up to one entry per page, compacting
+//first keeps those appends from compacting the log under it.
+static uint32_t first_entry_after(wrp_dirty_pages_t *dirty, uint64_t epoch)
+{
+    if (dirty->log_count > dirty->log_cap - dirty->num_pages) {
+        compact_log(dirty);
+    }
+
+    uint32_t lo = 0;
+    uint32_t hi = dirty->log_count;
+
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+
+        if (dirty->log[mid].epoch > epoch) {
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+
+    return lo;
+}
+
+//the current epoch is handed to the caller and later writes get a newer one
+static uint64_t sync_epoch(wrp_memory_t *memory)
+{
+    return memory->dirty.epoch++;
+}
+
+wrp_err_t wrp_mem_init(wrp_vm_t *vm, wrp_instance_t *instance, uint32_t mem_idx)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+    wrp_memory_t *memory = &instance->memories[mem_idx];
+
+    if (memory->imported) {
+        return init_imported_memory(vm, instance, mem_idx);
+    }
+
+    //contents are replaced even when the bytes stay put
+    bump_generation(memory);
+    memory->dirty.all_epoch = memory->dirty.epoch;
+    WRP_CHECK(reset_bytes(vm, memory));
+    memory->has_image = false;
+
+#if WRP_MEMORY_IMAGES
+    //the module's segments were checked when its image was built
+    wrp_memory_t *shared = &mdle->memories[mem_idx];
+    int fd = atomic_load_explicit(&shared->image_fd, memory_order_acquire);
+
+    if (memory->mapped && fd >= 0) {
+        return map_image(memory, fd);
+    }
+#endif
+
+    WRP_CHECK(check_segments(vm, mdle, mem_idx, (uint64_t)memory->min_pages * PAGE_SIZE));
+
+#if WRP_MEMORY_IMAGES
+    //fall back to copying the segments if the image can't be built
+    if (memory->mapped && is_image_candidate(mdle, mem_idx) && (fd = build_image(vm, mdle, mem_idx)) >= 0) {
+        return map_image(memory, publish_image(shared, fd));
+    }
+#endif
+
+    WRP_CHECK(zero_bytes(memory));
+    return copy_segments(vm, mdle, mem_idx, memory);
+}
+
+wrp_err_t wrp_mem_grow(wrp_vm_t *vm,
+    wrp_memory_t *memory,
+    uint32_t delta,
+    uint32_t *out_prev_pages)
+{
+    //tracking is sized up front so a failed allocation leaves the memory as it was
+    if (memory->dirty.epochs != NULL && (uint64_t)memory->num_pages + delta <= memory->max_pages) {
+        WRP_CHECK(reserve_epochs(vm, memory, memory->num_pages + delta));
+    }
+
+#if WRP_MEMORY_RESERVE
+    //grows in place, new pages are zero filled on first touch. Other
+    //threads may grow a shared memory at the same time, committing the
+    //same pages twice is harmless and only one of them publishes the size.
+    //Shared memories reserve their max, so only others ever move.
+    if (memory->mapped) {
+        uint32_t num_pages = atomic_load(&memory->num_pages);
+        uint64_t total_pages = 0;
+
+        do {
+            total_pages = (uint64_t)num_pages + delta;
+
+            if (total_pages > memory->max_pages) {
+                return WRP_ERR_INVALID_MEM_LIMIT;
+            }
+
+            if (total_pages > memory->reserved_pages) {
+                WRP_CHECK(extend_reservation(memory, total_pages));
+            }
+
+            WRP_CHECK(commit_pages(memory, num_pages, (uint32_t)total_pages));
+        } while (!atomic_compare_exchange_weak(&memory->num_pages, &num_pages, (uint32_t)total_pages));
+
+        if (delta > 0) {
+            bump_generation(memory);
+        }
+
+        if (memory->dirty.epochs != NULL) {
+            stamp_pages(memory, num_pages, (uint32_t)total_pages);
+        }
+
+        *out_prev_pages = num_pages;
+        return WRP_SUCCESS;
+    }
+#endif
+
+    uint32_t num_pages = memory->num_pages;
+    uint64_t total_pages = (uint64_t)num_pages + delta;
+
+    if (total_pages > memory->max_pages) {
+        return WRP_ERR_INVALID_MEM_LIMIT;
+    }
+
+    if (total_pages * PAGE_SIZE > SIZE_MAX) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    uint8_t *bytes = vm->alloc_fn((size_t)total_pages * PAGE_SIZE, 64);
+
+    if (bytes == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    size_t current_sz = (size_t)num_pages * PAGE_SIZE;
+
+    if (current_sz != 0) {
+        memcpy(bytes, memory->bytes, current_sz);
+    }
+
+    memset(bytes + current_sz, 0, (size_t)delta * PAGE_SIZE);
+
+    release_bytes(vm, memory);
+    memory->bytes = bytes;
+    memory->num_pages = (uint32_t)total_pages;
+    bump_generation(memory);
+
+    if (memory->dirty.epochs != NULL) {
+        stamp_pages(memory, num_pages, (uint32_t)total_pages);
+    }
+
+    *out_prev_pages = num_pages;
+    return WRP_SUCCESS;
+}
+
+#if WRP_FUTEX
+
+static int64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+//waiters queue on a bucket picked by address, each sleeping on its own
+//futex word. Comparing the value and queueing happen under the bucket's
+//lock and notify takes it too, so a notify after a store can't be missed,
+//whatever the width of the wait
+#define NUM_WAIT_QUEUES 64
+
+typedef struct wrp_waiter {
+    uint8_t *address;
+    _Atomic uint32_t woken;
+    struct wrp_waiter *next;
+} wrp_waiter_t;
+
+typedef struct wrp_wait_queue {
+    atomic_bool locked;
+    wrp_waiter_t *head;
+} wrp_wait_queue_t;
+
+static wrp_wait_queue_t wait_queues[NUM_WAIT_QUEUES];
+
+static wrp_wait_queue_t *lock_wait_queue(uint8_t *address)
+{
+    wrp_wait_queue_t *queue = &wait_queues[((uintptr_t)address >> 3) % NUM_WAIT_QUEUES];
+
+    //held only to walk a short list, never while sleeping
+    while (atomic_exchange_explicit(&queue->locked, true, memory_order_acquire)) {
+        sched_yield();
+    }
+
+    return queue;
+}
+
+static void unlock_wait_queue(wrp_wait_queue_t *queue)
+{
+    atomic_store_explicit(&queue->locked, false, memory_order_release);
+}
+
+static void unlink_waiter(wrp_wait_queue_t *queue, wrp_waiter_t *waiter)
+{
+    for (wrp_waiter_t **link = &queue->head; *link != NULL; link = &(*link)->next) {
+        if (*link == waiter) {
+            *link = waiter->next;
+            return;
+        }
+    }
+}
+
+static uint32_t wait_on(uint8_t *address, uint64_t expected, bool wide, int64_t timeout)
+{
+    wrp_waiter_t waiter = {.address = address, .woken = 0, .next = NULL};
+    wrp_wait_queue_t *queue = lock_wait_queue(address);
+    uint64_t value = wide ? atomic_load((_Atomic uint64_t *)address) : atomic_load((_Atomic uint32_t *)address);
+
+    //a mismatch is reported even when the timeout has already expired
+    if (value != expected) {
+        unlock_wait_queue(queue);
+        return WRP_WAIT_NOT_EQUAL;
+    }
+
+    //woken in the order they started waiting
+    wrp_waiter_t **link = &queue->head;
+
+    while (*link != NULL) {
+        link = &(*link)->next;
+    }
+
+    *link = &waiter;
+    unlock_wait_queue(queue);
+
+    int64_t deadline = timeout >= 0 ? monotonic_ns() + timeout : -1;
+
+    //signals and stray wakes just sleep again
+    while (atomic_load(&waiter.woken) == 0) {
+        struct timespec remaining;
+        struct timespec *remaining_ptr = NULL;
+
+        if (deadline >= 0) {
+            int64_t remaining_ns = deadline - monotonic_ns();
+
+            //a notify can still claim the waiter until it leaves the queue
+            if (remaining_ns <= 0) {
+                queue = lock_wait_queue(address);
+                bool woken = atomic_load(&waiter.woken) != 0;
+
+                if (!woken) {
+                    unlink_waiter(queue, &waiter);
+                }
+
+                unlock_wait_queue(queue);
+                return woken ? WRP_WAIT_OK : WRP_WAIT_TIMED_OUT;
+            }
+
+            remaining.tv_sec = remaining_ns / 1000000000;
+            remaining.tv_nsec = remaining_ns % 1000000000;
+            remaining_ptr = &remaining;
+        }
+
+        syscall(SYS_futex, &waiter.woken, FUTEX_WAIT_PRIVATE, 0, remaining_ptr, NULL, 0);
+    }
+
+    return WRP_WAIT_OK;
+}
+
+#endif
+
+wrp_err_t wrp_mem_wait32(wrp_memory_t *memory,
+    uint8_t *address,
+    uint32_t expected,
+    int64_t timeout,
+    uint32_t *out_result)
+{
+    if (!memory->shared) {
+        return WRP_ERR_INVALID_ATOMIC_WAIT;
+    }
+
+#if WRP_FUTEX
+    *out_result = wait_on(address, expected, false, timeout);
+    return WRP_SUCCESS;
+#else
+    return WRP_ERR_INVALID_ATOMIC_WAIT;
+#endif
+}
+
+wrp_err_t wrp_mem_wait64(wrp_memory_t *memory,
+    uint8_t *address,
+    uint64_t expected,
+    int64_t timeout,
+    uint32_t *out_result)
+{
+    if (!memory->shared) {
+        return WRP_ERR_INVALID_ATOMIC_WAIT;
+    }
+
+#if WRP_FUTEX
+    *out_result = wait_on(address, expected, true, timeout);
+    return WRP_SUCCESS;
+#else
+    return WRP_ERR_INVALID_ATOMIC_WAIT;
+#endif
+}
+
+uint32_t wrp_mem_notify(wrp_memory_t *memory, uint8_t *address, uint32_t count)
+{
+    if (!memory->shared || count == 0) {
+        return 0;
+    }
+
+#if WRP_FUTEX
+    wrp_wait_queue_t *queue = lock_wait_queue(address);
+    wrp_waiter_t **link = &queue->head;
+    uint32_t num_woken = 0;
+
+    while (*link != NULL && num_woken < count) {
+        wrp_waiter_t *waiter = *link;
+
+        if (waiter->address != address) {
+            link = &waiter->next;
+            continue;
+        }
+
+        //the waiter can return as soon as it sees woken, so it's unlinked
+        //first and only its address is used after
+        *link = waiter->next;
+        atomic_store(&waiter->woken, 1);
+        syscall(SYS_futex, &waiter->woken, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+        num_woken++;
+    }
+
+    unlock_wait_queue(queue);
+    return num_woken;
+#else
+    return 0;
+#endif
+}
+
+static void free_tracking(wrp_free_fn_t free_fn, wrp_memory_t *memory)
+{
+    if (memory->dirty.epochs != NULL) {
+        free_fn(memory->dirty.epochs);
+        free_fn(memory->dirty.log);
+        memset(&memory->dirty, 0, sizeof(memory->dirty));
+    }
+}
+
+void wrp_mem_free(wrp_vm_t *vm, wrp_memory_t *memory)
+{
+    release_bytes(vm, memory);
+    free_tracking(vm->free_fn, memory);
+    memory->has_image = false;
+}
+
+void wrp_mem_free_image(wrp_memory_t *memory)
+{
+#if WRP_MEMORY_IMAGES
+    int fd = atomic_exchange(&memory->image_fd, -1);
+
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
+
+wrp_err_t wrp_mem_track_dirty(wrp_vm_t *vm, wrp_memory_t *memory)
+{
+    if (memory->imported || memory->shared) {
+        return WRP_SUCCESS;
+    }
+
+    if (memory->dirty.epochs == NULL) {
+        WRP_CHECK(reserve_epochs(vm, memory, memory->num_pages > 0 ? memory->num_pages : 1));
+
+        //pages stamped 0 are unwritten since tracking began
+        memory->dirty.epoch = 1;
+        memory->dirty.all_epoch = 0;
+        memory->dirty.reset_epoch = 0;
+    }
+
+    memory->dirty.num_consumers++;
+    return WRP_SUCCESS;
+}
+
+void wrp_mem_untrack_dirty(wrp_free_fn_t free_fn, wrp_memory_t *memory)
+{
+    if (memory->dirty.epochs != NULL && --memory->dirty.num_consumers == 0) {
+        free_tracking(free_fn, memory);
+    }
+}
+
+void wrp_mem_mark_dirty(wrp_memory_t *memory, uint64_t address, size_t sz)
+{
+    uint64_t first_page = address / PAGE_SIZE;
+    uint64_t last_page = (address + (sz > 0 ? sz - 1 : 0)) / PAGE_SIZE;
+
+    for (uint64_t page = first_page; page <= last_page && page < memory->dirty.num_pages; page++) {
+        stamp_page(&memory->dirty, (uint32_t)page);
+    }
+}
+
+wrp_err_t wrp_mem_reset(wrp_vm_t *vm, wrp_instance_t *instance, uint32_t mem_idx, const uint8_t *pristine)
+{
+    wrp_memory_t *memory = &instance->memories[mem_idx];
+    wrp_dirty_pages_t *dirty = &memory->dirty;
+
+    //an imported memory belongs to the instance exporting it
+    if (memory->imported) {
+        return WRP_SUCCESS;
+    }
+
+    if (dirty->epochs == NULL ||
+        pristine == NULL ||
+        dirty->all_epoch > dirty->reset_epoch ||
+        memory->num_pages != memory->min_pages) {
+        WRP_CHECK(wrp_mem_init(vm, instance, mem_idx));
+    } else {
+        uint32_t first = first_entry_after(dirty, dirty->reset_epoch);
+        uint32_t end = dirty->log_count;
+
+        for (uint32_t i = first; i < end; i++) {
+            wrp_dirty_entry_t entry = dirty->log[i];
+
+            if (is_current(dirty, entry) && entry.page < memory->min_pages) {
+                size_t offset = (size_t)entry.page * PAGE_SIZE;
+                memcpy(memory->bytes + offset, pristine + offset, PAGE_SIZE);
+
+                //snapshots taken before the reset see the copied pages change
+                stamp_page(dirty, entry.page);
+            }
+        }
+    }
+
+    if (dirty->epochs != NULL) {
+        dirty->reset_epoch = sync_epoch(memory);
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_mem_snapshot(wrp_vm_t *vm, wrp_memory_t *memory, wrp_mem_shadow_t *shadow)
+{
+    wrp_dirty_pages_t *dirty = &memory->dirty;
+    uint32_t num_pages = memory->num_pages;
+    bool all_dirty = !shadow->taken || dirty->epochs == NULL || dirty->all_epoch > shadow->epoch;
+
+    if ((uint64_t)num_pages * PAGE_SIZE > SIZE_MAX) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    if (num_pages > shadow->cap_pages) {
+        uint8_t *bytes = vm->alloc_fn((size_t)num_pages * PAGE_SIZE, 64);
+
+        if (bytes == NULL) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+
+        if (!all_dirty && shadow->num_pages > 0) {
+            memcpy(bytes, shadow->bytes, (size_t)shadow->num_pages * PAGE_SIZE);
+        }
+
+        if (shadow->bytes != NULL) {
+            vm->free_fn(shadow->bytes);
+        }
+
+        shadow->bytes = bytes;
+        shadow->cap_pages = num_pages;
+    }
+
+    //pages the shadow lacks are taken whole, the rest from the log
+    uint32_t first_new = all_dirty ? 0 : (num_pages < shadow->num_pages ? num_pages : shadow->num_pages);
+
+    if (num_pages > first_new) {
+        size_t offset = (size_t)first_new * PAGE_SIZE;
+        memcpy(shadow->bytes + offset, memory->bytes + offset, (size_t)(num_pages - first_new) * PAGE_SIZE);
+    }
+
+    if (!all_dirty) {
+        for (uint32_t i = first_entry_after(dirty, shadow->epoch); i < dirty->log_count; i++) {
+            wrp_dirty_entry_t entry = dirty->log[i];
+
+            if (is_current(dirty, entry) && entry.page < first_new) {
+                size_t offset = (size_t)entry.page * PAGE_SIZE;
+                memcpy(shadow->bytes + offset, memory->bytes + offset, PAGE_SIZE);
+            }
+        }
+    }
+
+    shadow->num_pages = num_pages;
+    shadow->taken = true;
+
+    if (dirty->epochs != NULL) {
+        shadow->epoch = sync_epoch(memory);
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t shrink_pages(wrp_memory_t *memory, uint32_t num_pages)
+{
+#if WRP_MEMORY_RESERVE
+    //the dropped pages are replaced so growing again commits zeroed ones
+    if (memory->mapped) {
+        void *bytes = mmap(memory->bytes + (size_t)num_pages * PAGE_SIZE,
+            (size_t)(memory->num_pages - num_pages) * PAGE_SIZE,
+            PROT_NONE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED,
+            -1,
+            0);
+
+        if (bytes == MAP_FAILED) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+    }
+#endif
+
+    //heap bytes are kept, growing again allocates and zeroes new ones
+    memory->num_pages = num_pages;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_mem_restore(wrp_vm_t *vm, wrp_memory_t *memory, wrp_mem_shadow_t *shadow)
+{
+    wrp_dirty_pages_t *dirty = &memory->dirty;
+    uint32_t num_pages = memory->num_pages;
+    bool all_dirty = dirty->epochs == NULL || dirty->all_epoch > shadow->epoch;
+
+    if (!shadow->taken) {
+        return WRP_ERR_UNKNOWN;
+    }
+
+    if (num_pages < shadow->num_pages) {
+        uint32_t prev_pages = 0;
+        WRP_CHECK(wrp_mem_grow(vm, memory, shadow->num_pages - num_pages, &prev_pages));
+    } else if (num_pages > shadow->num_pages) {
+        WRP_CHECK(shrink_pages(memory, shadow->num_pages));
+    }
+
+    //pages the memory grew back are taken whole, the rest from the log
+    uint32_t first_new = all_dirty ? 0 : (num_pages < shadow->num_pages ? num_pages : shadow->num_pages);
+
+    if (shadow->num_pages > first_new) {
+        size_t offset = (size_t)first_new * PAGE_SIZE;
+        memcpy(memory->bytes + offset, shadow->bytes + offset, (size_t)(shadow->num_pages - first_new) * PAGE_SIZE);
+    }
+
+    //snapshots taken before the restore see the copied pages change
+    if (all_dirty && dirty->epochs != NULL) {
+        stamp_pages(memory, 0, shadow->num_pages);
+    } else if (!all_dirty) {
+        uint32_t first = first_entry_after(dirty, shadow->epoch);
+        uint32_t end = dirty->log_count;
+
+        for (uint32_t i = first; i < end; i++) {
+            wrp_dirty_entry_t entry = dirty->log[i];
+
+            if (is_current(dirty, entry) && entry.page < first_new) {
+                size_t offset = (size_t)entry.page * PAGE_SIZE;
+                memcpy(memory->bytes + offset, shadow->bytes + offset, PAGE_SIZE);
+                stamp_page(dirty, entry.page);
+            }
+        }
+    }
+
+    //views of the rolled back contents or size are stale
+    bump_generation(memory);
+
+    if (dirty->epochs != NULL) {
+        shadow->epoch = sync_epoch(memory);
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_mem_view(wrp_vm_t *vm, wrp_mem_view_t *out_view)
+{
+    wrp_memory_t *memory = vm->memory;
+
+    if (memory == NULL) {
+        return WRP_ERR_INVALID_MEM_IDX;
+    }
+
+    //writes through the view can't be tracked
+    memory->dirty.all_epoch = memory->dirty.epoch;
+
+    //read the generation first so a concurrent grow invalidates the view
+    out_view->memory = memory;
+    out_view->generation = atomic_load(&memory->generation);
+    out_view->bytes = memory->bytes;
+    out_view->sz = (uint64_t)atomic_load(&memory->num_pages) * PAGE_SIZE;
+    return WRP_SUCCESS;
+}
+
+bool wrp_mem_view_valid(wrp_vm_t *vm, wrp_mem_view_t *view)
+{
+    return vm->memory != NULL &&
+        vm->memory == view->memory &&
+        atomic_load(&vm->memory->generation) == view->generation;
+}
+
+static wrp_err_t check_access(wrp_vm_t *vm, uint64_t address, size_t sz, uint8_t **out_ptr)
+{
+    wrp_memory_t *memory = vm->memory;
+
+    if (memory == NULL) {
+        return WRP_ERR_INVALID_MEM_IDX;
+    }
+
+    uint64_t mem_sz = (uint64_t)atomic_load(&memory->num_pages) * PAGE_SIZE;
+
+    if (address > mem_sz || sz > mem_sz - address) {
+        return WRP_ERR_INVALID_MEMORY_ACCESS;
+    }
+
+    *out_ptr = memory->bytes + address;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_mem_read(wrp_vm_t *vm, uint64_t address, void *dst, size_t sz)
+{
+    uint8_t *ptr = NULL;
+    WRP_CHECK(check_access(vm, address, sz, &ptr));
+
+    if (sz != 0) {
+        memcpy(dst, ptr, sz);
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_mem_write(wrp_vm_t *vm, uint64_t address, const void *src, size_t sz)
+{
+    uint8_t *ptr = NULL;
+    WRP_CHECK(check_access(vm, address, sz, &ptr));
+
+    if (sz != 0) {
+        memcpy(ptr, src, sz);
+    }
+
+    if (vm->memory->dirty.epochs != NULL) {
+        wrp_mem_mark_dirty(vm->memory, address, sz);
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_mem_read_i32(wrp_vm_t *vm, uint64_t address, int32_t *out_value)
+{
+    return wrp_mem_read(vm, address, out_value, sizeof(int32_t));
+}
+
+wrp_err_t wrp_mem_read_i64(wrp_vm_t *vm, uint64_t address, int64_t *out_value)
+{
+    return wrp_mem_read(vm, address, out_value, sizeof(int64_t));
+}
+
+wrp_err_t wrp_mem_read_f32(wrp_vm_t *vm, uint64_t address, float *out_value)
+{
+    return wrp_mem_read(vm, address, out_value, sizeof(float));
+}
+
+wrp_err_t wrp_mem_read_f64(wrp_vm_t *vm, uint64_t address, double *out_value)
+{
+    return wrp_mem_read(vm, address, out_value, sizeof(double));
+}
+
+wrp_err_t wrp_mem_write_i32(wrp_vm_t *vm, uint64_t address, int32_t value)
+{
+    return wrp_mem_write(vm, address, &value, sizeof(int32_t));
+}
+
+wrp_err_t wrp_mem_write_i64(wrp_vm_t *vm, uint64_t address, int64_t value)
+{
+    return wrp_mem_write(vm, address, &value, sizeof(int64_t));
+}
+
+wrp_err_t wrp_mem_write_f32(wrp_vm_t *vm, uint64_t address, float value)
+{
+    return wrp_mem_write(vm, address, &value, sizeof(float));
+}
+
+wrp_err_t wrp_mem_write_f64(wrp_vm_t *vm, uint64_t address, double value)
+{
+    return wrp_mem_write(vm, address, &value, sizeof(double));
+}
@@ -0,0 +1,118 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "warp-types.h"
+
+//a host view of the linked memory, valid until the generation changes
+typedef struct wrp_mem_view {
+    wrp_memory_t *memory;
+    uint8_t *bytes;
+    uint64_t sz;
+    uint64_t generation;
+} wrp_mem_view_t;
+
+//a copy of a memory's pages, brought up to date by copying only the pages
+//written since the copy was last taken or restored. Its owner frees bytes.
+typedef struct wrp_mem_shadow {
+    uint8_t *bytes;
+    uint32_t num_pages;
+    uint32_t cap_pages;
+    uint64_t epoch;
+    bool taken;
+} wrp_mem_shadow_t;
+
+//atomic wait results
+#define WRP_WAIT_OK             0
+#define WRP_WAIT_NOT_EQUAL      1
+#define WRP_WAIT_TIMED_OUT      2
+
+wrp_err_t wrp_mem_init(wrp_vm_t *vm, wrp_instance_t *instance, uint32_t mem_idx);
+
+wrp_err_t wrp_mem_grow(wrp_vm_t *vm,
+    wrp_memory_t *memory,
+    uint32_t delta,
+    uint32_t *out_prev_pages);
+
+wrp_err_t wrp_mem_wait32(wrp_memory_t *memory,
+    uint8_t *address,
+    uint32_t expected,
+    int64_t timeout,
+    uint32_t *out_result);
+
+wrp_err_t wrp_mem_wait64(wrp_memory_t *memory,
+    uint8_t *address,
+    uint64_t expected,
+    int64_t timeout,
+    uint32_t *out_result);
+
+uint32_t wrp_mem_notify(wrp_memory_t *memory, uint8_t *address, uint32_t count);
+
+void wrp_mem_free(wrp_vm_t *vm, wrp_memory_t *memory);
+
+//closes the image built for a module's memory, instances already mapping
+//it keep their pages
+void wrp_mem_free_image(wrp_memory_t *memory);
+
+//stamps the pages the vm writes, so resets and shadows copy just those.
+//Each consumer tracking a memory lets it go with wrp_mem_untrack_dirty,
+//until the last one does every store pays for the stamp. Shared memories
+//are written concurrently and aren't tracked.
+wrp_err_t wrp_mem_track_dirty(wrp_vm_t *vm, wrp_memory_t *memory);
+
+void wrp_mem_untrack_dirty(wrp_free_fn_t free_fn, wrp_memory_t *memory);
+
+void wrp_mem_mark_dirty(wrp_memory_t *memory, uint64_t address, size_t sz);
+
+//returns the memory to its initialized contents, a tracked memory that
+//hasn't grown or been viewed copies its dirty pages back from pristine, an
+//initialized copy of its initial pages, anything else is initialized again
+wrp_err_t wrp_mem_reset(wrp_vm_t *vm, wrp_instance_t *instance, uint32_t mem_idx, const uint8_t *pristine);
+
+//untracked memories and a shadow's first copy take every page
+wrp_err_t wrp_mem_snapshot(wrp_vm_t *vm, wrp_memory_t *memory, wrp_mem_shadow_t *shadow);
+
+//returns the memory to the shadow's size and contents
+wrp_err_t wrp_mem_restore(wrp_vm_t *vm, wrp_memory_t *memory, wrp_mem_shadow_t *shadow);
+
+wrp_err_t wrp_mem_view(wrp_vm_t *vm, wrp_mem_view_t *out_view);
+
+bool wrp_mem_view_valid(wrp_vm_t *vm, wrp_mem_view_t *view);
+
+wrp_err_t wrp_mem_read(wrp_vm_t *vm, uint64_t address, void *dst, size_t sz);
+
+wrp_err_t wrp_mem_write(wrp_vm_t *vm, uint64_t address, const void *src, size_t sz);
+
+wrp_err_t wrp_mem_read_i32(wrp_vm_t *vm, uint64_t address, int32_t *out_value);
+
+wrp_err_t wrp_mem_read_i64(wrp_vm_t *vm, uint64_t address, int64_t *out_value);
+
+wrp_err_t wrp_mem_read_f32(wrp_vm_t *vm, uint64_t address, float *out_value);
+
+wrp_err_t wrp_mem_read_f64(wrp_vm_t *vm, uint64_t address, double *out_value);
+
+wrp_err_t wrp_mem_write_i32(wrp_vm_t *vm, uint64_t address, int32_t value);
+
+wrp_err_t wrp_mem_write_i64(wrp_vm_t *vm, uint64_t address, int64_t value);
+
+wrp_err_t wrp_mem_write_f32(wrp_vm_t *vm, uint64_t address, float value);
+
+wrp_err_t wrp_mem_write_f64(wrp_vm_t *vm, uint64_t address, double value);
@@ -0,0 +1,232 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdalign.h>
+#include <string.h>
+
+#include "warp-error.h"
+#include "warp-execution.h"
+#include "warp-macros.h"
+#include "warp-memory.h"
+#include "warp-pool.h"
+#include "warp.h"
+
+static void close_pooled_vm(wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    if (vm->mdle != NULL) {
+        wrp_unlink_instance(vm);
+    }
+
+    if (instance != NULL) {
+        wrp_destroy_instance(vm, instance);
+    }
+
+    wrp_close_vm(vm);
+}
+
+//initialized pages of tracked memories are copied once, every instance of
+//the module starts out with the same contents
+static wrp_err_t copy_pristine_memories(wrp_vm_pool_t *pool, wrp_instance_t *instance)
+{
+    for (uint32_t i = 0; i < pool->mdle->num_memories; i++) {
+        wrp_memory_t *memory = &instance->memories[i];
+
+        if (memory->dirty.epochs == NULL || pool->pristine_memories[i] != NULL) {
+            continue;
+        }
+
+        size_t sz = (size_t)memory->min_pages * PAGE_SIZE;
+        pool->pristine_memories[i] = pool->alloc_fn(sz, 64);
+
+        if (pool->pristine_memories[i] == NULL) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+
+        memcpy(pool->pristine_memories[i], memory->bytes, sz);
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t add_vm(wrp_vm_pool_t *pool, const wrp_registry_t *registry)
+{
+    wrp_vm_t *vm = wrp_open_vm(pool->alloc_fn, pool->free_fn);
+
+    if (vm == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    wrp_instance_t *instance = wrp_create_instance(vm, pool->mdle);
+    wrp_err_t err = instance == NULL ? vm->err : WRP_SUCCESS;
+
+    if (err == WRP_SUCCESS && registry != NULL) {
+        err = wrp_import_registry(instance, registry);
+    }
+
+    if (err == WRP_SUCCESS) {
+        err = wrp_link_instance(vm, instance);
+    }
+
+    //mapped memories are cheaper to decommit and initialize again
+    for (uint32_t i = 0; err == WRP_SUCCESS && i < pool->mdle->num_memories; i++) {
+        wrp_memory_t *memory = &instance->memories[i];
+
+        if (!memory->mapped && memory->min_pages > 0) {
+            err = wrp_mem_track_dirty(vm, memory);
+        }
+    }
+
+    if (err == WRP_SUCCESS) {
+        err = copy_pristine_memories(pool, instance);
+    }
+
+    if (err != WRP_SUCCESS) {
+        close_pooled_vm(vm, instance);
+        return err;
+    }
+
+    pool->vms[pool->num_vms++] = vm;
+    pool->free_vms[pool->num_free++] = vm;
+    return WRP_SUCCESS;
+}
+
+wrp_vm_pool_t *wrp_create_vm_pool(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *mdle,
+    const wrp_registry_t *registry,
+    uint32_t num_vms)
+{
+    wrp_vm_pool_t *pool = vm->alloc_fn(sizeof(wrp_vm_pool_t), alignof(wrp_vm_pool_t));
+
+    if (pool == NULL) {
+        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        return NULL;
+    }
+
+    memset(pool, 0, sizeof(wrp_vm_pool_t));
+    pool->alloc_fn = vm->alloc_fn;
+    pool->free_fn = vm->free_fn;
+    pool->mdle = mdle;
+
+    //a spare slot each, so an empty pool or memoryless module never asks for zero bytes
+    size_t vms_sz = ((size_t)num_vms + 1) * sizeof(wrp_vm_t *);
+    pool->vms = vm->alloc_fn(vms_sz, alignof(wrp_vm_t *));
+    pool->free_vms = vm->alloc_fn(vms_sz, alignof(wrp_vm_t *));
+    pool->pristine_memories = vm->alloc_fn(((size_t)mdle->num_memories + 1) * sizeof(uint8_t *), alignof(uint8_t *));
+
+    if (pool->vms == NULL || pool->free_vms == NULL || pool->pristine_memories == NULL) {
+        wrp_destroy_vm_pool(pool);
+        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        return NULL;
+    }
+
+    memset(pool->pristine_memories, 0, ((size_t)mdle->num_memories + 1) * sizeof(uint8_t *));
+
+    for (uint32_t i = 0; i < num_vms; i++) {
+        wrp_err_t err = add_vm(pool, registry);
+
+        if (err != WRP_SUCCESS) {
+            wrp_destroy_vm_pool(pool);
+            vm->err = err;
+            return NULL;
+        }
+    }
+
+    vm->err = WRP_SUCCESS;
+    return pool;
+}
+
+void wrp_destroy_vm_pool(wrp_vm_pool_t *pool)
+{
+    for (uint32_t i = 0; i < pool->num_vms; i++) {
+        close_pooled_vm(pool->vms[i], pool->vms[i]->instance);
+    }
+
+    if (pool->pristine_memories != NULL) {
+        for (uint32_t i = 0; i < pool->mdle->num_memories; i++) {
+            if (pool->pristine_memories[i] != NULL) {
+                pool->free_fn(pool->pristine_memories[i]);
+            }
+        }
+
+        pool->free_fn(pool->pristine_memories);
+    }
+
+    if (pool->vms != NULL) {
+        pool->free_fn(pool->vms);
+    }
+
+    if (pool->free_vms != NULL) {
+        pool->free_fn(pool->free_vms);
+    }
+
+    pool->free_fn(pool);
+}
+
+wrp_vm_t *wrp_vm_pool_acquire(wrp_vm_pool_t *pool)
+{
+    if (pool->num_free == 0) {
+        return NULL;
+    }
+
+    //the vm released last is the one most likely still in cache
+    return pool->free_vms[--pool->num_free];
+}
+
+static wrp_err_t recycle_vm(wrp_vm_pool_t *pool, wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    //whatever call was running or suspended is dropped with the stacks
+    wrp_reset_vm(vm);
+    wrp_disable_fuel(vm);
+
+    if (instance->globals_dirty) {
+        for (uint32_t i = mdle->num_global_imports; i < mdle->num_globals; i++) {
+            WRP_CHECK(wrp_exec_init_expr(vm, &mdle->globals[i].init_expr, &instance->global_buf[i]));
+        }
+
+        instance->globals_dirty = false;
+    }
+
+    for (uint32_t i = 0; i < mdle->num_memories; i++) {
+        WRP_CHECK(wrp_mem_reset(vm, instance, i, pool->pristine_memories[i]));
+    }
+
+    //init exprs run on the stacks
+    wrp_reset_vm(vm);
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_vm_pool_release(wrp_vm_pool_t *pool, wrp_vm_t *vm)
+{
+    wrp_instance_t *instance = vm->instance;
+    wrp_err_t err = recycle_vm(pool, vm, instance);
+
+    if (err != WRP_SUCCESS) {
+        for (uint32_t i = 0; i < pool->num_vms; i++) {
+            if (pool->vms[i] == vm) {
+                pool->vms[i] = pool->vms[--pool->num_vms];
+                break;
+            }
+        }
+
+        close_pooled_vm(vm, instance);
+        return err;
+    }
+
+    pool->free_vms[pool->num_free++] = vm;
+    return WRP_SUCCESS;
+}
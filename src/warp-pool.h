@@ -0,0 +1,59 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "warp-registry.h"
+#include "warp-types.h"
+#include "warp-wasm.h"
+#include "warp.h"
+
+//vms each linked to their own instance of one module, handed out and taken
+//back without instantiating or linking again. Only what a call can have
+//dirtied is reset on release: the stacks, the defined globals if any were
+//written and the memory pages written since the vm was acquired. Host writes
+//straight to an exported memory's or global's bytes aren't seen, views and
+//wrp_mem_write are. Not thread safe, each thread can have its own pool.
+typedef struct wrp_vm_pool {
+    wrp_alloc_fn_t alloc_fn;
+    wrp_free_fn_t free_fn;
+    wrp_wasm_mdle_t *mdle;
+    uint32_t num_vms;
+    uint32_t num_free;
+    wrp_vm_t **vms;
+    wrp_vm_t **free_vms;
+    uint8_t **pristine_memories;
+} wrp_vm_pool_t;
+
+//opens num_vms vms with vm's allocator up front, the imports of every
+//instance are bound from registry, which can be NULL if mdle has none. mdle
+//and registry must outlive the pool.
+wrp_vm_pool_t *wrp_create_vm_pool(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *mdle,
+    const wrp_registry_t *registry,
+    uint32_t num_vms);
+
+//closes every vm, including any still acquired
+void wrp_destroy_vm_pool(wrp_vm_pool_t *pool);
+
+//returns NULL once every vm is in use
+wrp_vm_t *wrp_vm_pool_acquire(wrp_vm_pool_t *pool);
+
+//a vm can be released with a call still suspended. One that can't be reset
+//is closed and leaves the pool, which then holds one vm less.
+wrp_err_t wrp_vm_pool_release(wrp_vm_pool_t *pool, wrp_vm_t *vm);
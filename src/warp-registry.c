@@ -0,0 +1,265 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdalign.h>
+#include <string.h>
+
+#include "warp-config.h"
+#include "warp-error.h"
+#include "warp-macros.h"
+#include "warp-registry.h"
+#include "warp-wasm.h"
+#include "warp.h"
+
+static wrp_err_t alloc_entries(wrp_vm_t *vm, uint32_t capacity, wrp_registry_entry_t **out_entries)
+{
+    size_t entries_sz = capacity * sizeof(wrp_registry_entry_t);
+    wrp_registry_entry_t *entries = vm->alloc_fn(entries_sz, alignof(wrp_registry_entry_t));
+
+    if (entries == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    //an entry without a name is empty
+    memset(entries, 0, entries_sz);
+    *out_entries = entries;
+    return WRP_SUCCESS;
+}
+
+static bool is_entry(const wrp_registry_entry_t *entry, uint32_t hash, const char *mdle_name, const char *field)
+{
+    return entry->hash == hash && strcmp(entry->mdle_name, mdle_name) == 0 && strcmp(entry->field, field) == 0;
+}
+
+static wrp_registry_entry_t *find_slot(wrp_registry_entry_t *entries,
+    uint32_t capacity,
+    uint32_t hash,
+    const char *mdle_name,
+    const char *field)
+{
+    uint32_t mask = capacity - 1;
+    uint32_t slot = hash & mask;
+
+    while (entries[slot].mdle_name != NULL && !is_entry(&entries[slot], hash, mdle_name, field)) {
+        slot = (slot + 1) & mask;
+    }
+
+    return &entries[slot];
+}
+
+//kept at most half full so probes stay short
+static wrp_err_t grow(wrp_vm_t *vm, wrp_registry_t *registry)
+{
+    if ((registry->num_entries + 1) * 2 <= registry->capacity) {
+        return WRP_SUCCESS;
+    }
+
+    uint32_t capacity = registry->capacity * 2;
+    wrp_registry_entry_t *entries = NULL;
+    WRP_CHECK(alloc_entries(vm, capacity, &entries));
+
+    for (uint32_t i = 0; i < registry->capacity; i++) {
+        wrp_registry_entry_t *entry = &registry->entries[i];
+
+        if (entry->mdle_name != NULL) {
+            *find_slot(entries, capacity, entry->hash, entry->mdle_name, entry->field) = *entry;
+        }
+    }
+
+    vm->free_fn(registry->entries);
+    registry->entries = entries;
+    registry->capacity = capacity;
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t add_entry(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    const char *field,
+    uint8_t kind,
+    wrp_registry_entry_t **out_entry)
+{
+    WRP_CHECK(grow(vm, registry));
+
+    uint32_t hash = wrp_hash_import(mdle_name, field);
+    wrp_registry_entry_t *entry = find_slot(registry->entries, registry->capacity, hash, mdle_name, field);
+
+    if (entry->mdle_name == NULL) {
+        registry->num_entries++;
+    }
+
+    *entry = (wrp_registry_entry_t){.mdle_name = mdle_name, .field = field, .hash = hash, .kind = kind};
+    *out_entry = entry;
+    return WRP_SUCCESS;
+}
+
+wrp_registry_t *wrp_create_registry(wrp_vm_t *vm)
+{
+    wrp_registry_t *registry = vm->alloc_fn(sizeof(wrp_registry_t), alignof(wrp_registry_t));
+
+    if (registry == NULL) {
+        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        return NULL;
+    }
+
+    registry->num_entries = 0;
+    registry->capacity = WRP_REGISTRY_SZ;
+
+    if ((vm->err = alloc_entries(vm, registry->capacity, &registry->entries)) != WRP_SUCCESS) {
+        vm->free_fn(registry);
+        return NULL;
+    }
+
+    vm->err = WRP_SUCCESS;
+    return registry;
+}
+
+void wrp_destroy_registry(wrp_vm_t *vm, wrp_registry_t *registry)
+{
+    vm->free_fn(registry->entries);
+    vm->free_fn(registry);
+}
+
+wrp_err_t wrp_register_func(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    const char *field,
+    const wrp_host_func_t *func)
+{
+    wrp_registry_entry_t *entry = NULL;
+    WRP_CHECK(add_entry(vm, registry, mdle_name, field, EXTERNAL_FUNC, &entry));
+    entry->func = *func;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_register_global(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    const char *field,
+    uint64_t *global,
+    int8_t type,
+    bool mutable)
+{
+    wrp_registry_entry_t *entry = NULL;
+    WRP_CHECK(add_entry(vm, registry, mdle_name, field, EXTERNAL_GLOBAL, &entry));
+    entry->global = global;
+    entry->global_type = type;
+    entry->global_mutability = mutable ? GLOBAL_MUTABLE : GLOBAL_IMMUTABLE;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_register_memory(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    const char *field,
+    wrp_memory_t *memory)
+{
+    wrp_registry_entry_t *entry = NULL;
+    WRP_CHECK(add_entry(vm, registry, mdle_name, field, EXTERNAL_MEMORY, &entry));
+    entry->memory = memory;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_register_instance(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    wrp_instance_t *instance)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    for (uint32_t i = 0; i < mdle->num_exports; i++) {
+        const wrp_export_t *export = &mdle->exports[i];
+        wrp_registry_entry_t *entry = NULL;
+
+        if (export->kind == EXTERNAL_FUNC) {
+            WRP_CHECK(add_entry(vm, registry, mdle_name, export->name, EXTERNAL_FUNC, &entry));
+            entry->instance = instance;
+            entry->func_idx = export->idx;
+        } else if (export->kind == EXTERNAL_GLOBAL) {
+            wrp_global_t *global = &mdle->globals[export->idx];
+            uint64_t *value = NULL;
+            WRP_CHECK(wrp_export_global(instance, export->name, &value));
+            WRP_CHECK(wrp_register_global(vm,
+                registry,
+                mdle_name,
+                export->name,
+                value,
+                global->type,
+                global->mutability == GLOBAL_MUTABLE));
+        } else if (export->kind == EXTERNAL_MEMORY) {
+            wrp_memory_t *memory = NULL;
+            WRP_CHECK(wrp_export_memory(instance, export->name, &memory));
+            WRP_CHECK(wrp_register_memory(vm, registry, mdle_name, export->name, memory));
+        }
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t import_entry(wrp_instance_t *instance, const wrp_import_t *import, const wrp_registry_entry_t *entry)
+{
+    if (entry->kind != import->kind) {
+        return WRP_ERR_INVALID_IMPORT;
+    }
+
+    if (import->kind == EXTERNAL_FUNC && entry->instance != NULL) {
+        return wrp_import_instance_func(instance, entry->instance, entry->func_idx, import->idx);
+    }
+
+    if (import->kind == EXTERNAL_FUNC) {
+        return wrp_import_func(instance, &entry->func, import->idx);
+    }
+
+    if (import->kind == EXTERNAL_GLOBAL) {
+        wrp_global_t *global = &instance->mdle->globals[import->idx];
+
+        if (global->type != entry->global_type) {
+            return WRP_ERR_TYPE_MISMATCH;
+        }
+
+        if (global->mutability != entry->global_mutability) {
+            return WRP_ERR_INVALID_MUTIBILITY;
+        }
+
+        return wrp_import_global(instance, entry->global, import->idx);
+    }
+
+    if (import->kind == EXTERNAL_MEMORY) {
+        return wrp_import_memory(instance, entry->memory, import->idx);
+    }
+
+    return WRP_ERR_INVALID_IMPORT;
+}
+
+wrp_err_t wrp_import_registry(wrp_instance_t *instance, const wrp_registry_t *registry)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    //the import's hash was taken when the module was indexed
+    for (uint32_t i = 0; i < mdle->num_imports; i++) {
+        const wrp_import_t *import = &mdle->imports[i];
+        const wrp_registry_entry_t *entry =
+            find_slot(registry->entries, registry->capacity, import->hash, import->name, import->field);
+
+        if (entry->mdle_name == NULL) {
+            return WRP_ERR_UNKNOWN_IMPORT;
+        }
+
+        WRP_CHECK(import_entry(instance, import, entry));
+    }
+
+    return WRP_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "warp-types.h"
+#include "warp-wasm.h"
+
+//names aren't copied and must outlive the registry, a function is either
+//the host's or the func_idx of instance
+typedef struct wrp_registry_entry {
+    const char *mdle_name;
+    const char *field;
+    uint32_t hash;
+    uint8_t kind;
+    wrp_host_func_t func;
+    wrp_instance_t *instance;
+    uint32_t func_idx;
+    uint64_t *global;
+    int8_t global_type;
+    uint8_t global_mutability;
+    wrp_memory_t *memory;
+} wrp_registry_entry_t;
+
+//host functions, globals and memories bound once under their import names
+//and resolved for any number of instances, open addressed so each import is
+//found with one probe in the common case
+typedef struct wrp_registry {
+    wrp_registry_entry_t *entries;
+    uint32_t num_entries;
+    uint32_t capacity;
+} wrp_registry_t;
+
+wrp_registry_t *wrp_create_registry(wrp_vm_t *vm);
+
+void wrp_destroy_registry(wrp_vm_t *vm, wrp_registry_t *registry);
+
+//registering a name again replaces its binding
+wrp_err_t wrp_register_func(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    const char *field,
+    const wrp_host_func_t *func);
+
+wrp_err_t wrp_register_global(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    const char *field,
+    uint64_t *global,
+    int8_t type,
+    bool mutable);
+
+wrp_err_t wrp_register_memory(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    const char *field,
+    wrp_memory_t *memory);
+
+//registers the function, global and memory exports of instance under
+//mdle_name, imports of them call into instance directly. The instance must
+//outlive the registry and the instances importing from it.
+wrp_err_t wrp_register_instance(wrp_vm_t *vm,
+    wrp_registry_t *registry,
+    const char *mdle_name,
+    wrp_instance_t *instance);
+
+//binds every import of the instance, fails with WRP_ERR_UNKNOWN_IMPORT for a
+//name that isn't registered and WRP_ERR_INVALID_IMPORT for one registered as
+//another kind
+wrp_err_t wrp_import_registry(wrp_instance_t *instance, const wrp_registry_t *registry);
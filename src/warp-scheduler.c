@@ -0,0 +1,278 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "warp-config.h"
+#include "warp-error.h"
+#include "warp-macros.h"
+#include "warp-scheduler.h"
+#include "warp-stack-ops.h"
+#include "warp-thread.h"
+#include "warp.h"
+
+wrp_scheduler_t *wrp_create_scheduler(wrp_vm_t *vm, const wrp_thread_pool_t *pool)
+{
+    wrp_scheduler_t *sched = vm->alloc_fn(sizeof(wrp_scheduler_t), alignof(wrp_scheduler_t));
+
+    if (sched == NULL) {
+        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        return NULL;
+    }
+
+    memset(sched, 0, sizeof(wrp_scheduler_t));
+    sched->alloc_fn = vm->alloc_fn;
+    sched->free_fn = vm->free_fn;
+    sched->num_workers = 1;
+
+    if (pool != NULL && pool->num_workers > 1) {
+        sched->pool = *pool;
+        sched->num_workers = pool->num_workers < WRP_MAX_WORKERS ? pool->num_workers : WRP_MAX_WORKERS;
+    }
+
+    for (uint32_t i = 0; i < sched->num_workers; i++) {
+        wrp_sched_deque_t *deque = &sched->deques[i];
+        atomic_init(&deque->top, 0);
+        atomic_init(&deque->bottom, 0);
+        deque->capacity = WRP_SCHED_DEQUE_SZ;
+        deque->tasks = vm->alloc_fn(deque->capacity * sizeof(wrp_sched_task_t *), alignof(wrp_sched_task_t *));
+
+        if (deque->tasks == NULL) {
+            wrp_destroy_scheduler(sched);
+            vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+            return NULL;
+        }
+    }
+
+    //a host pool brings its own threads
+    if (sched->pool.run_workers == NULL) {
+        wrp_start_workers(&sched->workers, sched->num_workers);
+    }
+
+    vm->err = WRP_SUCCESS;
+    return sched;
+}
+
+void wrp_destroy_scheduler(wrp_scheduler_t *sched)
+{
+    if (sched->workers.num_workers > 0) {
+        wrp_stop_workers(&sched->workers);
+    }
+
+    for (uint32_t i = 0; i < sched->num_workers; i++) {
+        if (sched->deques[i].tasks != NULL) {
+            sched->free_fn(sched->deques[i].tasks);
+        }
+    }
+
+    sched->free_fn(sched);
+}
+
+//no frame is running so the deque is only touched by this thread
+static wrp_err_t grow_deque(wrp_scheduler_t *sched, wrp_sched_deque_t *deque)
+{
+    uint32_t capacity = deque->capacity * 2;
+    wrp_sched_task_t **tasks = sched->alloc_fn(capacity * sizeof(wrp_sched_task_t *), alignof(wrp_sched_task_t *));
+
+    if (tasks == NULL) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    memcpy(tasks, deque->tasks, deque->capacity * sizeof(wrp_sched_task_t *));
+    sched->free_fn(deque->tasks);
+    deque->tasks = tasks;
+    deque->capacity = capacity;
+    return WRP_SUCCESS;
+}
+
+//functions and non-shared memories bound to another instance would let
+//tasks on different workers reach the same instance state
+static bool reaches_other_instance(const wrp_instance_t *instance)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    for (uint32_t i = 0; i < mdle->num_func_imports; i++) {
+        if (instance->func_imports[i].instance != NULL) {
+            return true;
+        }
+    }
+
+    for (uint32_t i = 0; i < mdle->num_memories; i++) {
+        const wrp_memory_t *memory = &instance->memories[i];
+
+        if (memory->imported && !memory->import->shared) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+wrp_err_t wrp_sched_submit(wrp_scheduler_t *sched, wrp_sched_task_t *task)
+{
+    //each task starts a call, so a suspended one would be lost
+    if (wrp_is_suspended(task->vm)) {
+        return WRP_ERR_VM_SUSPENDED;
+    }
+
+    wrp_instance_t *instance = task->vm->instance;
+
+    if (instance == NULL || reaches_other_instance(instance)) {
+        return WRP_ERR_SHARED_INSTANCE;
+    }
+
+    //an instance is claimed by its first task of the frame, a second one
+    //would run on its state from another worker
+    if (instance->sched_owner == sched && instance->sched_frame == sched->frame) {
+        return WRP_ERR_SHARED_INSTANCE;
+    }
+
+    //dealt round robin, stealing evens out tasks that take longer
+    wrp_sched_deque_t *deque = &sched->deques[sched->next_deque];
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+
+    if (bottom == deque->capacity) {
+        WRP_CHECK(grow_deque(sched, deque));
+    }
+
+    deque->tasks[bottom] = task;
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    sched->next_deque = (sched->next_deque + 1) % sched->num_workers;
+    instance->sched_owner = sched;
+    instance->sched_frame = sched->frame;
+    return WRP_SUCCESS;
+}
+
+//the owner and a thief can race for the last task, the top is claimed with
+//a compare exchange by whichever takes it
+static wrp_sched_task_t *pop_task(wrp_sched_deque_t *deque)
+{
+    int64_t bottom = atomic_load(&deque->bottom) - 1;
+    atomic_store(&deque->bottom, bottom);
+    int64_t top = atomic_load(&deque->top);
+
+    if (top > bottom) {
+        atomic_store(&deque->bottom, bottom + 1);
+        return NULL;
+    }
+
+    wrp_sched_task_t *task = deque->tasks[bottom];
+
+    if (top == bottom) {
+        if (!atomic_compare_exchange_strong(&deque->top, &top, top + 1)) {
+            task = NULL;
+        }
+
+        atomic_store(&deque->bottom, bottom + 1);
+    }
+
+    return task;
+}
+
+static wrp_sched_task_t *steal_task(wrp_sched_deque_t *deque, bool *out_contended)
+{
+    int64_t top = atomic_load(&deque->top);
+    int64_t bottom = atomic_load(&deque->bottom);
+
+    if (top >= bottom) {
+        return NULL;
+    }
+
+    wrp_sched_task_t *task = deque->tasks[top];
+
+    if (!atomic_compare_exchange_strong(&deque->top, &top, top + 1)) {
+        *out_contended = true;
+        return NULL;
+    }
+
+    return task;
+}
+
+static void run_task(wrp_sched_task_t *task)
+{
+    wrp_vm_t *vm = task->vm;
+
+    //suspended after it was submitted, the call is kept for wrp_resume
+    if (wrp_is_suspended(vm)) {
+        task->err = WRP_ERR_VM_SUSPENDED;
+        return;
+    }
+
+    wrp_reset_vm(vm);
+
+    for (uint32_t i = 0; i < task->num_args; i++) {
+        if ((task->err = wrp_stk_exec_push_op(vm, task->args[i].value, (int8_t)task->args[i].type)) != WRP_SUCCESS) {
+            return;
+        }
+    }
+
+    task->err = wrp_call_export(vm, &task->func);
+}
+
+static void frame_task(void *arg)
+{
+    wrp_scheduler_t *sched = arg;
+    uint32_t worker_idx = atomic_fetch_add(&sched->next_worker, 1);
+
+    if (worker_idx >= sched->num_workers) {
+        return;
+    }
+
+    wrp_sched_deque_t *own = &sched->deques[worker_idx];
+
+    while (true) {
+        wrp_sched_task_t *task = pop_task(own);
+
+        if (task != NULL) {
+            run_task(task);
+            continue;
+        }
+
+        //nothing is submitted during a frame, so once every deque is seen
+        //empty without losing a race the frame's work is all taken
+        bool contended = false;
+
+        for (uint32_t i = 1; i < sched->num_workers && task == NULL; i++) {
+            task = steal_task(&sched->deques[(worker_idx + i) % sched->num_workers], &contended);
+        }
+
+        if (task != NULL) {
+            run_task(task);
+        } else if (!contended) {
+            return;
+        }
+    }
+}
+
+void wrp_sched_run_frame(wrp_scheduler_t *sched)
+{
+    atomic_store(&sched->next_worker, 0);
+
+    if (sched->pool.run_workers != NULL) {
+        wrp_run_workers(&sched->pool, sched->num_workers, frame_task, sched);
+    } else {
+        wrp_wake_workers(&sched->workers, frame_task, sched);
+    }
+
+    for (uint32_t i = 0; i < sched->num_workers; i++) {
+        atomic_store(&sched->deques[i].top, 0);
+        atomic_store(&sched->deques[i].bottom, 0);
+    }
+
+    sched->next_deque = 0;
+    sched->frame++;
+}
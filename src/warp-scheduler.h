@@ -0,0 +1,81 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stdalign.h>
+#include <stdint.h>
+
+#include "warp-config.h"
+#include "warp-thread.h"
+#include "warp-types.h"
+#include "warp-wasm.h"
+#include "warp.h"
+
+//a call of a function export, args are pushed in order and results are left
+//on vm's operand stack, err is set once the frame has run it
+typedef struct wrp_sched_task {
+    wrp_vm_t *vm;
+    wrp_export_handle_t func;
+    const wrp_oprd_t *args;
+    uint32_t num_args;
+    wrp_err_t err;
+} wrp_sched_task_t;
+
+//its worker takes tasks from the bottom and idle workers steal from the top
+typedef struct wrp_sched_deque {
+    alignas(64) _Atomic int64_t top;
+    alignas(64) _Atomic int64_t bottom;
+    wrp_sched_task_t **tasks;
+    uint32_t capacity;
+} wrp_sched_deque_t;
+
+//runs frames of tasks submitted to per-worker deques, balanced by work
+//stealing. Vms may share modules and lazily validated modules are checked
+//under the module's lock. Instances stay apart: a second task of a frame
+//on the same instance, through the same vm or another one linked to it, is
+//rejected, so is one bound to another instance's functions or non-shared
+//memory. Imported mutable globals must not be shared by tasks of one frame.
+typedef struct wrp_scheduler {
+    wrp_alloc_fn_t alloc_fn;
+    wrp_free_fn_t free_fn;
+    wrp_thread_pool_t pool;
+    wrp_worker_group_t workers;
+    uint32_t num_workers;
+    uint32_t next_deque;
+    _Atomic uint32_t next_worker;
+    uint64_t frame;
+    wrp_sched_deque_t deques[WRP_MAX_WORKERS];
+} wrp_scheduler_t;
+
+//frames run on pool->num_workers workers of pool, see wrp_run_workers.
+//Without a run_workers the scheduler starts its own threads, which sleep
+//between frames until it is destroyed. NULL or fewer than two workers runs
+//frames on the calling thread.
+wrp_scheduler_t *wrp_create_scheduler(wrp_vm_t *vm, const wrp_thread_pool_t *pool);
+
+void wrp_destroy_scheduler(wrp_scheduler_t *sched);
+
+//the task is run by the next frame and must stay valid until it returns,
+//tasks are submitted from one thread while no frame is running. A suspended
+//vm fails with WRP_ERR_VM_SUSPENDED, its call is left for wrp_resume, and a
+//vm whose instance already has a task in the frame or reaches another
+//instance fails with WRP_ERR_SHARED_INSTANCE.
+wrp_err_t wrp_sched_submit(wrp_scheduler_t *sched, wrp_sched_task_t *task);
+
+//runs every submitted task and returns once all of them are done, which is
+//the frame's barrier
+void wrp_sched_run_frame(wrp_scheduler_t *sched);
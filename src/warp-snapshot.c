@@ -0,0 +1,258 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdalign.h>
+#include <string.h>
+
+#include "warp-error.h"
+#include "warp-macros.h"
+#include "warp-memory.h"
+#include "warp-snapshot.h"
+#include "warp.h"
+
+wrp_snapshot_t *wrp_create_snapshot(wrp_vm_t *vm)
+{
+    wrp_instance_t *instance = vm->instance;
+
+    if (instance == NULL) {
+        vm->err = WRP_ERR_UNKNOWN;
+        return NULL;
+    }
+
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+    wrp_snapshot_t *snapshot = vm->alloc_fn(sizeof(wrp_snapshot_t), alignof(wrp_snapshot_t));
+
+    if (snapshot == NULL) {
+        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        return NULL;
+    }
+
+    memset(snapshot, 0, sizeof(wrp_snapshot_t));
+    snapshot->alloc_fn = vm->alloc_fn;
+    snapshot->free_fn = vm->free_fn;
+    snapshot->instance = instance;
+
+    //a spare slot each, so a module without globals or memories never asks for zero bytes
+    size_t memories_sz = ((size_t)mdle->num_memories + 1) * sizeof(wrp_mem_shadow_t);
+    snapshot->global_buf = vm->alloc_fn(((size_t)mdle->num_globals + 1) * sizeof(uint64_t), alignof(uint64_t));
+    snapshot->memories = vm->alloc_fn(memories_sz, alignof(wrp_mem_shadow_t));
+
+    if (snapshot->global_buf == NULL || snapshot->memories == NULL) {
+        wrp_destroy_snapshot(snapshot);
+        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        return NULL;
+    }
+
+    memset(snapshot->memories, 0, memories_sz);
+
+    for (uint32_t i = 0; i < mdle->num_memories; i++) {
+        wrp_err_t err = wrp_mem_track_dirty(vm, &instance->memories[i]);
+
+        if (err != WRP_SUCCESS) {
+            wrp_destroy_snapshot(snapshot);
+            vm->err = err;
+            return NULL;
+        }
+
+        snapshot->num_tracked++;
+    }
+
+    vm->err = WRP_SUCCESS;
+    return snapshot;
+}
+
+void wrp_destroy_snapshot(wrp_snapshot_t *snapshot)
+{
+    for (uint32_t i = 0; i < snapshot->num_tracked; i++) {
+        wrp_mem_untrack_dirty(snapshot->free_fn, &snapshot->instance->memories[i]);
+    }
+
+    if (snapshot->memories != NULL) {
+        for (uint32_t i = 0; i < snapshot->instance->mdle->num_memories; i++) {
+            if (snapshot->memories[i].bytes != NULL) {
+                snapshot->free_fn(snapshot->memories[i].bytes);
+            }
+        }
+
+        snapshot->free_fn(snapshot->memories);
+    }
+
+    void *bufs[] = {snapshot->global_buf, snapshot->oprd_stk, snapshot->ctrl_stk, snapshot->call_stk};
+
+    for (size_t i = 0; i < sizeof(bufs) / sizeof(bufs[0]); i++) {
+        if (bufs[i] != NULL) {
+            snapshot->free_fn(bufs[i]);
+        }
+    }
+
+    snapshot->free_fn(snapshot);
+}
+
+//stacks are copied up to their heads, the buffers grow to the deepest seen
+static void *reserve_stack(wrp_snapshot_t *snapshot,
+    void *stk,
+    uint32_t *cap,
+    int32_t head,
+    size_t entry_sz,
+    size_t align)
+{
+    uint32_t count = (uint32_t)(head + 1);
+
+    if (count <= *cap) {
+        return stk;
+    }
+
+    void *new_stk = snapshot->alloc_fn(count * entry_sz, align);
+
+    if (new_stk == NULL) {
+        return NULL;
+    }
+
+    if (stk != NULL) {
+        snapshot->free_fn(stk);
+    }
+
+    *cap = count;
+    return new_stk;
+}
+
+static void copy_stack(void *dst, const void *src, int32_t head, size_t entry_sz)
+{
+    if (head >= 0) {
+        memcpy(dst, src, (size_t)(head + 1) * entry_sz);
+    }
+}
+
+static wrp_err_t save_stacks(wrp_vm_t *vm, wrp_snapshot_t *snapshot)
+{
+    wrp_oprd_t *oprd_stk = reserve_stack(snapshot,
+        snapshot->oprd_stk,
+        &snapshot->oprd_stk_cap,
+        vm->oprd_stk_head,
+        sizeof(wrp_oprd_t),
+        alignof(wrp_oprd_t));
+    wrp_ctrl_frame_t *ctrl_stk = reserve_stack(snapshot,
+        snapshot->ctrl_stk,
+        &snapshot->ctrl_stk_cap,
+        vm->ctrl_stk_head,
+        sizeof(wrp_ctrl_frame_t),
+        alignof(wrp_ctrl_frame_t));
+    wrp_call_frame_t *call_stk = reserve_stack(snapshot,
+        snapshot->call_stk,
+        &snapshot->call_stk_cap,
+        vm->call_stk_head,
+        sizeof(wrp_call_frame_t),
+        alignof(wrp_call_frame_t));
+
+    //a buffer that failed to grow is kept, along with its capacity
+    if (oprd_stk != NULL) {
+        snapshot->oprd_stk = oprd_stk;
+    }
+
+    if (ctrl_stk != NULL) {
+        snapshot->ctrl_stk = ctrl_stk;
+    }
+
+    if (call_stk != NULL) {
+        snapshot->call_stk = call_stk;
+    }
+
+    if ((oprd_stk == NULL && vm->oprd_stk_head >= 0) ||
+        (ctrl_stk == NULL && vm->ctrl_stk_head >= 0) ||
+        (call_stk == NULL && vm->call_stk_head >= 0)) {
+        return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+    }
+
+    copy_stack(snapshot->oprd_stk, vm->oprd_stk, vm->oprd_stk_head, sizeof(wrp_oprd_t));
+    copy_stack(snapshot->ctrl_stk, vm->ctrl_stk, vm->ctrl_stk_head, sizeof(wrp_ctrl_frame_t));
+    copy_stack(snapshot->call_stk, vm->call_stk, vm->call_stk_head, sizeof(wrp_call_frame_t));
+    snapshot->oprd_stk_head = vm->oprd_stk_head;
+    snapshot->ctrl_stk_head = vm->ctrl_stk_head;
+    snapshot->call_stk_head = vm->call_stk_head;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_snapshot(wrp_vm_t *vm, wrp_snapshot_t *snapshot)
+{
+    wrp_instance_t *instance = snapshot->instance;
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    if (vm->instance != instance) {
+        return WRP_ERR_UNKNOWN;
+    }
+
+    //a snapshot that fails part way can't be restored
+    snapshot->taken = false;
+    WRP_CHECK(save_stacks(vm, snapshot));
+
+    for (uint32_t i = 0; i < mdle->num_memories; i++) {
+        if (!instance->memories[i].imported) {
+            WRP_CHECK(wrp_mem_snapshot(vm, &instance->memories[i], &snapshot->memories[i]));
+        }
+    }
+
+    if (mdle->num_globals > 0) {
+        memcpy(snapshot->global_buf, instance->global_buf, (size_t)mdle->num_globals * sizeof(uint64_t));
+    }
+
+    snapshot->opcode_stream = vm->opcode_stream;
+    snapshot->fuel_metered = vm->fuel_metered;
+    snapshot->fuel = vm->fuel;
+    snapshot->suspended = vm->suspended;
+    snapshot->entry_stopped = vm->entry_stopped;
+    snapshot->entry_func_idx = vm->entry_func_idx;
+    snapshot->pending_host_type = vm->pending_host_type;
+    snapshot->taken = true;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_restore(wrp_vm_t *vm, wrp_snapshot_t *snapshot)
+{
+    wrp_instance_t *instance = snapshot->instance;
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    if (vm->instance != instance || !snapshot->taken) {
+        return WRP_ERR_UNKNOWN;
+    }
+
+    for (uint32_t i = 0; i < mdle->num_memories; i++) {
+        if (!instance->memories[i].imported) {
+            WRP_CHECK(wrp_mem_restore(vm, &instance->memories[i], &snapshot->memories[i]));
+        }
+    }
+
+    for (uint32_t i = mdle->num_global_imports; i < mdle->num_globals; i++) {
+        instance->global_buf[i] = snapshot->global_buf[i];
+    }
+
+    //a pool resets restored globals like written ones
+    instance->globals_dirty = true;
+
+    copy_stack(vm->oprd_stk, snapshot->oprd_stk, snapshot->oprd_stk_head, sizeof(wrp_oprd_t));
+    copy_stack(vm->ctrl_stk, snapshot->ctrl_stk, snapshot->ctrl_stk_head, sizeof(wrp_ctrl_frame_t));
+    copy_stack(vm->call_stk, snapshot->call_stk, snapshot->call_stk_head, sizeof(wrp_call_frame_t));
+    vm->oprd_stk_head = snapshot->oprd_stk_head;
+    vm->ctrl_stk_head = snapshot->ctrl_stk_head;
+    vm->call_stk_head = snapshot->call_stk_head;
+    vm->opcode_stream = snapshot->opcode_stream;
+    vm->fuel_metered = snapshot->fuel_metered;
+    vm->fuel = snapshot->fuel;
+    vm->suspended = snapshot->suspended;
+    vm->entry_stopped = snapshot->entry_stopped;
+    vm->entry_func_idx = snapshot->entry_func_idx;
+    vm->pending_host_type = snapshot->pending_host_type;
+    return WRP_SUCCESS;
+}
@@ -0,0 +1,75 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "warp-memory.h"
+#include "warp-types.h"
+#include "warp-wasm.h"
+#include "warp.h"
+
+//the state of a vm's linked instance and of the call it may have suspended:
+//defined globals, memories, stacks and fuel. Memory is copied incrementally,
+//taking or restoring a snapshot copies only the pages written since it was
+//last taken or restored, so a ring of snapshots can be kept cheaply for
+//rollback. Tables can't change after instantiation and imported globals and
+//memories belong to the instance exporting them, none are captured.
+typedef struct wrp_snapshot {
+    wrp_alloc_fn_t alloc_fn;
+    wrp_free_fn_t free_fn;
+    wrp_instance_t *instance;
+    bool taken;
+    uint64_t *global_buf;
+    wrp_mem_shadow_t *memories;
+    uint32_t num_tracked;
+    wrp_oprd_t *oprd_stk;
+    uint32_t oprd_stk_cap;
+    int32_t oprd_stk_head;
+    wrp_ctrl_frame_t *ctrl_stk;
+    uint32_t ctrl_stk_cap;
+    int32_t ctrl_stk_head;
+    wrp_call_frame_t *call_stk;
+    uint32_t call_stk_cap;
+    int32_t call_stk_head;
+    wrp_buf_t opcode_stream;
+    bool fuel_metered;
+    uint64_t fuel;
+    bool suspended;
+    bool entry_stopped;
+    uint32_t entry_func_idx;
+    const wrp_type_t *pending_host_type;
+} wrp_snapshot_t;
+
+//a snapshot of the instance linked to vm, which starts tracking the pages
+//its memories write. It is taken with wrp_snapshot. While any snapshot of
+//the instance lives, copy-on-write memories included, every store stamps
+//its page.
+wrp_snapshot_t *wrp_create_snapshot(wrp_vm_t *vm);
+
+//the instance must still be alive, its memories stop being tracked once
+//nothing else needs it
+void wrp_destroy_snapshot(wrp_snapshot_t *snapshot);
+
+//vm must still be linked to the snapshot's instance and not be running
+wrp_err_t wrp_snapshot(wrp_vm_t *vm, wrp_snapshot_t *snapshot);
+
+//a suspended call snapshotted is suspended again and can be resumed. Views
+//of the instance's memories are invalidated. A memory that can't grow back
+//fails the restore and leaves the instance partly restored.
+wrp_err_t wrp_restore(wrp_vm_t *vm, wrp_snapshot_t *snapshot);
@@ -18,6 +18,7 @@
 #include "warp-encode.h"
 #include "warp-error.h"
 #include "warp-macros.h"
+#include "warp-type-check.h"
 #include "warp-wasm.h"
 #include "warp.h"
 
@@ -165,6 +166,26 @@ wrp_err_t wrp_stk_exec_push_block(wrp_vm_t *vm,
     return WRP_SUCCESS;
 }
 
+//calls and loop back-edges are the only places a running call stops early,
+//nothing has changed yet so the instruction runs again when it's resumed
+static wrp_err_t checkpoint(wrp_vm_t *vm, size_t fuel_cost)
+{
+    if (atomic_load_explicit(&vm->suspend_requested, memory_order_relaxed)) {
+        atomic_store_explicit(&vm->suspend_requested, false, memory_order_relaxed);
+        return WRP_ERR_SUSPEND_REQUESTED;
+    }
+
+    if (vm->fuel_metered) {
+        if (vm->fuel < fuel_cost) {
+            return WRP_ERR_OUT_OF_FUEL;
+        }
+
+        vm->fuel -= fuel_cost;
+    }
+
+    return WRP_SUCCESS;
+}
+
 wrp_err_t wrp_stk_exec_pop_block(wrp_vm_t *vm, uint32_t depth, bool branch)
 {
     if (vm->ctrl_stk_head == -1) {
@@ -175,6 +196,22 @@ wrp_err_t wrp_stk_exec_pop_block(wrp_vm_t *vm, uint32_t depth, bool branch)
         return WRP_ERR_CALL_FRAME_BLOCK_UNDERFLOW;
     }
 
+    //a back-edge pays for the next iteration before anything is popped
+    if (branch && vm->ctrl_stk[vm->ctrl_stk_head - depth].type == BLOCK_LOOP) {
+        wrp_ctrl_frame_t *loop = &vm->ctrl_stk[vm->ctrl_stk_head - depth];
+
+        //no iteration is free, a cost of 0 is one not looked up yet since
+        //the loop was entered. The label follows the loop's signature.
+        if (vm->fuel_metered && loop->fuel_cost == 0) {
+            uint32_t func_idx = vm->call_stk[vm->call_stk_head].func_idx;
+            uint32_t block_idx = 0;
+            WRP_CHECK(wrp_get_block_idx(vm->mdle, func_idx, loop->label - 1, &block_idx));
+            loop->fuel_cost = vm->mdle->funcs[func_idx].block_costs[block_idx];
+        }
+
+        WRP_CHECK(checkpoint(vm, loop->fuel_cost));
+    }
+
     vm->ctrl_stk_head -= depth;
 
     //if at the outer most frame block (ie implicit func block), return call
@@ -210,14 +247,118 @@ wrp_err_t wrp_stk_exec_pop_block(wrp_vm_t *vm, uint32_t depth, bool branch)
     return WRP_SUCCESS;
 }
 
+//host functions run to completion without a frame, only the stack they
+//leave behind is checked
+static wrp_err_t call_host(wrp_vm_t *vm, wrp_host_func_t *host, wrp_type_t *type)
+{
+    if (call_frame_operand_count(vm) < type->num_params) {
+        return WRP_ERR_TYPE_MISMATCH;
+    }
+
+    for (uint32_t i = 0; i < type->num_params; i++) {
+        int32_t operand_idx = vm->oprd_stk_head - (type->num_params - 1) + i;
+
+        if (vm->oprd_stk[operand_idx].type != type->param_types[i]) {
+            return WRP_ERR_TYPE_MISMATCH;
+        }
+    }
+
+    int32_t results_head = vm->oprd_stk_head - (int32_t)type->num_params + (int32_t)type->num_results;
+    wrp_err_t err = host->fn(vm, host->ctx);
+
+    //a pending host function has only popped its params, the embedder pushes
+    //the results when it completes the call
+    if (err == WRP_ERR_HOST_PENDING) {
+        if (vm->oprd_stk_head != results_head - (int32_t)type->num_results) {
+            return WRP_ERR_TYPE_MISMATCH;
+        }
+
+        vm->pending_host_type = type;
+        return err;
+    }
+
+    //a yielding host function has finished, its results are checked as usual
+    if (err != WRP_SUCCESS && err != WRP_ERR_HOST_YIELD) {
+        return err;
+    }
+
+    if (vm->oprd_stk_head != results_head) {
+        return WRP_ERR_TYPE_MISMATCH;
+    }
+
+    for (uint32_t i = 0; i < type->num_results; i++) {
+        int32_t operand_idx = results_head - (type->num_results - 1) + i;
+
+        if (vm->oprd_stk[operand_idx].type != type->result_types[i]) {
+            return WRP_ERR_TYPE_MISMATCH;
+        }
+    }
+
+    return err;
+}
+
+void wrp_stk_exec_enter_instance(wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    vm->mdle = mdle;
+    vm->instance = instance;
+    vm->globals = instance->global_buf;
+    vm->global_imports = instance->global_imports;
+    vm->num_global_imports = mdle->num_global_imports;
+    vm->memory = NULL;
+
+    //resolved once here so memory ops don't have to follow the import
+    if (mdle->num_memories > 0) {
+        wrp_memory_t *memory = &instance->memories[0];
+        vm->memory = memory->imported ? memory->import : memory;
+    }
+}
+
 wrp_err_t wrp_stk_exec_push_call(wrp_vm_t *vm, uint32_t func_idx)
+{
+    //imported functions come first
+    if (func_idx < vm->mdle->num_func_imports) {
+        wrp_func_import_t *import = &vm->instance->func_imports[func_idx];
+
+        if (import->instance != NULL) {
+            wrp_func_t *func = &import->instance->mdle->funcs[import->func_idx];
+            return wrp_stk_exec_push_func(vm, import->instance, func, import->func_idx);
+        }
+    }
+
+    return wrp_stk_exec_push_func(vm, vm->instance, &vm->mdle->funcs[func_idx], func_idx);
+}
+
+wrp_err_t wrp_stk_exec_push_func(wrp_vm_t *vm,
+    wrp_instance_t *instance,
+    wrp_func_t *func,
+    uint32_t func_idx)
 {
     if (vm->call_stk_head >= WRP_CALL_STK_SZ) {
         return WRP_ERR_CALL_STK_OVERFLOW;
     }
 
-    wrp_func_t *func = &vm->mdle->funcs[func_idx];
-    wrp_type_t *type = &vm->mdle->types[func->type_idx];
+    //imports bound to another instance were followed by the caller, the rest
+    //are host functions
+    if (func_idx < instance->mdle->num_func_imports) {
+        wrp_type_t *type = &instance->mdle->types[func->type_idx];
+        return call_host(vm, &instance->func_imports[func_idx].host, type);
+    }
+
+    //checked before the callee's instance is entered, like everything else
+    //that can fail
+    if (vm->ctrl_stk_head >= WRP_BLOCK_STK_SZ) {
+        return WRP_ERR_BLOCK_STK_OVERFLOW;
+    }
+
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+    wrp_type_t *type = &mdle->types[func->type_idx];
+
+    //a lazily validated function traps with its validation error
+    if (!atomic_load_explicit(&func->validated, memory_order_acquire)) {
+        WRP_CHECK(wrp_type_check_func(vm, mdle, func_idx));
+    }
 
     if (call_frame_operand_count(vm) < type->num_params) {
         return WRP_ERR_TYPE_MISMATCH;
@@ -233,13 +374,22 @@ wrp_err_t wrp_stk_exec_push_call(wrp_vm_t *vm, uint32_t func_idx)
         }
     }
 
+    //a call stopped here runs again from the caller's instance
+    WRP_CHECK(checkpoint(vm, func->fuel_cost));
+
     //push locals
     for (uint32_t i = 0; i < func->num_locals; i++) {
         WRP_CHECK(wrp_stk_exec_push_op(vm, 0, func->local_types[i]));
     }
 
+    //the frame records the instance so returning enters the caller again
+    if (instance != vm->instance) {
+        wrp_stk_exec_enter_instance(vm, instance);
+    }
+
     //push frame
     vm->call_stk_head++;
+    vm->call_stk[vm->call_stk_head].instance = vm->instance;
     vm->call_stk[vm->call_stk_head].func_idx = func_idx;
     vm->call_stk[vm->call_stk_head].oprd_stk_ptr = vm->oprd_stk_head;
     vm->call_stk[vm->call_stk_head].ctrl_stk_ptr = vm->ctrl_stk_head;
@@ -285,7 +435,13 @@ wrp_err_t wrp_stk_exec_pop_call(wrp_vm_t *vm)
 
     //set opcode stream
     if (vm->call_stk_head > 0) {
-        uint32_t return_func_idx = vm->call_stk[vm->call_stk_head - 1].func_idx;
+        wrp_call_frame_t *caller = &vm->call_stk[vm->call_stk_head - 1];
+
+        if (caller->instance != vm->instance) {
+            wrp_stk_exec_enter_instance(vm, caller->instance);
+        }
+
+        uint32_t return_func_idx = caller->func_idx;
         vm->opcode_stream.bytes = vm->mdle->funcs[return_func_idx].code;
         vm->opcode_stream.sz = vm->mdle->funcs[return_func_idx].code_sz;
         vm->opcode_stream.pos = vm->call_stk[vm->call_stk_head].return_ptr;
@@ -433,6 +589,7 @@ wrp_err_t wrp_stk_check_push_block(wrp_vm_t *vm,
     vm->ctrl_stk[vm->ctrl_stk_head].signature = signature;
     vm->ctrl_stk[vm->ctrl_stk_head].oprd_stk_ptr = vm->oprd_stk_head;
     vm->ctrl_stk[vm->ctrl_stk_head].unreachable = false;
+    vm->ctrl_stk[vm->ctrl_stk_head].fuel_cost = 0;
     return WRP_SUCCESS;
 }
 
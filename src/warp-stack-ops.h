@@ -49,8 +49,19 @@ wrp_err_t wrp_stk_exec_push_block(wrp_vm_t *vm,
 
 wrp_err_t wrp_stk_exec_pop_block(wrp_vm_t *vm, uint32_t depth, bool branch);
 
+//makes instance the one vm runs in, without checking it is initialized
+void wrp_stk_exec_enter_instance(wrp_vm_t *vm, wrp_instance_t *instance);
+
+//calls to imported functions go to the host or enter the exporting instance
 wrp_err_t wrp_stk_exec_push_call(wrp_vm_t *vm, uint32_t func_idx);
 
+//calls func_idx of instance, func being its entry in instance's module,
+//without resolving imports again
+wrp_err_t wrp_stk_exec_push_func(wrp_vm_t *vm,
+    wrp_instance_t *instance,
+    wrp_func_t *func,
+    uint32_t func_idx);
+
 wrp_err_t wrp_stk_exec_pop_call(wrp_vm_t *vm);
 
 wrp_err_t wrp_stk_exec_call_frame_tail(wrp_vm_t *vm, int32_t *out_tail);
@@ -0,0 +1,98 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "warp-encode.h"
+#include "warp-error.h"
+#include "warp-execution.h"
+#include "warp-macros.h"
+#include "warp-table.h"
+#include "warp-wasm.h"
+#include "warp.h"
+
+static wrp_err_t eval_segment_offset(wrp_vm_t *vm,
+    wrp_elem_segment_t *segment,
+    uint32_t num_elem,
+    uint32_t *out_offset)
+{
+    uint64_t offset_value = 0;
+    WRP_CHECK(wrp_exec_init_expr(vm, &segment->offset_expr, &offset_value));
+
+    uint32_t offset = (uint32_t)wrp_decode_i32(offset_value);
+
+    if (offset > num_elem || segment->num_elem > num_elem - offset) {
+        return WRP_ERR_INVALID_ELEMENT_IDX;
+    }
+
+    *out_offset = offset;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_table_init(wrp_vm_t *vm, wrp_instance_t *instance, uint32_t table_idx)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+    wrp_table_t *table = &instance->tables[table_idx];
+
+    //all segments are checked before any are written
+    for (uint32_t i = 0; i < mdle->num_elem_segments; i++) {
+        wrp_elem_segment_t *segment = &mdle->elem_segments[i];
+
+        if (segment->table_idx == table_idx) {
+            uint32_t offset = 0;
+            WRP_CHECK(eval_segment_offset(vm, segment, table->num_elem, &offset));
+        }
+    }
+
+    memset(table->elem, 0, table->num_elem * sizeof(wrp_table_entry_t));
+
+    for (uint32_t i = 0; i < mdle->num_elem_segments; i++) {
+        wrp_elem_segment_t *segment = &mdle->elem_segments[i];
+
+        if (segment->table_idx != table_idx) {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        WRP_CHECK(eval_segment_offset(vm, segment, table->num_elem, &offset));
+
+        wrp_table_entry_t *entry = &table->elem[offset];
+
+        //func indices were bounds checked by the loader
+        for (uint32_t j = 0; j < segment->num_elem; j++, entry++) {
+            uint32_t func_idx = segment->elem[j];
+            wrp_func_t *func = &mdle->funcs[func_idx];
+
+            //sig ids are per module, so the import's declared type is used
+            entry->sig_id = mdle->types[func->type_idx].sig_id;
+            entry->func = func;
+            entry->instance = instance;
+            entry->func_idx = func_idx;
+
+            //imports were resolved before the tables, host imports stay
+            //with this instance
+            if (func_idx < mdle->num_func_imports && instance->func_imports[func_idx].instance != NULL) {
+                wrp_func_import_t *import = &instance->func_imports[func_idx];
+                entry->func = &import->instance->mdle->funcs[import->func_idx];
+                entry->instance = import->instance;
+                entry->func_idx = import->func_idx;
+            }
+        }
+    }
+
+    return WRP_SUCCESS;
+}
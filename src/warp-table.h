@@ -16,9 +16,8 @@
 
 #pragma once
 
-#include <stddef.h>
 #include <stdint.h>
 
 #include "warp-types.h"
 
-wrp_err_t wrp_scan_mdle(wrp_buf_t *buf, wrp_wasm_meta_t *out_meta);
+wrp_err_t wrp_table_init(wrp_vm_t *vm, wrp_instance_t *instance, uint32_t table_idx);
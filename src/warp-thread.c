@@ -0,0 +1,184 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+
+#include "warp-config.h"
+
+#if WRP_THREADS
+#include <pthread.h>
+#endif
+
+#include "warp-thread.h"
+
+#if WRP_THREADS
+typedef struct wrp_thread_task {
+    wrp_task_fn_t task;
+    void *arg;
+} wrp_thread_task_t;
+
+static void *thread_main(void *arg)
+{
+    wrp_thread_task_t *thread_task = arg;
+    thread_task->task(thread_task->arg);
+    return NULL;
+}
+#endif
+
+void wrp_run_workers(const wrp_thread_pool_t *pool, uint32_t num_workers, wrp_task_fn_t task, void *arg)
+{
+    if (pool != NULL && pool->run_workers != NULL) {
+        pool->run_workers(pool->pool, num_workers, task, arg);
+        return;
+    }
+
+    uint32_t num_threads = 0;
+
+#if WRP_THREADS
+    pthread_t threads[WRP_MAX_WORKERS];
+    wrp_thread_task_t thread_task = {.task = task, .arg = arg};
+
+    //the calling thread is the first worker
+    while (num_threads + 1 < num_workers && num_threads < WRP_MAX_WORKERS) {
+        if (pthread_create(&threads[num_threads], NULL, thread_main, &thread_task) != 0) {
+            break;
+        }
+
+        num_threads++;
+    }
+#endif
+
+    //workers that could not get a thread run here once the others are started
+    for (uint32_t i = num_threads; i < num_workers; i++) {
+        task(arg);
+    }
+
+#if WRP_THREADS
+    for (uint32_t i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+#endif
+}
+
+#if WRP_THREADS
+//each run is counted so a thread that wakes without a new one sleeps again,
+//threads start before the first run so none of them can miss it
+static void *group_main(void *arg)
+{
+    wrp_worker_group_t *group = arg;
+    uint64_t seen = 0;
+
+    pthread_mutex_lock(&group->lock);
+
+    while (true) {
+        while (group->run == seen && !group->stopping) {
+            pthread_cond_wait(&group->wake, &group->lock);
+        }
+
+        if (group->stopping) {
+            break;
+        }
+
+        seen = group->run;
+        wrp_task_fn_t task = group->task;
+        void *task_arg = group->arg;
+        pthread_mutex_unlock(&group->lock);
+
+        task(task_arg);
+
+        pthread_mutex_lock(&group->lock);
+
+        if (--group->num_running == 0) {
+            pthread_cond_signal(&group->done);
+        }
+    }
+
+    pthread_mutex_unlock(&group->lock);
+    return NULL;
+}
+#endif
+
+void wrp_start_workers(wrp_worker_group_t *group, uint32_t num_workers)
+{
+    memset(group, 0, sizeof(wrp_worker_group_t));
+    group->num_workers = num_workers;
+
+#if WRP_THREADS
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->wake, NULL);
+    pthread_cond_init(&group->done, NULL);
+
+    while (group->num_threads + 1 < num_workers && group->num_threads < WRP_MAX_WORKERS) {
+        if (pthread_create(&group->threads[group->num_threads], NULL, group_main, group) != 0) {
+            break;
+        }
+
+        group->num_threads++;
+    }
+#endif
+}
+
+void wrp_wake_workers(wrp_worker_group_t *group, wrp_task_fn_t task, void *arg)
+{
+#if WRP_THREADS
+    if (group->num_threads > 0) {
+        pthread_mutex_lock(&group->lock);
+        group->task = task;
+        group->arg = arg;
+        group->num_running = group->num_threads;
+        group->run++;
+        pthread_cond_broadcast(&group->wake);
+        pthread_mutex_unlock(&group->lock);
+    }
+#endif
+
+    //workers that could not get a thread run here
+    for (uint32_t i = group->num_threads; i < group->num_workers; i++) {
+        task(arg);
+    }
+
+#if WRP_THREADS
+    if (group->num_threads > 0) {
+        pthread_mutex_lock(&group->lock);
+
+        while (group->num_running > 0) {
+            pthread_cond_wait(&group->done, &group->lock);
+        }
+
+        pthread_mutex_unlock(&group->lock);
+    }
+#endif
+}
+
+void wrp_stop_workers(wrp_worker_group_t *group)
+{
+#if WRP_THREADS
+    pthread_mutex_lock(&group->lock);
+    group->stopping = true;
+    pthread_cond_broadcast(&group->wake);
+    pthread_mutex_unlock(&group->lock);
+
+    for (uint32_t i = 0; i < group->num_threads; i++) {
+        pthread_join(group->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&group->done);
+    pthread_cond_destroy(&group->wake);
+    pthread_mutex_destroy(&group->lock);
+#endif
+
+    group->num_threads = 0;
+}
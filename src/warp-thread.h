@@ -0,0 +1,71 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "warp-config.h"
+
+#if WRP_THREADS
+#include <pthread.h>
+#endif
+
+typedef void (*wrp_task_fn_t)(void *arg);
+
+//runs task(arg) once on each of num_workers threads and returns once every
+//call has finished, a host job system can stand in for this
+typedef void (*wrp_run_workers_fn_t)(void *pool, uint32_t num_workers, wrp_task_fn_t task, void *arg);
+
+typedef struct wrp_thread_pool {
+    wrp_run_workers_fn_t run_workers;
+    void *pool;
+    uint32_t num_workers;
+} wrp_thread_pool_t;
+
+//runs the task on the pool, or on new threads when the pool has no
+//run_workers. Without thread support the calls run one after another.
+void wrp_run_workers(const wrp_thread_pool_t *pool, uint32_t num_workers, wrp_task_fn_t task, void *arg);
+
+//threads started once that sleep between runs, for callers that run tasks
+//often enough that starting threads each time would show
+typedef struct wrp_worker_group {
+#if WRP_THREADS
+    pthread_t threads[WRP_MAX_WORKERS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+#endif
+    wrp_task_fn_t task;
+    void *arg;
+    uint64_t run;
+    uint32_t num_workers;
+    uint32_t num_threads;
+    uint32_t num_running;
+    bool stopping;
+} wrp_worker_group_t;
+
+//starts up to num_workers - 1 threads, the caller of wrp_wake_workers is the
+//first worker. Without thread support none are started.
+void wrp_start_workers(wrp_worker_group_t *group, uint32_t num_workers);
+
+//runs task(arg) once on each worker and returns once every call has
+//finished, workers without a thread run on the calling thread
+void wrp_wake_workers(wrp_worker_group_t *group, wrp_task_fn_t task, void *arg);
+
+//wakes the threads to exit and joins them
+void wrp_stop_workers(wrp_worker_group_t *group);
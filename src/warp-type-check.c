@@ -15,8 +15,15 @@
  */
 
 #include <stdalign.h>
+#include <stdatomic.h>
 #include <stddef.h>
 
+#include "warp-config.h"
+
+#if WRP_THREADS
+#include <sched.h>
+#endif
+
 #include "warp-buf.h"
 #include "warp-error.h"
 #include "warp-expr.h"
@@ -61,6 +68,11 @@ static wrp_err_t check_block(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
 static wrp_err_t check_loop(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
 {
     size_t address = vm->opcode_stream.pos - 1;
+    uint32_t func_idx = vm->call_stk[vm->call_stk_head].func_idx;
+    wrp_func_t *func = &vm->mdle->funcs[func_idx];
+
+    func->block_addrs[func->num_blocks] = address;
+    func->num_blocks++;
 
     int8_t signature = 0;
     WRP_CHECK(wrp_read_vari7(&vm->opcode_stream, &signature));
@@ -75,6 +87,7 @@ static wrp_err_t check_if(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
     wrp_func_t *func = &vm->mdle->funcs[func_idx];
 
     func->if_addrs[func->num_ifs] = address;
+    func->else_addrs[func->num_ifs] = 0;
     func->num_ifs++;
 
     int8_t signature = 0;
@@ -103,7 +116,7 @@ static wrp_err_t check_else(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
     //validate the if portion of the if / else
     WRP_CHECK(wrp_stk_check_block_sig(vm, 0, false, false));
 
-    //reset for the else block
+    //reset for the else block, both arms count towards the if's cost
     vm->oprd_stk_head = vm->ctrl_stk[vm->ctrl_stk_head].oprd_stk_ptr;
     vm->ctrl_stk[vm->ctrl_stk_head].unreachable = false;
 
@@ -115,11 +128,21 @@ static wrp_err_t check_end(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
     uint32_t func_idx = vm->call_stk[vm->call_stk_head].func_idx;
     wrp_func_t *func = &vm->mdle->funcs[func_idx];
 
+    //a block's cost is every instruction inside it, nested blocks included,
+    //and counts towards the block around it
+    size_t fuel_cost = vm->ctrl_stk[vm->ctrl_stk_head].fuel_cost;
+
     if (vm->ctrl_stk[vm->ctrl_stk_head].type == BLOCK_FUNC) {
         WRP_CHECK(wrp_stk_check_func_sig(vm));
+        func->fuel_cost = fuel_cost;
         return WRP_SUCCESS;
     }
 
+    //an init expression's block has nothing around it
+    if (vm->ctrl_stk_head > 0) {
+        vm->ctrl_stk[vm->ctrl_stk_head - 1].fuel_cost += fuel_cost;
+    }
+
     if (vm->ctrl_stk[vm->ctrl_stk_head].type == BLOCK) {
         uint32_t func_idx = vm->call_stk[vm->call_stk_head].func_idx;
         size_t block_address = vm->ctrl_stk[vm->ctrl_stk_head].address;
@@ -129,6 +152,18 @@ static wrp_err_t check_end(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
         func->block_labels[block_idx] = vm->opcode_stream.pos - 1;
     }
 
+    //the first iteration is paid with the block around the loop, every
+    //back-edge pays for the next one
+    if (vm->ctrl_stk[vm->ctrl_stk_head].type == BLOCK_LOOP) {
+        uint32_t func_idx = vm->call_stk[vm->call_stk_head].func_idx;
+        size_t loop_address = vm->ctrl_stk[vm->ctrl_stk_head].address;
+        uint32_t block_idx = 0;
+        WRP_CHECK(wrp_get_block_idx(out_mdle, func_idx, loop_address, &block_idx));
+
+        func->block_labels[block_idx] = vm->opcode_stream.pos - 1;
+        func->block_costs[block_idx] = fuel_cost;
+    }
+
     if (vm->ctrl_stk[vm->ctrl_stk_head].type == BLOCK_IF) {
         uint32_t func_idx = vm->call_stk[vm->call_stk_head].func_idx;
         size_t if_address = vm->ctrl_stk[vm->ctrl_stk_head].address;
@@ -176,15 +211,13 @@ static wrp_err_t check_br_table(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
     uint32_t target_count = 0;
     WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &target_count));
 
-    //TODO handle any table size
-    if (target_count > MAX_BRANCH_TABLE_SIZE) {
-        return WRP_ERR_MDLE_BRANCH_TABLE_OVERFLOW;
-    }
-
-    uint32_t branch_table[MAX_BRANCH_TABLE_SIZE] = {0};
+    //targets are compared with the default that follows them, skip to it
+    //and read them again rather than buffering a table of any size
+    size_t targets_pos = vm->opcode_stream.pos;
+    uint32_t target = 0;
 
     for (uint32_t i = 0; i < target_count; i++) {
-        WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &branch_table[i]));
+        WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &target));
     }
 
     uint32_t default_target = 0;
@@ -194,16 +227,23 @@ static wrp_err_t check_br_table(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
         return WRP_ERR_INVALID_BRANCH_TABLE;
     }
 
+    size_t end_pos = vm->opcode_stream.pos;
+    WRP_CHECK(wrp_seek(&vm->opcode_stream, targets_pos));
+
     for (uint32_t i = 0; i < target_count; i++) {
-        if ((int32_t)branch_table[i] > vm->ctrl_stk_head) {
+        WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &target));
+
+        if ((int32_t)target > vm->ctrl_stk_head) {
             return WRP_ERR_INVALID_BRANCH_TABLE;
         }
 
-        if (vm->ctrl_stk[branch_table[i]].signature != vm->ctrl_stk[default_target].signature) {
+        if (vm->ctrl_stk[target].signature != vm->ctrl_stk[default_target].signature) {
             return WRP_ERR_INVALID_BRANCH_TABLE;
         }
     }
 
+    WRP_CHECK(wrp_seek(&vm->opcode_stream, end_pos));
+
     WRP_CHECK(wrp_stk_check_block_sig(vm, default_target, true, false));
     WRP_CHECK(wrp_stk_check_unreachable(vm));
     return WRP_SUCCESS;
@@ -262,6 +302,13 @@ static wrp_err_t check_call_indirect(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
         return WRP_ERR_INVALID_RESERVED;
     }
 
+    if (out_mdle->num_tables == 0) {
+        return WRP_ERR_INVALID_TABLE_IDX;
+    }
+
+    int8_t elem_idx_type = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, I32, &elem_idx_type));
+
     uint32_t num_params = vm->mdle->types[type_idx].num_params;
 
     //check and pop params in reverse order
@@ -397,12 +444,33 @@ static wrp_err_t check_set_global(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
         return WRP_ERR_INVALID_GLOBAL_IDX;
     }
 
+    if (out_mdle->globals[global_idx].mutability != GLOBAL_MUTABLE) {
+        return WRP_ERR_INVALID_MUTIBILITY;
+    }
+
     int8_t global_type = out_mdle->globals[global_idx].type;
     int8_t actual_type = 0;
     WRP_CHECK(wrp_stk_check_pop_op(vm, global_type, &actual_type));
     return WRP_SUCCESS;
 }
 
+static int8_t address_type(wrp_wasm_mdle_t *out_mdle)
+{
+    return out_mdle->memories[0].memory64 ? I64 : I32;
+}
+
+static wrp_err_t check_offset(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    //memory64 offsets may use all 64 bits
+    if (out_mdle->memories[0].memory64) {
+        uint64_t offset = 0;
+        return wrp_read_varui64(&vm->opcode_stream, &offset);
+    }
+
+    uint32_t offset = 0;
+    return wrp_read_varui32(&vm->opcode_stream, &offset);
+}
+
 static wrp_err_t check_load(wrp_vm_t *vm,
     wrp_wasm_mdle_t *out_mdle,
     uint32_t natural_alignment,
@@ -421,11 +489,10 @@ static wrp_err_t check_load(wrp_vm_t *vm,
         return WRP_ERR_INVALID_ALIGNMENT;
     }
 
-    uint32_t offset = 0;
-    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &offset));
+    WRP_CHECK(check_offset(vm, out_mdle));
 
     int8_t address = 0;
-    WRP_CHECK(wrp_stk_check_pop_op(vm, I32, &address));
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
     WRP_CHECK(wrp_stk_check_push_op(vm, type));
     return WRP_SUCCESS;
 }
@@ -493,14 +560,13 @@ static wrp_err_t check_store(wrp_vm_t *vm,
         return WRP_ERR_INVALID_ALIGNMENT;
     }
 
-    uint32_t offset = 0;
-    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &offset));
+    WRP_CHECK(check_offset(vm, out_mdle));
 
     int8_t value_type = 0;
     WRP_CHECK(wrp_stk_check_pop_op(vm, type, &value_type));
 
     int8_t address = 0;
-    WRP_CHECK(wrp_stk_check_pop_op(vm, I32, &address));
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
 
     return WRP_SUCCESS;
 }
@@ -563,7 +629,7 @@ static wrp_err_t check_current_memory(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
         return WRP_ERR_INVALID_RESERVED;
     }
 
-    WRP_CHECK(wrp_stk_check_push_op(vm, I32));
+    WRP_CHECK(wrp_stk_check_push_op(vm, address_type(out_mdle)));
     return WRP_SUCCESS;
 }
 
@@ -581,9 +647,9 @@ static wrp_err_t check_grow_memory(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
     }
 
     int8_t delta = 0;
-    WRP_CHECK(wrp_stk_check_pop_op(vm, I32, &delta));
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &delta));
 
-    WRP_CHECK(wrp_stk_check_push_op(vm, I32));
+    WRP_CHECK(wrp_stk_check_push_op(vm, address_type(out_mdle)));
     return WRP_SUCCESS;
 }
 
@@ -890,6 +956,281 @@ static wrp_err_t check_reinterpret_f64_i64(wrp_vm_t *vm, wrp_wasm_mdle_t *out_md
     return WRP_SUCCESS;
 }
 
+static wrp_err_t check_atomic_memarg(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle, uint32_t natural_alignment)
+{
+    if (out_mdle->num_memories == 0) {
+        return WRP_ERR_INVALID_MEM_IDX;
+    }
+
+    uint32_t flags = 0;
+    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &flags));
+
+    //atomic accesses must state exactly their natural alignment
+    if (flags > 3 || (1U << flags) != natural_alignment) {
+        return WRP_ERR_INVALID_ALIGNMENT;
+    }
+
+    WRP_CHECK(check_offset(vm, out_mdle));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_load(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *out_mdle,
+    uint32_t natural_alignment,
+    int8_t type)
+{
+    WRP_CHECK(check_atomic_memarg(vm, out_mdle, natural_alignment));
+
+    int8_t address = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
+    WRP_CHECK(wrp_stk_check_push_op(vm, type));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_store(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *out_mdle,
+    uint32_t natural_alignment,
+    int8_t type)
+{
+    WRP_CHECK(check_atomic_memarg(vm, out_mdle, natural_alignment));
+
+    int8_t value_type = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, type, &value_type));
+
+    int8_t address = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_rmw(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *out_mdle,
+    uint32_t natural_alignment,
+    int8_t type)
+{
+    WRP_CHECK(check_atomic_memarg(vm, out_mdle, natural_alignment));
+
+    int8_t value_type = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, type, &value_type));
+
+    int8_t address = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
+    WRP_CHECK(wrp_stk_check_push_op(vm, type));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_cmpxchg(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *out_mdle,
+    uint32_t natural_alignment,
+    int8_t type)
+{
+    WRP_CHECK(check_atomic_memarg(vm, out_mdle, natural_alignment));
+
+    int8_t replacement_type = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, type, &replacement_type));
+
+    int8_t expected_type = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, type, &expected_type));
+
+    int8_t address = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
+    WRP_CHECK(wrp_stk_check_push_op(vm, type));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_notify(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    WRP_CHECK(check_atomic_memarg(vm, out_mdle, alignof(int32_t)));
+
+    int8_t count = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, I32, &count));
+
+    int8_t address = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
+    WRP_CHECK(wrp_stk_check_push_op(vm, I32));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_wait(wrp_vm_t *vm,
+    wrp_wasm_mdle_t *out_mdle,
+    uint32_t natural_alignment,
+    int8_t type)
+{
+    WRP_CHECK(check_atomic_memarg(vm, out_mdle, natural_alignment));
+
+    int8_t timeout = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, I64, &timeout));
+
+    int8_t expected = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, type, &expected));
+
+    int8_t address = 0;
+    WRP_CHECK(wrp_stk_check_pop_op(vm, address_type(out_mdle), &address));
+    WRP_CHECK(wrp_stk_check_push_op(vm, I32));
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_wait_i32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_wait(vm, out_mdle, sizeof(int32_t), I32);
+}
+
+static wrp_err_t check_atomic_wait_i64(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_wait(vm, out_mdle, sizeof(int64_t), I64);
+}
+
+static wrp_err_t check_atomic_fence(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    uint8_t reserved = 0;
+    WRP_CHECK(wrp_read_uint8(&vm->opcode_stream, &reserved));
+
+    if (reserved != 0) {
+        return WRP_ERR_INVALID_RESERVED;
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_atomic_load_i32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_load(vm, out_mdle, sizeof(int32_t), I32);
+}
+
+static wrp_err_t check_atomic_load_i64(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_load(vm, out_mdle, sizeof(int64_t), I64);
+}
+
+static wrp_err_t check_atomic_load_i32_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_load(vm, out_mdle, sizeof(int8_t), I32);
+}
+
+static wrp_err_t check_atomic_load_i32_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_load(vm, out_mdle, sizeof(int16_t), I32);
+}
+
+static wrp_err_t check_atomic_load_i64_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_load(vm, out_mdle, sizeof(int8_t), I64);
+}
+
+static wrp_err_t check_atomic_load_i64_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_load(vm, out_mdle, sizeof(int16_t), I64);
+}
+
+static wrp_err_t check_atomic_load_i64_32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_load(vm, out_mdle, sizeof(int32_t), I64);
+}
+
+static wrp_err_t check_atomic_store_i32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_store(vm, out_mdle, sizeof(int32_t), I32);
+}
+
+static wrp_err_t check_atomic_store_i64(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_store(vm, out_mdle, sizeof(int64_t), I64);
+}
+
+static wrp_err_t check_atomic_store_i32_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_store(vm, out_mdle, sizeof(int8_t), I32);
+}
+
+static wrp_err_t check_atomic_store_i32_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_store(vm, out_mdle, sizeof(int16_t), I32);
+}
+
+static wrp_err_t check_atomic_store_i64_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_store(vm, out_mdle, sizeof(int8_t), I64);
+}
+
+static wrp_err_t check_atomic_store_i64_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_store(vm, out_mdle, sizeof(int16_t), I64);
+}
+
+static wrp_err_t check_atomic_store_i64_32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_store(vm, out_mdle, sizeof(int32_t), I64);
+}
+
+static wrp_err_t check_atomic_rmw_i32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_rmw(vm, out_mdle, sizeof(int32_t), I32);
+}
+
+static wrp_err_t check_atomic_rmw_i64(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_rmw(vm, out_mdle, sizeof(int64_t), I64);
+}
+
+static wrp_err_t check_atomic_rmw_i32_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_rmw(vm, out_mdle, sizeof(int8_t), I32);
+}
+
+static wrp_err_t check_atomic_rmw_i32_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_rmw(vm, out_mdle, sizeof(int16_t), I32);
+}
+
+static wrp_err_t check_atomic_rmw_i64_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_rmw(vm, out_mdle, sizeof(int8_t), I64);
+}
+
+static wrp_err_t check_atomic_rmw_i64_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_rmw(vm, out_mdle, sizeof(int16_t), I64);
+}
+
+static wrp_err_t check_atomic_rmw_i64_32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_rmw(vm, out_mdle, sizeof(int32_t), I64);
+}
+
+static wrp_err_t check_atomic_cmpxchg_i32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_cmpxchg(vm, out_mdle, sizeof(int32_t), I32);
+}
+
+static wrp_err_t check_atomic_cmpxchg_i64(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_cmpxchg(vm, out_mdle, sizeof(int64_t), I64);
+}
+
+static wrp_err_t check_atomic_cmpxchg_i32_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_cmpxchg(vm, out_mdle, sizeof(int8_t), I32);
+}
+
+static wrp_err_t check_atomic_cmpxchg_i32_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_cmpxchg(vm, out_mdle, sizeof(int16_t), I32);
+}
+
+static wrp_err_t check_atomic_cmpxchg_i64_8(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_cmpxchg(vm, out_mdle, sizeof(int8_t), I64);
+}
+
+static wrp_err_t check_atomic_cmpxchg_i64_16(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_cmpxchg(vm, out_mdle, sizeof(int16_t), I64);
+}
+
+static wrp_err_t check_atomic_cmpxchg_i64_32(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+{
+    return check_atomic_cmpxchg(vm, out_mdle, sizeof(int32_t), I64);
+}
+
 static wrp_err_t (*const check_jump_table[])(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle) = {
     [OP_UNREACHABLE] = check_unreachable,
     [OP_NOOP] = check_noop,
@@ -1086,49 +1427,294 @@ static wrp_err_t (*const check_jump_table[])(wrp_vm_t *vm, wrp_wasm_mdle_t *out_
     //clang-format brace hack
 };
 
-static wrp_err_t wrp_type_check_funcs(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
+static wrp_err_t (*const check_atomic_jump_table[])(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle) = {
+    [OP_ATOMIC_NOTIFY] = check_atomic_notify,
+    [OP_I32_ATOMIC_WAIT] = check_atomic_wait_i32,
+    [OP_I64_ATOMIC_WAIT] = check_atomic_wait_i64,
+    [OP_ATOMIC_FENCE] = check_atomic_fence,
+    [0x04] = check_invalid_op,
+    [0x05] = check_invalid_op,
+    [0x06] = check_invalid_op,
+    [0x07] = check_invalid_op,
+    [0x08] = check_invalid_op,
+    [0x09] = check_invalid_op,
+    [0x0A] = check_invalid_op,
+    [0x0B] = check_invalid_op,
+    [0x0C] = check_invalid_op,
+    [0x0D] = check_invalid_op,
+    [0x0E] = check_invalid_op,
+    [0x0F] = check_invalid_op,
+    [OP_I32_ATOMIC_LOAD] = check_atomic_load_i32,
+    [OP_I64_ATOMIC_LOAD] = check_atomic_load_i64,
+    [OP_I32_ATOMIC_LOAD_8_U] = check_atomic_load_i32_8,
+    [OP_I32_ATOMIC_LOAD_16_U] = check_atomic_load_i32_16,
+    [OP_I64_ATOMIC_LOAD_8_U] = check_atomic_load_i64_8,
+    [OP_I64_ATOMIC_LOAD_16_U] = check_atomic_load_i64_16,
+    [OP_I64_ATOMIC_LOAD_32_U] = check_atomic_load_i64_32,
+    [OP_I32_ATOMIC_STORE] = check_atomic_store_i32,
+    [OP_I64_ATOMIC_STORE] = check_atomic_store_i64,
+    [OP_I32_ATOMIC_STORE_8] = check_atomic_store_i32_8,
+    [OP_I32_ATOMIC_STORE_16] = check_atomic_store_i32_16,
+    [OP_I64_ATOMIC_STORE_8] = check_atomic_store_i64_8,
+    [OP_I64_ATOMIC_STORE_16] = check_atomic_store_i64_16,
+    [OP_I64_ATOMIC_STORE_32] = check_atomic_store_i64_32,
+    [OP_I32_ATOMIC_RMW_ADD] = check_atomic_rmw_i32,
+    [OP_I64_ATOMIC_RMW_ADD] = check_atomic_rmw_i64,
+    [OP_I32_ATOMIC_RMW_8_ADD_U] = check_atomic_rmw_i32_8,
+    [OP_I32_ATOMIC_RMW_16_ADD_U] = check_atomic_rmw_i32_16,
+    [OP_I64_ATOMIC_RMW_8_ADD_U] = check_atomic_rmw_i64_8,
+    [OP_I64_ATOMIC_RMW_16_ADD_U] = check_atomic_rmw_i64_16,
+    [OP_I64_ATOMIC_RMW_32_ADD_U] = check_atomic_rmw_i64_32,
+    [OP_I32_ATOMIC_RMW_SUB] = check_atomic_rmw_i32,
+    [OP_I64_ATOMIC_RMW_SUB] = check_atomic_rmw_i64,
+    [OP_I32_ATOMIC_RMW_8_SUB_U] = check_atomic_rmw_i32_8,
+    [OP_I32_ATOMIC_RMW_16_SUB_U] = check_atomic_rmw_i32_16,
+    [OP_I64_ATOMIC_RMW_8_SUB_U] = check_atomic_rmw_i64_8,
+    [OP_I64_ATOMIC_RMW_16_SUB_U] = check_atomic_rmw_i64_16,
+    [OP_I64_ATOMIC_RMW_32_SUB_U] = check_atomic_rmw_i64_32,
+    [OP_I32_ATOMIC_RMW_AND] = check_atomic_rmw_i32,
+    [OP_I64_ATOMIC_RMW_AND] = check_atomic_rmw_i64,
+    [OP_I32_ATOMIC_RMW_8_AND_U] = check_atomic_rmw_i32_8,
+    [OP_I32_ATOMIC_RMW_16_AND_U] = check_atomic_rmw_i32_16,
+    [OP_I64_ATOMIC_RMW_8_AND_U] = check_atomic_rmw_i64_8,
+    [OP_I64_ATOMIC_RMW_16_AND_U] = check_atomic_rmw_i64_16,
+    [OP_I64_ATOMIC_RMW_32_AND_U] = check_atomic_rmw_i64_32,
+    [OP_I32_ATOMIC_RMW_OR] = check_atomic_rmw_i32,
+    [OP_I64_ATOMIC_RMW_OR] = check_atomic_rmw_i64,
+    [OP_I32_ATOMIC_RMW_8_OR_U] = check_atomic_rmw_i32_8,
+    [OP_I32_ATOMIC_RMW_16_OR_U] = check_atomic_rmw_i32_16,
+    [OP_I64_ATOMIC_RMW_8_OR_U] = check_atomic_rmw_i64_8,
+    [OP_I64_ATOMIC_RMW_16_OR_U] = check_atomic_rmw_i64_16,
+    [OP_I64_ATOMIC_RMW_32_OR_U] = check_atomic_rmw_i64_32,
+    [OP_I32_ATOMIC_RMW_XOR] = check_atomic_rmw_i32,
+    [OP_I64_ATOMIC_RMW_XOR] = check_atomic_rmw_i64,
+    [OP_I32_ATOMIC_RMW_8_XOR_U] = check_atomic_rmw_i32_8,
+    [OP_I32_ATOMIC_RMW_16_XOR_U] = check_atomic_rmw_i32_16,
+    [OP_I64_ATOMIC_RMW_8_XOR_U] = check_atomic_rmw_i64_8,
+    [OP_I64_ATOMIC_RMW_16_XOR_U] = check_atomic_rmw_i64_16,
+    [OP_I64_ATOMIC_RMW_32_XOR_U] = check_atomic_rmw_i64_32,
+    [OP_I32_ATOMIC_RMW_XCHG] = check_atomic_rmw_i32,
+    [OP_I64_ATOMIC_RMW_XCHG] = check_atomic_rmw_i64,
+    [OP_I32_ATOMIC_RMW_8_XCHG_U] = check_atomic_rmw_i32_8,
+    [OP_I32_ATOMIC_RMW_16_XCHG_U] = check_atomic_rmw_i32_16,
+    [OP_I64_ATOMIC_RMW_8_XCHG_U] = check_atomic_rmw_i64_8,
+    [OP_I64_ATOMIC_RMW_16_XCHG_U] = check_atomic_rmw_i64_16,
+    [OP_I64_ATOMIC_RMW_32_XCHG_U] = check_atomic_rmw_i64_32,
+    [OP_I32_ATOMIC_RMW_CMPXCHG] = check_atomic_cmpxchg_i32,
+    [OP_I64_ATOMIC_RMW_CMPXCHG] = check_atomic_cmpxchg_i64,
+    [OP_I32_ATOMIC_RMW_8_CMPXCHG_U] = check_atomic_cmpxchg_i32_8,
+    [OP_I32_ATOMIC_RMW_16_CMPXCHG_U] = check_atomic_cmpxchg_i32_16,
+    [OP_I64_ATOMIC_RMW_8_CMPXCHG_U] = check_atomic_cmpxchg_i64_8,
+    [OP_I64_ATOMIC_RMW_16_CMPXCHG_U] = check_atomic_cmpxchg_i64_16,
+    [OP_I64_ATOMIC_RMW_32_CMPXCHG_U] = check_atomic_cmpxchg_i64_32
+    //clang-format brace hack
+};
+
+static wrp_err_t check_atomic_op(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
 {
-    uint32_t block_offset = 0;
-    uint32_t if_offset = 0;
+    uint32_t atomic_opcode = 0;
+    WRP_CHECK(wrp_read_varui32(&vm->opcode_stream, &atomic_opcode));
 
-    for (uint32_t i = 0; i < out_mdle->num_funcs; i++) {
-        wrp_reset_vm(vm);
+    if (atomic_opcode >= NUM_ATOMIC_OPCODES) {
+        return WRP_ERR_INVALID_OPCODE;
+    }
+
+    return check_atomic_jump_table[atomic_opcode](vm, out_mdle);
+}
+
+static wrp_err_t check_func(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle, uint32_t func_idx)
+{
+    wrp_reset_vm(vm);
+
+    //an earlier failed check may have left entries behind
+    out_mdle->funcs[func_idx].num_blocks = 0;
+    out_mdle->funcs[func_idx].num_ifs = 0;
+    out_mdle->funcs[func_idx].fuel_cost = 0;
+
+    WRP_CHECK(wrp_stk_check_push_call(vm, func_idx));
+    WRP_CHECK(wrp_stk_check_push_block(vm, 0, BLOCK_FUNC, VOID));
+
+    vm->opcode_stream.bytes = out_mdle->funcs[func_idx].code;
+    vm->opcode_stream.sz = out_mdle->funcs[func_idx].code_sz;
+    vm->opcode_stream.pos = 0;
+
+    //every instruction counts towards the innermost block it is in, which
+    //adds its count to the block around it when it ends
+    while (vm->opcode_stream.pos < vm->opcode_stream.sz) {
+        uint8_t opcode = 0;
+        WRP_CHECK(wrp_read_uint8(&vm->opcode_stream, &opcode));
+
+        if (vm->ctrl_stk_head >= 0) {
+            vm->ctrl_stk[vm->ctrl_stk_head].fuel_cost++;
+        }
+
+        if (opcode == OP_ATOMIC_PREFIX) {
+            WRP_CHECK(check_atomic_op(vm, out_mdle));
+            continue;
+        }
+
+        if (opcode >= NUM_OPCODES) {
+            return WRP_ERR_INVALID_OPCODE;
+        }
+
+        WRP_CHECK(check_jump_table[opcode](vm, out_mdle));
+    }
+
+    if (!wrp_end_of_buf(&vm->opcode_stream)) {
+        return WRP_ERR_MDLE_INVALID_BYTES;
+    }
+
+    if (vm->opcode_stream.bytes[vm->opcode_stream.pos - 1] != OP_END) {
+        return WRP_ERR_MDLE_INVALID_END_OPCODE;
+    }
+
+    //publishes the block and if entries recorded above to vms that see the flag
+    atomic_store_explicit(&out_mdle->funcs[func_idx].validated, true, memory_order_release);
+    return WRP_SUCCESS;
+}
+
+//functions only write to their own block and if slices, so workers share the
+//module and each checks on its own scratch vm
+typedef struct wrp_check_job {
+    wrp_wasm_mdle_t *mdle;
+    wrp_vm_t **workers;
+    uint32_t num_workers;
+    _Atomic uint32_t next_worker;
+    _Atomic uint32_t next_func;
+    _Atomic uint32_t failed_func;
+    wrp_err_t errs[WRP_MAX_WORKERS];
+    uint32_t failed_funcs[WRP_MAX_WORKERS];
+} wrp_check_job_t;
+
+static void check_funcs_task(void *arg)
+{
+    wrp_check_job_t *job = arg;
+    uint32_t worker_idx = atomic_fetch_add(&job->next_worker, 1);
+
+    if (worker_idx >= job->num_workers) {
+        return;
+    }
 
-        WRP_CHECK(wrp_stk_check_push_call(vm, i));
-        WRP_CHECK(wrp_stk_check_push_block(vm, 0, BLOCK_FUNC, VOID));
+    wrp_vm_t *vm = job->workers[worker_idx];
 
-        vm->opcode_stream.bytes = out_mdle->funcs[i].code;
-        vm->opcode_stream.sz = out_mdle->funcs[i].code_sz;
-        vm->opcode_stream.pos = 0;
+    while (true) {
+        uint32_t func_idx = atomic_fetch_add(&job->next_func, 1);
 
-        if (i > 0) {
-            block_offset += out_mdle->funcs[i - 1].num_blocks;
-            if_offset += out_mdle->funcs[i - 1].num_ifs;
+        //only the lowest failing function is reported, like a serial check
+        if (func_idx >= job->mdle->num_funcs || func_idx > atomic_load(&job->failed_func)) {
+            return;
         }
 
-        out_mdle->funcs[i].block_addrs = &out_mdle->block_addrs_buf[block_offset];
-        out_mdle->funcs[i].block_labels = &out_mdle->block_label_buf[block_offset];
-        out_mdle->funcs[i].if_addrs = &out_mdle->if_addrs_buf[if_offset];
-        out_mdle->funcs[i].else_addrs = &out_mdle->else_addrs_buf[if_offset];
-        out_mdle->funcs[i].if_labels = &out_mdle->if_label_buf[if_offset];
+        if (atomic_load_explicit(&job->mdle->funcs[func_idx].validated, memory_order_acquire)) {
+            continue;
+        }
+
+        wrp_err_t err = check_func(vm, job->mdle, func_idx);
+
+        if (err != WRP_SUCCESS) {
+            job->errs[worker_idx] = err;
+            job->failed_funcs[worker_idx] = func_idx;
 
-        while (vm->opcode_stream.pos < vm->opcode_stream.sz) {
-            uint8_t opcode = 0;
-            WRP_CHECK(wrp_read_uint8(&vm->opcode_stream, &opcode));
+            uint32_t failed_func = atomic_load(&job->failed_func);
 
-            if (opcode >= NUM_OPCODES) {
-                return WRP_ERR_INVALID_OPCODE;
+            while (func_idx < failed_func && !atomic_compare_exchange_weak(&job->failed_func, &failed_func, func_idx)) {
             }
 
-            WRP_CHECK(check_jump_table[opcode](vm, out_mdle));
+            return;
         }
+    }
+}
 
-        if (!wrp_end_of_buf(&vm->opcode_stream)) {
-            return WRP_ERR_MDLE_INVALID_BYTES;
+//scratch vms for the workers after the first are opened when a check first
+//needs them and kept with vm, later modules it validates reuse them
+static wrp_err_t open_check_workers(wrp_vm_t *vm, uint32_t num_workers)
+{
+    if (vm->check_workers == NULL) {
+        vm->check_workers = vm->alloc_fn(WRP_MAX_WORKERS * sizeof(wrp_vm_t *), alignof(wrp_vm_t *));
+
+        if (vm->check_workers == NULL) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
         }
+    }
 
-        if (vm->opcode_stream.bytes[vm->opcode_stream.pos - 1] != OP_END) {
-            return WRP_ERR_MDLE_INVALID_END_OPCODE;
+    while (vm->num_check_workers + 1 < num_workers) {
+        wrp_vm_t *worker = wrp_open_vm(vm->alloc_fn, vm->free_fn);
+
+        if (worker == NULL) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+
+        vm->check_workers[vm->num_check_workers++] = worker;
+    }
+
+    return WRP_SUCCESS;
+}
+
+static wrp_err_t check_funcs_parallel(wrp_vm_t *vm,
+    const wrp_thread_pool_t *pool,
+    wrp_wasm_mdle_t *out_mdle,
+    uint32_t num_workers)
+{
+    wrp_check_job_t job = {0};
+    wrp_vm_t *workers[WRP_MAX_WORKERS] = {0};
+
+    WRP_CHECK(open_check_workers(vm, num_workers));
+
+    //the calling vm is the first worker's scratch space
+    workers[0] = vm;
+
+    for (uint32_t i = 1; i < num_workers; i++) {
+        workers[i] = vm->check_workers[i - 1];
+        workers[i]->mdle = out_mdle;
+    }
+
+    job.mdle = out_mdle;
+    job.workers = workers;
+    job.num_workers = num_workers;
+    atomic_init(&job.next_worker, 0);
+    atomic_init(&job.next_func, 0);
+    atomic_init(&job.failed_func, UINT32_MAX);
+
+    wrp_run_workers(pool, num_workers, check_funcs_task, &job);
+
+    uint32_t failed_func = atomic_load(&job.failed_func);
+    wrp_err_t err = WRP_SUCCESS;
+
+    for (uint32_t i = 0; i < num_workers; i++) {
+        if (job.errs[i] != WRP_SUCCESS && job.failed_funcs[i] == failed_func) {
+            err = job.errs[i];
+        }
+    }
+
+    for (uint32_t i = 1; i < num_workers; i++) {
+        workers[i]->mdle = NULL;
+    }
+
+    return err;
+}
+
+//vm is scratch space for the check, the pool comes from the caller
+static wrp_err_t wrp_type_check_funcs(wrp_vm_t *vm,
+    const wrp_thread_pool_t *pool,
+    wrp_wasm_mdle_t *out_mdle)
+{
+    uint32_t num_workers = pool->num_workers;
+
+    if (num_workers > WRP_MAX_WORKERS) {
+        num_workers = WRP_MAX_WORKERS;
+    }
+
+    if (num_workers > out_mdle->num_funcs) {
+        num_workers = out_mdle->num_funcs;
+    }
+
+    if (num_workers > 1) {
+        return check_funcs_parallel(vm, pool, out_mdle, num_workers);
+    }
+
+    for (uint32_t i = 0; i < out_mdle->num_funcs; i++) {
+        if (!atomic_load_explicit(&out_mdle->funcs[i].validated, memory_order_acquire)) {
+            WRP_CHECK(check_func(vm, out_mdle, i));
         }
     }
 
@@ -1161,10 +1747,38 @@ static wrp_err_t wrp_type_check_expr(wrp_vm_t *vm,
     return WRP_SUCCESS;
 }
 
+//initializers run before the instance's own globals exist, so they may only
+//read imported globals that can't change
+static wrp_err_t check_expr_global(wrp_wasm_mdle_t *out_mdle, wrp_init_expr_t *expr)
+{
+    wrp_buf_t code = {.bytes = expr->code, .sz = expr->sz, .pos = 0};
+    uint8_t opcode = 0;
+    WRP_CHECK(wrp_read_uint8(&code, &opcode));
+
+    if (opcode != OP_GET_GLOBAL) {
+        return WRP_SUCCESS;
+    }
+
+    uint32_t global_idx = 0;
+    WRP_CHECK(wrp_read_varui32(&code, &global_idx));
+
+    if (global_idx >= out_mdle->num_global_imports || out_mdle->globals[global_idx].mutability != GLOBAL_IMMUTABLE) {
+        return WRP_ERR_INVALID_INITIALZER_EXPRESSION;
+    }
+
+    return WRP_SUCCESS;
+}
+
 static wrp_err_t wrp_type_check_exprs(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
 {
+    for (uint32_t i = out_mdle->num_global_imports; i < out_mdle->num_globals; i++) {
+        WRP_CHECK(wrp_type_check_expr(vm, out_mdle, &out_mdle->globals[i].init_expr));
+        WRP_CHECK(check_expr_global(out_mdle, &out_mdle->globals[i].init_expr));
+    }
+
     for (uint32_t i = 0; i < out_mdle->num_data_segments; i++) {
         WRP_CHECK(wrp_type_check_expr(vm, out_mdle, &out_mdle->data_segments[i].offset_expr));
+        WRP_CHECK(check_expr_global(out_mdle, &out_mdle->data_segments[i].offset_expr));
     }
 
     return WRP_SUCCESS;
@@ -1173,8 +1787,92 @@ static wrp_err_t wrp_type_check_exprs(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
 wrp_err_t wrp_type_check_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle)
 {
     vm->mdle = out_mdle;
-    WRP_CHECK(wrp_type_check_funcs(vm, out_mdle));
+
+    //lazily validated functions are checked by wrp_type_check_func on first call
+    if (!vm->lazy_validation) {
+        WRP_CHECK(wrp_type_check_funcs(vm, &vm->thread_pool, out_mdle));
+    }
+
     WRP_CHECK(wrp_type_check_exprs(vm, out_mdle));
     vm->mdle = NULL;
     return WRP_SUCCESS;
 }
+
+//checks run on a scratch vm owned by the module, the calling vm may be
+//part way through executing it
+static wrp_err_t get_check_vm(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, wrp_vm_t **out_check_vm)
+{
+    if (mdle->check_vm == NULL) {
+        mdle->check_vm = wrp_open_vm(vm->alloc_fn, vm->free_fn);
+
+        if (mdle->check_vm == NULL) {
+            return WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        }
+
+        mdle->check_vm->mdle = mdle;
+    }
+
+    *out_check_vm = mdle->check_vm;
+    return WRP_SUCCESS;
+}
+
+//vms sharing the module may reach an unchecked function together, so the
+//scratch vm is only used under the module's lock. It's held for a whole
+//function body, waiters give up the core instead of spinning.
+static void lock_mdle(wrp_wasm_mdle_t *mdle)
+{
+    while (atomic_flag_test_and_set_explicit(&mdle->check_lock, memory_order_acquire)) {
+#if WRP_THREADS
+        sched_yield();
+#endif
+    }
+}
+
+static void unlock_mdle(wrp_wasm_mdle_t *mdle)
+{
+    atomic_flag_clear_explicit(&mdle->check_lock, memory_order_release);
+}
+
+wrp_err_t wrp_type_check_func(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, uint32_t func_idx)
+{
+    //pairs with the release in check_func, a checked function needs no lock
+    if (atomic_load_explicit(&mdle->funcs[func_idx].validated, memory_order_acquire)) {
+        return WRP_SUCCESS;
+    }
+
+    lock_mdle(mdle);
+
+    //another vm may have checked it while this one waited
+    wrp_vm_t *check_vm = NULL;
+    wrp_err_t err = WRP_SUCCESS;
+
+    if (!atomic_load_explicit(&mdle->funcs[func_idx].validated, memory_order_relaxed) && (err = get_check_vm(vm, mdle, &check_vm)) == WRP_SUCCESS) {
+        err = check_func(check_vm, mdle, func_idx);
+    }
+
+    unlock_mdle(mdle);
+    return err;
+}
+
+wrp_err_t wrp_type_check_staged_func(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, uint32_t func_idx)
+{
+    vm->mdle = mdle;
+    wrp_err_t err = check_func(vm, mdle, func_idx);
+    vm->mdle = NULL;
+    return err;
+}
+
+wrp_err_t wrp_type_check_remaining_funcs(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle)
+{
+    lock_mdle(mdle);
+
+    wrp_vm_t *check_vm = NULL;
+    wrp_err_t err = get_check_vm(vm, mdle, &check_vm);
+
+    if (err == WRP_SUCCESS) {
+        err = wrp_type_check_funcs(check_vm, &vm->thread_pool, mdle);
+    }
+
+    unlock_mdle(mdle);
+    return err;
+}
@@ -21,3 +21,10 @@
 #include "warp-types.h"
 
 wrp_err_t wrp_type_check_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *out_mdle);
+
+wrp_err_t wrp_type_check_func(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, uint32_t func_idx);
+
+//checks a function of a module that is still being loaded, vm is scratch space
+wrp_err_t wrp_type_check_staged_func(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, uint32_t func_idx);
+
+wrp_err_t wrp_type_check_remaining_funcs(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle);
@@ -16,11 +16,20 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct wrp_vm wrp_vm_t;
 typedef struct wrp_wasm_mdle wrp_wasm_mdle_t;
+typedef struct wrp_instance wrp_instance_t;
+typedef struct wrp_func wrp_func_t;
 typedef struct wrp_wasm_meta wrp_wasm_meta_t;
 typedef struct wrp_buf wrp_buf_t;
 typedef struct wrp_init_expr wrp_init_expr_t;
+typedef struct wrp_memory wrp_memory_t;
+typedef struct wrp_stream wrp_stream_t;
 typedef enum wrp_err wrp_err_t;
+
+typedef void *(*wrp_alloc_fn_t)(size_t size, size_t align);
+
+typedef void (*wrp_free_fn_t)(void *ptr);
@@ -22,6 +22,23 @@
 #include "warp-wasm.h"
 
 #define ALIGN_64(x) (((x + 63) / 64) * 64)
+#define FNV_OFFSET 0x811c9dc5u
+#define FNV_PRIME 0x01000193u
+
+uint32_t wrp_index_sz(uint32_t count)
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t index_sz = 1;
+
+    while (index_sz < (uint64_t)count * 2) {
+        index_sz <<= 1;
+    }
+
+    return (uint32_t)index_sz;
+}
 
 size_t wrp_mdle_sz(wrp_wasm_meta_t *meta)
 {
@@ -32,10 +49,11 @@ size_t wrp_mdle_sz(wrp_wasm_meta_t *meta)
     mdle_sz += ALIGN_64(meta->code_buf_sz * sizeof(uint8_t));
     mdle_sz += ALIGN_64(meta->num_block_ops * sizeof(size_t));
     mdle_sz += ALIGN_64(meta->num_block_ops * sizeof(size_t));
+    mdle_sz += ALIGN_64(meta->num_block_ops * sizeof(size_t));
     mdle_sz += ALIGN_64(meta->num_if_ops * sizeof(size_t));
     mdle_sz += ALIGN_64(meta->num_if_ops * sizeof(size_t));
     mdle_sz += ALIGN_64(meta->num_if_ops * sizeof(size_t));
-    mdle_sz += ALIGN_64(meta->num_globals * sizeof(uint64_t));
+    mdle_sz += ALIGN_64(meta->global_expr_buf_sz * sizeof(uint8_t));
     mdle_sz += ALIGN_64(meta->import_name_buf_sz * sizeof(char));
     mdle_sz += ALIGN_64(meta->import_field_buf_sz * sizeof(char));
     mdle_sz += ALIGN_64(meta->export_name_buf_sz * sizeof(char));
@@ -52,6 +70,8 @@ size_t wrp_mdle_sz(wrp_wasm_meta_t *meta)
     mdle_sz += ALIGN_64(meta->num_data_segments * sizeof(wrp_data_segment_t));
     mdle_sz += ALIGN_64(meta->num_imports * sizeof(wrp_import_t));
     mdle_sz += ALIGN_64(meta->num_exports * sizeof(wrp_export_t));
+    mdle_sz += ALIGN_64(wrp_index_sz(meta->num_imports) * sizeof(wrp_name_slot_t));
+    mdle_sz += ALIGN_64(wrp_index_sz(meta->num_exports) * sizeof(wrp_name_slot_t));
     return mdle_sz;
 }
 
@@ -78,6 +98,9 @@ void wrp_mdle_init(wrp_wasm_meta_t *meta, wrp_wasm_mdle_t *out_mdle)
     out_mdle->block_label_buf = (size_t *)(ptr + offset);
     offset += ALIGN_64(meta->num_block_ops * sizeof(size_t));
 
+    out_mdle->block_cost_buf = (size_t *)(ptr + offset);
+    offset += ALIGN_64(meta->num_block_ops * sizeof(size_t));
+
     out_mdle->if_addrs_buf = (size_t *)(ptr + offset);
     offset += ALIGN_64(meta->num_if_ops * sizeof(size_t));
 
@@ -87,8 +110,8 @@ void wrp_mdle_init(wrp_wasm_meta_t *meta, wrp_wasm_mdle_t *out_mdle)
     out_mdle->if_label_buf = (size_t *)(ptr + offset);
     offset += ALIGN_64(meta->num_if_ops * sizeof(size_t));
 
-    out_mdle->global_buf = (uint64_t *)(ptr + offset);
-    offset += ALIGN_64(meta->num_globals * sizeof(uint64_t));
+    out_mdle->global_expr_buf = (uint8_t *)(ptr + offset);
+    offset += ALIGN_64(meta->global_expr_buf_sz * sizeof(uint8_t));
 
     out_mdle->import_name_buf = (char *)(ptr + offset);
     offset += ALIGN_64(meta->import_name_buf_sz * sizeof(char));
@@ -137,6 +160,82 @@ void wrp_mdle_init(wrp_wasm_meta_t *meta, wrp_wasm_mdle_t *out_mdle)
 
     out_mdle->exports = (wrp_export_t *)(ptr + offset);
     offset += ALIGN_64(meta->num_exports * sizeof(wrp_export_t));
+
+    out_mdle->import_index = (wrp_name_slot_t *)(ptr + offset);
+    out_mdle->import_index_sz = wrp_index_sz(meta->num_imports);
+    offset += ALIGN_64(out_mdle->import_index_sz * sizeof(wrp_name_slot_t));
+
+    out_mdle->export_index = (wrp_name_slot_t *)(ptr + offset);
+    out_mdle->export_index_sz = wrp_index_sz(meta->num_exports);
+    offset += ALIGN_64(out_mdle->export_index_sz * sizeof(wrp_name_slot_t));
+}
+
+static size_t num_table_elem(wrp_wasm_mdle_t *mdle)
+{
+    size_t num_elem = 0;
+
+    for (uint32_t i = 0; i < mdle->num_tables; i++) {
+        num_elem += mdle->tables[i].num_elem;
+    }
+
+    return num_elem;
+}
+
+size_t wrp_instance_sz(wrp_wasm_mdle_t *mdle)
+{
+    size_t instance_sz = sizeof(wrp_instance_t);
+    instance_sz += ALIGN_64(mdle->num_func_imports * sizeof(wrp_func_import_t));
+    instance_sz += ALIGN_64(mdle->num_global_imports * sizeof(uint64_t *));
+    instance_sz += ALIGN_64(mdle->num_globals * sizeof(uint64_t));
+    instance_sz += ALIGN_64(mdle->num_memories * sizeof(wrp_memory_t));
+    instance_sz += ALIGN_64(mdle->num_tables * sizeof(wrp_table_t));
+    instance_sz += ALIGN_64(num_table_elem(mdle) * sizeof(wrp_table_entry_t));
+    return instance_sz;
+}
+
+void wrp_instance_init(wrp_wasm_mdle_t *mdle, wrp_instance_t *out_instance)
+{
+    uint8_t *ptr = (uint8_t *)out_instance;
+    size_t offset = sizeof(wrp_instance_t);
+
+    out_instance->mdle = mdle;
+
+    out_instance->func_imports = (wrp_func_import_t *)(ptr + offset);
+    offset += ALIGN_64(mdle->num_func_imports * sizeof(wrp_func_import_t));
+
+    out_instance->global_imports = (uint64_t **)(ptr + offset);
+    offset += ALIGN_64(mdle->num_global_imports * sizeof(uint64_t *));
+
+    out_instance->global_buf = (uint64_t *)(ptr + offset);
+    offset += ALIGN_64(mdle->num_globals * sizeof(uint64_t));
+
+    out_instance->memories = (wrp_memory_t *)(ptr + offset);
+    offset += ALIGN_64(mdle->num_memories * sizeof(wrp_memory_t));
+
+    out_instance->tables = (wrp_table_t *)(ptr + offset);
+    offset += ALIGN_64(mdle->num_tables * sizeof(wrp_table_t));
+
+    out_instance->elem_buf = (wrp_table_entry_t *)(ptr + offset);
+    offset += ALIGN_64(num_table_elem(mdle) * sizeof(wrp_table_entry_t));
+
+    //imported globals stay unset until the host provides them, the rest
+    //are evaluated when the instance is first linked
+    for (uint32_t i = 0; i < mdle->num_global_imports; i++) {
+        out_instance->global_imports[i] = NULL;
+    }
+
+    memcpy(out_instance->memories, mdle->memories, mdle->num_memories * sizeof(wrp_memory_t));
+
+    size_t elem_offset = 0;
+
+    for (uint32_t i = 0; i < mdle->num_tables; i++) {
+        out_instance->tables[i] = mdle->tables[i];
+        out_instance->tables[i].elem = &out_instance->elem_buf[elem_offset];
+        elem_offset += mdle->tables[i].num_elem;
+    }
+
+    out_instance->initialized = false;
+    out_instance->initializing = false;
 }
 
 bool wrp_is_valid_wasm_type(int8_t type)
@@ -190,13 +289,34 @@ bool wrp_is_valid_elem_type(int8_t elem_type)
     return elem_type == ANY_FUNC;
 }
 
-wrp_err_t wrp_check_meta(wrp_wasm_meta_t *meta)
+void wrp_default_limits(wrp_limits_t *out_limits)
 {
-    if (meta->num_types > MAX_TYPES) {
+    out_limits->max_types = DEFAULT_MAX_TYPES;
+    out_limits->max_funcs = DEFAULT_MAX_FUNCS;
+    out_limits->max_imports = DEFAULT_MAX_IMPORTS;
+    out_limits->max_exports = DEFAULT_MAX_EXPORTS;
+    out_limits->max_globals = DEFAULT_MAX_GLOBALS;
+    out_limits->max_elem_segments = DEFAULT_MAX_ELEM_SEGMENTS;
+    out_limits->max_data_segments = DEFAULT_MAX_DATA_SEGMENTS;
+    out_limits->max_table_elem = DEFAULT_MAX_TABLE_SIZE;
+    out_limits->max_func_params = DEFAULT_MAX_FUNC_PARAMS;
+    out_limits->max_func_locals = DEFAULT_MAX_FUNC_LOCALS;
+    out_limits->max_func_body_sz = DEFAULT_MAX_FUNC_BODY_SZ;
+    out_limits->max_mdle_sz = DEFAULT_MAX_MDLE_SZ;
+    out_limits->max_memory64_reserve_pages = DEFAULT_MAX_MEMORY64_RESERVE;
+}
+
+wrp_err_t wrp_check_meta(wrp_wasm_meta_t *meta, const wrp_limits_t *limits)
+{
+    if (meta->num_types > limits->max_types) {
         return WRP_ERR_MDLE_TYPE_OVERFLOW;
     }
 
-    if (meta->num_funcs > MAX_FUNCS) {
+    if (meta->num_imports > limits->max_imports) {
+        return WRP_ERR_MDLE_IMPORT_OVERFLOW;
+    }
+
+    if (meta->num_funcs > limits->max_funcs) {
         return WRP_ERR_MDLE_FUNC_OVERFLOW;
     }
 
@@ -208,27 +328,24 @@ wrp_err_t wrp_check_meta(wrp_wasm_meta_t *meta)
         return WRP_ERR_MDLE_MEMORY_OVERFLOW;
     }
 
-    if (meta->num_globals > MAX_GLOBALS) {
+    if (meta->num_globals > limits->max_globals) {
         return WRP_ERR_MDLE_GLOBAL_OVERFLOW;
     }
 
-    if (meta->num_exports > MAX_EXPORTS) {
+    if (meta->num_exports > limits->max_exports) {
         return WRP_ERR_MDLE_EXPORT_OVERFLOW;
     }
 
-    if (meta->num_elem_segments > MAX_ELEMENT_SEGMENTS) {
+    if (meta->num_elem_segments > limits->max_elem_segments) {
         return WRP_ERR_MDLE_ELEMENT_OVERFLOW;
     }
 
-    if (meta->num_data_segments > MAX_DATA_SEGMENTS) {
+    if (meta->num_data_segments > limits->max_data_segments) {
         return WRP_ERR_MDLE_DATA_OVERFLOW;
     }
 
-    if (meta->num_code_locals > MAX_LOCALS) {
-        return WRP_ERR_MDLE_LOCAL_OVERFLOW;
-    }
-
-    if (meta->code_buf_sz > MAX_CODE_SIZE) {
+    //the counts above are limited, so their staged size can't wrap
+    if (wrp_mdle_sz(meta) > limits->max_mdle_sz) {
         return WRP_ERR_MDLE_CODE_OVERFLOW;
     }
 
@@ -269,32 +386,290 @@ wrp_err_t wrp_get_if_idx(wrp_wasm_mdle_t *mdle,
     return WRP_ERR_UNKNOWN_IF;
 }
 
+//FNV-1a, a zero byte ends each name so an import's module name and field
+//can't run into each other
+static uint32_t hash_name(uint32_t hash, const char *name)
+{
+    for (const char *c = name; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * FNV_PRIME;
+    }
+
+    return hash * FNV_PRIME;
+}
+
+uint32_t wrp_hash_import(const char *mdle_name, const char *field)
+{
+    return hash_name(hash_name(FNV_OFFSET, mdle_name), field);
+}
+
+//FNV-1a over both counts and then the types, so the split between params
+//and results is part of the hash
+uint32_t wrp_hash_signature(const wrp_type_t *type)
+{
+    uint32_t hash = FNV_OFFSET;
+    hash = (hash ^ type->num_params) * FNV_PRIME;
+    hash = (hash ^ type->num_results) * FNV_PRIME;
+
+    for (uint32_t i = 0; i < type->num_params; i++) {
+        hash = (hash ^ (uint8_t)type->param_types[i]) * FNV_PRIME;
+    }
+
+    for (uint32_t i = 0; i < type->num_results; i++) {
+        hash = (hash ^ (uint8_t)type->result_types[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+static bool is_import(const wrp_import_t *import, const char *mdle_name, const char *field)
+{
+    return strcmp(import->name, mdle_name) == 0 && strcmp(import->field, field) == 0;
+}
+
+wrp_err_t wrp_index_names(wrp_wasm_mdle_t *mdle)
+{
+    uint32_t mask = mdle->import_index_sz - 1;
+
+    for (uint32_t i = 0; i < mdle->num_imports; i++) {
+        wrp_import_t *import = &mdle->imports[i];
+        uint32_t hash = wrp_hash_import(import->name, import->field);
+        uint32_t slot = hash & mask;
+        bool repeated = false;
+        import->hash = hash;
+
+        while (mdle->import_index[slot].idx != 0 && !repeated) {
+            wrp_name_slot_t *entry = &mdle->import_index[slot];
+            repeated = entry->hash == hash && is_import(&mdle->imports[entry->idx - 1], import->name, import->field);
+            slot = (slot + 1) & mask;
+        }
+
+        if (!repeated) {
+            mdle->import_index[slot] = (wrp_name_slot_t){.hash = hash, .idx = i + 1};
+        }
+    }
+
+    mask = mdle->export_index_sz - 1;
+
+    for (uint32_t i = 0; i < mdle->num_exports; i++) {
+        uint32_t hash = hash_name(FNV_OFFSET, mdle->exports[i].name);
+        uint32_t slot = hash & mask;
+
+        while (mdle->export_index[slot].idx != 0) {
+            wrp_name_slot_t *entry = &mdle->export_index[slot];
+
+            if (entry->hash == hash && strcmp(mdle->exports[entry->idx - 1].name, mdle->exports[i].name) == 0) {
+                return WRP_ERR_MDLE_DUPLICATE_EXPORT;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+
+        mdle->export_index[slot] = (wrp_name_slot_t){.hash = hash, .idx = i + 1};
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_find_export(const wrp_wasm_mdle_t *mdle,
+    const char *name,
+    wrp_export_handle_t *out_handle)
+{
+    if (mdle->num_exports == 0) {
+        return WRP_ERR_UNKNOWN_EXPORT;
+    }
+
+    uint32_t mask = mdle->export_index_sz - 1;
+    uint32_t hash = hash_name(FNV_OFFSET, name);
+
+    for (uint32_t slot = hash & mask; mdle->export_index[slot].idx != 0; slot = (slot + 1) & mask) {
+        const wrp_name_slot_t *entry = &mdle->export_index[slot];
+        const wrp_export_t *export = &mdle->exports[entry->idx - 1];
+
+        if (entry->hash == hash && strcmp(export->name, name) == 0) {
+            out_handle->mdle = mdle;
+            out_handle->kind = export->kind;
+            out_handle->idx = export->idx;
+            return WRP_SUCCESS;
+        }
+    }
+
+    return WRP_ERR_UNKNOWN_EXPORT;
+}
+
+wrp_err_t wrp_find_import(const wrp_wasm_mdle_t *mdle,
+    const char *mdle_name,
+    const char *field,
+    uint32_t *out_import_idx)
+{
+    if (mdle->num_imports == 0) {
+        return WRP_ERR_UNKNOWN_IMPORT;
+    }
+
+    uint32_t mask = mdle->import_index_sz - 1;
+    uint32_t hash = wrp_hash_import(mdle_name, field);
+
+    for (uint32_t slot = hash & mask; mdle->import_index[slot].idx != 0; slot = (slot + 1) & mask) {
+        const wrp_name_slot_t *entry = &mdle->import_index[slot];
+
+        if (entry->hash == hash && is_import(&mdle->imports[entry->idx - 1], mdle_name, field)) {
+            *out_import_idx = entry->idx - 1;
+            return WRP_SUCCESS;
+        }
+    }
+
+    return WRP_ERR_UNKNOWN_IMPORT;
+}
+
 wrp_err_t wrp_export_func(wrp_wasm_mdle_t *mdle,
     const char *func_name,
     uint32_t *out_func_idx)
 {
-    for (uint32_t i = 0; i < mdle->num_exports; i++) {
-        if (mdle->exports[i].kind == EXTERNAL_FUNC) {
-            if (strcmp(mdle->exports[i].name, func_name) == 0) {
-                *out_func_idx = mdle->exports[i].idx;
-                return WRP_SUCCESS;
-            }
+    wrp_export_handle_t handle = {0};
+
+    if (wrp_find_export(mdle, func_name, &handle) != WRP_SUCCESS || handle.kind != EXTERNAL_FUNC) {
+        return WRP_ERR_UNKNOWN_FUNC;
+    }
+
+    *out_func_idx = handle.idx;
+    return WRP_SUCCESS;
+}
+
+static bool same_types(const int8_t *a, const int8_t *b, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+wrp_err_t wrp_import_func(wrp_instance_t *instance,
+    const wrp_host_func_t *func,
+    uint32_t func_idx)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    if (func_idx >= mdle->num_func_imports) {
+        return WRP_ERR_INVALID_FUNC_IDX;
+    }
+
+    wrp_type_t *type = &mdle->types[mdle->funcs[func_idx].type_idx];
+
+    if (func->num_params != type->num_params || func->num_results != type->num_results ||
+        !same_types(func->param_types, type->param_types, type->num_params) ||
+        !same_types(func->result_types, type->result_types, type->num_results)) {
+        return WRP_ERR_TYPE_MISMATCH;
+    }
+
+    instance->func_imports[func_idx] = (wrp_func_import_t){.host = *func};
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_import_instance_func(wrp_instance_t *instance,
+    wrp_instance_t *exporter,
+    uint32_t exporter_func_idx,
+    uint32_t func_idx)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+    wrp_wasm_mdle_t *exporter_mdle = exporter->mdle;
+
+    if (func_idx >= mdle->num_func_imports || exporter_func_idx >= exporter_mdle->num_funcs) {
+        return WRP_ERR_INVALID_FUNC_IDX;
+    }
+
+    wrp_type_t *type = &mdle->types[mdle->funcs[func_idx].type_idx];
+    wrp_type_t *exporter_type = &exporter_mdle->types[exporter_mdle->funcs[exporter_func_idx].type_idx];
+
+    if (exporter_type->num_params != type->num_params || exporter_type->num_results != type->num_results ||
+        !same_types(exporter_type->param_types, type->param_types, type->num_params) ||
+        !same_types(exporter_type->result_types, type->result_types, type->num_results)) {
+        return WRP_ERR_TYPE_MISMATCH;
+    }
+
+    //binding to what the import is bound to keeps calls one hop
+    if (exporter_func_idx < exporter_mdle->num_func_imports) {
+        wrp_func_import_t *import = &exporter->func_imports[exporter_func_idx];
+
+        if (import->host.fn == NULL && import->instance == NULL) {
+            return WRP_ERR_MISSING_FUNC_IMPORT;
         }
+
+        instance->func_imports[func_idx] = *import;
+        return WRP_SUCCESS;
     }
 
-    return WRP_ERR_UNKNOWN_FUNC;
+    instance->func_imports[func_idx] = (wrp_func_import_t){.instance = exporter, .func_idx = exporter_func_idx};
+    return WRP_SUCCESS;
 }
 
-wrp_err_t wrp_import_global(wrp_wasm_mdle_t *mdle,
+wrp_err_t wrp_import_global(wrp_instance_t *instance,
     uint64_t *global,
     uint32_t global_idx)
 {
+    if (global_idx >= instance->mdle->num_global_imports) {
+        return WRP_ERR_INVALID_GLOBAL_IDX;
+    }
+
+    instance->global_imports[global_idx] = global;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_export_global(wrp_instance_t *instance,
+    const char *global_name,
+    uint64_t **out_global)
+{
+    wrp_export_handle_t handle = {0};
+
+    if (wrp_find_export(instance->mdle, global_name, &handle) != WRP_SUCCESS || handle.kind != EXTERNAL_GLOBAL) {
+        return WRP_ERR_INVALID_GLOBAL_IDX;
+    }
+
+    if (handle.idx < instance->mdle->num_global_imports) {
+        *out_global = instance->global_imports[handle.idx];
+    } else {
+        *out_global = &instance->global_buf[handle.idx];
+    }
+
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_export_memory(wrp_instance_t *instance,
+    const char *memory_name,
+    wrp_memory_t **out_memory)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    wrp_export_handle_t handle = {0};
+
+    if (wrp_find_export(mdle, memory_name, &handle) != WRP_SUCCESS || handle.kind != EXTERNAL_MEMORY) {
+        return WRP_ERR_INVALID_MEM_IDX;
+    }
+
+    wrp_memory_t *memory = &instance->memories[handle.idx];
+
+    //re-exporting an import hands out the original memory
+    if (memory->import != NULL) {
+        memory = memory->import;
+    }
+
+    *out_memory = memory;
+    return WRP_SUCCESS;
+}
+
+wrp_err_t wrp_import_memory(wrp_instance_t *instance,
+    wrp_memory_t *memory,
+    uint32_t memory_idx)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
     for (uint32_t i = 0; i < mdle->num_imports; i++) {
-        if (mdle->imports[i].kind == EXTERNAL_GLOBAL && mdle->imports[i].idx == global_idx) {
-            mdle->globals[global_idx].value = global;
+        if (mdle->imports[i].kind == EXTERNAL_MEMORY && mdle->imports[i].idx == memory_idx) {
+            instance->memories[memory_idx].import = memory;
             return WRP_SUCCESS;
         }
     }
 
-    return WRP_ERR_INVALID_GLOBAL_IDX;
+    return WRP_ERR_INVALID_MEM_IDX;
 }
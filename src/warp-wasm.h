@@ -17,6 +17,7 @@
 #pragma once
 
 #include <stdalign.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -263,6 +264,77 @@
 #define OP_F64_REINTERPRET_I64  0xBF
 #define NUM_OPCODES             0xC0
 
+// atomic op codes, follow OP_ATOMIC_PREFIX
+#define OP_ATOMIC_PREFIX        0xFE
+#define OP_ATOMIC_NOTIFY                0x00
+#define OP_I32_ATOMIC_WAIT              0x01
+#define OP_I64_ATOMIC_WAIT              0x02
+#define OP_ATOMIC_FENCE                 0x03
+#define OP_I32_ATOMIC_LOAD              0x10
+#define OP_I64_ATOMIC_LOAD              0x11
+#define OP_I32_ATOMIC_LOAD_8_U          0x12
+#define OP_I32_ATOMIC_LOAD_16_U         0x13
+#define OP_I64_ATOMIC_LOAD_8_U          0x14
+#define OP_I64_ATOMIC_LOAD_16_U         0x15
+#define OP_I64_ATOMIC_LOAD_32_U         0x16
+#define OP_I32_ATOMIC_STORE             0x17
+#define OP_I64_ATOMIC_STORE             0x18
+#define OP_I32_ATOMIC_STORE_8           0x19
+#define OP_I32_ATOMIC_STORE_16          0x1A
+#define OP_I64_ATOMIC_STORE_8           0x1B
+#define OP_I64_ATOMIC_STORE_16          0x1C
+#define OP_I64_ATOMIC_STORE_32          0x1D
+#define OP_I32_ATOMIC_RMW_ADD           0x1E
+#define OP_I64_ATOMIC_RMW_ADD           0x1F
+#define OP_I32_ATOMIC_RMW_8_ADD_U       0x20
+#define OP_I32_ATOMIC_RMW_16_ADD_U      0x21
+#define OP_I64_ATOMIC_RMW_8_ADD_U       0x22
+#define OP_I64_ATOMIC_RMW_16_ADD_U      0x23
+#define OP_I64_ATOMIC_RMW_32_ADD_U      0x24
+#define OP_I32_ATOMIC_RMW_SUB           0x25
+#define OP_I64_ATOMIC_RMW_SUB           0x26
+#define OP_I32_ATOMIC_RMW_8_SUB_U       0x27
+#define OP_I32_ATOMIC_RMW_16_SUB_U      0x28
+#define OP_I64_ATOMIC_RMW_8_SUB_U       0x29
+#define OP_I64_ATOMIC_RMW_16_SUB_U      0x2A
+#define OP_I64_ATOMIC_RMW_32_SUB_U      0x2B
+#define OP_I32_ATOMIC_RMW_AND           0x2C
+#define OP_I64_ATOMIC_RMW_AND           0x2D
+#define OP_I32_ATOMIC_RMW_8_AND_U       0x2E
+#define OP_I32_ATOMIC_RMW_16_AND_U      0x2F
+#define OP_I64_ATOMIC_RMW_8_AND_U       0x30
+#define OP_I64_ATOMIC_RMW_16_AND_U      0x31
+#define OP_I64_ATOMIC_RMW_32_AND_U      0x32
+#define OP_I32_ATOMIC_RMW_OR            0x33
+#define OP_I64_ATOMIC_RMW_OR            0x34
+#define OP_I32_ATOMIC_RMW_8_OR_U        0x35
+#define OP_I32_ATOMIC_RMW_16_OR_U       0x36
+#define OP_I64_ATOMIC_RMW_8_OR_U        0x37
+#define OP_I64_ATOMIC_RMW_16_OR_U       0x38
+#define OP_I64_ATOMIC_RMW_32_OR_U       0x39
+#define OP_I32_ATOMIC_RMW_XOR           0x3A
+#define OP_I64_ATOMIC_RMW_XOR           0x3B
+#define OP_I32_ATOMIC_RMW_8_XOR_U       0x3C
+#define OP_I32_ATOMIC_RMW_16_XOR_U      0x3D
+#define OP_I64_ATOMIC_RMW_8_XOR_U       0x3E
+#define OP_I64_ATOMIC_RMW_16_XOR_U      0x3F
+#define OP_I64_ATOMIC_RMW_32_XOR_U      0x40
+#define OP_I32_ATOMIC_RMW_XCHG          0x41
+#define OP_I64_ATOMIC_RMW_XCHG          0x42
+#define OP_I32_ATOMIC_RMW_8_XCHG_U      0x43
+#define OP_I32_ATOMIC_RMW_16_XCHG_U     0x44
+#define OP_I64_ATOMIC_RMW_8_XCHG_U      0x45
+#define OP_I64_ATOMIC_RMW_16_XCHG_U     0x46
+#define OP_I64_ATOMIC_RMW_32_XCHG_U     0x47
+#define OP_I32_ATOMIC_RMW_CMPXCHG       0x48
+#define OP_I64_ATOMIC_RMW_CMPXCHG       0x49
+#define OP_I32_ATOMIC_RMW_8_CMPXCHG_U   0x4A
+#define OP_I32_ATOMIC_RMW_16_CMPXCHG_U  0x4B
+#define OP_I64_ATOMIC_RMW_8_CMPXCHG_U   0x4C
+#define OP_I64_ATOMIC_RMW_16_CMPXCHG_U  0x4D
+#define OP_I64_ATOMIC_RMW_32_CMPXCHG_U  0x4E
+#define NUM_ATOMIC_OPCODES              0x4F
+
 typedef void (*wrp_thunk_fn_t)(uint64_t *arg_values,
     uint8_t *arg_types,
     uint32_t num_args,
@@ -293,20 +365,41 @@ typedef struct wrp_wasm_meta {
     uint32_t num_data_segments;
     size_t data_buf_sz;
     size_t data_expr_buf_sz;
+    size_t global_expr_buf_sz;
 } wrp_wasm_meta_t;
 
+//checked while loading, the module's tables are sized from what it declares
+typedef struct wrp_limits {
+    uint32_t max_types;
+    uint32_t max_funcs;
+    uint32_t max_imports;
+    uint32_t max_exports;
+    uint32_t max_globals;
+    uint32_t max_elem_segments;
+    uint32_t max_data_segments;
+    uint32_t max_table_elem;
+    uint32_t max_func_params;
+    uint32_t max_func_locals;
+    uint32_t max_func_body_sz;
+    size_t max_mdle_sz;
+    uint32_t max_memory64_reserve_pages;
+} wrp_limits_t;
+
 typedef struct wrp_init_expr{
     uint8_t *code;
     uint8_t sz;
     int8_t value_type;
 } wrp_init_expr_t;
 
+//sig_id is the first type index with the same signature, so equal ids mean
+//equal signatures within a module
 typedef struct wrp_type {
     uint8_t form;
     int8_t *param_types;
     uint32_t num_params;
     int8_t *result_types;
     uint32_t num_results;
+    uint32_t sig_id;
 } wrp_type_t;
 
 typedef struct wrp_func {
@@ -317,22 +410,60 @@ typedef struct wrp_func {
     size_t code_sz;
     size_t *block_addrs;
     size_t *block_labels;
+    size_t *block_costs;
     uint32_t num_blocks;
     size_t *if_addrs;
     size_t *if_labels;
     size_t *else_addrs;
     uint32_t num_ifs;
+    size_t fuel_cost;
+    _Atomic bool validated;
 } wrp_func_t;
 
 typedef struct wrp_global {
-    uint64_t *value;
     int8_t type;
     uint8_t mutability;
+    wrp_init_expr_t init_expr;
 } wrp_global_t;
 
+//host functions pop their params and push their results with the
+//wrp_stk_exec_* functions, they must not call back into the vm. Returning
+//WRP_ERR_HOST_YIELD after pushing the results suspends the call, which
+//carries on after the host function when it's resumed. Returning
+//WRP_ERR_HOST_PENDING after popping the params suspends it until the
+//results are pushed with wrp_complete_host_call, e.g. once an asset loads.
+typedef wrp_err_t (*wrp_host_fn_t)(wrp_vm_t *vm, void *ctx);
+
+//the types are checked against the import's when it is bound
+typedef struct wrp_host_func {
+    wrp_host_fn_t fn;
+    void *ctx;
+    const int8_t *param_types;
+    uint32_t num_params;
+    const int8_t *result_types;
+    uint32_t num_results;
+} wrp_host_func_t;
+
+//bound either to a host function or to a function another instance defines,
+//which is called directly in that instance's context
+typedef struct wrp_func_import {
+    wrp_host_func_t host;
+    wrp_instance_t *instance;
+    uint32_t func_idx;
+} wrp_func_import_t;
+
+//resolved when the element is written so call_indirect needs no lookups,
+//an empty slot has no func
+typedef struct wrp_table_entry {
+    wrp_func_t *func;
+    wrp_instance_t *instance;
+    uint32_t func_idx;
+    uint32_t sig_id;
+} wrp_table_entry_t;
+
 typedef struct wrp_table {
     int8_t type;
-    uint32_t *elem;
+    wrp_table_entry_t *elem;
     uint32_t num_elem;
     uint32_t max_elem;
 } wrp_table_t;
@@ -344,10 +475,47 @@ typedef struct wrp_elem_segment{
     wrp_init_expr_t offset_expr;
 } wrp_elem_segment_t;
 
+//a page's stamp changing to the current epoch, logged in epoch order
+typedef struct wrp_dirty_entry {
+    uint32_t page;
+    uint64_t epoch;
+} wrp_dirty_entry_t;
+
+//a tracked memory stamps each page it writes with the current epoch and
+//logs the page the first time its stamp changes, a consumer remembers the
+//epoch it last synced at and walks the log entries after it. A full log
+//drops the entries superseded by a newer stamp of the same page. Views and
+//re-inits make every page dirty at once. Tracking stops once its last
+//consumer lets it go.
+typedef struct wrp_dirty_pages {
+    uint32_t num_consumers;
+    uint64_t *epochs;
+    uint32_t num_pages;
+    wrp_dirty_entry_t *log;
+    uint32_t log_count;
+    uint32_t log_cap;
+    uint64_t epoch;
+    uint64_t all_epoch;
+    uint64_t reset_epoch;
+} wrp_dirty_pages_t;
+
 typedef struct wrp_memory {
     uint8_t *bytes;
-    uint32_t num_pages;
+    _Atomic uint32_t num_pages;
+    uint32_t min_pages;
     uint32_t max_pages;
+    uint32_t reserved_pages;
+    _Atomic uint64_t generation;
+    bool shared;
+    bool memory64;
+    bool imported;
+    bool mapped;
+    //an instance's initial pages are mapped from its module's image, which
+    //the module's memory owns once its first instance has built it
+    bool has_image;
+    _Atomic int image_fd;
+    wrp_memory_t *import;
+    wrp_dirty_pages_t dirty;
 } wrp_memory_t;
 
 typedef struct wrp_data_segment{
@@ -357,11 +525,13 @@ typedef struct wrp_data_segment{
     wrp_init_expr_t offset_expr;
 } wrp_data_segment_t;
 
+//hash is of name and field, set by wrp_index_names
 typedef struct wrp_import {
     char *name;
     char *field;
     uint8_t kind;
     uint32_t idx;
+    uint32_t hash;
 } wrp_import_t;
 
 typedef struct wrp_export {
@@ -370,6 +540,20 @@ typedef struct wrp_export {
     uint32_t idx;
 } wrp_export_t;
 
+//names are looked up in open addressed indices that are at most half full,
+//slots keep the name's hash so probing rarely compares names that differ
+typedef struct wrp_name_slot {
+    uint32_t hash;
+    uint32_t idx; //entry index + 1, 0 marks an empty slot
+} wrp_name_slot_t;
+
+//an export resolved once by name, valid for every instance of its module
+typedef struct wrp_export_handle {
+    const wrp_wasm_mdle_t *mdle;
+    uint8_t kind;
+    uint32_t idx;
+} wrp_export_handle_t;
+
 typedef struct wrp_wasm_mdle {
     alignas(64) int8_t *param_type_buf;
     int8_t *result_type_buf;
@@ -377,10 +561,11 @@ typedef struct wrp_wasm_mdle {
     uint8_t *code_buf;
     size_t *block_addrs_buf;
     size_t *block_label_buf;
+    size_t *block_cost_buf;
     size_t *if_addrs_buf;
     size_t *else_addrs_buf;
     size_t *if_label_buf;
-    uint64_t *global_buf;
+    uint8_t *global_expr_buf;
     char *import_name_buf;
     char *import_field_buf;
     char *export_name_buf;
@@ -394,8 +579,10 @@ typedef struct wrp_wasm_mdle {
     uint32_t num_types;
     wrp_func_t *funcs;
     uint32_t num_funcs;
+    uint32_t num_func_imports;
     wrp_global_t *globals;
     uint32_t num_globals;
+    uint32_t num_global_imports;
     wrp_table_t *tables;
     uint32_t num_tables;
     wrp_elem_segment_t *elem_segments;
@@ -408,12 +595,44 @@ typedef struct wrp_wasm_mdle {
     uint32_t num_imports;
     wrp_export_t *exports;
     uint32_t num_exports;
+    wrp_name_slot_t *import_index;
+    uint32_t import_index_sz;
+    wrp_name_slot_t *export_index;
+    uint32_t export_index_sz;
+    wrp_vm_t *check_vm;
+    atomic_flag check_lock;
+    wrp_wasm_meta_t meta;
+    bool image;
 } wrp_wasm_mdle_t;
 
+//the state a module changes while it runs, any number of instances share one
+//module. Memories and tables start as copies of the module's descriptors.
+//Globals are stored inline by index, imported ones come first and are read
+//through the pointer the host bound instead. Imported functions also come
+//first and are called through the host function or instance bound to them.
+typedef struct wrp_instance {
+    alignas(64) wrp_wasm_mdle_t *mdle;
+    wrp_func_import_t *func_imports;
+    uint64_t **global_imports;
+    uint64_t *global_buf;
+    wrp_memory_t *memories;
+    wrp_table_t *tables;
+    wrp_table_entry_t *elem_buf;
+    bool initialized;
+    bool initializing;
+    bool globals_dirty;
+    const void *sched_owner;
+    uint64_t sched_frame;
+} wrp_instance_t;
+
 size_t wrp_mdle_sz(wrp_wasm_meta_t *meta);
 
 void wrp_mdle_init(wrp_wasm_meta_t *meta, wrp_wasm_mdle_t *out_mdle);
 
+size_t wrp_instance_sz(wrp_wasm_mdle_t *mdle);
+
+void wrp_instance_init(wrp_wasm_mdle_t *mdle, wrp_instance_t *out_instance);
+
 bool wrp_is_valid_wasm_type(int8_t type);
 
 bool wrp_is_valid_block_signature(int8_t type);
@@ -422,7 +641,9 @@ bool wrp_is_valid_value_type(int8_t type);
 
 bool wrp_is_valid_elem_type(int8_t elem_type);
 
-wrp_err_t wrp_check_meta(wrp_wasm_meta_t *meta);
+void wrp_default_limits(wrp_limits_t *out_limits);
+
+wrp_err_t wrp_check_meta(wrp_wasm_meta_t *meta, const wrp_limits_t *limits);
 
 wrp_err_t wrp_get_block_idx(wrp_wasm_mdle_t *mdle,
     uint32_t func_idx,
@@ -434,11 +655,57 @@ wrp_err_t wrp_get_if_idx(wrp_wasm_mdle_t *mdle,
     size_t if_address,
     uint32_t *out_if_idx);
 
+//smallest power of two at least twice count, zero for none
+uint32_t wrp_index_sz(uint32_t count);
+
+uint32_t wrp_hash_import(const char *mdle_name, const char *field);
+
+uint32_t wrp_hash_signature(const wrp_type_t *type);
+
+//fails with WRP_ERR_MDLE_DUPLICATE_EXPORT, imports may repeat a name and
+//the first of them is found
+wrp_err_t wrp_index_names(wrp_wasm_mdle_t *mdle);
+
+wrp_err_t wrp_find_export(const wrp_wasm_mdle_t *mdle,
+    const char *name,
+    wrp_export_handle_t *out_handle);
+
+wrp_err_t wrp_find_import(const wrp_wasm_mdle_t *mdle,
+    const char *mdle_name,
+    const char *field,
+    uint32_t *out_import_idx);
+
 wrp_err_t wrp_export_func(wrp_wasm_mdle_t *mdle,
     const char *func_name,
     uint32_t *out_func_idx);
 
-wrp_err_t wrp_import_global(wrp_wasm_mdle_t *mdle,
+//fails with WRP_ERR_TYPE_MISMATCH if the signatures differ
+wrp_err_t wrp_import_func(wrp_instance_t *instance,
+    const wrp_host_func_t *func,
+    uint32_t func_idx);
+
+//binds the import to exporter_func_idx of another instance, which must
+//outlive instance. A function exporter imported itself is followed to what it
+//is bound to, so its imports must be bound first. Fails with
+//WRP_ERR_TYPE_MISMATCH if the signatures differ.
+wrp_err_t wrp_import_instance_func(wrp_instance_t *instance,
+    wrp_instance_t *exporter,
+    uint32_t exporter_func_idx,
+    uint32_t func_idx);
+
+wrp_err_t wrp_import_global(wrp_instance_t *instance,
     uint64_t *global,
     uint32_t global_idx);
 
+//imported globals export the host's value
+wrp_err_t wrp_export_global(wrp_instance_t *instance,
+    const char *global_name,
+    uint64_t **out_global);
+
+wrp_err_t wrp_export_memory(wrp_instance_t *instance,
+    const char *memory_name,
+    wrp_memory_t **out_memory);
+
+wrp_err_t wrp_import_memory(wrp_instance_t *instance,
+    wrp_memory_t *memory,
+    uint32_t memory_idx);
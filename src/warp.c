@@ -19,9 +19,12 @@
 
 #include "warp-encode.h"
 #include "warp-execution.h"
+#include "warp-image.h"
 #include "warp-load.h"
-#include "warp-scan.h"
+#include "warp-macros.h"
+#include "warp-memory.h"
 #include "warp-stack-ops.h"
+#include "warp-table.h"
 #include "warp-type-check.h"
 #include "warp-wasm.h"
 #include "warp.h"
@@ -41,136 +44,362 @@ wrp_vm_t *wrp_open_vm(wrp_alloc_fn_t alloc_fn, wrp_free_fn_t free_fn)
     vm->alloc_fn = alloc_fn;
     vm->free_fn = free_fn;
     vm->mdle = NULL;
+    vm->instance = NULL;
+    vm->memory = NULL;
+    vm->globals = NULL;
+    vm->global_imports = NULL;
+    vm->num_global_imports = 0;
     vm->oprd_stk_head = -1;
     vm->ctrl_stk_head = -1;
     vm->call_stk_head = -1;
     vm->opcode_stream.bytes = NULL;
     vm->opcode_stream.sz = 0;
     vm->opcode_stream.pos = 0;
+    vm->thread_pool.run_workers = NULL;
+    vm->thread_pool.pool = NULL;
+    vm->thread_pool.num_workers = 0;
+    vm->check_workers = NULL;
+    vm->num_check_workers = 0;
+    vm->lazy_validation = false;
+    vm->fuel_metered = false;
+    vm->fuel = 0;
+    vm->suspended = false;
+    vm->entry_stopped = false;
+    vm->entry_func_idx = 0;
+    vm->pending_host_type = NULL;
+    atomic_init(&vm->suspend_requested, false);
+    wrp_default_limits(&vm->limits);
     vm->err = WRP_SUCCESS;
     return vm;
 }
 
-wrp_wasm_mdle_t *wrp_instantiate_mdle(wrp_vm_t *vm, wrp_buf_t *buf)
+void wrp_set_thread_pool(wrp_vm_t *vm, const wrp_thread_pool_t *pool)
+{
+    if (pool == NULL) {
+        vm->thread_pool.run_workers = NULL;
+        vm->thread_pool.pool = NULL;
+        vm->thread_pool.num_workers = 0;
+        return;
+    }
+
+    vm->thread_pool = *pool;
+}
+
+void wrp_set_fuel(wrp_vm_t *vm, uint64_t fuel)
+{
+    vm->fuel_metered = true;
+    vm->fuel = fuel;
+}
+
+void wrp_disable_fuel(wrp_vm_t *vm)
+{
+    vm->fuel_metered = false;
+    vm->fuel = 0;
+}
+
+uint64_t wrp_get_fuel(const wrp_vm_t *vm)
+{
+    return vm->fuel;
+}
+
+void wrp_request_suspend(wrp_vm_t *vm)
+{
+    atomic_store_explicit(&vm->suspend_requested, true, memory_order_relaxed);
+}
+
+bool wrp_is_suspended(const wrp_vm_t *vm)
+{
+    return vm->suspended;
+}
+
+bool wrp_is_host_call_pending(const wrp_vm_t *vm)
+{
+    return vm->pending_host_type != NULL;
+}
+
+wrp_err_t wrp_complete_host_call(wrp_vm_t *vm, const wrp_oprd_t *results, uint32_t num_results)
+{
+    const wrp_type_t *type = vm->pending_host_type;
+
+    if (type == NULL) {
+        return WRP_ERR_UNKNOWN;
+    }
+
+    if (num_results != type->num_results) {
+        return WRP_ERR_TYPE_MISMATCH;
+    }
+
+    for (uint32_t i = 0; i < num_results; i++) {
+        if (results[i].type != type->result_types[i]) {
+            return WRP_ERR_TYPE_MISMATCH;
+        }
+    }
+
+    for (uint32_t i = 0; i < num_results; i++) {
+        WRP_CHECK(wrp_stk_exec_push_op(vm, results[i].value, (int8_t)results[i].type));
+    }
+
+    vm->pending_host_type = NULL;
+    return WRP_SUCCESS;
+}
+
+void wrp_set_lazy_validation(wrp_vm_t *vm, bool lazy)
+{
+    vm->lazy_validation = lazy;
+}
+
+void wrp_set_limits(wrp_vm_t *vm, const wrp_limits_t *limits)
+{
+    vm->limits = *limits;
+}
+
+static wrp_wasm_mdle_t *check_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle)
+{
+    if ((vm->err = wrp_type_check_mdle(vm, mdle)) != WRP_SUCCESS) {
+        wrp_destroy_mdle(vm, mdle);
+        vm->mdle = NULL;
+        return NULL;
+    }
+
+    vm->err = WRP_SUCCESS;
+    return mdle;
+}
+
+static wrp_wasm_mdle_t *instantiate_mdle(wrp_vm_t *vm, wrp_buf_t *buf, bool in_place)
 {
     if (vm->mdle != NULL) {
         return NULL;
     }
 
-    wrp_wasm_meta_t meta = {0};
+    wrp_wasm_mdle_t *mdle = NULL;
 
     vm->err = WRP_ERR_UNKNOWN;
 
-    if ((vm->err = wrp_scan_mdle(buf, &meta)) != WRP_SUCCESS) {
+    if ((vm->err = wrp_load_mdle(vm, buf, in_place, &mdle)) != WRP_SUCCESS) {
+        return NULL;
+    }
+
+    return check_mdle(vm, mdle);
+}
+
+wrp_wasm_mdle_t *wrp_instantiate_mdle(wrp_vm_t *vm, wrp_buf_t *buf)
+{
+    return instantiate_mdle(vm, buf, false);
+}
+
+wrp_wasm_mdle_t *wrp_instantiate_mdle_in_place(wrp_vm_t *vm, wrp_buf_t *buf)
+{
+    return instantiate_mdle(vm, buf, true);
+}
+
+wrp_stream_t *wrp_stream_begin(wrp_vm_t *vm)
+{
+    if (vm->mdle != NULL) {
         return NULL;
     }
 
-    if ((vm->err = wrp_check_meta(&meta)) != WRP_SUCCESS) {
+    wrp_stream_t *stream = NULL;
+
+    if ((vm->err = wrp_load_stream_begin(vm, &stream)) != WRP_SUCCESS) {
         return NULL;
     }
 
-    size_t mdle_sz = wrp_mdle_sz(&meta);
+    return stream;
+}
 
-    wrp_wasm_mdle_t *mdle = vm->alloc_fn(mdle_sz, 64);
+wrp_err_t wrp_stream_feed(wrp_vm_t *vm, wrp_stream_t *stream, const uint8_t *bytes, size_t sz)
+{
+    return (vm->err = wrp_load_stream_feed(stream, bytes, sz));
+}
 
-    if (mdle == NULL) {
-        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
-        return mdle;
+wrp_wasm_mdle_t *wrp_stream_finish(wrp_vm_t *vm, wrp_stream_t *stream)
+{
+    wrp_wasm_mdle_t *mdle = NULL;
+
+    if ((vm->err = wrp_load_stream_finish(stream, &mdle)) != WRP_SUCCESS) {
+        return NULL;
     }
 
-    wrp_mdle_init(&meta, mdle);
+    return check_mdle(vm, mdle);
+}
 
-    if ((vm->err = wrp_load_mdle(vm, buf, mdle)) != WRP_SUCCESS) {
-        wrp_destroy_mdle(vm, mdle);
-        vm->mdle = NULL;
+wrp_err_t wrp_serialize_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, wrp_buf_t *out_image)
+{
+    return (vm->err = wrp_write_mdle_image(vm, mdle, out_image));
+}
+
+static wrp_wasm_mdle_t *deserialize_mdle(wrp_vm_t *vm, wrp_buf_t *image, bool in_place)
+{
+    if (vm->mdle != NULL) {
         return NULL;
     }
 
-    if ((vm->err = wrp_type_check_mdle(vm, mdle)) != WRP_SUCCESS) {
-        wrp_destroy_mdle(vm, mdle);
-        vm->mdle = NULL;
+    wrp_wasm_mdle_t *mdle = NULL;
+
+    if ((vm->err = wrp_read_mdle_image(vm, image, in_place, &mdle)) != WRP_SUCCESS) {
         return NULL;
     }
 
-    vm->err = WRP_SUCCESS;
     return mdle;
 }
 
+wrp_wasm_mdle_t *wrp_deserialize_mdle(wrp_vm_t *vm, wrp_buf_t *image)
+{
+    return deserialize_mdle(vm, image, false);
+}
+
+wrp_wasm_mdle_t *wrp_deserialize_mdle_in_place(wrp_vm_t *vm, wrp_buf_t *image)
+{
+    return deserialize_mdle(vm, image, true);
+}
+
 void wrp_destroy_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle)
 {
+    if (mdle->check_vm != NULL) {
+        wrp_close_vm(mdle->check_vm);
+    }
+
     for (uint32_t i = 0; i < mdle->num_memories; i++) {
-        if (mdle->memories[i].bytes != NULL) {
-            vm->free_fn(mdle->memories[i].bytes);
-        }
+        wrp_mem_free_image(&mdle->memories[i]);
     }
 
-    vm->free_fn(mdle);
+    //a module deserialized in place lives in its image, which the caller owns
+    if (!mdle->image) {
+        vm->free_fn(mdle);
+    }
 }
 
-wrp_err_t wrp_link_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle)
+wrp_err_t wrp_validate_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle)
 {
-    if (vm->mdle) {
-        return WRP_ERR_UNKNOWN;
+    return wrp_type_check_remaining_funcs(vm, mdle);
+}
+
+wrp_instance_t *wrp_create_instance(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle)
+{
+    size_t instance_sz = wrp_instance_sz(mdle);
+    wrp_instance_t *instance = vm->alloc_fn(instance_sz, 64);
+
+    if (instance == NULL) {
+        vm->err = WRP_ERR_MEMORY_ALLOCATION_FAILED;
+        return NULL;
     }
 
-    vm->mdle = mdle;
+    memset(instance, 0, instance_sz);
+    wrp_instance_init(mdle, instance);
 
-    for (uint32_t i = 0; i < mdle->num_imports; i++) {
-        if (mdle->imports[i].kind == EXTERNAL_GLOBAL && mdle->globals[mdle->imports[i].idx].value == NULL) {
-            vm->mdle = NULL;
-            vm->err = WRP_ERR_MISSING_GLOBAL_IMPORT;
-            return vm->err;
-        }
+    vm->err = WRP_SUCCESS;
+    return instance;
+}
+
+void wrp_destroy_instance(wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    for (uint32_t i = 0; i < instance->mdle->num_memories; i++) {
+        wrp_mem_free(vm, &instance->memories[i]);
     }
 
-    // TODO run element init expressions
+    vm->free_fn(instance);
+}
 
-    for (uint32_t i = 0; i < mdle->num_memories; i++) {
-        if (mdle->memories[i].num_pages != 0) {
-            memset(mdle->memories[i].bytes, 0, mdle->memories[i].num_pages * PAGE_SIZE);
+void wrp_reset_instance(wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    //defined globals are re-evaluated from their init exprs, and tables and
+    //memories are reset in place, by the next link
+    instance->initialized = false;
+}
+
+static wrp_err_t init_instance(wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+
+    for (uint32_t i = 0; i < mdle->num_func_imports; i++) {
+        wrp_func_import_t *import = &instance->func_imports[i];
+
+        if (import->host.fn == NULL && import->instance == NULL) {
+            return WRP_ERR_MISSING_FUNC_IMPORT;
         }
     }
 
-    for (uint32_t i = 0; i < mdle->num_data_segments; i++) {
-        wrp_data_segment_t *segment = &mdle->data_segments[i];
-        uint32_t mem_idx = segment->mem_idx;
-        uint32_t mem_sz = mdle->memories[segment->mem_idx].num_pages * PAGE_SIZE;
-        uint32_t data_sz = segment->sz;
-        uint64_t offset_value = 0;
+    //instances it imports functions from are initialized first, as if they
+    //had been instantiated before it, instances importing from each other
+    //are skipped once they are on the way
+    instance->initializing = true;
 
-        if ((vm->err = wrp_exec_init_expr(vm, &segment->offset_expr, &offset_value)) != WRP_SUCCESS) {
-            vm->mdle = NULL;
-            return vm->err;
+    for (uint32_t i = 0; i < mdle->num_func_imports; i++) {
+        wrp_instance_t *exporter = instance->func_imports[i].instance;
+
+        if (exporter != NULL && !exporter->initialized && !exporter->initializing) {
+            wrp_err_t err = init_instance(vm, exporter);
+
+            if (err != WRP_SUCCESS) {
+                instance->initializing = false;
+                return err;
+            }
         }
+    }
 
-        int32_t offset = wrp_decode_i32(offset_value);
+    instance->initializing = false;
 
-        if ((offset < 0 || offset + data_sz > mem_sz)) {
-            vm->mdle = NULL;
-            vm->err = WRP_ERR_INVALID_MEMORY_ACCESS;
-            return vm->err;
+    //initializers run on the vm's stacks, which validation may have left dirty
+    wrp_reset_vm(vm);
+    wrp_stk_exec_enter_instance(vm, instance);
+
+    for (uint32_t i = 0; i < mdle->num_global_imports; i++) {
+        if (instance->global_imports[i] == NULL) {
+            return WRP_ERR_MISSING_GLOBAL_IMPORT;
         }
+    }
+
+    for (uint32_t i = mdle->num_global_imports; i < mdle->num_globals; i++) {
+        WRP_CHECK(wrp_exec_init_expr(vm, &mdle->globals[i].init_expr, &instance->global_buf[i]));
+    }
+
+    instance->globals_dirty = false;
+
+    for (uint32_t i = 0; i < mdle->num_tables; i++) {
+        WRP_CHECK(wrp_table_init(vm, instance, i));
+    }
+
+    for (uint32_t i = 0; i < mdle->num_memories; i++) {
+        WRP_CHECK(wrp_mem_init(vm, instance, i));
+    }
+
+    instance->initialized = true;
+    return WRP_SUCCESS;
+}
+
+static void clear_instance(wrp_vm_t *vm)
+{
+    vm->mdle = NULL;
+    vm->instance = NULL;
+    vm->memory = NULL;
+    vm->globals = NULL;
+    vm->global_imports = NULL;
+    vm->num_global_imports = 0;
+}
+
+wrp_err_t wrp_link_instance(wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    if (vm->mdle) {
+        return WRP_ERR_UNKNOWN;
+    }
 
-        memcpy(mdle->memories[mem_idx].bytes + offset, segment->data, data_sz);
+    if (!instance->initialized && (vm->err = init_instance(vm, instance)) != WRP_SUCCESS) {
+        clear_instance(vm);
+        return vm->err;
     }
 
+    wrp_stk_exec_enter_instance(vm, instance);
     return WRP_SUCCESS;
 }
 
-wrp_err_t wrp_unlink_mdle(wrp_vm_t *vm)
+wrp_err_t wrp_unlink_instance(wrp_vm_t *vm)
 {
     if (vm->mdle == NULL) {
         vm->err = WRP_ERR_UNKNOWN;
         return vm->err;
     }
 
-    for (uint32_t i = 0; i < vm->mdle->num_imports; i++) {
-        if (vm->mdle->imports[i].kind == EXTERNAL_GLOBAL){
-            vm->mdle->globals[vm->mdle->imports[i].idx].value = NULL;
-        }
-    }
-
-    vm->mdle = NULL;
+    clear_instance(vm);
     return WRP_SUCCESS;
 }
 
@@ -189,7 +418,50 @@ wrp_err_t wrp_call(wrp_vm_t *vm, uint32_t func_idx)
         return WRP_ERR_INVALID_FUNC_IDX;
     }
 
-    return (vm->err = wrp_exec_func(vm, func_idx));
+    //the stacks still hold the suspended call
+    if (vm->suspended) {
+        return WRP_ERR_VM_SUSPENDED;
+    }
+
+    wrp_instance_t *instance = vm->instance;
+    vm->err = wrp_exec_func(vm, func_idx);
+
+    //a trap in an imported instance's function leaves that instance entered
+    if (vm->instance != instance) {
+        wrp_stk_exec_enter_instance(vm, instance);
+    }
+
+    return vm->err;
+}
+
+wrp_err_t wrp_resume(wrp_vm_t *vm)
+{
+    if (vm->mdle == NULL || !vm->suspended) {
+        return WRP_ERR_UNKNOWN;
+    }
+
+    if (vm->pending_host_type != NULL) {
+        return WRP_ERR_HOST_PENDING;
+    }
+
+    wrp_instance_t *instance = vm->instance;
+    vm->err = wrp_exec_resume(vm);
+
+    //the linked instance is entered again, whether the call finished or not
+    if (vm->instance != instance) {
+        wrp_stk_exec_enter_instance(vm, instance);
+    }
+
+    return vm->err;
+}
+
+wrp_err_t wrp_call_export(wrp_vm_t *vm, const wrp_export_handle_t *handle)
+{
+    if (handle->mdle != vm->mdle || handle->kind != EXTERNAL_FUNC) {
+        return WRP_ERR_UNKNOWN_FUNC;
+    }
+
+    return wrp_call(vm, handle->idx);
 }
 
 void wrp_reset_vm(wrp_vm_t *vm)
@@ -200,10 +472,22 @@ void wrp_reset_vm(wrp_vm_t *vm)
     vm->opcode_stream.bytes = NULL;
     vm->opcode_stream.sz = 0;
     vm->opcode_stream.pos = 0;
+    vm->suspended = false;
+    vm->entry_stopped = false;
+    vm->pending_host_type = NULL;
+    atomic_store_explicit(&vm->suspend_requested, false, memory_order_relaxed);
     vm->err = WRP_SUCCESS;
 }
 
 void wrp_close_vm(wrp_vm_t *vm)
 {
+    if (vm->check_workers != NULL) {
+        for (uint32_t i = 0; i < vm->num_check_workers; i++) {
+            wrp_close_vm(vm->check_workers[i]);
+        }
+
+        vm->free_fn(vm->check_workers);
+    }
+
     vm->free_fn(vm);
 }
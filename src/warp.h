@@ -26,14 +26,13 @@
 #include "warp-buf.h"
 #include "warp-config.h"
 #include "warp-error.h"
+#include "warp-memory.h"
+#include "warp-registry.h"
 #include "warp-stack-ops.h"
+#include "warp-thread.h"
 #include "warp-types.h"
 #include "warp-wasm.h"
 
-typedef void *(*wrp_alloc_fn_t)(size_t size, size_t align);
-
-typedef void (*wrp_free_fn_t)(void *ptr);
-
 typedef struct wrp_oprd {
     uint64_t value;
     uint8_t type;
@@ -46,17 +45,27 @@ typedef struct wrp_ctrl_frame {
     int8_t signature;
     int32_t oprd_stk_ptr;
     bool unreachable;
+    size_t fuel_cost;
 } wrp_ctrl_frame_t;
 
+//instance is the one func_idx belongs to, entered again on returning into it
 typedef struct wrp_call_frame {
+    wrp_instance_t *instance;
     uint32_t func_idx;
     int32_t oprd_stk_ptr;
     int32_t ctrl_stk_ptr;
     size_t return_ptr;
 } wrp_call_frame_t;
 
+//mdle, instance, memory and globals are those of the instance currently
+//running, calls into an imported instance's functions switch them
 typedef struct wrp_vm {
     wrp_wasm_mdle_t *mdle;
+    wrp_instance_t *instance;
+    wrp_memory_t *memory;
+    uint64_t *globals;
+    uint64_t **global_imports;
+    uint32_t num_global_imports;
     wrp_alloc_fn_t alloc_fn;
     wrp_free_fn_t free_fn;
     wrp_oprd_t oprd_stk[WRP_OPERAND_STK_SZ];
@@ -66,23 +75,139 @@ typedef struct wrp_vm {
     wrp_call_frame_t call_stk[WRP_CALL_STK_SZ];
     int32_t call_stk_head;
     wrp_buf_t opcode_stream;
+    wrp_thread_pool_t thread_pool;
+    wrp_vm_t **check_workers;
+    uint32_t num_check_workers;
+    bool lazy_validation;
+    bool fuel_metered;
+    uint64_t fuel;
+    bool suspended;
+    bool entry_stopped;
+    uint32_t entry_func_idx;
+    const wrp_type_t *pending_host_type;
+    atomic_bool suspend_requested;
+    wrp_limits_t limits;
     wrp_err_t err;
 } wrp_vm_t;
 
 wrp_vm_t *wrp_open_vm(wrp_alloc_fn_t alloc_fn, wrp_free_fn_t free_fn);
 
+//functions of later instantiations are validated by pool->num_workers
+//workers, NULL or fewer than two workers validates on the calling thread
+void wrp_set_thread_pool(wrp_vm_t *vm, const wrp_thread_pool_t *pool);
+
+//when enabled, later instantiations leave function bodies unchecked and each
+//function is validated on its first call, which traps if it is invalid.
+//The check runs under the module's lock, so vms sharing a module on other
+//threads may call into it at the same time
+void wrp_set_lazy_validation(wrp_vm_t *vm, bool lazy);
+
+//limits later instantiations are checked against, and the address space
+//their memory64 memories reserve up front, wrp_open_vm starts with the
+//defaults in warp-config.h
+void wrp_set_limits(wrp_vm_t *vm, const wrp_limits_t *limits);
+
+//meters later calls. Validation counts the instructions in each function
+//body and loop, nested blocks and both arms of an if included, and a loop
+//counts once in the body or loop around it. Fuel is only checked where it
+//is charged: a call pays for the callee's body and a loop back-edge for the
+//loop, so the charge is an upper bound on what runs. A call that runs out
+//stops with WRP_ERR_OUT_OF_FUEL, the fuel it couldn't pay for is left
+//unspent and it can be resumed once more is set.
+void wrp_set_fuel(wrp_vm_t *vm, uint64_t fuel);
+
+void wrp_disable_fuel(wrp_vm_t *vm);
+
+uint64_t wrp_get_fuel(const wrp_vm_t *vm);
+
+//stops the running call at its next call or loop back-edge with
+//WRP_ERR_SUSPEND_REQUESTED, safe to call from any thread. A request made
+//while nothing runs stops the next call before it starts.
+void wrp_request_suspend(wrp_vm_t *vm);
+
+//true after a call stopped with WRP_ERR_OUT_OF_FUEL,
+//WRP_ERR_SUSPEND_REQUESTED, WRP_ERR_HOST_YIELD or WRP_ERR_HOST_PENDING,
+//until it is resumed or the vm is reset
+bool wrp_is_suspended(const wrp_vm_t *vm);
+
+//true from a host function returning WRP_ERR_HOST_PENDING until the call is
+//completed, resuming before then returns WRP_ERR_HOST_PENDING
+bool wrp_is_host_call_pending(const wrp_vm_t *vm);
+
+//pushes the results of the pending host call, checked against its import's
+//type, after which the vm can be resumed. The vm mustn't be used by another
+//thread while the call is completed.
+wrp_err_t wrp_complete_host_call(wrp_vm_t *vm, const wrp_oprd_t *results, uint32_t num_results);
+
 wrp_wasm_mdle_t *wrp_instantiate_mdle(wrp_vm_t *vm, wrp_buf_t *buf);
 
+//code, data and init expressions reference buf rather than being copied,
+//its bytes must stay valid and unmodified until the module is destroyed
+wrp_wasm_mdle_t *wrp_instantiate_mdle_in_place(wrp_vm_t *vm, wrp_buf_t *buf);
+
+//instantiates a module from chunks of bytes as they arrive, sections are
+//loaded and function bodies validated while later chunks are still on their
+//way, vm must not be used for anything else until the stream is finished
+wrp_stream_t *wrp_stream_begin(wrp_vm_t *vm);
+
+//after an error every later feed returns it too
+wrp_err_t wrp_stream_feed(wrp_vm_t *vm, wrp_stream_t *stream, const uint8_t *bytes, size_t sz);
+
+//frees the stream, returns NULL if the stream failed or ended mid-section
+wrp_wasm_mdle_t *wrp_stream_finish(wrp_vm_t *vm, wrp_stream_t *stream);
+
+//writes a validated copy of the module to out_image, allocated with the vm's
+//allocator, which wrp_deserialize_mdle can use without loading or validating
+//it again. Modules instantiated in place can't be serialized.
+wrp_err_t wrp_serialize_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, wrp_buf_t *out_image);
+
+//the module is copied out of image, whose bytes must be 64 byte aligned and
+//are only read, so a read-only mapping can be shared and read any number of
+//times. Only images written by the same build are read.
+wrp_wasm_mdle_t *wrp_deserialize_mdle(wrp_vm_t *vm, wrp_buf_t *image);
+
+//the module is relocated in place inside image, whose bytes must also be
+//writable, e.g. a private file mapping, and must stay valid until the module
+//is destroyed. The image is checked before it's written, a rejected image is
+//left unchanged, and once read it can't be read again.
+wrp_wasm_mdle_t *wrp_deserialize_mdle_in_place(wrp_vm_t *vm, wrp_buf_t *image);
+
 void wrp_destroy_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle);
 
-wrp_err_t wrp_link_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle);
+//validates every function not yet checked, for tooling over lazy modules
+wrp_err_t wrp_validate_mdle(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle);
+
+//instances hold the globals, memories and tables of a module, which stays
+//unchanged so any number of instances in any number of vms can share it.
+//The module must outlive its instances.
+wrp_instance_t *wrp_create_instance(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle);
+
+void wrp_destroy_instance(wrp_vm_t *vm, wrp_instance_t *instance);
 
-wrp_err_t wrp_unlink_mdle(wrp_vm_t *vm);
+//returns the instance to the state it was created in, imports are kept
+void wrp_reset_instance(wrp_vm_t *vm, wrp_instance_t *instance);
+
+//attaches the instance to vm, its memories are initialized on the first
+//link and keep their contents when it is linked again
+wrp_err_t wrp_link_instance(wrp_vm_t *vm, wrp_instance_t *instance);
+
+wrp_err_t wrp_unlink_instance(wrp_vm_t *vm);
 
 wrp_err_t wrp_start(wrp_vm_t *vm);
 
 wrp_err_t wrp_call(wrp_vm_t *vm, uint32_t func_idx);
 
+//calls a function export resolved with wrp_find_export, without looking up
+//its name again, the handle must come from the module linked to vm
+wrp_err_t wrp_call_export(wrp_vm_t *vm, const wrp_export_handle_t *handle);
+
+//continues a suspended call from where it stopped, it can stop again and
+//leaves its results on the operand stack like wrp_call once it finishes.
+//A suspended vm can't start another call, wrp_call fails with
+//WRP_ERR_VM_SUSPENDED until it's resumed to the end or reset, which
+//abandons the suspended call.
+wrp_err_t wrp_resume(wrp_vm_t *vm);
+
 void wrp_reset_vm(wrp_vm_t *vm);
 
 void wrp_close_vm(wrp_vm_t *vm);
@@ -0,0 +1,174 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <string.h>
+
+#include "async-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+#define NUM_PARKED_VMS 32
+
+static const int8_t i32[] = {I32};
+
+typedef struct load_request {
+    wrp_vm_t *vm;
+    int32_t key;
+} load_request_t;
+
+typedef struct load_queue {
+    load_request_t requests[NUM_PARKED_VMS];
+    uint32_t num_requests;
+} load_queue_t;
+
+//queues the load, the test completes it later as the engine would
+static wrp_err_t host_load(wrp_vm_t *vm, void *ctx)
+{
+    load_queue_t *queue = ctx;
+
+    if (queue->num_requests >= NUM_PARKED_VMS) {
+        return WRP_ERR_UNKNOWN;
+    }
+
+    load_request_t *request = &queue->requests[queue->num_requests];
+    wrp_err_t err = wrp_stk_exec_pop_i32(vm, &request->key);
+
+    if (err != WRP_SUCCESS) {
+        return err;
+    }
+
+    request->vm = vm;
+    queue->num_requests++;
+    return WRP_ERR_HOST_PENDING;
+}
+
+static wrp_err_t complete_load(const load_request_t *request)
+{
+    wrp_oprd_t result = {(uint64_t)(uint32_t)(request->key * 10), I32};
+    return wrp_complete_host_call(request->vm, &result, 1);
+}
+
+static void test_pending_calls(wrp_vm_t *vm, load_queue_t *queue, uint32_t *passed, uint32_t *failed)
+{
+    //each load parks the vm until the test completes it
+    queue->num_requests = 0;
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 2);
+    wrp_stk_exec_push_i32(vm, 3);
+    test_check("async", wrp_call(vm, find_func(vm, "load_sum")) == WRP_ERR_HOST_PENDING, "first load parked", passed, failed);
+    test_check("async", wrp_is_suspended(vm) && wrp_is_host_call_pending(vm), "first load pending", passed, failed);
+    test_check("async", wrp_resume(vm) == WRP_ERR_HOST_PENDING, "resume before completion", passed, failed);
+
+    //completions are checked against the import's results
+    wrp_oprd_t wrong[] = {{0, I64}, {0, I32}};
+    test_check("async", wrp_complete_host_call(vm, wrong, 1) == WRP_ERR_TYPE_MISMATCH, "wrong result type", passed, failed);
+    test_check("async", wrp_complete_host_call(vm, wrong + 1, 0) == WRP_ERR_TYPE_MISMATCH, "missing result", passed, failed);
+    test_check("async", wrp_is_host_call_pending(vm), "still pending", passed, failed);
+
+    test_check("async", queue->num_requests == 1 && complete_load(&queue->requests[0]) == WRP_SUCCESS, "first load completed", passed, failed);
+    test_check("async", wrp_complete_host_call(vm, wrong + 1, 1) == WRP_ERR_UNKNOWN, "completed twice", passed, failed);
+    test_check("async", wrp_resume(vm) == WRP_ERR_HOST_PENDING, "second load parked", passed, failed);
+    test_check("async", queue->num_requests == 2 && complete_load(&queue->requests[1]) == WRP_SUCCESS, "second load completed", passed, failed);
+    test_check("async", wrp_resume(vm) == WRP_SUCCESS && pop_result(vm, 50), "load_sum finished", passed, failed);
+    test_check("async", !wrp_is_suspended(vm) && !wrp_is_host_call_pending(vm), "load_sum resumed", passed, failed);
+
+    //an exported import parks its caller before any frame is pushed
+    queue->num_requests = 0;
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 7);
+    test_check("async", wrp_call(vm, find_func(vm, "load")) == WRP_ERR_HOST_PENDING, "direct load parked", passed, failed);
+    test_check("async", complete_load(&queue->requests[0]) == WRP_SUCCESS, "direct load completed", passed, failed);
+    test_check("async", wrp_resume(vm) == WRP_SUCCESS && pop_result(vm, 70), "direct load finished", passed, failed);
+
+    //resetting abandons a pending call
+    queue->num_requests = 0;
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 1);
+    wrp_stk_exec_push_i32(vm, 1);
+    test_check("async", wrp_call(vm, find_func(vm, "load_sum")) == WRP_ERR_HOST_PENDING, "abandoned load parked", passed, failed);
+    wrp_reset_vm(vm);
+    test_check("async", !wrp_is_host_call_pending(vm) && wrp_resume(vm) == WRP_ERR_UNKNOWN, "abandoned load", passed, failed);
+}
+
+static void test_parked_vms(wrp_vm_t *vm, load_queue_t *queue, wrp_registry_t *registry, uint32_t *passed, uint32_t *failed)
+{
+    wrp_vm_t *vms[NUM_PARKED_VMS];
+    wrp_instance_t *instances[NUM_PARKED_VMS];
+    queue->num_requests = 0;
+
+    //every vm waits on its first load without holding a thread
+    for (uint32_t i = 0; i < NUM_PARKED_VMS; i++) {
+        vms[i] = wrp_open_vm(test_alloc, test_free);
+        ASSERT(vms[i], "vm failed to initialise");
+        instances[i] = wrp_create_instance(vms[i], vm->mdle);
+        ASSERT(instances[i], "failed to create instance");
+        ASSERT(wrp_import_registry(instances[i], registry) == WRP_SUCCESS, "failed to import registry");
+        ASSERT(wrp_link_instance(vms[i], instances[i]) == WRP_SUCCESS, "failed to link instance");
+
+        wrp_reset_vm(vms[i]);
+        wrp_stk_exec_push_i32(vms[i], (int32_t)i);
+        wrp_stk_exec_push_i32(vms[i], 1);
+        test_check("async", wrp_call(vms[i], find_func(vms[i], "load_sum")) == WRP_ERR_HOST_PENDING, "vm parked", passed, failed);
+    }
+
+    test_check("async", queue->num_requests == NUM_PARKED_VMS, "every vm parked", passed, failed);
+
+    load_request_t first_loads[NUM_PARKED_VMS];
+    memcpy(first_loads, queue->requests, sizeof(first_loads));
+    queue->num_requests = 0;
+
+    //loads complete out of order, each vm then parks on its second load
+    for (uint32_t i = NUM_PARKED_VMS; i > 0; i--) {
+        test_check("async", complete_load(&first_loads[i - 1]) == WRP_SUCCESS, "out of order completion", passed, failed);
+        test_check("async", wrp_resume(first_loads[i - 1].vm) == WRP_ERR_HOST_PENDING, "vm parked again", passed, failed);
+    }
+
+    test_check("async", queue->num_requests == NUM_PARKED_VMS, "second loads queued", passed, failed);
+
+    for (uint32_t i = 0; i < NUM_PARKED_VMS; i++) {
+        ASSERT(complete_load(&queue->requests[i]) == WRP_SUCCESS, "failed to complete second load");
+    }
+
+    for (uint32_t i = 0; i < NUM_PARKED_VMS; i++) {
+        test_check("async", wrp_resume(vms[i]) == WRP_SUCCESS && pop_result(vms[i], (int32_t)(i + 1) * 10), "vm finished", passed, failed);
+        ASSERT(wrp_unlink_instance(vms[i]) == WRP_SUCCESS, "failed to unlink instance");
+        wrp_destroy_instance(vms[i], instances[i]);
+        wrp_close_vm(vms[i]);
+    }
+}
+
+void run_async_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_registry_t *registry = wrp_create_registry(vm);
+    ASSERT(registry, "failed to create registry");
+
+    static load_queue_t queue;
+    wrp_host_func_t load = {host_load, &queue, i32, 1, i32, 1};
+    ASSERT(wrp_register_func(vm, registry, "env", "load", &load) == WRP_SUCCESS, "failed to register load");
+
+    load_mdle_with_registry(vm, dir, path_buf, path_buf_sz, "async.0.wasm", registry);
+
+    test_pending_calls(vm, &queue, passed, failed);
+    test_parked_vms(vm, &queue, registry, passed, failed);
+
+    unload_mdle(vm);
+    wrp_destroy_registry(vm, registry);
+}
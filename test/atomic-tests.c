@@ -0,0 +1,244 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdatomic.h>
+
+#include "atomic-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+#include "warp-thread.h"
+
+#define NUM_WAIT_RACES  8
+
+//one worker waits while the other stores and then notifies once. The
+//notify comes after the store, so the waiter either sees the new value
+//or is woken, it never sleeps through to its timeout
+typedef struct wait_race {
+    uint8_t *address;
+    wrp_memory_t *memory;
+    bool wide;
+    atomic_uint next_role;
+    uint32_t wait_result;
+} wait_race_t;
+
+static void wait_or_notify(void *arg)
+{
+    wait_race_t *race = arg;
+
+    if (atomic_fetch_add(&race->next_role, 1) == 0) {
+        int64_t timeout = 1000000000;
+
+        if (race->wide) {
+            wrp_mem_wait64(race->memory, race->address, 0, timeout, &race->wait_result);
+        } else {
+            wrp_mem_wait32(race->memory, race->address, 0, timeout, &race->wait_result);
+        }
+    } else {
+        //a 64 bit waiter must see a store to only the high word
+        if (race->wide) {
+            atomic_fetch_add((_Atomic uint64_t *)race->address, (uint64_t)1 << 32);
+        } else {
+            atomic_fetch_add((_Atomic uint32_t *)race->address, 1);
+        }
+
+        wrp_mem_notify(race->memory, race->address, 1);
+    }
+}
+
+static void test_wait_races(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+#if WRP_FUTEX
+    wrp_memory_t *memory = NULL;
+    ASSERT(wrp_export_memory(vm->instance, "memory", &memory) == WRP_SUCCESS, "failed to export memory");
+
+    for (uint32_t i = 0; i < NUM_WAIT_RACES * 2; i++) {
+        wait_race_t race = {.address = memory->bytes + 32, .memory = memory, .wide = i % 2 == 1};
+        atomic_init(&race.next_role, 0);
+        atomic_store((_Atomic uint64_t *)race.address, 0);
+        wrp_run_workers(NULL, 2, wait_or_notify, &race);
+
+        if (race.wait_result != WRP_WAIT_TIMED_OUT) {
+            (*passed)++;
+        } else {
+            (*failed)++;
+            printf("atomic test wait%s race failed\n", race.wide ? "64" : "32");
+        }
+    }
+
+    atomic_store((_Atomic uint64_t *)(memory->bytes + 32), 0);
+#else
+    (void)vm;
+    (void)passed;
+    (void)failed;
+#endif
+}
+
+void run_atomic_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "atomic.0.wasm");
+
+    START_FUNC_TESTS(vm, "store");
+    TEST_IN_I32_I32(vm, 0, 5);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, 0, 5);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "add");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 3, 5);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "sub");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 1, 8);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "and");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 0xe, 7);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "or");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 0x10, 6);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "xor");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 0x13, 0x16);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "xchg");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 7, 5);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "cmpxchg");
+    TEST_IN_I32_I32_I32_OUT_I32(vm, 0, 7, 9, 7);
+    TEST_IN_I32_I32_I32_OUT_I32(vm, 0, 7, 1, 9);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, 0, 9);
+    TEST_IN_I32_TRAP(vm, 1, WRP_ERR_UNALIGNED_ATOMIC);
+    TEST_IN_I32_TRAP(vm, 0x20000, WRP_ERR_INVALID_MEMORY_ACCESS);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "store");
+    TEST_IN_I32_I32(vm, 8, 0x1ff);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "add8_u");
+    TEST_IN_I32_I32_OUT_I32(vm, 8, 1, 0xff);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, 8, 0x100);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load8_u");
+    TEST_IN_I32_OUT_I32(vm, 9, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "i64.add");
+    TEST_IN_I32_I64_OUT_I64(vm, 16, 0x100000000, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "i64.load");
+    TEST_IN_I32_OUT_I64(vm, 16, 0x100000000);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "notify");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 1, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "wait32");
+    TEST_IN_I32_I32_I64_OUT_I32(vm, 0, 1, 0, 1);
+    TEST_IN_I32_I32_I64_OUT_I32(vm, 0, 9, 0, 2);
+    TEST_IN_I32_I32_I64_TRAP(vm, 2, 0, 0, WRP_ERR_UNALIGNED_ATOMIC);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "wait64");
+    TEST_IN_I32_I64_I64_OUT_I32(vm, 16, 0, 0, 1);
+    TEST_IN_I32_I64_I64_OUT_I32(vm, 16, 0x100000000, 1000, 2);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_wait_races(vm, passed, failed);
+
+    START_FUNC_TESTS(vm, "fence");
+    TEST_EMPTY(vm);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "grow_memory");
+    TEST_IN_I32_OUT_I32(vm, 1, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, 0x1fffc, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //a second vm shares the memory through an import, it sees the grown
+    //memory and its data segment is written into the shared bytes
+    wrp_memory_t *memory = NULL;
+    ASSERT(wrp_export_memory(vm->instance, "memory", &memory) == WRP_SUCCESS, "failed to export memory");
+
+    wrp_vm_t *import_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(import_vm, "vm failed to initialise");
+
+    load_mdle_with_memory(import_vm, dir, path_buf, path_buf_sz, "atomic.1.wasm", memory);
+
+    START_FUNC_TESTS(import_vm, "load");
+    TEST_IN_I32_OUT_I32(import_vm, 64, 42);
+    TEST_IN_I32_OUT_I32(import_vm, 0x1fffc, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(import_vm, "add");
+    TEST_IN_I32_I32_OUT_I32(import_vm, 0, 1, 9);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(import_vm);
+    wrp_close_vm(import_vm);
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, 0, 10);
+    TEST_IN_I32_OUT_I32(vm, 64, 42);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "grow_memory");
+    TEST_IN_I32_OUT_I32(vm, 1, -1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    TEST_LINK(vm, dir, path_buf, path_buf_sz, "atomic.1.wasm", WRP_ERR_MISSING_MEMORY_IMPORT, (*passed), (*failed));
+
+    load_mdle(vm, dir, path_buf, path_buf_sz, "atomic.2.wasm");
+
+    START_FUNC_TESTS(vm, "wait32");
+    TEST_IN_I32_I32_I64_TRAP(vm, 0, 0, 0, WRP_ERR_INVALID_ATOMIC_WAIT);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "notify");
+    TEST_IN_I32_I32_OUT_I32(vm, 0, 1, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "atomic.3.wasm", WRP_ERR_INVALID_MEM_LIMIT, (*passed), (*failed));
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "atomic.4.wasm", WRP_ERR_INVALID_ALIGNMENT, (*passed), (*failed));
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "atomic.5.wasm", WRP_ERR_INVALID_MEM_IDX, (*passed), (*failed));
+}
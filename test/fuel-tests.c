@@ -0,0 +1,113 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "fuel-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+//validation counts 3 instructions directly in sum's body, 2 in its block
+//and 13 in its loop, a call pays for all of them and each of the n
+//back-edges for the loop again
+#define SUM_COST(n) (3 + 2 + 13 * ((n) + 1))
+
+static void test_fuel(wrp_vm_t *vm, uint64_t fuel, uint64_t expected, uint32_t *passed, uint32_t *failed)
+{
+    if (wrp_get_fuel(vm) == expected) {
+        (*passed)++;
+    } else {
+        (*failed)++;
+        printf("fuel test failed. Expected: %llu, Actual: %llu, set: %llu\n",
+            (unsigned long long)expected, (unsigned long long)wrp_get_fuel(vm), (unsigned long long)fuel);
+    }
+}
+
+static void test_metering(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "fuel.0.wasm");
+
+    //exactly enough
+    wrp_set_fuel(vm, SUM_COST(10));
+    START_FUNC_TESTS(vm, "sum");
+    TEST_IN_I32_I32_OUT_I32(vm, 10, 0, 55);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, SUM_COST(10), 0, passed, failed);
+
+    //the last back-edge can't be paid for
+    wrp_set_fuel(vm, SUM_COST(10) - 1);
+    START_FUNC_TESTS(vm, "sum");
+    TEST_IN_I32_I32_TRAP(vm, 10, 0, WRP_ERR_OUT_OF_FUEL);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, SUM_COST(10) - 1, 12, passed, failed);
+
+    //the call itself can't be paid for, its first iteration included
+    wrp_set_fuel(vm, SUM_COST(0) - 1);
+    START_FUNC_TESTS(vm, "sum");
+    TEST_IN_I32_I32_TRAP(vm, 0, 0, WRP_ERR_OUT_OF_FUEL);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, SUM_COST(0) - 1, SUM_COST(0) - 1, passed, failed);
+
+    //calls charge the callee's body
+    wrp_set_fuel(vm, 1000);
+    START_FUNC_TESTS(vm, "twice");
+    TEST_IN_I32_OUT_I32(vm, 5, 30);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, 1000, 1000 - 8 - 2 * SUM_COST(5), passed, failed);
+
+    //both arms of every if are charged whichever runs, the 16 instructions
+    //in the body
+    wrp_set_fuel(vm, 100);
+    START_FUNC_TESTS(vm, "clamp");
+    TEST_IN_I32_OUT_I32(vm, -5, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, 100, 100 - 16, passed, failed);
+
+    wrp_set_fuel(vm, 100);
+    START_FUNC_TESTS(vm, "clamp");
+    TEST_IN_I32_OUT_I32(vm, 50, 50);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, 100, 100 - 16, passed, failed);
+
+    //an endless loop stops once the budget is spent
+    wrp_set_fuel(vm, 100000);
+    START_FUNC_TESTS(vm, "spin");
+    TEST_EMPTY_TRAP(vm, WRP_ERR_OUT_OF_FUEL);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, 100000, 0, passed, failed);
+
+    //unmetered calls don't charge
+    wrp_disable_fuel(vm);
+    START_FUNC_TESTS(vm, "sum");
+    TEST_IN_I32_I32_OUT_I32(vm, 1000, 0, 500500);
+    END_FUNC_TESTS((*passed), (*failed));
+    test_fuel(vm, 0, 0, passed, failed);
+
+    unload_mdle(vm);
+}
+
+void run_fuel_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    test_metering(vm, dir, path_buf, path_buf_sz, passed, failed);
+}
@@ -0,0 +1,131 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "globals-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+static void test_get_sp(wrp_vm_t *vm, int32_t sp, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "get_sp");
+    TEST_OUT_I32(vm, sp);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void set_sp(wrp_vm_t *vm, int32_t sp, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "set_sp");
+    TEST_IN_I32(vm, sp);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_bump(wrp_vm_t *vm, int32_t counter, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "bump");
+    TEST_OUT_I32(vm, counter);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_mutable_globals(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    uint64_t counter = 10;
+    load_mdle_with_global(vm, dir, path_buf, path_buf_sz, "globals.0.wasm", &counter);
+    wrp_instance_t *first = vm->instance;
+
+    //imported globals are written through to the host
+    test_bump(vm, 11, passed, failed);
+    test_bump(vm, 12, passed, failed);
+    ASSERT(counter == 12, "imported global wasn't written through");
+
+    test_get_sp(vm, 3, passed, failed);
+    set_sp(vm, 8, passed, failed);
+    test_get_sp(vm, 8, passed, failed);
+
+    uint64_t *sp = NULL;
+    ASSERT(wrp_export_global(first, "sp", &sp) == WRP_SUCCESS, "failed to export sp");
+    ASSERT(*sp == 8, "exported global doesn't match");
+    *sp = 12;
+    test_get_sp(vm, 12, passed, failed);
+    ASSERT(wrp_export_global(first, "get_sp", &sp) != WRP_SUCCESS, "exported a function as a global");
+
+    //each instance owns its defined globals but shares the import
+    wrp_vm_t *other_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(other_vm, "vm failed to initialise");
+
+    wrp_instance_t *second = wrp_create_instance(other_vm, vm->mdle);
+    ASSERT(second, "failed to create second instance");
+    ASSERT(wrp_link_instance(other_vm, second) == WRP_ERR_MISSING_GLOBAL_IMPORT, "linked without its import");
+    ASSERT(wrp_import_global(second, &counter, 0) == WRP_SUCCESS, "failed to import global");
+    ASSERT(wrp_link_instance(other_vm, second) == WRP_SUCCESS, "failed to attach second instance");
+
+    test_get_sp(other_vm, 3, passed, failed);
+    test_bump(other_vm, 13, passed, failed);
+    test_get_sp(vm, 12, passed, failed);
+    test_bump(vm, 14, passed, failed);
+
+    ASSERT(wrp_unlink_instance(other_vm) == WRP_SUCCESS, "failed to detach second instance");
+    wrp_destroy_instance(other_vm, second);
+    wrp_close_vm(other_vm);
+
+    //resetting evaluates the initialisers again
+    relink_mdle(vm);
+    test_get_sp(vm, 3, passed, failed);
+
+    unload_mdle(vm);
+}
+
+static void test_imported_initializer(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    uint64_t base = 42;
+    load_mdle_with_global(vm, dir, path_buf, path_buf_sz, "globals.1.wasm", &base);
+
+    START_FUNC_TESTS(vm, "get_based");
+    TEST_OUT_I32(vm, 42);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+}
+
+void run_globals_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    test_mutable_globals(vm, dir, path_buf, path_buf_sz, passed, failed);
+    test_imported_initializer(vm, dir, path_buf, path_buf_sz, passed, failed);
+
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "globals.2.wasm", WRP_ERR_INVALID_MUTIBILITY, (*passed), (*failed));
+    TEST_MODULE(vm,
+        dir,
+        path_buf,
+        path_buf_sz,
+        "globals.3.wasm",
+        WRP_ERR_INVALID_INITIALZER_EXPRESSION,
+        (*passed),
+        (*failed));
+}
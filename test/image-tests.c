@@ -0,0 +1,178 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include <string.h>
+
+#include "image-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+//a copy stands in for an image read back from disk
+static void load_image_copy(wrp_vm_t *vm, wrp_buf_t *image, bool in_place, wrp_buf_t *out_copy)
+{
+    printf("loading test module image\n");
+
+    wrp_reset_vm(vm);
+
+    out_copy->bytes = test_alloc(image->sz, 64);
+    out_copy->sz = image->sz;
+    out_copy->pos = 0;
+    memcpy(out_copy->bytes, image->bytes, image->sz);
+
+    wrp_wasm_mdle_t *mdle = in_place ? wrp_deserialize_mdle_in_place(vm, out_copy) : wrp_deserialize_mdle(vm, out_copy);
+    ASSERT(mdle, "failed to deserialize image: %s", wrp_debug_err(vm->err));
+    wrp_instance_t *instance = wrp_create_instance(vm, mdle);
+    ASSERT(instance, "failed to create instance of deserialized module");
+    ASSERT(wrp_link_instance(vm, instance) == WRP_SUCCESS, "failed to attach deserialized module");
+}
+
+static wrp_err_t deserialize_modified(wrp_vm_t *vm, wrp_buf_t *image, size_t offset, uint8_t xor, size_t sz)
+{
+    wrp_buf_t copy = {.bytes = test_alloc(image->sz, 64), .sz = sz, .pos = 0};
+    memcpy(copy.bytes, image->bytes, image->sz);
+    copy.bytes[offset] ^= xor;
+
+    wrp_reset_vm(vm);
+    wrp_wasm_mdle_t *mdle = wrp_deserialize_mdle(vm, &copy);
+
+    if (mdle != NULL) {
+        wrp_destroy_mdle(vm, mdle);
+    }
+
+    test_free(copy.bytes);
+    return vm->err;
+}
+
+void run_image_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_buf_t image = {0};
+    wrp_buf_t copy = {0};
+
+    wrp_err_t err = serialize_mdle(vm, dir, path_buf, path_buf_sz, "validate.0.wasm", &image);
+    ASSERT(err == WRP_SUCCESS, "failed to serialize module: %s", wrp_debug_err(err));
+
+    load_image_copy(vm, &image, false, &copy);
+    ASSERT(vm->mdle->funcs[17].validated, "deserialized function needs validating");
+    ASSERT(memcmp(copy.bytes, image.bytes, image.sz) == 0, "deserializing modified the image");
+
+    START_FUNC_TESTS(vm, "f17");
+    TEST_IN_I32_OUT_I32(vm, 1, 17);
+    TEST_IN_I32_OUT_I32(vm, 0, -17);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f63");
+    TEST_IN_I32_OUT_I32(vm, 1, 63);
+    TEST_IN_I32_OUT_I32(vm, 0, -63);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    //the same bytes can be read again
+    wrp_wasm_mdle_t *mdle = wrp_deserialize_mdle(vm, &copy);
+    ASSERT(mdle, "failed to deserialize image twice: %s", wrp_debug_err(vm->err));
+    wrp_destroy_mdle(vm, mdle);
+    test_free(copy.bytes);
+
+    //damaged, stale and truncated images are rejected
+    err = deserialize_modified(vm, &image, image.sz - 1, 0, image.sz);
+    ASSERT(err == WRP_SUCCESS, "failed to deserialize unmodified image: %s", wrp_debug_err(err));
+
+    err = deserialize_modified(vm, &image, image.sz / 2, 0x10, image.sz);
+    ASSERT(err == WRP_ERR_MDLE_IMAGE_CHECKSUM, "deserialized corrupt image: %s", wrp_debug_err(err));
+
+    err = deserialize_modified(vm, &image, 4, 0x01, image.sz);
+    ASSERT(err == WRP_ERR_MDLE_IMAGE_VERSION, "deserialized image of another version: %s", wrp_debug_err(err));
+
+    err = deserialize_modified(vm, &image, 0, 0, image.sz - 64);
+    ASSERT(err == WRP_ERR_INVALID_MDLE_IMAGE, "deserialized truncated image: %s", wrp_debug_err(err));
+
+    err = deserialize_modified(vm, &image, 0, 0x01, image.sz);
+    ASSERT(err == WRP_ERR_INVALID_MDLE_IMAGE, "deserialized image without magic number: %s", wrp_debug_err(err));
+
+    test_free(image.bytes);
+
+    //data segments and memories come back unlinked
+    err = serialize_mdle(vm, dir, path_buf, path_buf_sz, "memory.62.wasm", &image);
+    ASSERT(err == WRP_SUCCESS, "failed to serialize module: %s", wrp_debug_err(err));
+
+    for (uint32_t i = 0; i < 2; i++) {
+        load_image_copy(vm, &image, i == 1, &copy);
+
+        START_FUNC_TESTS(vm, "data");
+        TEST_OUT_I32(vm, 1);
+        END_FUNC_TESTS((*passed), (*failed));
+
+        START_FUNC_TESTS(vm, "cast");
+        TEST_OUT_F64(vm, 42.0);
+        END_FUNC_TESTS((*passed), (*failed));
+
+        unload_mdle(vm);
+
+        //pointers relocated in place can't be relocated again
+        if (i == 1) {
+            mdle = wrp_deserialize_mdle_in_place(vm, &copy);
+            ASSERT(mdle == NULL && vm->err == WRP_ERR_INVALID_MDLE_IMAGE, "deserialized image in place twice");
+        }
+
+        test_free(copy.bytes);
+    }
+
+    test_free(image.bytes);
+
+    //an image rejected by the reading vm is left as it was
+    err = serialize_mdle(vm, dir, path_buf, path_buf_sz, "table.0.wasm", &image);
+    ASSERT(err == WRP_SUCCESS, "failed to serialize module: %s", wrp_debug_err(err));
+
+    wrp_limits_t defaults = vm->limits;
+    wrp_limits_t limits = defaults;
+    limits.max_table_elem = 5;
+    wrp_set_limits(vm, &limits);
+
+    copy = (wrp_buf_t){.bytes = test_alloc(image.sz, 64), .sz = image.sz, .pos = 0};
+    memcpy(copy.bytes, image.bytes, image.sz);
+
+    wrp_reset_vm(vm);
+    mdle = wrp_deserialize_mdle_in_place(vm, &copy);
+    ASSERT(mdle == NULL && vm->err == WRP_ERR_INVALID_TABLE_LIMIT, "deserialized image beyond table limit");
+    ASSERT(memcmp(copy.bytes, image.bytes, image.sz) == 0, "rejected image was modified");
+
+    wrp_set_limits(vm, &defaults);
+    wrp_reset_vm(vm);
+    mdle = wrp_deserialize_mdle_in_place(vm, &copy);
+    ASSERT(mdle, "failed to deserialize previously rejected image: %s", wrp_debug_err(vm->err));
+    wrp_destroy_mdle(vm, mdle);
+    test_free(copy.bytes);
+    test_free(image.bytes);
+
+    //serializing validates the functions a lazy module has not called yet
+    wrp_set_lazy_validation(vm, true);
+    err = serialize_mdle(vm, dir, path_buf, path_buf_sz, "validate.1.wasm", &image);
+    ASSERT(err == WRP_ERR_TYPE_MISMATCH, "serialized invalid module: %s", wrp_debug_err(err));
+    wrp_set_lazy_validation(vm, false);
+
+    //in place modules reference their input buffer
+    load_mdle_in_place(vm, dir, path_buf, path_buf_sz, "memory.62.wasm", &copy);
+    err = wrp_serialize_mdle(vm, vm->mdle, &image);
+    ASSERT(err == WRP_ERR_INVALID_MDLE_IMAGE, "serialized module loaded in place: %s", wrp_debug_err(err));
+    unload_mdle(vm);
+    free(copy.bytes);
+}
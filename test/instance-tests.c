@@ -0,0 +1,90 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "instance-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+static void test_load(wrp_vm_t *vm, int32_t stored, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "load");
+    TEST_OUT_I32(vm, stored);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void store(wrp_vm_t *vm, int32_t value, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "store");
+    TEST_IN_I32(vm, value);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+void run_instance_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "instance.0.wasm");
+    wrp_instance_t *first = vm->instance;
+
+#if WRP_MEMORY_RESERVE && WRP_MEMORY_IMAGES
+    int image_fd = vm->mdle->memories[0].image_fd;
+    ASSERT(image_fd >= 0 && first->memories[0].has_image, "first instance didn't build a memory image");
+#endif
+
+    test_load(vm, 7, passed, failed);
+    store(vm, 5, passed, failed);
+    test_load(vm, 5, passed, failed);
+
+    //a second vm runs its own instance of the same module alongside
+    wrp_vm_t *other_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(other_vm, "vm failed to initialise");
+
+    wrp_instance_t *second = wrp_create_instance(other_vm, vm->mdle);
+    ASSERT(second, "failed to create second instance");
+    ASSERT(wrp_link_instance(other_vm, second) == WRP_SUCCESS, "failed to attach second instance");
+
+#if WRP_MEMORY_RESERVE && WRP_MEMORY_IMAGES
+    //later instances map the image the first one built
+    ASSERT(vm->mdle->memories[0].image_fd == image_fd && second->memories[0].has_image, "second instance didn't share the memory image");
+#endif
+
+    test_load(other_vm, 7, passed, failed);
+    store(other_vm, 9, passed, failed);
+    test_load(other_vm, 9, passed, failed);
+    test_load(vm, 5, passed, failed);
+
+    ASSERT(wrp_unlink_instance(other_vm) == WRP_SUCCESS, "failed to detach second instance");
+    wrp_close_vm(other_vm);
+
+    //instances keep their state while they are not linked
+    ASSERT(wrp_unlink_instance(vm) == WRP_SUCCESS, "failed to detach first instance");
+    ASSERT(wrp_link_instance(vm, second) == WRP_SUCCESS, "failed to attach second instance");
+    test_load(vm, 9, passed, failed);
+
+    ASSERT(wrp_unlink_instance(vm) == WRP_SUCCESS, "failed to detach second instance");
+    ASSERT(wrp_link_instance(vm, first) == WRP_SUCCESS, "failed to attach first instance");
+    test_load(vm, 5, passed, failed);
+
+    //resetting writes the data segment again
+    relink_mdle(vm);
+    test_load(vm, 7, passed, failed);
+
+    wrp_destroy_instance(vm, second);
+    unload_mdle(vm);
+}
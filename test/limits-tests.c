@@ -0,0 +1,111 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "limits-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+//the module declares more functions, exports, code, locals and branch
+//targets than the limits this loader once had compiled in
+void run_limits_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "limits.0.wasm");
+
+    START_FUNC_TESTS(vm, "f0");
+    TEST_OUT_I32(vm, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f299");
+    TEST_OUT_I32(vm, 299);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "switch");
+    TEST_IN_I32_OUT_I32(vm, 0, 1);
+    TEST_IN_I32_OUT_I32(vm, 49, 1);
+    TEST_IN_I32_OUT_I32(vm, 50, 2);
+    TEST_IN_I32_OUT_I32(vm, 99, 1);
+    TEST_IN_I32_OUT_I32(vm, 100, 2);
+    TEST_IN_I32_OUT_I32(vm, -1, 2);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "locals");
+    TEST_OUT_I32(vm, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //handles are resolved once and called without looking up names
+    wrp_export_handle_t handles[300];
+    char name[8] = {0};
+
+    for (uint32_t i = 0; i < 300; i++) {
+        snprintf(name, sizeof(name), "f%u", i);
+        ASSERT(wrp_find_export(vm->mdle, name, &handles[i]) == WRP_SUCCESS, "failed to find export \"%s\"", name);
+    }
+
+    for (uint32_t i = 0; i < 300; i++) {
+        int32_t result = -1;
+        wrp_reset_vm(vm);
+        ASSERT(wrp_call_export(vm, &handles[i]) == WRP_SUCCESS, "failed to call export f%u", i);
+        ASSERT(wrp_stk_exec_pop_i32(vm, &result) == WRP_SUCCESS && result == (int32_t)i, "export f%u returned %d", i, result);
+    }
+
+    wrp_export_handle_t handle = {0};
+    ASSERT(wrp_find_export(vm->mdle, "f300", &handle) == WRP_ERR_UNKNOWN_EXPORT, "found missing export");
+    ASSERT(wrp_call_export(vm, &handle) == WRP_ERR_UNKNOWN_FUNC, "called unresolved handle");
+
+    uint32_t import_idx = 0;
+    ASSERT(wrp_find_import(vm->mdle, "env", "f0", &import_idx) == WRP_ERR_UNKNOWN_IMPORT, "found missing import");
+
+    unload_mdle(vm);
+
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "limits.1.wasm", WRP_ERR_MDLE_DUPLICATE_EXPORT, (*passed), (*failed));
+
+    //the same module against tighter limits
+    wrp_limits_t defaults = vm->limits;
+    wrp_limits_t limits = defaults;
+
+    limits.max_funcs = 128;
+    wrp_set_limits(vm, &limits);
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "limits.0.wasm", WRP_ERR_MDLE_FUNC_OVERFLOW, (*passed), (*failed));
+
+    limits = defaults;
+    limits.max_exports = 128;
+    wrp_set_limits(vm, &limits);
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "limits.0.wasm", WRP_ERR_MDLE_EXPORT_OVERFLOW, (*passed), (*failed));
+
+    limits = defaults;
+    limits.max_func_locals = 1024;
+    wrp_set_limits(vm, &limits);
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "limits.0.wasm", WRP_ERR_MDLE_LOCAL_OVERFLOW, (*passed), (*failed));
+
+    limits = defaults;
+    limits.max_func_body_sz = 64;
+    wrp_set_limits(vm, &limits);
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "limits.0.wasm", WRP_ERR_MDLE_CODE_OVERFLOW, (*passed), (*failed));
+
+    limits = defaults;
+    limits.max_mdle_sz = 4096;
+    wrp_set_limits(vm, &limits);
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "limits.0.wasm", WRP_ERR_MDLE_CODE_OVERFLOW, (*passed), (*failed));
+
+    wrp_set_limits(vm, &defaults);
+}
@@ -0,0 +1,153 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "linking-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+static const int8_t i32_i32[] = {I32, I32};
+static const int8_t i32[] = {I32};
+
+static wrp_err_t host_add(wrp_vm_t *vm, void *ctx)
+{
+    int32_t a = 0;
+    int32_t b = 0;
+    wrp_err_t err = wrp_stk_exec_pop_i32(vm, &b);
+
+    if (err == WRP_SUCCESS) {
+        err = wrp_stk_exec_pop_i32(vm, &a);
+    }
+
+    return err == WRP_SUCCESS ? wrp_stk_exec_push_i32(vm, (int32_t)((uint32_t)a + (uint32_t)b)) : err;
+}
+
+static void test_calls(wrp_vm_t *vm, int32_t calls, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "calls");
+    TEST_OUT_I32(vm, calls);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_peeks(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    //the library's memory is read in the library, the importer's after return
+    START_FUNC_TESTS(vm, "peeks");
+    TEST_OUT_I32(vm, 10);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_indirect(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    //a table entry enters the library like a direct call to the import
+    START_FUNC_TESTS(vm, "indirect_square");
+    TEST_IN_I32_OUT_I32(vm, 5, 25);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_calls(vm, 5, passed, failed);
+
+    //the host function the library re-exports, then a local function
+    START_FUNC_TESTS(vm, "indirect");
+    TEST_IN_I32_I32_I32_OUT_I32(vm, 1, 2, 3, 5);
+    TEST_IN_I32_I32_I32_OUT_I32(vm, 2, 1, 2, 5);
+    TEST_IN_I32_I32_I32_TRAP(vm, 0, 1, 2, WRP_ERR_INDIRECT_CALL_TYPE_MISMATCH);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_calls(vm, 7, passed, failed);
+}
+
+static void test_shared_library(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_registry_t *registry = wrp_create_registry(vm);
+    ASSERT(registry, "failed to create registry");
+
+    wrp_host_func_t add = {host_add, NULL, i32_i32, 2, i32, 1};
+    ASSERT(wrp_register_func(vm, registry, "env", "add", &add) == WRP_SUCCESS, "failed to register add");
+
+    //the library is never linked, importing its functions initializes it
+    wrp_instance_t *lib = load_instance(vm, dir, path_buf, path_buf_sz, "linking.0.wasm");
+    ASSERT(wrp_import_registry(lib, registry) == WRP_SUCCESS, "failed to import registry into library");
+    ASSERT(wrp_register_instance(vm, registry, "lib", lib) == WRP_SUCCESS, "failed to register library");
+
+    load_mdle_with_registry(vm, dir, path_buf, path_buf_sz, "linking.1.wasm", registry);
+    ASSERT(lib->initialized, "library wasn't initialized");
+
+    START_FUNC_TESTS(vm, "sum_squares");
+    TEST_IN_I32_I32_OUT_I32(vm, 2, 3, 13);
+    TEST_IN_I32_I32_OUT_I32(vm, -4, 0, 16);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_peeks(vm, passed, failed);
+    test_calls(vm, 4, passed, failed);
+
+    //a trap in the library returns to the importer's context
+    START_FUNC_TESTS(vm, "div");
+    TEST_IN_I32_I32_OUT_I32(vm, 6, 3, 2);
+    TEST_IN_I32_I32_TRAP(vm, 1, 0, WRP_ERR_I32_DIVIDE_BY_ZERO);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_peeks(vm, passed, failed);
+    test_indirect(vm, passed, failed);
+
+    //every importer shares the library's state
+    wrp_vm_t *other_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(other_vm, "vm failed to initialise");
+
+    wrp_instance_t *second = wrp_create_instance(other_vm, vm->mdle);
+    ASSERT(second, "failed to create second instance");
+    ASSERT(wrp_import_registry(second, registry) == WRP_SUCCESS, "failed to import registry");
+    ASSERT(wrp_link_instance(other_vm, second) == WRP_SUCCESS, "failed to attach second instance");
+
+    START_FUNC_TESTS(other_vm, "sum_squares");
+    TEST_IN_I32_I32_OUT_I32(other_vm, 1, 1, 2);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_calls(other_vm, 9, passed, failed);
+    test_calls(vm, 9, passed, failed);
+
+    ASSERT(wrp_unlink_instance(other_vm) == WRP_SUCCESS, "failed to detach second instance");
+    wrp_destroy_instance(other_vm, second);
+
+    //a re-exported import can only be followed once it is bound
+    wrp_instance_t *unbound = load_instance(other_vm, dir, path_buf, path_buf_sz, "linking.0.wasm");
+    uint32_t add_idx = 0;
+    ASSERT(wrp_export_func(unbound->mdle, "add", &add_idx) == WRP_SUCCESS, "library doesn't export add");
+    ASSERT(wrp_import_instance_func(vm->instance, unbound, add_idx, 2) == WRP_ERR_MISSING_FUNC_IMPORT,
+        "imported an unbound import");
+    unload_instance(other_vm, unbound);
+    wrp_close_vm(other_vm);
+
+    unload_mdle(vm);
+
+    TEST_LINK_WITH_REGISTRY(vm, dir, path_buf, path_buf_sz, "linking.2.wasm", registry, WRP_ERR_TYPE_MISMATCH, (*passed), (*failed));
+
+    unload_instance(vm, lib);
+    wrp_destroy_registry(vm, registry);
+}
+
+void run_linking_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    test_shared_library(vm, dir, path_buf, path_buf_sz, passed, failed);
+}
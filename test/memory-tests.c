@@ -281,7 +281,31 @@ void run_memory_tests(wrp_vm_t *vm,
     TEST_IN_I64_OUT_I64(vm, 0x3456436598bacdef, 0x98bacdef);
     END_FUNC_TESTS((*passed), (*failed));
 
+    //stores made above must not leak into the next link of the module
+    relink_mdle(vm);
+    START_FUNC_TESTS(vm, "data");
+    TEST_OUT_I32(vm, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    wrp_buf_t buf = {0};
+    load_mdle_in_place(vm, dir, path_buf, path_buf_sz, "memory.62.wasm", &buf);
+
+    wrp_data_segment_t *segment = &vm->mdle->data_segments[0];
+    ASSERT(segment->data >= buf.bytes && segment->data + segment->sz <= buf.bytes + buf.sz, "data segment was copied");
+    ASSERT(vm->mdle->funcs[0].code >= buf.bytes && vm->mdle->funcs[0].code < buf.bytes + buf.sz, "code was copied");
+
+    START_FUNC_TESTS(vm, "data");
+    TEST_OUT_I32(vm, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "cast");
+    TEST_OUT_F64(vm, 42.0);
+    END_FUNC_TESTS((*passed), (*failed));
+
     unload_mdle(vm);
+    free(buf.bytes);
 
     load_mdle(vm, dir, path_buf, path_buf_sz, "memory_redundancy.0.wasm");
 
@@ -369,6 +393,45 @@ void run_memory_tests(wrp_vm_t *vm,
     TEST_IN_I32_OUT_I32(vm, 0x10001, -1);
     END_FUNC_TESTS((*passed), (*failed));
 
+    //host accessors share the script's bytes and views last until a grow
+    wrp_mem_view_t view = {0};
+    ASSERT(wrp_mem_view(vm, &view) == WRP_SUCCESS, "failed to view memory");
+    ASSERT(view.sz == 0x10000 && wrp_mem_view_valid(vm, &view), "invalid memory view");
+    ASSERT(wrp_mem_write_i32(vm, 0xfff8, 7) == WRP_SUCCESS, "failed to write memory");
+    ASSERT(wrp_mem_write_i32(vm, 0xfffd, 7) == WRP_ERR_INVALID_MEMORY_ACCESS, "out of bounds write");
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, -8, 7);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //grown pages read as zero and existing pages keep their contents
+    START_FUNC_TESTS(vm, "grow_memory");
+    TEST_IN_I32_OUT_I32(vm, 1, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    int32_t value = 0;
+    ASSERT(!wrp_mem_view_valid(vm, &view), "memory view outlived a grow");
+    ASSERT(wrp_mem_read_i32(vm, 0xfff8, &value) == WRP_SUCCESS && value == 7, "failed to read memory");
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, -4, 0);
+    TEST_IN_I32_OUT_I32(vm, -0x10004, 42);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "grow_memory");
+    TEST_IN_I32_OUT_I32(vm, 0, 2);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //relinking returns the memory to its initial size and contents
+    relink_mdle(vm);
+    START_FUNC_TESTS(vm, "grow_memory");
+    TEST_IN_I32_OUT_I32(vm, 0, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I32_OUT_I32(vm, -4, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
     unload_mdle(vm);
 
     load_mdle(vm, dir, path_buf, path_buf_sz, "memory_trap.1.wasm");
@@ -0,0 +1,136 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "memory64-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+void run_memory64_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "memory64.0.wasm");
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I64_OUT_I32(vm, 8, 42);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "store");
+    TEST_IN_I64_I32(vm, 16, 5);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I64_OUT_I32(vm, 16, 5);
+    TEST_IN_I64_OUT_I32(vm, 0xfffc, 0);
+    TEST_IN_I64_TRAP(vm, 0xfffd, WRP_ERR_INVALID_MEMORY_ACCESS);
+    TEST_IN_I64_TRAP(vm, -1, WRP_ERR_INVALID_MEMORY_ACCESS);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load_offset_4g");
+    TEST_IN_I64_TRAP(vm, 0, WRP_ERR_INVALID_MEMORY_ACCESS);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load8_offset_1");
+    TEST_IN_I64_TRAP(vm, -1, WRP_ERR_INVALID_MEMORY_ACCESS);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "size");
+    TEST_OUT_I64(vm, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //grow past 4Gb, only the pages that are touched get backed
+    START_FUNC_TESTS(vm, "grow");
+    TEST_IN_I64_OUT_I64(vm, 0x100000000, -1);
+    TEST_IN_I64_OUT_I64(vm, 0x10000, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "size");
+    TEST_OUT_I64(vm, 0x10001);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load_offset_4g");
+    TEST_IN_I64_OUT_I32(vm, 0, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "store");
+    TEST_IN_I64_I32(vm, 0x100000010, 7);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load_offset_4g");
+    TEST_IN_I64_OUT_I32(vm, 0x10, 7);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I64_OUT_I32(vm, 16, 5);
+    TEST_IN_I64_TRAP(vm, 0x10000fffd, WRP_ERR_INVALID_MEMORY_ACCESS);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "grow");
+    TEST_IN_I64_OUT_I64(vm, 1, -1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    //a smaller reservation moves to a larger one as the memory grows past it
+    wrp_limits_t defaults = vm->limits;
+    wrp_limits_t limits = defaults;
+    limits.max_memory64_reserve_pages = 2;
+    wrp_set_limits(vm, &limits);
+    load_mdle(vm, dir, path_buf, path_buf_sz, "memory64.0.wasm");
+
+    START_FUNC_TESTS(vm, "store");
+    TEST_IN_I64_I32(vm, 16, 5);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "grow");
+    TEST_IN_I64_OUT_I64(vm, 1, 1);
+    TEST_IN_I64_OUT_I64(vm, 2, 2);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "store");
+    TEST_IN_I64_I32(vm, 0x30010, 9);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "load");
+    TEST_IN_I64_OUT_I32(vm, 8, 42);
+    TEST_IN_I64_OUT_I32(vm, 16, 5);
+    TEST_IN_I64_OUT_I32(vm, 0x30010, 9);
+    TEST_IN_I64_OUT_I32(vm, 0x3fffc, 0);
+    TEST_IN_I64_TRAP(vm, 0x40000, WRP_ERR_INVALID_MEMORY_ACCESS);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+    wrp_set_limits(vm, &defaults);
+
+    load_mdle(vm, dir, path_buf, path_buf_sz, "memory64.1.wasm");
+
+    START_FUNC_TESTS(vm, "add");
+    TEST_IN_I64_I32_OUT_I32(vm, 0, 3, 0);
+    TEST_IN_I64_I32_OUT_I32(vm, 0, 1, 3);
+    TEST_IN_I64_I32_TRAP(vm, 2, 1, WRP_ERR_UNALIGNED_ATOMIC);
+    TEST_IN_I64_I32_TRAP(vm, 0x10000, 1, WRP_ERR_INVALID_MEMORY_ACCESS);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "memory64.2.wasm", WRP_ERR_TYPE_MISMATCH, (*passed), (*failed));
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "memory64.3.wasm", WRP_ERR_TYPE_MISMATCH, (*passed), (*failed));
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "memory64.4.wasm", WRP_ERR_INVALID_MEM_LIMIT, (*passed), (*failed));
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "memory64.5.wasm", WRP_ERR_INVALID_MEM_LIMIT, (*passed), (*failed));
+}
@@ -0,0 +1,138 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "pool-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+#include "warp-pool.h"
+
+#define NUM_POOLED_VMS 4
+
+//leaves a written global, a dirtied page and an extra page behind
+static void dirty_vm(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "bump");
+    TEST_OUT_I32(vm, 8);
+    TEST_OUT_I32(vm, 9);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "poke");
+    TEST_IN_I32_I32(vm, 0, 1);
+    TEST_IN_I32_I32(vm, 65540, 99);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "peek");
+    TEST_IN_I32_OUT_I32(vm, 0, 1);
+    TEST_IN_I32_OUT_I32(vm, 65540, 99);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_clean_vm(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "bump");
+    TEST_OUT_I32(vm, 8);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "peek");
+    TEST_IN_I32_OUT_I32(vm, 0, 5);
+    TEST_IN_I32_OUT_I32(vm, 65540, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_recycling(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "pool.0.wasm");
+
+    wrp_vm_pool_t *pool = wrp_create_vm_pool(vm, vm->mdle, NULL, NUM_POOLED_VMS);
+    ASSERT(pool, "failed to create vm pool");
+
+    //every vm has its own instance
+    wrp_vm_t *vms[NUM_POOLED_VMS];
+
+    for (uint32_t i = 0; i < NUM_POOLED_VMS; i++) {
+        vms[i] = wrp_vm_pool_acquire(pool);
+        test_check("pool", vms[i] != NULL && (i == 0 || vms[i]->instance != vms[i - 1]->instance), "acquire", passed, failed);
+    }
+
+    test_check("pool", wrp_vm_pool_acquire(pool) == NULL, "pool exhausted", passed, failed);
+
+    for (uint32_t i = 0; i < NUM_POOLED_VMS; i++) {
+        test_check("pool", wrp_vm_pool_release(pool, vms[i]) == WRP_SUCCESS, "release", passed, failed);
+    }
+
+    //a released vm comes back as it was created
+    wrp_vm_t *pooled = wrp_vm_pool_acquire(pool);
+    dirty_vm(pooled, passed, failed);
+    test_check("pool", wrp_vm_pool_release(pool, pooled) == WRP_SUCCESS, "release dirty", passed, failed);
+    test_check("pool", wrp_vm_pool_acquire(pool) == pooled, "reacquire", passed, failed);
+    test_clean_vm(pooled, passed, failed);
+
+    //so does a grown one
+    START_FUNC_TESTS(pooled, "grow");
+    TEST_OUT_I32(pooled, 2);
+    TEST_OUT_I32(pooled, 3);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_check("pool", wrp_vm_pool_release(pool, pooled) == WRP_SUCCESS, "release grown", passed, failed);
+    pooled = wrp_vm_pool_acquire(pool);
+
+    START_FUNC_TESTS(pooled, "grow");
+    TEST_OUT_I32(pooled, 2);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //and one whose memory the host wrote through a view
+    wrp_mem_view_t view;
+    test_check("pool", wrp_mem_view(pooled, &view) == WRP_SUCCESS, "view", passed, failed);
+    view.bytes[65540] = 42;
+    test_check("pool", wrp_vm_pool_release(pool, pooled) == WRP_SUCCESS, "release viewed", passed, failed);
+    pooled = wrp_vm_pool_acquire(pool);
+    test_clean_vm(pooled, passed, failed);
+
+    //a suspended call is dropped on release
+    uint32_t spin = 0;
+    ASSERT(wrp_export_func(pooled->mdle, "spin", &spin) == WRP_SUCCESS, "function spin does not exist in module!");
+    wrp_set_fuel(pooled, 100);
+    test_check("pool", wrp_call(pooled, spin) == WRP_ERR_OUT_OF_FUEL && wrp_is_suspended(pooled), "suspended", passed, failed);
+    test_check("pool", wrp_vm_pool_release(pool, pooled) == WRP_SUCCESS, "release suspended", passed, failed);
+    pooled = wrp_vm_pool_acquire(pool);
+    test_check("pool", !wrp_is_suspended(pooled) && !pooled->fuel_metered, "resumable dropped", passed, failed);
+    test_clean_vm(pooled, passed, failed);
+
+    //host writes are tracked like the vm's own
+    test_check("pool", wrp_mem_write_i32(pooled, 65540, 7) == WRP_SUCCESS, "host write", passed, failed);
+    test_check("pool", wrp_vm_pool_release(pool, pooled) == WRP_SUCCESS, "release host written", passed, failed);
+    pooled = wrp_vm_pool_acquire(pool);
+    test_clean_vm(pooled, passed, failed);
+    test_check("pool", wrp_vm_pool_release(pool, pooled) == WRP_SUCCESS, "release clean", passed, failed);
+
+    wrp_destroy_vm_pool(pool);
+    unload_mdle(vm);
+}
+
+void run_pool_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    test_recycling(vm, dir, path_buf, path_buf_sz, passed, failed);
+}
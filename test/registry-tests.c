@@ -0,0 +1,175 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include <stdio.h>
+
+#include "registry-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+#define NUM_DUMMY_BINDINGS 2000
+
+static const int8_t i32_i32[] = {I32, I32};
+static const int8_t i32[] = {I32};
+
+static wrp_err_t host_add(wrp_vm_t *vm, void *ctx)
+{
+    int32_t a = 0;
+    int32_t b = 0;
+    wrp_err_t err = wrp_stk_exec_pop_i32(vm, &b);
+
+    if (err == WRP_SUCCESS) {
+        err = wrp_stk_exec_pop_i32(vm, &a);
+    }
+
+    return err == WRP_SUCCESS ? wrp_stk_exec_push_i32(vm, (int32_t)((uint32_t)a + (uint32_t)b)) : err;
+}
+
+//leaves its result off the stack
+static wrp_err_t host_broken_add(wrp_vm_t *vm, void *ctx)
+{
+    int32_t a = 0;
+    int32_t b = 0;
+    wrp_err_t err = wrp_stk_exec_pop_i32(vm, &b);
+    return err == WRP_SUCCESS ? wrp_stk_exec_pop_i32(vm, &a) : err;
+}
+
+static wrp_err_t host_log(wrp_vm_t *vm, void *ctx)
+{
+    return wrp_stk_exec_pop_i32(vm, (int32_t *)ctx);
+}
+
+static void test_sum3(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "sum3");
+    TEST_IN_I32_I32_I32_OUT_I32(vm, 1, 2, 3, 6);
+    TEST_IN_I32_I32_I32_OUT_I32(vm, -1, 1, 0, 0);
+    TEST_IN_I32_I32_I32_OUT_I32(vm, 0x7fffffff, 1, 0, (int32_t)0x80000000);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_tick(wrp_vm_t *vm, int32_t counter, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "tick");
+    TEST_OUT_I32(vm, counter);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_host_imports(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_registry_t *registry = wrp_create_registry(vm);
+    ASSERT(registry, "failed to create registry");
+
+    //enough unrelated bindings to grow the table several times
+    static char names[NUM_DUMMY_BINDINGS][16];
+    uint64_t dummy = 0;
+
+    for (uint32_t i = 0; i < NUM_DUMMY_BINDINGS; i++) {
+        snprintf(names[i], sizeof(names[i]), "dummy%u", i);
+        ASSERT(wrp_register_global(vm, registry, "env", names[i], &dummy, I32, false) == WRP_SUCCESS,
+            "failed to register \"%s\"", names[i]);
+    }
+
+    //the memory is exported by another module's instance
+    wrp_vm_t *memory_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(memory_vm, "vm failed to initialise");
+    load_mdle(memory_vm, dir, path_buf, path_buf_sz, "registry.1.wasm");
+
+    wrp_memory_t *memory = NULL;
+    ASSERT(wrp_export_memory(memory_vm->instance, "memory", &memory) == WRP_SUCCESS, "failed to export memory");
+
+    int32_t logged = 0;
+    uint64_t counter = 10;
+    wrp_host_func_t add = {host_add, NULL, i32_i32, 2, i32, 1};
+    wrp_host_func_t log = {host_log, &logged, i32, 1, NULL, 0};
+
+    ASSERT(wrp_register_func(vm, registry, "env", "add", &add) == WRP_SUCCESS, "failed to register add");
+    ASSERT(wrp_register_func(vm, registry, "env", "log", &log) == WRP_SUCCESS, "failed to register log");
+    ASSERT(wrp_register_global(vm, registry, "env", "counter", &counter, I32, true) == WRP_SUCCESS,
+        "failed to register counter");
+    ASSERT(wrp_register_memory(vm, registry, "env", "memory", memory) == WRP_SUCCESS, "failed to register memory");
+
+    load_mdle_with_registry(vm, dir, path_buf, path_buf_sz, "registry.0.wasm", registry);
+
+    test_sum3(vm, passed, failed);
+    test_tick(vm, 11, passed, failed);
+    ASSERT(logged == 11 && counter == 11, "host didn't see the tick");
+
+    START_FUNC_TESTS(vm, "peek");
+    TEST_OUT_I32(vm, 42);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //an exported import calls straight into the host
+    START_FUNC_TESTS(vm, "add");
+    TEST_IN_I32_I32_OUT_I32(vm, 2, 3, 5);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //the same bindings serve another instance
+    wrp_vm_t *other_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(other_vm, "vm failed to initialise");
+
+    wrp_instance_t *second = wrp_create_instance(other_vm, vm->mdle);
+    ASSERT(second, "failed to create second instance");
+    ASSERT(wrp_link_instance(other_vm, second) == WRP_ERR_MISSING_FUNC_IMPORT, "linked without its imports");
+    ASSERT(wrp_import_registry(second, registry) == WRP_SUCCESS, "failed to import registry");
+    ASSERT(wrp_link_instance(other_vm, second) == WRP_SUCCESS, "failed to attach second instance");
+
+    test_sum3(other_vm, passed, failed);
+    test_tick(other_vm, 12, passed, failed);
+    test_tick(vm, 13, passed, failed);
+    ASSERT(logged == 13, "host didn't see the tick");
+
+    ASSERT(wrp_unlink_instance(other_vm) == WRP_SUCCESS, "failed to detach second instance");
+    wrp_destroy_instance(other_vm, second);
+    wrp_close_vm(other_vm);
+    unload_mdle(vm);
+
+    //rebinding only affects instances that import afterwards
+    wrp_host_func_t broken_add = {host_broken_add, NULL, i32_i32, 2, i32, 1};
+    ASSERT(wrp_register_func(vm, registry, "env", "add", &broken_add) == WRP_SUCCESS, "failed to rebind add");
+    load_mdle_with_registry(vm, dir, path_buf, path_buf_sz, "registry.0.wasm", registry);
+
+    START_FUNC_TESTS(vm, "add");
+    TEST_IN_I32_I32_TRAP(vm, 2, 3, WRP_ERR_TYPE_MISMATCH);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    unload_mdle(memory_vm);
+    wrp_close_vm(memory_vm);
+
+    //unresolved and mismatched imports
+    TEST_LINK_WITH_REGISTRY(vm, dir, path_buf, path_buf_sz, "registry.2.wasm", registry, WRP_ERR_UNKNOWN_IMPORT, (*passed), (*failed));
+    TEST_LINK_WITH_REGISTRY(vm, dir, path_buf, path_buf_sz, "registry.3.wasm", registry, WRP_ERR_TYPE_MISMATCH, (*passed), (*failed));
+    TEST_LINK_WITH_REGISTRY(vm, dir, path_buf, path_buf_sz, "registry.4.wasm", registry, WRP_ERR_INVALID_IMPORT, (*passed), (*failed));
+
+    wrp_destroy_registry(vm, registry);
+}
+
+void run_registry_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    test_host_imports(vm, dir, path_buf, path_buf_sz, passed, failed);
+}
@@ -0,0 +1,215 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "resume-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+#define MAX_SLICES 100000
+
+static const int8_t i32[] = {I32};
+
+typedef struct host_yield_ctx {
+    uint32_t calls;
+    bool request;
+} host_yield_ctx_t;
+
+//increments its param, then either yields or asks to be suspended later
+static wrp_err_t host_yield(wrp_vm_t *vm, void *ctx)
+{
+    host_yield_ctx_t *yield_ctx = ctx;
+    yield_ctx->calls++;
+
+    int32_t value = 0;
+    wrp_err_t err = wrp_stk_exec_pop_i32(vm, &value);
+
+    if (err == WRP_SUCCESS) {
+        err = wrp_stk_exec_push_i32(vm, value + 1);
+    }
+
+    if (err != WRP_SUCCESS) {
+        return err;
+    }
+
+    if (yield_ctx->request) {
+        wrp_request_suspend(vm);
+        return WRP_SUCCESS;
+    }
+
+    return WRP_ERR_HOST_YIELD;
+}
+
+//calls func_idx with fresh fuel for every slice until it finishes
+static wrp_err_t call_sliced(wrp_vm_t *vm, uint32_t func_idx, uint64_t slice, uint32_t *out_slices)
+{
+    wrp_set_fuel(vm, slice);
+    wrp_err_t err = wrp_call(vm, func_idx);
+    uint32_t slices = 1;
+
+    while (err == WRP_ERR_OUT_OF_FUEL && wrp_is_suspended(vm) && slices < MAX_SLICES) {
+        wrp_set_fuel(vm, slice);
+        err = wrp_resume(vm);
+        slices++;
+    }
+
+    *out_slices = slices;
+    return err;
+}
+
+static void test_fuel_slices(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "fuel.0.wasm");
+    uint32_t sum = find_func(vm, "sum");
+    uint32_t slices = 0;
+
+    //a long loop is spread over many slices, 13018 instructions in slices of 500
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 1000);
+    wrp_stk_exec_push_i32(vm, 0);
+    wrp_err_t err = call_sliced(vm, sum, 500, &slices);
+    test_check("resume", err == WRP_SUCCESS && pop_result(vm, 500500) && slices == 27, "sum sliced", passed, failed);
+    test_check("resume", !wrp_is_suspended(vm), "sum finished", passed, failed);
+
+    //a call that can't be paid for runs again from the caller
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 50);
+    err = call_sliced(vm, find_func(vm, "twice"), 20, &slices);
+    test_check("resume", err == WRP_SUCCESS && pop_result(vm, 2550), "twice sliced", passed, failed);
+
+    //so does an entry that can't be paid for
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 3);
+    wrp_stk_exec_push_i32(vm, 0);
+    err = call_sliced(vm, sum, 2, &slices);
+    test_check("resume", err == WRP_ERR_OUT_OF_FUEL && wrp_is_suspended(vm), "entry stopped", passed, failed);
+    wrp_set_fuel(vm, 1000);
+    test_check("resume", wrp_resume(vm) == WRP_SUCCESS && pop_result(vm, 6), "entry resumed", passed, failed);
+
+    //a suspended call has to be resumed or reset before the next one
+    wrp_reset_vm(vm);
+    wrp_set_fuel(vm, 1000);
+    uint32_t spin = find_func(vm, "spin");
+    test_check("resume", wrp_call(vm, spin) == WRP_ERR_OUT_OF_FUEL, "spin stopped", passed, failed);
+    test_check("resume", wrp_call(vm, spin) == WRP_ERR_VM_SUSPENDED, "call while suspended", passed, failed);
+    wrp_reset_vm(vm);
+    test_check("resume", !wrp_is_suspended(vm) && wrp_resume(vm) == WRP_ERR_UNKNOWN, "resume after reset", passed, failed);
+
+    //a request stops the next call before it starts
+    wrp_request_suspend(vm);
+    test_check("resume", wrp_call(vm, spin) == WRP_ERR_SUSPEND_REQUESTED, "spin requested", passed, failed);
+    test_check("resume", wrp_resume(vm) == WRP_ERR_OUT_OF_FUEL, "spin resumed", passed, failed);
+
+    wrp_reset_vm(vm);
+    wrp_disable_fuel(vm);
+    unload_mdle(vm);
+}
+
+static void test_host_yield(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_registry_t *registry = wrp_create_registry(vm);
+    ASSERT(registry, "failed to create registry");
+
+    host_yield_ctx_t ctx = {0, false};
+    wrp_host_func_t yield = {host_yield, &ctx, i32, 1, i32, 1};
+    ASSERT(wrp_register_func(vm, registry, "env", "yield", &yield) == WRP_SUCCESS, "failed to register yield");
+
+    load_mdle_with_registry(vm, dir, path_buf, path_buf_sz, "resume.0.wasm", registry);
+    uint32_t count = find_func(vm, "count");
+
+    //every yield returns to the host after the call to it
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 3);
+    wrp_stk_exec_push_i32(vm, 0);
+    wrp_err_t err = wrp_call(vm, count);
+    uint32_t yields = 0;
+
+    while (err == WRP_ERR_HOST_YIELD && yields < MAX_SLICES) {
+        yields++;
+        err = wrp_resume(vm);
+    }
+
+    test_check("resume", err == WRP_SUCCESS && pop_result(vm, 3) && yields == 3 && ctx.calls == 3, "count yielded", passed, failed);
+
+    //a request stops the loop at its next back-edge
+    ctx.calls = 0;
+    ctx.request = true;
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 3);
+    wrp_stk_exec_push_i32(vm, 0);
+    err = wrp_call(vm, count);
+    uint32_t stops = 0;
+
+    while (err == WRP_ERR_SUSPEND_REQUESTED && stops < MAX_SLICES) {
+        test_check("resume", ctx.calls == stops + 1, "count stopped after call", passed, failed);
+        stops++;
+        err = wrp_resume(vm);
+    }
+
+    test_check("resume", err == WRP_SUCCESS && pop_result(vm, 3) && stops == 3, "count requested", passed, failed);
+
+    unload_mdle(vm);
+    wrp_destroy_registry(vm, registry);
+}
+
+static void test_instance_resume(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_registry_t *registry = wrp_create_registry(vm);
+    ASSERT(registry, "failed to create registry");
+
+    wrp_instance_t *lib = load_instance(vm, dir, path_buf, path_buf_sz, "fuel.0.wasm");
+    ASSERT(wrp_register_instance(vm, registry, "lib", lib) == WRP_SUCCESS, "failed to register library");
+    load_mdle_with_registry(vm, dir, path_buf, path_buf_sz, "resume.1.wasm", registry);
+
+    //calls stopped inside the library resume in it and return to the importer
+    wrp_reset_vm(vm);
+    wrp_stk_exec_push_i32(vm, 50);
+    uint32_t slices = 0;
+    wrp_err_t err = call_sliced(vm, find_func(vm, "twice"), 20, &slices);
+    test_check("resume", err == WRP_SUCCESS && pop_result(vm, 2550) && slices > 1, "twice across instances", passed, failed);
+    test_check("resume", vm->mdle != lib->mdle, "importer entered again", passed, failed);
+
+    wrp_disable_fuel(vm);
+    unload_mdle(vm);
+    unload_instance(vm, lib);
+    wrp_destroy_registry(vm, registry);
+}
+
+void run_resume_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    test_fuel_slices(vm, dir, path_buf, path_buf_sz, passed, failed);
+    test_host_yield(vm, dir, path_buf, path_buf_sz, passed, failed);
+    test_instance_resume(vm, dir, path_buf, path_buf_sz, passed, failed);
+}
@@ -0,0 +1,282 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "scheduler-tests.h"
+#include "test-common.h"
+#include "warp-scheduler.h"
+
+#define NUM_VMS 32
+#define NUM_FRAMES 3
+
+static const int8_t i32_i32[] = {I32, I32};
+static const int8_t i32[] = {I32};
+
+//leaves the call for the test to complete
+static wrp_err_t pending_add(wrp_vm_t *vm, void *ctx)
+{
+    int32_t a = 0;
+    int32_t b = 0;
+    wrp_err_t err = wrp_stk_exec_pop_i32(vm, &b);
+
+    if (err == WRP_SUCCESS) {
+        err = wrp_stk_exec_pop_i32(vm, &a);
+    }
+
+    return err == WRP_SUCCESS ? WRP_ERR_HOST_PENDING : err;
+}
+
+static int32_t expected_sum(uint32_t n)
+{
+    uint32_t sum = 0;
+
+    for (uint32_t i = 1; i <= n; i++) {
+        sum += i;
+    }
+
+    return (int32_t)sum;
+}
+
+//a few long tasks land on the same worker so the others have to steal them
+static uint32_t task_n(uint32_t frame, uint32_t vm_idx)
+{
+    return vm_idx % 8 == 0 ? 20000 + frame * 1000 : vm_idx * 37 + frame;
+}
+
+static void test_frames(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_instance_t *first = load_instance(vm, dir, path_buf, path_buf_sz, "scheduler.0.wasm");
+    wrp_wasm_mdle_t *mdle = first->mdle;
+    wrp_destroy_instance(vm, first);
+
+    wrp_export_handle_t sum = {0};
+    ASSERT(wrp_find_export(mdle, "sum", &sum) == WRP_SUCCESS, "module doesn't export sum");
+
+    //every vm runs its own instance of the shared module
+    wrp_vm_t *vms[NUM_VMS] = {0};
+    wrp_instance_t *instances[NUM_VMS] = {0};
+
+    for (uint32_t i = 0; i < NUM_VMS; i++) {
+        vms[i] = wrp_open_vm(test_alloc, test_free);
+        ASSERT(vms[i], "vm failed to initialise");
+        instances[i] = wrp_create_instance(vms[i], mdle);
+        ASSERT(instances[i], "failed to create instance");
+        ASSERT(wrp_link_instance(vms[i], instances[i]) == WRP_SUCCESS, "failed to attach instance");
+    }
+
+    wrp_thread_pool_t pool = {.num_workers = 4};
+    wrp_scheduler_t *sched = wrp_create_scheduler(vm, &pool);
+    ASSERT(sched, "failed to create scheduler");
+
+#if WRP_THREADS
+    //the caller is the first worker, the others sleep between frames
+    ASSERT(sched->workers.num_threads == 3, "scheduler didn't start its workers");
+#endif
+
+    wrp_sched_task_t tasks[NUM_VMS] = {0};
+    wrp_oprd_t args[NUM_VMS][2] = {0};
+
+    for (uint32_t frame = 0; frame < NUM_FRAMES; frame++) {
+        printf("running scheduler frame %u\n", frame);
+
+        for (uint32_t i = 0; i < NUM_VMS; i++) {
+            args[i][0] = (wrp_oprd_t){.value = task_n(frame, i), .type = I32};
+            args[i][1] = (wrp_oprd_t){.value = 0, .type = I32};
+            tasks[i] = (wrp_sched_task_t){.vm = vms[i], .func = sum, .args = args[i], .num_args = 2};
+            ASSERT(wrp_sched_submit(sched, &tasks[i]) == WRP_SUCCESS, "failed to submit task");
+        }
+
+        //the barrier returns once every task has run
+        wrp_sched_run_frame(sched);
+
+        for (uint32_t i = 0; i < NUM_VMS; i++) {
+            int32_t result = 0;
+
+            if (tasks[i].err == WRP_SUCCESS && wrp_stk_exec_pop_i32(vms[i], &result) == WRP_SUCCESS &&
+                result == expected_sum(task_n(frame, i))) {
+                (*passed)++;
+            } else {
+                (*failed)++;
+                printf("scheduler task %u of frame %u failed\n", i, frame);
+            }
+        }
+    }
+
+    //a failing task doesn't stop the others
+    wrp_export_handle_t not_func = sum;
+    not_func.kind = EXTERNAL_MEMORY;
+
+    for (uint32_t i = 0; i < NUM_VMS; i++) {
+        tasks[i] = (wrp_sched_task_t){.vm = vms[i], .func = i == 5 ? not_func : sum, .args = args[i], .num_args = 2};
+        ASSERT(wrp_sched_submit(sched, &tasks[i]) == WRP_SUCCESS, "failed to submit task");
+    }
+
+    wrp_sched_run_frame(sched);
+
+    for (uint32_t i = 0; i < NUM_VMS; i++) {
+        wrp_err_t expected = i == 5 ? WRP_ERR_UNKNOWN_FUNC : WRP_SUCCESS;
+
+        if (tasks[i].err == expected) {
+            (*passed)++;
+        } else {
+            (*failed)++;
+            printf("scheduler task %u failed. Expected: \"%s\", Actual: \"%s\"\n", i, wrp_debug_err(expected),
+                wrp_debug_err(tasks[i].err));
+        }
+    }
+
+    //nothing is left over for the next frame
+    wrp_sched_run_frame(sched);
+
+#if WRP_THREADS
+    ASSERT(sched->workers.num_threads == 3 && sched->workers.run == NUM_FRAMES + 2, "frames didn't reuse the workers");
+#endif
+    wrp_destroy_scheduler(sched);
+
+    for (uint32_t i = 0; i < NUM_VMS; i++) {
+        ASSERT(wrp_unlink_instance(vms[i]) == WRP_SUCCESS, "failed to detach instance");
+        wrp_destroy_instance(vms[i], instances[i]);
+        wrp_close_vm(vms[i]);
+    }
+
+    wrp_destroy_mdle(vm, mdle);
+    printf("done\n\n");
+}
+
+static void test_rejected_tasks(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    wrp_registry_t *registry = wrp_create_registry(vm);
+    ASSERT(registry, "failed to create registry");
+
+    wrp_host_func_t add = {pending_add, NULL, i32_i32, 2, i32, 1};
+    ASSERT(wrp_register_func(vm, registry, "env", "add", &add) == WRP_SUCCESS, "failed to register add");
+
+    wrp_vm_t *lib_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(lib_vm, "vm failed to initialise");
+
+    wrp_instance_t *lib = load_instance(lib_vm, dir, path_buf, path_buf_sz, "linking.0.wasm");
+    ASSERT(wrp_import_registry(lib, registry) == WRP_SUCCESS, "failed to import registry into library");
+    ASSERT(wrp_link_instance(lib_vm, lib) == WRP_SUCCESS, "failed to attach library");
+    ASSERT(wrp_register_instance(vm, registry, "lib", lib) == WRP_SUCCESS, "failed to register library");
+
+    wrp_export_handle_t sum = {0};
+    ASSERT(wrp_find_export(lib->mdle, "sum", &sum) == WRP_SUCCESS, "library doesn't export sum");
+
+    wrp_thread_pool_t pool = {.num_workers = 2};
+    wrp_scheduler_t *sched = wrp_create_scheduler(vm, &pool);
+    ASSERT(sched, "failed to create scheduler");
+
+    //a vm waiting on its host keeps the call through a frame
+    wrp_oprd_t args[2] = {{.value = 2, .type = I32}, {.value = 3, .type = I32}};
+    ASSERT(wrp_stk_exec_push_i32(lib_vm, 2) == WRP_SUCCESS && wrp_stk_exec_push_i32(lib_vm, 3) == WRP_SUCCESS,
+        "failed to push args");
+    ASSERT(wrp_call_export(lib_vm, &sum) == WRP_ERR_HOST_PENDING, "host call wasn't left pending");
+
+    wrp_sched_task_t task = {.vm = lib_vm, .func = sum, .args = args, .num_args = 2};
+    wrp_err_t err = wrp_sched_submit(sched, &task);
+    wrp_sched_run_frame(sched);
+
+    wrp_oprd_t result = {.value = 5, .type = I32};
+    int32_t value = 0;
+
+    if (err == WRP_ERR_VM_SUSPENDED && wrp_complete_host_call(lib_vm, &result, 1) == WRP_SUCCESS &&
+        wrp_resume(lib_vm) == WRP_SUCCESS && wrp_stk_exec_pop_i32(lib_vm, &value) == WRP_SUCCESS && value == 5) {
+        (*passed)++;
+    } else {
+        (*failed)++;
+        printf("suspended vm was scheduled: \"%s\"\n", wrp_debug_err(err));
+    }
+
+    //a second task on the library's instance, from the same vm or another
+    //linked to it, waits for the next frame
+    wrp_vm_t *twin_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(twin_vm, "vm failed to initialise");
+    ASSERT(wrp_link_instance(twin_vm, lib) == WRP_SUCCESS, "failed to attach library twice");
+
+    wrp_export_handle_t peek = {0};
+    ASSERT(wrp_find_export(lib->mdle, "peek", &peek) == WRP_SUCCESS, "library doesn't export peek");
+
+    wrp_sched_task_t first = {.vm = lib_vm, .func = peek};
+    wrp_sched_task_t again = {.vm = lib_vm, .func = peek};
+    wrp_sched_task_t twin = {.vm = twin_vm, .func = peek};
+    bool claimed = wrp_sched_submit(sched, &first) == WRP_SUCCESS &&
+        wrp_sched_submit(sched, &again) == WRP_ERR_SHARED_INSTANCE &&
+        wrp_sched_submit(sched, &twin) == WRP_ERR_SHARED_INSTANCE;
+    wrp_sched_run_frame(sched);
+
+    bool released = wrp_sched_submit(sched, &twin) == WRP_SUCCESS;
+    wrp_sched_run_frame(sched);
+
+    if (claimed && released && first.err == WRP_SUCCESS && twin.err == WRP_SUCCESS) {
+        (*passed)++;
+    } else {
+        (*failed)++;
+        printf("instance was scheduled twice in a frame\n");
+    }
+
+    ASSERT(wrp_unlink_instance(twin_vm) == WRP_SUCCESS, "failed to detach library");
+    wrp_close_vm(twin_vm);
+
+    //an importer of the library would reach its state from any worker
+    wrp_vm_t *importer_vm = wrp_open_vm(test_alloc, test_free);
+    ASSERT(importer_vm, "vm failed to initialise");
+    load_mdle_with_registry(importer_vm, dir, path_buf, path_buf_sz, "linking.1.wasm", registry);
+
+    wrp_export_handle_t calls = {0};
+    ASSERT(wrp_find_export(importer_vm->mdle, "calls", &calls) == WRP_SUCCESS, "importer doesn't export calls");
+
+    task = (wrp_sched_task_t){.vm = importer_vm, .func = calls};
+    err = wrp_sched_submit(sched, &task);
+
+    if (err == WRP_ERR_SHARED_INSTANCE) {
+        (*passed)++;
+    } else {
+        (*failed)++;
+        printf("instance sharing a library was scheduled: \"%s\"\n", wrp_debug_err(err));
+    }
+
+    wrp_sched_run_frame(sched);
+    wrp_destroy_scheduler(sched);
+
+    unload_mdle(importer_vm);
+    wrp_close_vm(importer_vm);
+
+    ASSERT(wrp_unlink_instance(lib_vm) == WRP_SUCCESS, "failed to detach library");
+    unload_instance(lib_vm, lib);
+    wrp_close_vm(lib_vm);
+    wrp_destroy_registry(vm, registry);
+    printf("done\n\n");
+}
+
+void run_scheduler_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    test_frames(vm, dir, path_buf, path_buf_sz, passed, failed);
+    test_rejected_tasks(vm, dir, path_buf, path_buf_sz, passed, failed);
+}
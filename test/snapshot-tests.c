@@ -0,0 +1,270 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "snapshot-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+#include "warp-snapshot.h"
+
+#define NUM_RING_SNAPSHOTS 3
+
+static void test_memory(wrp_vm_t *vm, int32_t num_pages, int32_t first, int32_t second, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "size");
+    TEST_OUT_I32(vm, num_pages);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "peek");
+    TEST_IN_I32_OUT_I32(vm, 0, first);
+
+    if (num_pages > 1) {
+        TEST_IN_I32_OUT_I32(vm, 65540, second);
+    }
+
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+static void test_rollback(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    wrp_snapshot_t *snapshot = wrp_create_snapshot(vm);
+    ASSERT(snapshot, "failed to create snapshot");
+    test_check("snapshot", wrp_restore(vm, snapshot) == WRP_ERR_UNKNOWN, "restore untaken", passed, failed);
+
+    START_FUNC_TESTS(vm, "bump");
+    TEST_OUT_I32(vm, 8);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "poke");
+    TEST_IN_I32_I32(vm, 0, 11);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_check("snapshot", wrp_snapshot(vm, snapshot) == WRP_SUCCESS, "take", passed, failed);
+
+    START_FUNC_TESTS(vm, "bump");
+    TEST_OUT_I32(vm, 9);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "grow");
+    TEST_OUT_I32(vm, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "poke");
+    TEST_IN_I32_I32(vm, 0, 22);
+    TEST_IN_I32_I32(vm, 65540, 33);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_memory(vm, 2, 22, 33, passed, failed);
+    test_check("snapshot", wrp_restore(vm, snapshot) == WRP_SUCCESS, "restore", passed, failed);
+
+    START_FUNC_TESTS(vm, "bump");
+    TEST_OUT_I32(vm, 9);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_memory(vm, 1, 11, 0, passed, failed);
+
+    //the page dropped by the restore grows back zeroed
+    START_FUNC_TESTS(vm, "grow");
+    TEST_OUT_I32(vm, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_memory(vm, 2, 11, 0, passed, failed);
+
+    //a view can't be tracked, so the restore copies every page
+    wrp_mem_view_t view;
+    test_check("snapshot", wrp_snapshot(vm, snapshot) == WRP_SUCCESS, "retake", passed, failed);
+    test_check("snapshot", wrp_mem_view(vm, &view) == WRP_SUCCESS, "view", passed, failed);
+    view.bytes[65540] = 42;
+    test_check("snapshot", wrp_restore(vm, snapshot) == WRP_SUCCESS, "restore viewed", passed, failed);
+    test_check("snapshot", !wrp_mem_view_valid(vm, &view), "view invalidated", passed, failed);
+    test_memory(vm, 2, 11, 0, passed, failed);
+
+    //so are host writes
+    test_check("snapshot", wrp_mem_write_i32(vm, 0, 7) == WRP_SUCCESS, "host write", passed, failed);
+    test_check("snapshot", wrp_restore(vm, snapshot) == WRP_SUCCESS, "restore host written", passed, failed);
+    test_memory(vm, 2, 11, 0, passed, failed);
+
+    wrp_destroy_snapshot(snapshot);
+}
+
+static void test_ring(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    wrp_snapshot_t *ring[NUM_RING_SNAPSHOTS];
+
+    //one snapshot per frame, each frame writes the first page
+    for (int32_t i = 0; i < NUM_RING_SNAPSHOTS; i++) {
+        ring[i] = wrp_create_snapshot(vm);
+        ASSERT(ring[i], "failed to create snapshot");
+        test_check("snapshot", wrp_snapshot(vm, ring[i]) == WRP_SUCCESS, "take ring", passed, failed);
+
+        START_FUNC_TESTS(vm, "poke");
+        TEST_IN_I32_I32(vm, 0, 100 + i);
+        END_FUNC_TESTS((*passed), (*failed));
+
+        if (i == 0) {
+            START_FUNC_TESTS(vm, "grow");
+            TEST_OUT_I32(vm, 1);
+            END_FUNC_TESTS((*passed), (*failed));
+        } else if (i == 1) {
+            START_FUNC_TESTS(vm, "poke");
+            TEST_IN_I32_I32(vm, 65540, 200);
+            END_FUNC_TESTS((*passed), (*failed));
+        }
+    }
+
+    //older and newer snapshots can be restored in any order
+    test_check("snapshot", wrp_restore(vm, ring[0]) == WRP_SUCCESS, "restore oldest", passed, failed);
+    test_memory(vm, 1, 5, 0, passed, failed);
+    test_check("snapshot", wrp_restore(vm, ring[2]) == WRP_SUCCESS, "restore newest", passed, failed);
+    test_memory(vm, 2, 101, 200, passed, failed);
+    test_check("snapshot", wrp_restore(vm, ring[1]) == WRP_SUCCESS, "restore middle", passed, failed);
+    test_memory(vm, 2, 100, 0, passed, failed);
+    test_check("snapshot", wrp_restore(vm, ring[2]) == WRP_SUCCESS, "restore newest again", passed, failed);
+    test_memory(vm, 2, 101, 200, passed, failed);
+
+    for (int32_t i = 0; i < NUM_RING_SNAPSHOTS; i++) {
+        wrp_destroy_snapshot(ring[i]);
+    }
+}
+
+static void test_incremental(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "grow");
+    TEST_OUT_I32(vm, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    wrp_snapshot_t *snapshot = wrp_create_snapshot(vm);
+    ASSERT(snapshot, "failed to create snapshot");
+    test_check("snapshot", wrp_snapshot(vm, snapshot) == WRP_SUCCESS, "take full", passed, failed);
+
+    //bytes written behind the tracking's back show which pages are copied
+    vm->memory->bytes[8] = 1;
+    vm->memory->bytes[65544] = 1;
+
+    START_FUNC_TESTS(vm, "poke");
+    TEST_IN_I32_I32(vm, 65540, 300);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    test_check("snapshot", wrp_snapshot(vm, snapshot) == WRP_SUCCESS, "take incremental", passed, failed);
+
+    uint8_t *shadow = snapshot->memories[0].bytes;
+    test_check("snapshot", shadow[8] == 0 && shadow[65544] == 1, "only written pages copied", passed, failed);
+
+    START_FUNC_TESTS(vm, "poke");
+    TEST_IN_I32_I32(vm, 65540, 400);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    vm->memory->bytes[8] = 2;
+    test_check("snapshot", wrp_restore(vm, snapshot) == WRP_SUCCESS, "restore incremental", passed, failed);
+    test_check("snapshot", vm->memory->bytes[8] == 2, "only written pages restored", passed, failed);
+
+    START_FUNC_TESTS(vm, "peek");
+    TEST_IN_I32_OUT_I32(vm, 65540, 300);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    wrp_destroy_snapshot(snapshot);
+}
+
+static void test_long_lived(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "grow");
+    TEST_OUT_I32(vm, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    wrp_snapshot_t *old = wrp_create_snapshot(vm);
+    wrp_snapshot_t *frame = wrp_create_snapshot(vm);
+    ASSERT(old && frame, "failed to create snapshot");
+    test_check("snapshot", wrp_snapshot(vm, old) == WRP_SUCCESS, "take old", passed, failed);
+
+    //enough frames to fill the page log several times over while the old
+    //snapshot still needs the first page's entries
+    for (int32_t i = 0; i < 16; i++) {
+        test_check("snapshot", wrp_snapshot(vm, frame) == WRP_SUCCESS, "take frame", passed, failed);
+
+        START_FUNC_TESTS(vm, "poke");
+        TEST_IN_I32_I32(vm, i == 0 ? 0 : 65540, 500 + i);
+        END_FUNC_TESTS((*passed), (*failed));
+    }
+
+    test_memory(vm, 2, 500, 515, passed, failed);
+
+    vm->memory->bytes[65544] = 3;
+    test_check("snapshot", wrp_restore(vm, frame) == WRP_SUCCESS, "restore frame", passed, failed);
+    test_memory(vm, 2, 500, 514, passed, failed);
+    test_check("snapshot", vm->memory->bytes[65544] == 0, "written page restored", passed, failed);
+
+    test_check("snapshot", wrp_restore(vm, old) == WRP_SUCCESS, "restore old", passed, failed);
+    test_memory(vm, 2, 5, 0, passed, failed);
+
+    //stores only pay for tracking while a snapshot needs it
+    wrp_destroy_snapshot(frame);
+    test_check("snapshot", vm->memory->dirty.epochs != NULL, "tracked for old", passed, failed);
+    wrp_destroy_snapshot(old);
+    test_check("snapshot", vm->memory->dirty.epochs == NULL, "untracked", passed, failed);
+}
+
+static void test_suspended(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    wrp_snapshot_t *snapshot = wrp_create_snapshot(vm);
+    ASSERT(snapshot, "failed to create snapshot");
+
+    uint32_t spin = 0;
+    ASSERT(wrp_export_func(vm->mdle, "spin", &spin) == WRP_SUCCESS, "function spin does not exist in module!");
+    wrp_set_fuel(vm, 100);
+    test_check("snapshot", wrp_call(vm, spin) == WRP_ERR_OUT_OF_FUEL, "suspend", passed, failed);
+
+    uint64_t fuel = wrp_get_fuel(vm);
+    test_check("snapshot", wrp_snapshot(vm, snapshot) == WRP_SUCCESS, "take suspended", passed, failed);
+
+    //the restored call runs on from where it was snapshotted
+    for (uint32_t i = 0; i < 2; i++) {
+        wrp_set_fuel(vm, 50);
+        test_check("snapshot", wrp_resume(vm) == WRP_ERR_OUT_OF_FUEL, "resume", passed, failed);
+        test_check("snapshot", wrp_restore(vm, snapshot) == WRP_SUCCESS, "restore suspended", passed, failed);
+        test_check("snapshot", wrp_is_suspended(vm) && wrp_get_fuel(vm) == fuel, "suspended again", passed, failed);
+    }
+
+    wrp_reset_vm(vm);
+    wrp_disable_fuel(vm);
+    test_check("snapshot", !wrp_is_suspended(vm), "reset", passed, failed);
+
+    //a snapshot of an idle vm drops a suspended call on restore
+    test_check("snapshot", wrp_snapshot(vm, snapshot) == WRP_SUCCESS, "take idle", passed, failed);
+    wrp_set_fuel(vm, 100);
+    test_check("snapshot", wrp_call(vm, spin) == WRP_ERR_OUT_OF_FUEL, "suspend again", passed, failed);
+    test_check("snapshot", wrp_restore(vm, snapshot) == WRP_SUCCESS && !wrp_is_suspended(vm) && !vm->fuel_metered,
+        "restore idle",
+        passed,
+        failed);
+
+    wrp_destroy_snapshot(snapshot);
+}
+
+void run_snapshot_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    void (*tests[])(wrp_vm_t *, uint32_t *, uint32_t *) = {test_rollback, test_ring, test_incremental, test_long_lived, test_suspended};
+
+    //each test starts from a fresh instance
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        load_mdle(vm, dir, path_buf, path_buf_sz, "snapshot.0.wasm");
+        tests[i](vm, passed, failed);
+        unload_mdle(vm);
+    }
+}
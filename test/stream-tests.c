@@ -0,0 +1,85 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+
+#include "stream-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+//chunks split sections, section headers and function bodies at every offset
+static const size_t chunk_szs[] = {1, 3, 7, 64, SIZE_MAX};
+
+void run_stream_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    for (size_t i = 0; i < sizeof(chunk_szs) / sizeof(chunk_szs[0]); i++) {
+        load_mdle_streamed(vm, dir, path_buf, path_buf_sz, "validate.0.wasm", chunk_szs[i]);
+        ASSERT(vm->mdle->funcs[63].validated, "streamed function was not validated");
+
+        START_FUNC_TESTS(vm, "f1");
+        TEST_IN_I32_OUT_I32(vm, 1, 1);
+        TEST_IN_I32_OUT_I32(vm, 0, -1);
+        END_FUNC_TESTS((*passed), (*failed));
+
+        START_FUNC_TESTS(vm, "f63");
+        TEST_IN_I32_OUT_I32(vm, 1, 63);
+        TEST_IN_I32_OUT_I32(vm, 0, -63);
+        END_FUNC_TESTS((*passed), (*failed));
+
+        unload_mdle(vm);
+
+        load_mdle_streamed(vm, dir, path_buf, path_buf_sz, "memory.62.wasm", chunk_szs[i]);
+
+        START_FUNC_TESTS(vm, "data");
+        TEST_OUT_I32(vm, 1);
+        END_FUNC_TESTS((*passed), (*failed));
+
+        START_FUNC_TESTS(vm, "cast");
+        TEST_OUT_F64(vm, 42.0);
+        END_FUNC_TESTS((*passed), (*failed));
+
+        unload_mdle(vm);
+
+        wrp_err_t err = stream_mdle(vm, dir, path_buf, path_buf_sz, "validate.1.wasm", chunk_szs[i], SIZE_MAX);
+        ASSERT(err == WRP_ERR_TYPE_MISMATCH, "streamed invalid module: %s", wrp_debug_err(err));
+    }
+
+    //modules must end between sections
+    wrp_err_t err = stream_mdle(vm, dir, path_buf, path_buf_sz, "validate.0.wasm", 5, 4);
+    ASSERT(err == WRP_ERR_MDLE_MISSING_PREAMBLE, "streamed partial preamble: %s", wrp_debug_err(err));
+
+    err = stream_mdle(vm, dir, path_buf, path_buf_sz, "validate.0.wasm", 5, 40);
+    ASSERT(err == WRP_ERR_INVALID_BUFFER_ACCESS, "streamed truncated module: %s", wrp_debug_err(err));
+
+    //lazily validated modules stream without checking function bodies
+    wrp_set_lazy_validation(vm, true);
+    load_mdle_streamed(vm, dir, path_buf, path_buf_sz, "validate.1.wasm", 7);
+
+    START_FUNC_TESTS(vm, "f0");
+    TEST_IN_I32_OUT_I32(vm, 1, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f10");
+    TEST_IN_I32_TRAP(vm, 1, WRP_ERR_TYPE_MISMATCH);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+    wrp_set_lazy_validation(vm, false);
+}
@@ -0,0 +1,56 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "table-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+static void test_dispatch(wrp_vm_t *vm, uint32_t *passed, uint32_t *failed)
+{
+    START_FUNC_TESTS(vm, "dispatch");
+    TEST_IN_I32_OUT_I32(vm, 0, 7);
+    TEST_IN_I32_OUT_I32(vm, 1, 9);
+    TEST_IN_I32_OUT_I32(vm, 4, 9);
+    TEST_IN_I32_TRAP(vm, 2, WRP_ERR_INDIRECT_CALL_TYPE_MISMATCH);
+    TEST_IN_I32_TRAP(vm, 3, WRP_ERR_UNINITIALIZED_ELEMENT);
+    TEST_IN_I32_TRAP(vm, 5, WRP_ERR_UNDEFINED_ELEMENT);
+    TEST_IN_I32_TRAP(vm, -1, WRP_ERR_UNDEFINED_ELEMENT);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    //a different type index with the same signature still matches
+    START_FUNC_TESTS(vm, "dispatch_same_sig");
+    TEST_IN_I32_OUT_I32(vm, 0, 7);
+    END_FUNC_TESTS((*passed), (*failed));
+}
+
+void run_table_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "table.0.wasm");
+    test_dispatch(vm, passed, failed);
+
+    //resetting writes the element segments again
+    relink_mdle(vm);
+    test_dispatch(vm, passed, failed);
+    unload_mdle(vm);
+
+    TEST_LINK(vm, dir, path_buf, path_buf_sz, "table.1.wasm", WRP_ERR_INVALID_ELEMENT_IDX, (*passed), (*failed));
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "table.2.wasm", WRP_ERR_INVALID_TABLE_IDX, (*passed), (*failed));
+}
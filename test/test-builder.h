@@ -48,6 +48,22 @@
         }                                                                                     \
     }
 
+#define TEST_LINK_WITH_REGISTRY(vm, dir, path_buf, path_buf_sz, mdle_name, registry, result, passed, failed) \
+    {                                                                                                   \
+        wrp_err_t err = link_mdle_with_registry(vm, dir, path_buf, path_buf_sz, mdle_name, registry);     \
+                                                                                                        \
+        if (err == result) {                                                                            \
+            passed++;                                                                                   \
+            printf("module test %s passed\n", mdle_name);                                               \
+        } else {                                                                                        \
+            failed++;                                                                                   \
+            const char *format = "module test %s failed. Expected: \"%s\", Actual: \"%s\"\n";           \
+            const char *result_name = wrp_debug_err(result);                                            \
+            const char *err_name = wrp_debug_err(err);                                                  \
+            printf(format, mdle_name, result_name, err_name);                                           \
+        }                                                                                               \
+    }
+
 #define START_FUNC_TESTS(vm, func)                                             \
     {                                                                          \
         const char *func_name = func;                                          \
@@ -275,6 +291,11 @@
     CALL(vm)           \
     END_TEST()
 
+#define TEST_EMPTY_TRAP(vm, err) \
+    START_TEST(vm)               \
+    CALL_AND_TRAP(vm, err)       \
+    END_TEST()
+
 #define TEST_IN_I32(vm, param_1) \
     START_TEST(vm)               \
     PUSH_I32(vm, param_1)        \
@@ -331,6 +352,14 @@
     CALL_AND_TRAP(vm, err)                              \
     END_TEST()
 
+#define TEST_IN_I32_I32_I32_TRAP(vm, param_1, param_2, param_3, err) \
+    START_TEST(vm)                                                   \
+    PUSH_I32(vm, param_1)                                            \
+    PUSH_I32(vm, param_2)                                            \
+    PUSH_I32(vm, param_3)                                            \
+    CALL_AND_TRAP(vm, err)                                           \
+    END_TEST()
+
 #define TEST_IN_I32_OUT_I64(vm, param_1, result) \
     START_TEST(vm)                               \
     PUSH_I32(vm, param_1)                        \
@@ -344,6 +373,34 @@
     POP_I64(vm, result)          \
     END_TEST()
 
+#define TEST_IN_I64_TRAP(vm, param_1, err) \
+    START_TEST(vm)                         \
+    PUSH_I64(vm, param_1)                  \
+    CALL_AND_TRAP(vm, err)                 \
+    END_TEST()
+
+#define TEST_IN_I64_I32(vm, param_1, param_2) \
+    START_TEST(vm)                            \
+    PUSH_I64(vm, param_1)                     \
+    PUSH_I32(vm, param_2)                     \
+    CALL(vm)                                  \
+    END_TEST()
+
+#define TEST_IN_I64_I32_OUT_I32(vm, param_1, param_2, result) \
+    START_TEST(vm)                                            \
+    PUSH_I64(vm, param_1)                                     \
+    PUSH_I32(vm, param_2)                                     \
+    CALL(vm)                                                  \
+    POP_I32(vm, result)                                       \
+    END_TEST()
+
+#define TEST_IN_I64_I32_TRAP(vm, param_1, param_2, err) \
+    START_TEST(vm)                                      \
+    PUSH_I64(vm, param_1)                               \
+    PUSH_I32(vm, param_2)                               \
+    CALL_AND_TRAP(vm, err)                              \
+    END_TEST()
+
 #define TEST_IN_I64_OUT_I64(vm, param_1, result) \
     START_TEST(vm)                               \
     PUSH_I64(vm, param_1)                        \
@@ -366,6 +423,40 @@
     POP_I64(vm, result)                                       \
     END_TEST()
 
+#define TEST_IN_I32_I64_OUT_I64(vm, param_1, param_2, result) \
+    START_TEST(vm)                                            \
+    PUSH_I32(vm, param_1)                                     \
+    PUSH_I64(vm, param_2)                                     \
+    CALL(vm)                                                  \
+    POP_I64(vm, result)                                       \
+    END_TEST()
+
+#define TEST_IN_I32_I32_I64_OUT_I32(vm, param_1, param_2, param_3, result) \
+    START_TEST(vm)                                                         \
+    PUSH_I32(vm, param_1)                                                  \
+    PUSH_I32(vm, param_2)                                                  \
+    PUSH_I64(vm, param_3)                                                  \
+    CALL(vm)                                                               \
+    POP_I32(vm, result)                                                    \
+    END_TEST()
+
+#define TEST_IN_I32_I64_I64_OUT_I32(vm, param_1, param_2, param_3, result) \
+    START_TEST(vm)                                                         \
+    PUSH_I32(vm, param_1)                                                  \
+    PUSH_I64(vm, param_2)                                                  \
+    PUSH_I64(vm, param_3)                                                  \
+    CALL(vm)                                                               \
+    POP_I32(vm, result)                                                    \
+    END_TEST()
+
+#define TEST_IN_I32_I32_I64_TRAP(vm, param_1, param_2, param_3, err) \
+    START_TEST(vm)                                                   \
+    PUSH_I32(vm, param_1)                                            \
+    PUSH_I32(vm, param_2)                                            \
+    PUSH_I64(vm, param_3)                                            \
+    CALL_AND_TRAP(vm, err)                                           \
+    END_TEST()
+
 #define TEST_IN_I32_I64_TRAP(vm, param_1, param_2, err) \
     START_TEST(vm)                                      \
     PUSH_I32(vm, param_1)                               \
@@ -106,6 +106,18 @@ void test_free(void *ptr)
     free(unaligned_ptr);
 }
 
+static wrp_instance_t *create_instance(wrp_vm_t *vm, wrp_wasm_mdle_t *mdle, const char *mdle_name)
+{
+    wrp_instance_t *instance = wrp_create_instance(vm, mdle);
+    ASSERT(instance, "failed to create instance of \"%s\"", mdle_name);
+    return instance;
+}
+
+static void link_instance(wrp_vm_t *vm, wrp_instance_t *instance, const char *mdle_name)
+{
+    ASSERT(wrp_link_instance(vm, instance) == WRP_SUCCESS, "failed to attach module \"%s\"", mdle_name);
+}
+
 void load_mdle(wrp_vm_t *vm,
     const char *dir,
     uint8_t *path_buf,
@@ -123,9 +135,125 @@ void load_mdle(wrp_vm_t *vm,
 
     wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
     ASSERT(mdle, "failed to instantiate \"%s\"", mdle_name);
-    ASSERT(wrp_link_mdle(vm, mdle) == WRP_SUCCESS, "failed to attach module \"%s\"", mdle_name);
+    link_instance(vm, create_instance(vm, mdle, mdle_name), mdle_name);
+
+    free(buf.bytes);
+}
+
+void load_mdle_in_place(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    wrp_buf_t *out_buf)
+{
+    wrp_reset_vm(vm);
+
+    printf("loading test module %s in place\n", mdle_name);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+    ASSERT(load_buf(path_buf, out_buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle_in_place(vm, out_buf);
+    ASSERT(mdle, "failed to instantiate \"%s\"", mdle_name);
+    link_instance(vm, create_instance(vm, mdle, mdle_name), mdle_name);
+}
+
+//feeds chunk_sz bytes at a time and stops after max_sz bytes
+static wrp_wasm_mdle_t *stream_buf(wrp_vm_t *vm, wrp_buf_t *buf, size_t chunk_sz, size_t max_sz)
+{
+    wrp_stream_t *stream = wrp_stream_begin(vm);
+    ASSERT(stream, "failed to begin stream");
+
+    size_t sz = buf->sz < max_sz ? buf->sz : max_sz;
+
+    for (size_t pos = 0; pos < sz; pos += chunk_sz) {
+        size_t num_bytes = sz - pos < chunk_sz ? sz - pos : chunk_sz;
+
+        if (wrp_stream_feed(vm, stream, &buf->bytes[pos], num_bytes) != WRP_SUCCESS) {
+            break;
+        }
+    }
+
+    wrp_err_t feed_err = vm->err;
+    wrp_wasm_mdle_t *mdle = wrp_stream_finish(vm, stream);
+    ASSERT(feed_err == WRP_SUCCESS || vm->err == feed_err, "stream finished with a different error");
+
+    return mdle;
+}
+
+void load_mdle_streamed(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    size_t chunk_sz)
+{
+    wrp_reset_vm(vm);
+
+    printf("streaming test module %s in %zu byte chunks\n", mdle_name, chunk_sz);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = stream_buf(vm, &buf, chunk_sz, buf.sz);
+    ASSERT(mdle, "failed to instantiate \"%s\"", mdle_name);
+    link_instance(vm, create_instance(vm, mdle, mdle_name), mdle_name);
+
+    free(buf.bytes);
+}
+
+wrp_err_t stream_mdle(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    size_t chunk_sz,
+    size_t max_sz)
+{
+    wrp_reset_vm(vm);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = stream_buf(vm, &buf, chunk_sz, max_sz);
+
+    if (mdle != NULL) {
+        wrp_destroy_mdle(vm, mdle);
+    }
 
     free(buf.bytes);
+    return vm->err;
+}
+
+wrp_err_t serialize_mdle(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    wrp_buf_t *out_image)
+{
+    wrp_reset_vm(vm);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
+    free(buf.bytes);
+
+    if (mdle == NULL) {
+        return vm->err;
+    }
+
+    wrp_err_t err = wrp_serialize_mdle(vm, mdle, out_image);
+    wrp_destroy_mdle(vm, mdle);
+    return err;
 }
 
 wrp_err_t validate_mdle(wrp_vm_t *vm,
@@ -192,14 +320,23 @@ wrp_err_t link_mdle(wrp_vm_t *vm,
     uint64_t *globals = test_alloc(sizeof(uint64_t) * num_global_imports, alignof(uint64_t));
     uint32_t current_global = 0;
 
+    wrp_instance_t *instance = create_instance(vm, mdle, mdle_name);
+
     for(uint32_t i = 0; i < mdle->num_imports; i++){
         if(mdle->imports[i].kind == EXTERNAL_GLOBAL){
-            wrp_import_global(mdle, &globals[current_global++], mdle->imports[i].idx);
+            wrp_import_global(instance, &globals[current_global++], mdle->imports[i].idx);
         }
     }
 
-    wrp_err_t result = wrp_link_mdle(vm, mdle);
+    wrp_err_t result = wrp_link_instance(vm, instance);
+
+    if (result == WRP_SUCCESS) {
+        wrp_unlink_instance(vm);
+    }
+
+    wrp_destroy_instance(vm, instance);
     wrp_destroy_mdle(vm, mdle);
+    test_free(globals);
     return result;
 }
 
@@ -208,6 +345,190 @@ void unload_mdle(wrp_vm_t *vm)
     printf("unloading test module\n\n");
 
     wrp_wasm_mdle_t *mdle = vm->mdle;
-    ASSERT(wrp_unlink_mdle(vm) == WRP_SUCCESS, "failed to detach modile");
+    wrp_instance_t *instance = vm->instance;
+    ASSERT(wrp_unlink_instance(vm) == WRP_SUCCESS, "failed to detach modile");
+    wrp_destroy_instance(vm, instance);
+    wrp_destroy_mdle(vm, mdle);
+}
+
+void relink_mdle(wrp_vm_t *vm)
+{
+    printf("relinking test module\n");
+
+    wrp_instance_t *instance = vm->instance;
+    ASSERT(wrp_unlink_instance(vm) == WRP_SUCCESS, "failed to detach module");
+    wrp_reset_instance(vm, instance);
+    wrp_reset_vm(vm);
+    ASSERT(wrp_link_instance(vm, instance) == WRP_SUCCESS, "failed to attach module");
+}
+
+void load_mdle_with_memory(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    wrp_memory_t *memory)
+{
+    wrp_reset_vm(vm);
+
+    printf("loading test module %s\n", mdle_name);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
+    ASSERT(mdle, "failed to instantiate \"%s\"", mdle_name);
+
+    wrp_instance_t *instance = create_instance(vm, mdle, mdle_name);
+
+    uint32_t import_idx = 0;
+    ASSERT(wrp_find_import(mdle, "env", "memory", &import_idx) == WRP_SUCCESS, "\"%s\" doesn't import memory", mdle_name);
+    ASSERT(wrp_import_memory(instance, memory, mdle->imports[import_idx].idx) == WRP_SUCCESS,
+        "failed to import memory into \"%s\"", mdle_name);
+
+    link_instance(vm, instance, mdle_name);
+
+    free(buf.bytes);
+}
+
+void load_mdle_with_global(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    uint64_t *global)
+{
+    wrp_reset_vm(vm);
+
+    printf("loading test module %s\n", mdle_name);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
+    ASSERT(mdle, "failed to instantiate \"%s\"", mdle_name);
+
+    wrp_instance_t *instance = create_instance(vm, mdle, mdle_name);
+
+    uint32_t import_idx = 0;
+    ASSERT(wrp_find_import(mdle, "env", "global", &import_idx) == WRP_SUCCESS, "\"%s\" doesn't import a global", mdle_name);
+    ASSERT(wrp_import_global(instance, global, mdle->imports[import_idx].idx) == WRP_SUCCESS,
+        "failed to import global into \"%s\"", mdle_name);
+
+    link_instance(vm, instance, mdle_name);
+
+    free(buf.bytes);
+}
+
+void load_mdle_with_registry(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    const wrp_registry_t *registry)
+{
+    wrp_reset_vm(vm);
+
+    printf("loading test module %s\n", mdle_name);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
+    ASSERT(mdle, "failed to instantiate \"%s\"", mdle_name);
+
+    wrp_instance_t *instance = create_instance(vm, mdle, mdle_name);
+    ASSERT(wrp_import_registry(instance, registry) == WRP_SUCCESS, "failed to import registry into \"%s\"", mdle_name);
+    link_instance(vm, instance, mdle_name);
+
+    free(buf.bytes);
+}
+
+wrp_err_t link_mdle_with_registry(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    const wrp_registry_t *registry)
+{
+    wrp_reset_vm(vm);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
+    free(buf.bytes);
+
+    if (mdle == NULL) {
+        return vm->err;
+    }
+
+    wrp_instance_t *instance = create_instance(vm, mdle, mdle_name);
+    wrp_err_t result = wrp_import_registry(instance, registry);
+
+    if (result == WRP_SUCCESS && (result = wrp_link_instance(vm, instance)) == WRP_SUCCESS) {
+        wrp_unlink_instance(vm);
+    }
+
+    wrp_destroy_instance(vm, instance);
+    wrp_destroy_mdle(vm, mdle);
+    return result;
+}
+
+wrp_instance_t *load_instance(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name)
+{
+    printf("loading test module %s\n", mdle_name);
+
+    ASSERT(make_path(dir, mdle_name, path_buf, path_buf_sz), "failed to make path to \"%s\"", mdle_name);
+
+    wrp_buf_t buf = {0};
+    ASSERT(load_buf(path_buf, &buf), "failed to load \"%s\"", mdle_name);
+
+    wrp_wasm_mdle_t *mdle = wrp_instantiate_mdle(vm, &buf);
+    ASSERT(mdle, "failed to instantiate \"%s\"", mdle_name);
+    free(buf.bytes);
+
+    return create_instance(vm, mdle, mdle_name);
+}
+
+void unload_instance(wrp_vm_t *vm, wrp_instance_t *instance)
+{
+    wrp_wasm_mdle_t *mdle = instance->mdle;
+    wrp_destroy_instance(vm, instance);
     wrp_destroy_mdle(vm, mdle);
 }
+
+void test_check(const char *group, bool condition, const char *name, uint32_t *passed, uint32_t *failed)
+{
+    if (condition) {
+        (*passed)++;
+    } else {
+        (*failed)++;
+        printf("%s test %s failed\n", group, name);
+    }
+}
+
+uint32_t find_func(wrp_vm_t *vm, const char *func_name)
+{
+    uint32_t func_idx = 0;
+    ASSERT(wrp_export_func(vm->mdle, func_name, &func_idx) == WRP_SUCCESS, "function %s does not exist in module!", func_name);
+    return func_idx;
+}
+
+bool pop_result(wrp_vm_t *vm, int32_t expected)
+{
+    int32_t result = 0;
+    return wrp_stk_exec_pop_i32(vm, &result) == WRP_SUCCESS && result == expected && vm->oprd_stk_head == -1;
+}
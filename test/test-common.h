@@ -44,6 +44,38 @@ void load_mdle(wrp_vm_t *vm,
     size_t path_buf_sz,
     const char *mdle_name);
 
+//the module references out_buf, free its bytes after unloading
+void load_mdle_in_place(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    wrp_buf_t *out_buf);
+
+void load_mdle_streamed(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    size_t chunk_sz);
+
+//streams at most max_sz bytes of the module and returns the error, if any
+wrp_err_t stream_mdle(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    size_t chunk_sz,
+    size_t max_sz);
+
+//the image is allocated with the vm's allocator
+wrp_err_t serialize_mdle(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    wrp_buf_t *out_image);
+
 wrp_err_t validate_mdle(wrp_vm_t *vm,
     const char *dir,
     uint8_t *path_buf,
@@ -56,4 +88,54 @@ wrp_err_t link_mdle(wrp_vm_t *vm,
         size_t path_buf_sz,
         const char *mdle_name);
 
+//memory is imported as "env" "memory"
+void load_mdle_with_memory(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    wrp_memory_t *memory);
+
+//global is imported as "env" "global"
+void load_mdle_with_global(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    uint64_t *global);
+
+//every import is bound from registry
+void load_mdle_with_registry(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    const wrp_registry_t *registry);
+
+wrp_err_t link_mdle_with_registry(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name,
+    const wrp_registry_t *registry);
+
+//an instance that isn't linked, for other instances to import from
+wrp_instance_t *load_instance(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    const char *mdle_name);
+
+void unload_instance(wrp_vm_t *vm, wrp_instance_t *instance);
+
 void unload_mdle(wrp_vm_t *vm);
+
+void relink_mdle(wrp_vm_t *vm);
+
+//counts a check of a group of tests, printing the name of any that fail
+void test_check(const char *group, bool condition, const char *name, uint32_t *passed, uint32_t *failed);
+
+uint32_t find_func(wrp_vm_t *vm, const char *func_name);
+
+//true when the only operand left is the expected i32
+bool pop_result(wrp_vm_t *vm, int32_t expected);
@@ -0,0 +1,137 @@
+/*
+ *  Copyright 2017 Adam Dicker
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+ */
+
+#include "validate-tests.h"
+#include "test-builder.h"
+#include "test-common.h"
+
+//a host pool that runs every worker on the calling thread
+static void run_workers_serially(void *pool, uint32_t num_workers, wrp_task_fn_t task, void *arg)
+{
+    uint32_t *num_runs = pool;
+
+    for (uint32_t i = 0; i < num_workers; i++) {
+        task(arg);
+        (*num_runs)++;
+    }
+}
+
+static void run_validate_mdle_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    load_mdle(vm, dir, path_buf, path_buf_sz, "validate.0.wasm");
+
+    START_FUNC_TESTS(vm, "f0");
+    TEST_IN_I32_OUT_I32(vm, 1, 0);
+    TEST_IN_I32_OUT_I32(vm, 0, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f1");
+    TEST_IN_I32_OUT_I32(vm, 1, 1);
+    TEST_IN_I32_OUT_I32(vm, 0, -1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f31");
+    TEST_IN_I32_OUT_I32(vm, 1, 31);
+    TEST_IN_I32_OUT_I32(vm, 0, -31);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f63");
+    TEST_IN_I32_OUT_I32(vm, 1, 63);
+    TEST_IN_I32_OUT_I32(vm, 0, -63);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+
+    TEST_MODULE(vm, dir, path_buf, path_buf_sz, "validate.1.wasm", WRP_ERR_TYPE_MISMATCH, (*passed), (*failed));
+}
+
+void run_validate_tests(wrp_vm_t *vm,
+    const char *dir,
+    uint8_t *path_buf,
+    size_t path_buf_sz,
+    uint32_t *passed,
+    uint32_t *failed)
+{
+    run_validate_mdle_tests(vm, dir, path_buf, path_buf_sz, passed, failed);
+
+    //default worker threads
+    wrp_thread_pool_t pool = {.run_workers = NULL, .pool = NULL, .num_workers = 4};
+    wrp_set_thread_pool(vm, &pool);
+    run_validate_mdle_tests(vm, dir, path_buf, path_buf_sz, passed, failed);
+    ASSERT(vm->num_check_workers == 3, "opened %u check workers, expected 3", vm->num_check_workers);
+
+    //later modules validate on the same scratch vms
+    wrp_vm_t *check_worker = vm->check_workers[0];
+
+    //host supplied pool
+    uint32_t num_runs = 0;
+    pool.run_workers = run_workers_serially;
+    pool.pool = &num_runs;
+    wrp_set_thread_pool(vm, &pool);
+    run_validate_mdle_tests(vm, dir, path_buf, path_buf_sz, passed, failed);
+    ASSERT(num_runs == 8, "host pool ran %u workers, expected 8", num_runs);
+    ASSERT(vm->num_check_workers == 3 && vm->check_workers[0] == check_worker, "check workers weren't reused");
+
+    wrp_set_thread_pool(vm, NULL);
+
+    //lazy validation checks each function on its first call
+    wrp_set_lazy_validation(vm, true);
+    load_mdle(vm, dir, path_buf, path_buf_sz, "validate.1.wasm");
+    ASSERT(!vm->mdle->funcs[0].validated, "function validated before its first call");
+
+    START_FUNC_TESTS(vm, "f0");
+    TEST_IN_I32_OUT_I32(vm, 1, 0);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f9");
+    TEST_IN_I32_OUT_I32(vm, 0, -9);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f10");
+    TEST_IN_I32_TRAP(vm, 1, WRP_ERR_TYPE_MISMATCH);
+    TEST_IN_I32_TRAP(vm, 1, WRP_ERR_TYPE_MISMATCH);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    START_FUNC_TESTS(vm, "f25");
+    TEST_IN_I32_TRAP(vm, 1, WRP_ERR_INVALID_FUNC_IDX);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    ASSERT(vm->mdle->funcs[0].validated && !vm->mdle->funcs[1].validated, "unexpected lazily validated functions");
+    ASSERT(wrp_validate_mdle(vm, vm->mdle) == WRP_ERR_TYPE_MISMATCH, "validating all functions did not fail");
+    unload_mdle(vm);
+
+    load_mdle(vm, dir, path_buf, path_buf_sz, "validate.0.wasm");
+
+    START_FUNC_TESTS(vm, "f63");
+    TEST_IN_I32_OUT_I32(vm, 1, 63);
+    TEST_IN_I32_OUT_I32(vm, 0, -63);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    ASSERT(wrp_validate_mdle(vm, vm->mdle) == WRP_SUCCESS, "failed to validate all functions");
+    ASSERT(vm->mdle->funcs[0].validated && vm->mdle->funcs[62].validated, "functions left unvalidated");
+
+    START_FUNC_TESTS(vm, "f1");
+    TEST_IN_I32_OUT_I32(vm, 1, 1);
+    END_FUNC_TESTS((*passed), (*failed));
+
+    unload_mdle(vm);
+    wrp_set_lazy_validation(vm, false);
+}
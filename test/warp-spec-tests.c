@@ -17,6 +17,8 @@
 #include <stdalign.h>
 #include <stdint.h>
 
+#include "async-tests.h"
+#include "atomic-tests.h"
 #include "block-tests.h"
 #include "br-tests.h"
 #include "br_if-tests.h"
@@ -25,13 +27,28 @@
 #include "const-tests.h"
 #include "f32-tests.h"
 #include "f64-tests.h"
+#include "fuel-tests.h"
+#include "globals-tests.h"
 #include "i32-tests.h"
 #include "i64-tests.h"
 #include "if-tests.h"
+#include "image-tests.h"
+#include "instance-tests.h"
+#include "limits-tests.h"
+#include "linking-tests.h"
 #include "loop-tests.h"
 #include "memory-tests.h"
+#include "memory64-tests.h"
 #include "nop-tests.h"
+#include "pool-tests.h"
+#include "registry-tests.h"
+#include "resume-tests.h"
 #include "return-tests.h"
+#include "scheduler-tests.h"
+#include "snapshot-tests.h"
+#include "stream-tests.h"
+#include "table-tests.h"
+#include "validate-tests.h"
 #include "test-common.h"
 
 #define MAX_FILE_PATH 4096
@@ -71,6 +88,8 @@ int main(int argc, char **argv)
 
     uint32_t passed = 0;
     uint32_t failed = 0;
+    run_async_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_atomic_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_block_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_br_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_br_if_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
@@ -79,13 +98,28 @@ int main(int argc, char **argv)
     run_const_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_f32_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_f64_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_fuel_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_globals_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_i32_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_i64_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_if_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_image_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_instance_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_limits_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_linking_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_loop_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_memory_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_memory64_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_nop_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_pool_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_registry_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_resume_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
     run_return_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_scheduler_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_snapshot_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_stream_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_table_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
+    run_validate_tests(vm, argv[1], path_buf, MAX_FILE_PATH + 1, &passed, &failed);
 
     test_free(path_buf);
     wrp_close_vm(vm);